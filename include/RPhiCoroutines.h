@@ -0,0 +1,464 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+// The coroutine support requires a C++20 compiler. The rest of the library doesn't
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <optional>
+#include <vector>
+#include "RPhiDeviceManager.h"
+#include "RPhiSpatial.h"
+
+namespace RPhi
+{
+
+/*
+	Executor
+
+	Decides where and when the coroutines awaiting device events are resumed. 
+	The events are raised by DeviceManager::update() (or dispatch()), on the 
+	thread calling it, which the executor can hand the coroutine over from.
+*/
+class Executor
+{
+public:
+	virtual ~Executor() {}
+	virtual void schedule( std::coroutine_handle<> handle ) = 0;
+};
+
+/*
+	InlineExecutor
+
+	Resumes the coroutines right away, from within DeviceManager::update()
+*/
+class InlineExecutor : public Executor
+{
+public:
+	virtual void schedule( std::coroutine_handle<> handle )	{ handle.resume(); }
+};
+
+/*
+	ManualExecutor
+
+	Queues the coroutines and resumes them when run() is called, typically after
+	DeviceManager::update() on the same thread. Once the queue has grown to its 
+	working size, scheduling a coroutine doesn't allocate memory.
+*/
+class ManualExecutor : public Executor
+{
+public:
+	virtual void schedule( std::coroutine_handle<> handle )	{ mScheduledHandles.push_back( handle ); }
+
+	// Resume the coroutines scheduled so far and return how many there were. The 
+	// coroutines scheduled while running are resumed by the next call
+	std::size_t run()
+	{
+		mRunningHandles.swap( mScheduledHandles );
+		for ( std::size_t i=0; i<mRunningHandles.size(); ++i )
+			mRunningHandles[i].resume();
+		std::size_t numHandles = mRunningHandles.size();
+		mRunningHandles.clear();
+		return numHandles;
+	}
+
+private:
+	std::vector< std::coroutine_handle<> > mScheduledHandles;
+	std::vector< std::coroutine_handle<> > mRunningHandles;
+};
+
+/*
+	AsyncEvent
+
+	An event that coroutines can co_await. Each awaiting coroutine is resumed on
+	its executor with the next value raised. When the event is closed, they are
+	resumed with a default-constructed value instead.
+
+	The waiters live in the frames of the awaiting coroutines and are chained 
+	together, so awaiting an event doesn't allocate memory. A coroutine which is 
+	destroyed while awaiting removes itself from the event.
+
+	A Waiter can consume several values before completing (see 
+	AsyncSpatial::nextMeasures()), by returning false from deliver().
+*/
+template<typename T>
+class AsyncEvent
+{
+public:
+	AsyncEvent()
+		: mFirstWaiter(nullptr),
+		  mLastWaiter(nullptr),
+		  mClosed(false)
+	{
+	}
+
+	~AsyncEvent()
+	{
+		close();
+	}
+
+	class Waiter
+	{
+	public:
+		Waiter( AsyncEvent* event, Executor* executor )
+			: mEvent(event),
+			  mExecutor(executor),
+			  mHandle(),
+			  mNext(nullptr),
+			  mWaiting(false)
+		{
+		}
+
+		virtual ~Waiter()
+		{
+			if ( mWaiting )
+				mEvent->remove( this );
+		}
+
+		bool	await_ready() const noexcept			{ return mEvent->isClosed(); }
+		void	await_suspend( std::coroutine_handle<> handle )
+		{
+			mHandle = handle;
+			mEvent->add( this );
+		}
+
+	protected:
+		friend class AsyncEvent;
+
+		// Consume a value and return whether the waiter is done
+		virtual bool	deliver( const T& value ) = 0;
+
+	private:
+		AsyncEvent*				mEvent;
+		Executor*				mExecutor;
+		std::coroutine_handle<>	mHandle;
+		Waiter*					mNext;
+		bool					mWaiting;
+	};
+
+	// Awaits the next value
+	class NextValue : public Waiter
+	{
+	public:
+		NextValue( AsyncEvent* event, Executor* executor )
+			: Waiter( event, executor ),
+			  mValue()
+		{
+		}
+
+		T				await_resume()					{ return mValue; }
+
+	protected:
+		virtual bool	deliver( const T& value )		{ mValue = value; return true; }
+
+	private:
+		T				mValue;
+	};
+
+	NextValue	next( Executor& executor )				{ return NextValue( this, &executor ); }
+
+	bool		isClosed() const						{ return mClosed; }
+	bool		hasWaiters() const						{ return mFirstWaiter!=nullptr; }
+
+	// Deliver the value to the current waiters and schedule the ones that are done.
+	// The waiters added in the meantime (by coroutines resumed inline) wait for the 
+	// next value
+	void raise( const T& value )
+	{
+		Waiter* waiter = mFirstWaiter;
+		mFirstWaiter = nullptr;
+		mLastWaiter = nullptr;
+		while ( waiter )
+		{
+			Waiter* next = waiter->mNext;
+			waiter->mNext = nullptr;
+			if ( waiter->deliver( value ) )
+			{
+				waiter->mWaiting = false;
+				waiter->mExecutor->schedule( waiter->mHandle );
+			}
+			else
+			{
+				append( waiter );
+			}
+			waiter = next;
+		}
+	}
+
+	// Resume all the waiters, and the coroutines awaiting afterwards, without a value
+	void close()
+	{
+		mClosed = true;
+		Waiter* waiter = mFirstWaiter;
+		mFirstWaiter = nullptr;
+		mLastWaiter = nullptr;
+		while ( waiter )
+		{
+			Waiter* next = waiter->mNext;
+			waiter->mNext = nullptr;
+			waiter->mWaiting = false;
+			waiter->mExecutor->schedule( waiter->mHandle );
+			waiter = next;
+		}
+	}
+
+private:
+	AsyncEvent( const AsyncEvent& );
+	AsyncEvent& operator=( const AsyncEvent& );
+
+	void add( Waiter* waiter )
+	{
+		if ( mClosed )
+		{
+			waiter->mExecutor->schedule( waiter->mHandle );
+			return;
+		}
+		waiter->mWaiting = true;
+		append( waiter );
+	}
+
+	void append( Waiter* waiter )
+	{
+		if ( mLastWaiter )
+			mLastWaiter->mNext = waiter;
+		else
+			mFirstWaiter = waiter;
+		mLastWaiter = waiter;
+	}
+
+	void remove( Waiter* waiter )
+	{
+		Waiter* previous = nullptr;
+		for ( Waiter* current=mFirstWaiter; current; current=current->mNext )
+		{
+			if ( current==waiter )
+			{
+				if ( previous )
+					previous->mNext = current->mNext;
+				else
+					mFirstWaiter = current->mNext;
+				if ( mLastWaiter==current )
+					mLastWaiter = previous;
+				return;
+			}
+			previous = current;
+		}
+	}
+
+	Waiter*		mFirstWaiter;
+	Waiter*		mLastWaiter;
+	bool		mClosed;
+};
+
+/*
+	AsyncDeviceManager
+
+	Exposes the device connections and disconnections of a DeviceManager as 
+	awaitable events:
+
+		Device* device = co_await asyncDeviceManager.nextDeviceConnected();
+	
+	The awaited Device is null when the AsyncDeviceManager is destroyed. A 
+	disconnecting Device is deleted once all the listeners have been notified:
+	the coroutines awaiting nextDeviceDisconnecting() must be resumed inline
+	to access it. Likewise, in background acquisition mode, a single dispatch()
+	can connect and disconnect a Device: a coroutine resumed later by the 
+	executor should check that the Device is still in DeviceManager::getDevices().
+*/
+class AsyncDeviceManager : public DeviceManager::Listener
+{
+public:
+	AsyncDeviceManager( DeviceManager& deviceManager, Executor& executor )
+		: mDeviceManager(deviceManager),
+		  mExecutor(executor),
+		  mConnected(),
+		  mDisconnecting()
+	{
+		mDeviceManager.addListener( this );
+	}
+
+	virtual ~AsyncDeviceManager()
+	{
+		mDeviceManager.removeListener( this );
+	}
+
+	typedef AsyncEvent<Device*> DeviceEvent;
+	DeviceEvent::NextValue		nextDeviceConnected()		{ return mConnected.next( mExecutor ); }
+	DeviceEvent::NextValue		nextDeviceDisconnecting()	{ return mDisconnecting.next( mExecutor ); }
+
+	DeviceManager&				getDeviceManager() const	{ return mDeviceManager; }
+	Executor&					getExecutor() const			{ return mExecutor; }
+
+	virtual void onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )		{ mConnected.raise( device ); }
+	virtual void onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )	{ mDisconnecting.raise( device ); }
+
+private:
+	DeviceManager&				mDeviceManager;
+	Executor&					mExecutor;
+	DeviceEvent					mConnected;
+	DeviceEvent					mDisconnecting;
+};
+
+/*
+	AsyncDevice
+
+	Exposes the changes of a Device as an awaitable event:
+
+		while ( co_await asyncDevice.nextChange() ) 
+			...
+
+	nextChange() returns false once the Device has been disconnected (or the 
+	AsyncDevice destroyed), after which the Device mustn't be accessed anymore.
+	The AsyncDevice subscribes to the given channels of the Device only.
+*/
+class AsyncDevice : public Device::Listener, public DeviceManager::Listener
+{
+public:
+	AsyncDevice( DeviceManager& deviceManager, Device& device, Executor& executor, Device::ChannelMask channelMask=Device::kAllChannels )
+		: mDeviceManager(deviceManager),
+		  mDevice(&device),
+		  mExecutor(executor),
+		  mChanged()
+	{
+		mDeviceManager.addListener( this );
+		mDevice->addListener( this, channelMask );
+	}
+
+	virtual ~AsyncDevice()
+	{
+		if ( !mDevice )
+			return;
+		mDeviceManager.removeListener( this );
+		mDevice->removeListener( this );
+	}
+
+	AsyncEvent<bool>::NextValue	nextChange()				{ return mChanged.next( mExecutor ); }
+
+	// Null once the Device is disconnected
+	Device*						getDevice() const			{ return mDevice; }
+	Executor&					getExecutor() const			{ return mExecutor; }
+
+	virtual void onDeviceChanged( Device* /*device*/ )		{ mChanged.raise( true ); }
+
+	virtual void onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+	{
+		if ( device!=mDevice )
+			return;
+		// From now on, neither the Device nor the DeviceManager are accessed. This lets
+		// the coroutines resume after the DeviceManager is destroyed
+		mDevice->removeListener( this );
+		mDevice = nullptr;
+		mDeviceManager.removeListener( this );
+		onDeviceClosed();
+	}
+
+protected:
+	// Resume the awaiting coroutines without a value
+	virtual void onDeviceClosed()							{ mChanged.close(); }
+
+private:
+	DeviceManager&				mDeviceManager;
+	Device*						mDevice;
+	Executor&					mExecutor;
+	AsyncEvent<bool>			mChanged;
+};
+
+/*
+	AsyncSpatial
+
+	Exposes the measures of a Spatial as awaitable events. nextMeasure() awaits
+	a single measure and returns an empty optional once the Spatial has been 
+	disconnected. nextMeasures() awaits a block of measures and returns how many 
+	were stored into it (less than requested once the Spatial is disconnected):
+
+		Spatial::Measure block[64];
+		while ( co_await asyncSpatial.nextMeasures( block, 64 )==64 )
+			...
+*/
+class AsyncSpatial : public AsyncDevice
+{
+public:
+	AsyncSpatial( DeviceManager& deviceManager, Spatial& spatial, Executor& executor )
+		: AsyncDevice( deviceManager, spatial, executor ),
+		  mMeasures()
+	{
+	}
+
+	typedef AsyncEvent< std::optional<Spatial::Measure> > MeasureEvent;
+	MeasureEvent::NextValue		nextMeasure()				{ return mMeasures.next( getExecutor() ); }
+
+	class NextMeasures : public MeasureEvent::Waiter
+	{
+	public:
+		NextMeasures( MeasureEvent* event, Executor* executor, Spatial::Measure* measures, std::size_t numMeasures )
+			: MeasureEvent::Waiter( event, executor ),
+			  mMeasures(measures),
+			  mNumMeasures(numMeasures),
+			  mNumStoredMeasures(0)
+		{
+		}
+
+		bool			await_ready() const noexcept		{ return mNumMeasures==0 || MeasureEvent::Waiter::await_ready(); }
+		std::size_t		await_resume()						{ return mNumStoredMeasures; }
+
+	protected:
+		virtual bool deliver( const std::optional<Spatial::Measure>& measure )
+		{
+			mMeasures[mNumStoredMeasures++] = *measure;
+			return mNumStoredMeasures>=mNumMeasures;
+		}
+
+	private:
+		Spatial::Measure*	mMeasures;
+		std::size_t			mNumMeasures;
+		std::size_t			mNumStoredMeasures;
+	};
+
+	NextMeasures nextMeasures( Spatial::Measure* measures, std::size_t numMeasures )	
+	{ 
+		return NextMeasures( &mMeasures, &getExecutor(), measures, numMeasures ); 
+	}
+
+	virtual void onDeviceChanged( Device* device )
+	{
+		AsyncDevice::onDeviceChanged( device );
+		if ( mMeasures.hasWaiters() )
+			mMeasures.raise( static_cast<Spatial*>(device)->getMeasure() );
+	}
+
+protected:
+	virtual void onDeviceClosed()
+	{
+		AsyncDevice::onDeviceClosed();
+		mMeasures.close();
+	}
+
+private:
+	MeasureEvent				mMeasures;
+};
+
+}
+
+#endif
@@ -25,6 +25,9 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
+#include "RPhiRecording.h"
+#include "RPhiStatistics.h"
 typedef struct _CPhidget *CPhidgetHandle;
 
 namespace RPhi
@@ -61,25 +64,83 @@ public:
 	int					getVersion() const			{ return mVersion; }
 	bool				isAttached() const;		
 	const std::string&	getTypeName() const			{ return mTypeName; }
-	const char*			getLabel() const;
+	
+	// The label is read when the Device is created and then only changed by setLabel()
+	const char*			getLabel() const			{ return mLabel.c_str(); }
 	void				setLabel( const char* label );
 	
+	// A Device can expose several channels (for example each Thermocouple of a 
+	// TemperatureSensor). Listeners can subscribe to a subset of them using a mask
+	// where channel N is represented by bit N
+	typedef unsigned int ChannelMask;
+	static const ChannelMask kAllChannels = 0xffffffff;
+	static ChannelMask	getChannelMask( int channel )	{ return static_cast<ChannelMask>(1) << channel; }
+
+	// Samples produced by the hardware which never made it to the client code, 
+	// because the device wasn't polled often enough or because its measures were
+	// dropped on the way (see DeviceManager::startAcquisition()). Gaps are 
+	// detected by the devices with a known data rate, like the Spatial
+	struct Gap
+	{
+		int64_t			mStartTimeInUs;		// Time of the last measure before the gap
+		int64_t			mEndTimeInUs;		// Time of the first measure after the gap
+		uint64_t		mNumLostSamples;
+	};
+
+	// What exactly changed in a device. Each field is one value of a channel with its
+	// previous and new values: an axis of a sensor of a Spatial, the temperature (0)
+	// or the potential (1) of a Thermocouple, the ambient temperature (0). Only the 
+	// fields which changed are listed
+	struct Delta
+	{
+		struct Field
+		{
+			int			mChannel;
+			int			mIndex;
+			double		mOldValue;
+			double		mNewValue;
+		};
+
+		ChannelMask		mChangedChannels;
+		const Field*	mFields;
+		std::size_t		mNumFields;
+	};
+
 	class Listener
 	{
 	public:
 		virtual ~Listener() {}
 		virtual void onDeviceChanged( Device* /*device*/ ) {}
+		
+		// Called before onDeviceChanged() for the first measure after a gap, so that 
+		// the code integrating the measures can reset instead of drifting
+		virtual void onDeviceGap( Device* /*device*/, const Gap& /*gap*/ ) {}
+
+		// Called after onDeviceChanged() with what changed, so that a listener can 
+		// process the deltas only instead of comparing the whole device. A decimated
+		// listener (see Spatial::setListenerDataRateInMs()) gets the delta of the 
+		// changes it's notified of only
+		virtual void onDeviceDelta( Device* /*device*/, const Delta& /*delta*/ ) {}
 	};
 
-	void				addListener( Listener* listener );
+	void				addListener( Listener* listener, ChannelMask channelMask=kAllChannels );
 	bool				removeListener( Listener* listener );
 	void				removeListeners();
+	ChannelMask			getListenerChannelMask( Listener* listener ) const;
+	ChannelMask			getSubscribedChannels() const;
 	
+	// Runtime counters, see DeviceStatistics
+	const DeviceStatistics& getStatistics() const	{ return mStatistics; }
+
 	virtual std::string toString() const;
 
 protected:
 	Device( Type type, CPhidgetHandle phidgetSpecificHandle );
 	
+	// Create a Device which isn't backed by a Phidget (see ReplayDeviceManager). 
+	// Such a device is always attached and has no label
+	Device( Type type, const std::string& name, int serialNumber, int version, const std::string& typeName );
+	
 	friend class DeviceManager;
 	virtual ~Device();
 
@@ -90,6 +151,50 @@ protected:
 	
 	typedef				std::vector<Listener*> Listeners; 
 	const Listeners&	getListeners() const { return mListeners; }	
+	
+	// Notify the listeners subscribed to at least one of the changed channels, with 
+	// the fields added since the previous notification as delta
+	void				notifyDeviceChanged( ChannelMask changedChannels );
+	void				addDeltaField( int channel, int index, double oldValue, double newValue );
+
+	// Count the gap and notify all the listeners
+	void				notifyDeviceGap( const Gap& gap );
+
+	// Notify the listener of one change out of decimation only (see Spatial::setListenerDataRateInMs())
+	void				setListenerDecimation( Listener* listener, unsigned int decimation );
+
+	// Called once a listener got removed
+	virtual void		onListenerRemoved( Listener* /*listener*/ ) {}
+
+	// Count the C API calls which failed or returned EPHIDGET_UNKNOWNVAL
+	void				countFailedCall()			{ mStatistics.mNumFailedCalls.fetch_add( 1, std::memory_order_relaxed ); }
+	void				countUnknownValue()			{ mStatistics.mNumUnknownValues.fetch_add( 1, std::memory_order_relaxed ); }
+
+	// Background acquisition (see DeviceManager::startAcquisition()).
+	// acquire() is called by the acquisition thread. It reads the Phidget and appends 
+	// a record for each polled measure that changed since its previous call (all of 
+	// them when resync is true). It mustn't touch the state seen by the client code.
+	// applyRecord() is called by the thread dispatching the records. It updates the 
+	// measure from the record and returns the channels that changed
+	virtual void		acquire( ChannelMask /*polledChannels*/, bool /*resync*/, int64_t /*timeInUs*/, std::vector<Record>& /*records*/ ) {}
+	virtual ChannelMask	applyRecord( const Record& /*record*/ )		{ return 0; }
+
+	// The channels a measure record is about
+	virtual ChannelMask	getRecordChannels( const Record& record ) const	{ return getChannelMask( record.mChannel ); }
+
+	// The channels worth polling and the marking of those that aren't
+	virtual ChannelMask	getPolledChannels() const		{ return kAllChannels; }
+	virtual void		setStaleChannels( ChannelMask /*channels*/ ) {}
+
+	// The type specific part of the records (see RecordBuilder). appendDescription()
+	// completes the kDeviceAttached record at attachedRecordIndex and appends the
+	// records describing the device, appendMeasures() appends the current measures
+	// of the given channels. setDescription() does the opposite for a device which
+	// isn't backed by a Phidget, from the kDeviceAttached record and the ones after it
+	friend class RecordBuilder;
+	virtual void		appendDescription( std::size_t /*attachedRecordIndex*/, int64_t /*timeInUs*/, std::vector<Record>& /*records*/ ) const {}
+	virtual void		appendMeasures( ChannelMask /*channels*/, int64_t /*timeInUs*/, std::vector<Record>& /*records*/ ) const {}
+	virtual void		setDescription( const Record* /*records*/, std::size_t /*numRecords*/ ) {}
 
 private:
 	CPhidgetHandle		mPhidgetHandleFromManager;
@@ -99,7 +204,23 @@ private:
 	int					mSerialNumber;
 	int					mVersion;
 	std::string			mTypeName;
+	std::string			mLabel;
 	Listeners			mListeners;
+	typedef				std::vector<ChannelMask> ChannelMasks;
+	ChannelMasks		mListenerChannelMasks;		// One mask per listener, in the same order
+	typedef				std::vector<unsigned int> Counts;
+	Counts				mListenerDecimations;		// Also one per listener
+	Counts				mListenerNumChanges;		// The changes each decimated listener was notified of or skipped
+	Listeners			mNotifiedListeners;			// The copy of mListeners being notified
+	unsigned int		mNumListenerRemovals;
+	typedef				std::vector<Delta::Field> DeltaFields;
+	DeltaFields			mDeltaFields;				// Of the next notification
+	ChannelMask			mLastChangedChannels;		// Of the last notification
+	std::atomic<ChannelMask> mAcquisitionPolledChannels;	// Written by the dispatching thread, read by the acquisition thread
+	bool				mAcquisitionResync;			// Only accessed by the acquisition thread
+	bool				mExactType;					// Not of a sub-class of its registered type: the DeviceManager calls update() without the virtual table
+	int64_t				mMissingSinceInUs;			// When the device vanished from the Phidget manager, or -1. Only accessed by the polling thread
+	DeviceStatistics	mStatistics;
 };
 
 }
\ No newline at end of file
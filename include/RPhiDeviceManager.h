@@ -25,13 +25,19 @@
 
 #include <string>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+#include "RPhiStatistics.h"
+#include "RPhiDeviceTypes.h"
+#include "RPhiRecording.h"
 typedef struct _CPhidgetManager *CPhidgetManagerHandle;		
 typedef struct _CPhidget *CPhidgetHandle;
 
 namespace RPhi
 {
 
-class Device;
+template<typename T> class SpscQueue;
 
 /*	
 	DeviceManager
@@ -40,8 +46,16 @@ class Device;
 	connected to the machine. The manager keeps track of the devices and 
 	make them avalaible via a list of Device objects that it maintains.
 
-	This DeviceManager class is abstract. Only LocalDeviceManager and 
-	RemoteDeviceManager classes can be instantiated
+	This DeviceManager class is abstract. Only LocalDeviceManager,
+	RemoteDeviceManager and ReplayDeviceManager classes can be instantiated
+
+	By default, update() polls the devices on the calling thread. Alternatively,
+	startAcquisition() moves the polling to a background acquisition thread 
+	owned by the manager. This thread pushes the device changes into a lock-free
+	queue which the application drains by calling dispatch() (or update()) on 
+	its own thread. The listeners are still notified on that thread, one device
+	change at a time, so they don't need to be thread-safe. Only the managers 
+	backed by a Phidget manager (local and remote) support it.
 
 	User guide
 	http://www.phidgets.com/docs/Phidget_Manager
@@ -59,8 +73,36 @@ public:
 	typedef std::vector<Device*> Devices;
 	const Devices&			getDevices() const			{ return mDevices; }
 
+	// The devices of one of the types registered in DeviceTypes
+	template<typename T>
+	const std::vector<T*>&	getDevicesOfType() const	{ return mDeviceContainers.get( static_cast<const T*>(NULL) ); }
+
 	void					update();
 
+	// Start/stop the background acquisition thread. The thread polls the devices
+	// every intervalInUs and queues at most queueCapacity changes. When the queue
+	// is full, the changes of a device are dropped and sent again in full once 
+	// there's room. Stopping the acquisition dispatches the remaining changes
+	bool					startAcquisition( int intervalInUs=1000, std::size_t queueCapacity=4096 );
+	void					stopAcquisition();
+	bool					isAcquiring() const			{ return mAcquiring; }
+
+	// Apply the changes queued by the acquisition thread and notify the listeners.
+	// Returns the number of events dispatched
+	std::size_t				dispatch();
+	uint64_t				getNumDroppedAcquisitionRecords() const { return mNumDroppedAcquisitionRecords; }
+
+	// Debounce the devices which attach and detach repeatedly, for example on a 
+	// marginal cable. A device vanishing from the Phidget manager is kept, but not
+	// polled, for the hold-off period before being disconnected. If it comes back
+	// in the meantime, the same Device goes on with its state and its listeners, 
+	// without any notification. 0, the default, disconnects a device right away
+	void					setHoldOffInUs( int64_t holdOffInUs )	{ mHoldOffInUs = holdOffInUs; }
+	int64_t					getHoldOffInUs() const		{ return mHoldOffInUs; }
+
+	// Runtime counters, see DeviceManagerStatistics and StatisticsSnapshot
+	const DeviceManagerStatistics& getStatistics() const { return mStatistics; }
+
 	class Listener
 	{
 	public:
@@ -72,6 +114,26 @@ public:
 	void					addListener( Listener* listener );
 	bool					removeListener( Listener* listener );
 
+	// Receives all the changes of an update() (or dispatch()) in a single call, as 
+	// a contiguous array of records holding the new measures, in the order the 
+	// devices were polled. This saves a virtual call per device change and lets the 
+	// consumer go over all of them in one pass. The Devices are notified as usual
+	struct Change
+	{
+		Device*				mDevice;
+		Record				mRecord;			// Of kind kSpatialMeasure, kThermocoupleMeasure or kAmbientTemperature
+	};
+
+	class BatchListener
+	{
+	public:
+		virtual ~BatchListener() {}
+		virtual void onDevicesChanged( DeviceManager* deviceManager, const Change* changes, std::size_t numChanges ) = 0;
+	};
+
+	void					addBatchListener( BatchListener* batchListener );
+	bool					removeBatchListener( BatchListener* batchListener );
+
 	static const char*		getLibraryVersion();
 	static const char*		getErrorDescription( int errorCode );
 
@@ -87,19 +149,94 @@ protected:
 
 	virtual void			openDevice( CPhidgetHandle phidgetHandle, int serialNumber ) = 0;
 
-private:
-	void					updateDeviceList();
+	// Synchronize the list of Devices with the devices currently attached
+	virtual void			updateDeviceList();
+
+	// Add or remove a Device created by a sub-class and notify the listeners. 
+	// The DeviceManager takes ownership of the added Device
+	void					registerDevice( Device* device );
+	void					unregisterDevice( Device* device );
 
-	static CPhidgetHandle	createDeviceSpecificHandle( int deviceID );
-	static Device*			createDevice( int deviceID, CPhidgetHandle deviceSpecificHandle );
+private:
+	bool					createPhidgetManager();
+
+	// Walk the DeviceTypes registry to find the type handling the device ID
+	static CPhidgetHandle	createDeviceSpecificHandle( int /*deviceID*/, DeviceTypeList<> ) { return NULL; }
+	template<typename T, typename... Rest>
+	static CPhidgetHandle	createDeviceSpecificHandle( int deviceID, DeviceTypeList<T, Rest...> );
+	static Device*			createDevice( int /*deviceID*/, CPhidgetHandle /*deviceSpecificHandle*/, DeviceTypeList<> ) { return NULL; }
+	template<typename T, typename... Rest>
+	static Device*			createDevice( int deviceID, CPhidgetHandle deviceSpecificHandle, DeviceTypeList<T, Rest...> );
 	void					addDevice( CPhidgetHandle phidgetHandle );
+	bool					reattachDevice( CPhidgetHandle phidgetHandle );
+	bool					isHeldOff( Device* device, int64_t timeInUs );
 	void					deleteDevice( CPhidgetHandle phidgetHandle );
+	void					connectDevice( Device* device );
+	void					disconnectDevice( Device* device );
+	struct DevicePoller;
+	struct ExactTypeChecker;
+	template<typename T>
+	void					pollDevices( const std::vector<T*>& devices );
+	void					timedUpdateDeviceList();
+	void					collectChanges( Device* device, int64_t timeInUs );
+	void					notifyBatchListeners();
+
+	// The devices as seen by the thread polling them
+	Devices&				getPolledDevices()			{ return mAcquiring ? mAcquiredDevices : mDevices; }
+
+	struct DeviceEvent;
+	void					pushDeviceEvent( const DeviceEvent& event );
+	void					acquisitionThreadMain( int intervalInUs );
+	void					acquireDevices( std::vector<Record>& records, std::vector<DeviceEvent>& events );
 
 	CPhidgetManagerHandle	mManagerHandle;
 	bool					mIsLocal;
 	Devices					mDevices;
+	DeviceContainers<DeviceTypes> mDeviceContainers;	// mDevices, by type
 	typedef					std::vector<Listener*> Listeners; 
 	Listeners				mListeners;
+	typedef					std::vector<BatchListener*> BatchListeners;
+	BatchListeners			mBatchListeners;
+	std::vector<Change>		mChanges;					// Since the last notification of the batch listeners
+	std::vector<Record>		mChangeRecords;
+	std::atomic<int64_t>	mHoldOffInUs;
+
+	std::atomic<bool>		mAcquiring;
+	std::atomic<bool>		mAcquisitionStopRequested;
+	std::atomic<bool>		mAcquisitionThreadRunning;
+	std::atomic<uint64_t>	mNumDroppedAcquisitionRecords;
+	Devices					mAcquiredDevices;			// Only accessed by the acquisition thread while it runs
+	SpscQueue<DeviceEvent>*	mDeviceEvents;
+	std::thread				mAcquisitionThread;
+
+	DeviceManagerStatistics	mStatistics;
+};
+
+/*
+	TypedDeviceManagerListener
+
+	A DeviceManager::Listener for a single type of device (see DeviceTypes), 
+	which receives the device as a T. The devices of another type are ignored
+*/
+template<typename T>
+class TypedDeviceManagerListener : public DeviceManager::Listener
+{
+public:
+	virtual void onConnected( DeviceManager* /*deviceManager*/, T* /*device*/ ) {}
+	virtual void onDisconnecting( DeviceManager* /*deviceManager*/, T* /*device*/ ) {}
+
+private:
+	virtual void onDeviceConnected( DeviceManager* deviceManager, Device* device )
+	{
+		if ( T* typedDevice = deviceCast<T>( device ) )
+			onConnected( deviceManager, typedDevice );
+	}
+
+	virtual void onDeviceDisconnecting( DeviceManager* deviceManager, Device* device )
+	{
+		if ( T* typedDevice = deviceCast<T>( device ) )
+			onDisconnecting( deviceManager, typedDevice );
+	}
 };
 
 }
\ No newline at end of file
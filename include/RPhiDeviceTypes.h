@@ -0,0 +1,164 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "RPhiSpatial.h"
+#include "RPhiTemperatureSensor.h"
+
+namespace RPhi
+{
+
+/*
+	DeviceTypes
+
+	The compile-time registry of the device types the DeviceManager knows about.
+	From the list below, the DeviceManager generates the creation of the devices
+	from their Phidget device ID, keeps the connected devices in one container 
+	per type and updates each container in its own loop, calling update() 
+	directly instead of through the virtual table when the exact type of the 
+	devices is known. The ReplayDeviceManager creates the recorded devices from 
+	it too.
+
+	A device type T registers by being added to the list. It must provide:
+	- a public static const Device::Type kType, its value in the Device::Type enum
+	- a protected constructor taking the CPhidgetHandle created below
+	- protected static bool isPhidgetDeviceID( int deviceID ), which tells whether
+	  it handles the Phidgets with the given ID (a CPhidget_DeviceID value)
+	- protected static CPhidgetHandle createPhidgetHandle(), which creates a 
+	  handle specific to the type
+	- a protected constructor taking a name, a serial number, a version and a 
+	  type name, for the devices which aren't backed by a Phidget
+	- the overrides of the Device methods dealing with records: appendDescription(),
+	  appendMeasures() and setDescription() for the records specific to the 
+	  type, applyRecord() for its measure records
+	and declare DeviceManager as a friend.
+*/
+template<typename... Types> struct DeviceTypeList {};
+
+typedef DeviceTypeList<Spatial, TemperatureSensor> DeviceTypes;
+
+// Return the Device as a T if it's one, NULL otherwise. It replaces the static_cast 
+// on the result of Device::getType()
+template<typename T>
+T* deviceCast( Device* device )
+{
+	return ( device && device->getType()==T::kType ) ? static_cast<T*>(device) : NULL;
+}
+
+template<typename T>
+const T* deviceCast( const Device* device )
+{
+	return ( device && device->getType()==T::kType ) ? static_cast<const T*>(device) : NULL;
+}
+
+/*
+	DeviceContainers
+
+	One contiguous container per registered device type. A Device goes into the 
+	container of its type. forEach() calls the visitor with each container in 
+	turn, as a std::vector<T*>, so that the visitor can loop on devices of a 
+	single static type
+*/
+template<typename List> class DeviceContainers;
+
+template<>
+class DeviceContainers< DeviceTypeList<> >
+{
+public:
+	bool add( Device* /*device*/ )						{ return false; }
+	bool remove( Device* /*device*/ )					{ return false; }
+	template<typename Visitor> void forEach( Visitor& /*visitor*/ ) const {}
+	void get() const {}
+};
+
+template<typename T, typename... Rest>
+class DeviceContainers< DeviceTypeList<T, Rest...> > : public DeviceContainers< DeviceTypeList<Rest...> >
+{
+	typedef DeviceContainers< DeviceTypeList<Rest...> > Base;
+
+public:
+	bool add( Device* device )
+	{
+		if ( device->getType()!=T::kType )
+			return Base::add( device );
+		mDevices.push_back( static_cast<T*>(device) );
+		return true;
+	}
+
+	bool remove( Device* device )
+	{
+		if ( device->getType()!=T::kType )
+			return Base::remove( device );
+		typename std::vector<T*>::iterator itr = std::find( mDevices.begin(), mDevices.end(), static_cast<T*>(device) );
+		if ( itr==mDevices.end() )
+			return false;
+		mDevices.erase( itr );
+		return true;
+	}
+
+	template<typename Visitor> 
+	void forEach( Visitor& visitor ) const
+	{
+		visitor( mDevices );
+		Base::forEach( visitor );
+	}
+
+	// Overloaded on the type of the null pointer given, see DeviceManager::getDevicesOfType()
+	using Base::get;
+	const std::vector<T*>& get( const T* ) const		{ return mDevices; }
+
+private:
+	std::vector<T*>		mDevices;
+};
+
+/*
+	TypedDeviceListener
+
+	A Device::Listener for a single type of device, which receives the device 
+	as a T. The notifications of the devices of another type are ignored
+*/
+template<typename T>
+class TypedDeviceListener : public Device::Listener
+{
+public:
+	virtual void onChanged( T* /*device*/ ) {}
+	virtual void onGap( T* /*device*/, const Device::Gap& /*gap*/ ) {}
+
+private:
+	virtual void onDeviceChanged( Device* device )
+	{
+		if ( T* typedDevice = deviceCast<T>( device ) )
+			onChanged( typedDevice );
+	}
+
+	virtual void onDeviceGap( Device* device, const Device::Gap& gap )
+	{
+		if ( T* typedDevice = deviceCast<T>( device ) )
+			onGap( typedDevice, gap );
+	}
+};
+
+}
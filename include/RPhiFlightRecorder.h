@@ -0,0 +1,197 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "RPhiDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	Flight recorder format
+
+	A flight recording is a fixed-size file made of a FlightRecordingHeader 
+	followed by mNumEntries FlightRecordingEntries, used as a circular buffer of 
+	Records (see RPhiRecording.h). Record n (counting from 1) is stored in entry 
+	(n-1) % mNumEntries with mSequence set to n, so the oldest records get 
+	overwritten by the newest ones. An entry with mSequence==0 has never been 
+	written.
+
+	mChecksum is the CRC-32 of mSequence followed by mRecord. The file is written 
+	through a memory mapping with no other synchronization, so after a crash or a 
+	power loss an entry may be partially written: its checksum tells.
+*/
+struct FlightRecordingHeader
+{
+	char		mMagic[8];				// "RPHIFLT" followed by a null character
+	uint32_t	mVersion;
+	uint32_t	mEntrySize;				// sizeof(FlightRecordingEntry)
+	uint64_t	mNumEntries;
+	int64_t		mCreationTimeInUs;
+	uint8_t		mReserved[8];
+};
+
+struct FlightRecordingEntry
+{
+	uint64_t	mSequence;
+	uint32_t	mChecksum;
+	uint32_t	mPadding;
+	Record		mRecord;
+};
+
+static const char		kFlightRecordingMagic[8] = { 'R', 'P', 'H', 'I', 'F', 'L', 'T', 0 };
+static const uint32_t	kFlightRecordingVersion = 1;
+
+/*
+	FlightRecorder
+
+	The FlightRecorder attaches to a DeviceManager and writes the measures of all 
+	its devices, as well as their attachment and detachment, into a flight 
+	recording: a memory-mapped circular file which keeps the last records when 
+	the process crashes or the machine loses power. 
+	
+	Writing a record costs a copy into the mapping and a checksum, on the thread 
+	that calls DeviceManager::update(). Nothing is allocated once the buffer of 
+	records has grown to its working size. The operating system writes the mapped 
+	pages back to the file, which survives a crash of the process. A sync thread 
+	also flushes the mapping to the disk every sync interval, which bounds what a 
+	power loss can take away.
+
+	Each time a quarter of the entries has been written, the descriptions of the 
+	connected devices are written again, so that the devices of the measures kept 
+	in the file are always described, even once their kDeviceAttached record has 
+	been overwritten.
+
+	When the file already holds a flight recording with the same number of 
+	entries, the FlightRecorder carries on after its last record, so restarting 
+	the process doesn't wipe what happened before.
+
+	After a restart, recover() reads back the last records of the file in order, 
+	ready to be written as a regular recording and replayed.
+*/
+class FlightRecorder : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	static const std::size_t kDefaultNumEntries = 1 << 18;		// A little more than 4 minutes of a Spatial at 1ms, 28MB
+
+	FlightRecorder( DeviceManager* deviceManager, const std::string& filename, std::size_t numEntries=kDefaultNumEntries );
+	virtual ~FlightRecorder();
+
+	bool				isOpen() const						{ return mHeader!=NULL; }
+	const std::string&	getFilename() const					{ return mFilename; }
+	DeviceManager*		getDeviceManager() const			{ return mDeviceManager; }
+	std::size_t			getNumEntries() const				{ return mNumEntries; }
+
+	// The sequence number of the last record written, 0 if none
+	uint64_t			getLastSequence() const				{ return mNextSequence-1; }
+
+	// Flush the mapping to the disk and wait for it to be done
+	void				sync();
+
+	// How often the sync thread flushes the mapping. 0 leaves it to the operating system
+	void				setSyncIntervalInMs( int syncIntervalInMs );
+	int					getSyncIntervalInMs() const;
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+	/*
+		Recovery
+
+		The records read back from a flight recording, in the order they were 
+		written. The records which can't be read back, because they were being 
+		written at the time of the crash or hadn't reached the disk at the time of 
+		a power loss, are skipped and counted.
+
+		The records are made self-contained: the devices still attached at the 
+		start of the recovered window are described there, the measures of a 
+		device whose description was overwritten get the next description of the
+		device found in the file, and the descriptions written again by the 
+		FlightRecorder are removed. So write() gives a 
+		recording that the ReplayDeviceManager can play.
+	*/
+	struct Recovery
+	{
+		Recovery();
+
+		bool				write( const std::string& filename ) const;
+
+		std::vector<Record>	mRecords;
+		uint64_t			mFirstSequence;			// Of the records read from the file, 0 if none
+		uint64_t			mLastSequence;
+		std::size_t			mNumLostRecords;		// Between mFirstSequence and mLastSequence
+		std::size_t			mNumDroppedRecords;		// Measures of devices described nowhere in the file
+	};
+
+	// Read the records of the last durationInUs of the file, before its last 
+	// record, or all of them if durationInUs is 0. Return false if the file 
+	// isn't a flight recording
+	static bool			recover( const std::string& filename, int64_t durationInUs, Recovery& recovery );
+
+	static uint32_t		computeChecksum( const FlightRecordingEntry& entry );
+
+private:
+	FlightRecorder( const FlightRecorder& );
+	FlightRecorder& operator=( const FlightRecorder& );
+
+	bool				open();
+	void				close();
+	bool				flushMapping();
+	uint64_t			getDescriptionInterval() const;
+	void				writeRecords();
+	void				syncThreadMain();
+
+	typedef std::vector<const Device*> Devices;
+
+	DeviceManager*				mDeviceManager;
+	std::string					mFilename;
+	std::size_t					mNumEntries;
+	void*						mFileHandle;		// Only used on Windows
+	void*						mMappingHandle;		// Only used on Windows
+	void*						mData;
+	std::size_t					mSize;
+	FlightRecordingHeader*		mHeader;
+	FlightRecordingEntry*		mEntries;
+	uint64_t					mNextSequence;
+	uint64_t					mNextDescriptionSequence;
+	Devices						mDevices;
+	std::vector<Record>			mRecords;
+
+	int							mSyncIntervalInMs;
+	bool						mStopRequested;
+	mutable std::mutex			mMutex;
+	std::condition_variable		mCondition;
+	std::thread					mSyncThread;
+};
+
+}
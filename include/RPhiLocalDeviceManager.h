@@ -35,6 +35,7 @@ class LocalDeviceManager : public DeviceManager
 {
 public:
 	LocalDeviceManager();
+	virtual ~LocalDeviceManager();
 
 protected:
 	virtual void openDevice( CPhidgetHandle phidgetHandle, int serialNumber );
@@ -0,0 +1,103 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+class Device;
+
+/*
+	MeasureWriter
+
+	Formats devices and their measures into a caller-provided buffer, for logging 
+	or exporting. Unlike toString(), the MeasureWriter doesn't allocate memory 
+	(once its working buffer has grown to its working size) and doesn't call 
+	into the Phidget21 library.
+
+	The devices are first converted to Records (see RecordBuilder), which are 
+	then written in one of the following formats:
+	- kText: one line per record, with named fields
+	- kJsonLines: one JSON object per line
+	- kCsv: one line per record, with the columns given by writeCsvHeader(). 
+	  The columns that don't apply to a record are left empty
+	- kBinary: the Records themselves, as stored in a recording (see RPhiRecording.h)
+
+	The write functions return the number of bytes written, or 0 when the buffer 
+	is too small or there's nothing to write. The text formats are null-terminated, 
+	the null character isn't counted in the size returned.
+*/
+class MeasureWriter
+{
+public:
+	enum Format
+	{
+		kText,
+		kJsonLines,
+		kCsv,
+		kBinary
+	};
+
+	// The number of decimals of the values in the text formats, kFullPrecision
+	// to write them with as many significant digits as needed to read them back exactly
+	enum 
+	{
+		kDefaultPrecision = 3,
+		kFullPrecision = -1
+	};
+
+	MeasureWriter( Format format, int precision=kDefaultPrecision );
+
+	Format					getFormat() const				{ return mFormat; }
+	int						getPrecision() const			{ return mPrecision; }
+	void					setPrecision( int precision );
+
+	// The description of the device: the kDeviceAttached record followed by the name, ranges, etc...
+	std::size_t				writeDescription( const Device* device, int64_t timeInUs, char* buffer, std::size_t size );
+	
+	// The current measures of the device. For a TemperatureSensor, only the channels which aren't stale 
+	std::size_t				writeMeasures( const Device* device, int64_t timeInUs, char* buffer, std::size_t size );
+	
+	std::size_t				writeRecord( const Record& record, char* buffer, std::size_t size ) const;
+	
+	// The first line of a CSV file. Writes nothing in the other formats
+	std::size_t				writeCsvHeader( char* buffer, std::size_t size ) const;
+
+	static const char*		getKindName( uint16_t kind );
+
+private:
+	std::size_t				writeRecords( char* buffer, std::size_t size ) const;
+
+	Format					mFormat;
+	int						mPrecision;
+	char					mValueFormat[8];		// The printf format of the values
+	std::vector<Record>		mRecords;				// Working buffer
+};
+
+}
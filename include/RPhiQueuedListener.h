@@ -0,0 +1,146 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "RPhiDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	QueuedListener
+
+	Listeners are notified from within DeviceManager::update(), so a slow 
+	listener slows down the acquisition of every device. The QueuedListener 
+	decouples a slow consumer from the acquisition: it listens to the devices 
+	of a DeviceManager, snapshots each event into records (see RecordBuilder)
+	and queues them. A delivery thread owned by the QueuedListener then passes
+	them to the Consumer, one event at a time.
+
+	An event is made of the description of a connected device, of the measures 
+	of a device after a change, or of the kDeviceDetached record of a device.
+	At most capacity measure events are queued. When the queue is full, the 
+	policy decides what happens to a new measure event:
+	- kBlock: the thread calling DeviceManager::update() waits for room
+	- kDropOldest: the oldest queued measure event is dropped
+	- kCoalesce: if a measure event of the same device is still queued, its 
+	  measures are replaced by the new ones. This is done whether the queue is
+	  full or not, so the consumer always gets the latest measures. Otherwise 
+	  the oldest queued measure event is dropped
+	The connection and disconnection events are never dropped nor coalesced.
+
+	The events still queued are delivered before the QueuedListener is destroyed.
+*/
+class QueuedListener : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	enum Policy
+	{
+		kBlock,
+		kDropOldest,
+		kCoalesce
+	};
+
+	class Consumer
+	{
+	public:
+		virtual ~Consumer() {}
+
+		// Called by the delivery thread with the records of one event
+		virtual void onRecords( const Record* records, std::size_t numRecords ) = 0;
+	};
+
+	enum { kDefaultCapacity = 256 };
+
+	QueuedListener( DeviceManager* deviceManager, Consumer* consumer, Policy policy=kCoalesce, 
+					std::size_t capacity=kDefaultCapacity, Device::ChannelMask channelMask=Device::kAllChannels );
+	virtual ~QueuedListener();
+
+	DeviceManager*		getDeviceManager() const			{ return mDeviceManager; }
+	Policy				getPolicy() const					{ return mPolicy; }
+	std::size_t			getCapacity() const					{ return mCapacity; }
+	std::size_t			getNumQueuedEvents() const;
+
+	uint64_t			getNumDeliveredEvents() const		{ return mNumDeliveredEvents; }
+	uint64_t			getNumDroppedEvents() const			{ return mNumDroppedEvents; }
+	uint64_t			getNumCoalescedEvents() const		{ return mNumCoalescedEvents; }
+	uint64_t			getNumBlockedEvents() const			{ return mNumBlockedEvents; }		// With kBlock, the events that had to wait for room
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	QueuedListener( const QueuedListener& );
+	QueuedListener& operator=( const QueuedListener& );
+
+	struct Event
+	{
+		int					mSerialNumber;
+		bool				mIsMeasure;
+		bool				mDropped;
+		std::vector<Record>	mRecords;
+	};
+
+	// Called with mMutex locked
+	Event*				allocateEvent( int serialNumber, bool isMeasure );
+	void				queueEvent( Event* event );
+	void				dropOldestMeasureEvent();
+	
+	void				deliveryThreadMain();
+
+	DeviceManager*			mDeviceManager;
+	Consumer*				mConsumer;
+	Policy					mPolicy;
+	std::size_t				mCapacity;
+	Device::ChannelMask		mChannelMask;
+
+	mutable std::mutex		mMutex;						// Protects everything below, except the counters
+	std::condition_variable	mEventQueued;
+	std::condition_variable	mEventDelivered;
+	std::deque<Event*>		mEvents;
+	std::vector<Event*>		mFreeEvents;				// Recycled along with their records
+	typedef std::map<int, Event*> PendingMeasureEvents;
+	PendingMeasureEvents	mPendingMeasureEvents;		// The queued measure event of each device, with kCoalesce
+	std::size_t				mNumQueuedEvents;			// Not counting the dropped ones still in mEvents
+	std::size_t				mNumQueuedMeasureEvents;
+	bool					mStopRequested;
+
+	std::atomic<uint64_t>	mNumDeliveredEvents;
+	std::atomic<uint64_t>	mNumDroppedEvents;
+	std::atomic<uint64_t>	mNumCoalescedEvents;
+	std::atomic<uint64_t>	mNumBlockedEvents;
+	std::thread				mDeliveryThread;
+};
+
+}
@@ -0,0 +1,70 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include "RPhiRecording.h"
+#include "RPhiSpatial.h"
+#include "RPhiTemperatureSensor.h"
+
+namespace RPhi
+{
+
+/*
+	RecordBuilder
+
+	Converts Devices and their measures into Records (see RPhiRecording.h). 
+	Used by everything that stores or publishes measures in the Record format.
+	
+	The records are appended to the given vector. Once the vector has grown to 
+	its working size, building records doesn't allocate memory.
+*/
+class RecordBuilder
+{
+public:
+	// Append a zero-initialized record and return it
+	static Record&		appendRecord( std::vector<Record>& records, Record::Kind kind, int serialNumber, int64_t timeInUs );
+
+	// Append the kDeviceAttached record of the device followed by the records describing 
+	// it. The records specific to the type of the device come from the Device itself
+	static void			appendDeviceDescription( const Device* device, int64_t timeInUs, std::vector<Record>& records );
+
+	// Append the current measures of the given channels of the device (see 
+	// Device::appendMeasures()). For a TemperatureSensor, one record is appended 
+	// per non-stale channel
+	static void			appendMeasures( const Device* device, int64_t timeInUs, std::vector<Record>& records, 
+										Device::ChannelMask channels=Device::kAllChannels );
+
+	// Append a single measure
+	static void			appendSpatialMeasure( const Spatial::Measure& measure, int serialNumber, int64_t timeInUs, std::vector<Record>& records );
+	static void			appendThermocoupleMeasure( int index, const TemperatureSensor::Thermocouple::Measure& measure, int serialNumber, int64_t timeInUs, std::vector<Record>& records );
+	static void			appendAmbientTemperature( double temperatureInC, int serialNumber, int64_t timeInUs, std::vector<Record>& records );
+
+	// Convert a measure into the payload of a record, and back
+	static void										copySpatialMeasure( Record::SpatialMeasure& destination, const Spatial::Measure& measure );
+	static Spatial::Measure							toSpatialMeasure( const Record::SpatialMeasure& measure );
+	static TemperatureSensor::Thermocouple::Measure	toThermocoupleMeasure( const Record::ThermocoupleMeasure& measure );
+};
+
+}
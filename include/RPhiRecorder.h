@@ -0,0 +1,105 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "RPhiDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiRecording.h"
+#include "RPhiRecordingIndex.h"
+
+namespace RPhi
+{
+
+/*
+	Recorder
+
+	The Recorder attaches to a DeviceManager and writes the measures of all its 
+	devices, as well as their attachment and detachment, into an append-only 
+	recording file (see RPhiRecording.h).
+
+	The records are accumulated in memory by the thread that calls
+	DeviceManager::update(). They are written to the file in batches by a 
+	dedicated writer thread, so that file access never slows down the acquisition.
+	
+	The writer thread also maintains the sparse time index of the recording and 
+	appends its new entries to the sidecar index file as it goes (see 
+	RecordingIndex).
+
+	The recording can be read back using a RecordingReader.
+*/
+class Recorder : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	Recorder( DeviceManager* deviceManager, const std::string& filename, int64_t indexIntervalInUs=RecordingIndex::kDefaultIntervalInUs );
+	virtual ~Recorder();
+
+	bool				isOpen() const						{ return mFile!=NULL; }
+	const std::string&	getFilename() const					{ return mFilename; }
+	DeviceManager*		getDeviceManager() const			{ return mDeviceManager; }
+
+	// Block until all the records accumulated so far have been written to the file
+	void				flush();
+
+	// How long the writer thread waits before writing a partial batch
+	void				setFlushIntervalInMs( int flushIntervalInMs );
+	int					getFlushIntervalInMs() const		{ return mFlushIntervalInMs; }
+
+	uint64_t			getNumRecordsWritten() const;
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	// Account for the records appended to the pending batch. mMutex must be locked
+	void				onRecordsAdded( std::size_t previousNumPendingRecords );
+	void				writerThreadMain();
+
+	DeviceManager*				mDeviceManager;
+	std::string					mFilename;
+	FILE*						mFile;
+	FILE*						mIndexFile;
+	RecordingIndex				mIndex;					// Only accessed by the writer thread
+	RecordingIndex::Entries		mNewIndexEntries;
+	int							mFlushIntervalInMs;
+	
+	typedef std::vector<Record> Records;
+	Records						mPendingRecords;		// Filled by the acquisition thread 
+	Records						mWritingRecords;		// Written by the writer thread
+	uint64_t					mNumRecordsQueued;
+	uint64_t					mNumRecordsWritten;
+	bool						mFlushRequested;
+	bool						mStopRequested;
+	mutable std::mutex			mMutex;
+	std::condition_variable		mCondition;
+	std::thread					mWriterThread;
+};
+
+}
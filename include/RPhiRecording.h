@@ -0,0 +1,155 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+
+namespace RPhi
+{
+
+/*
+	Recording format
+
+	A recording is an append-only binary file made of a RecordingHeader followed 
+	by a sequence of fixed-size Records, in the order they were written. 
+	Because all the records have the same size, the file can be memory-mapped 
+	and accessed like an array (see RecordingReader).
+
+	Every record is timestamped (in microseconds since the Epoch) and refers to 
+	a device by its serial number. When a device gets attached, a kDeviceAttached 
+	record is written, followed by the records describing the device (name, type
+	name and ranges). Then come the measures of the device and finally a 
+	kDeviceDetached record.
+
+	Values are stored in the native byte order of the recording machine (little 
+	endian on all the supported platforms).
+
+	A recording comes with a sidecar index file (see RecordingIndex) made of a 
+	RecordingIndexHeader followed by RecordingIndexEntries. Each entry points to
+	the first record of a device written after a given time. The entries of a 
+	device are spaced by at least the interval stored in the header. The entries 
+	with mSerialNumber==0 cover all the devices.
+*/
+struct RecordingHeader
+{
+	char		mMagic[8];				// "RPHIREC" followed by a null character
+	uint32_t	mVersion;
+	uint32_t	mRecordSize;			// sizeof(Record)
+	int64_t		mStartTimeInUs;
+	uint8_t		mReserved[8];
+};
+
+struct Record
+{
+	enum Kind
+	{
+		kDeviceAttached = 1,			// mDeviceInfo
+		kDeviceDetached,				// No payload
+		kDeviceName,					// mText
+		kDeviceTypeName,				// mText
+		kSpatialMinMeasure,				// mSpatialMeasure
+		kSpatialMaxMeasure,				// mSpatialMeasure
+		kSpatialMeasure,				// mSpatialMeasure, mChannel is the mask of the Spatial::Sensors read (0 for all of them)
+		kThermocoupleInfo,				// mThermocoupleInfo, mChannel is the index of the Thermocouple
+		kThermocoupleMeasure,			// mThermocoupleMeasure, mChannel is the index of the Thermocouple
+		kAmbientTemperature				// mAmbientTemperatureInC
+	};
+
+	struct DeviceInfo
+	{
+		int32_t		mType;				// Device::Type
+		int32_t		mVersion;
+		int32_t		mNumAccelerationAxes;
+		int32_t		mNumAngularRateAxes;
+		int32_t		mNumMagneticFieldAxes;
+		int32_t		mDataRateInMs;
+		int32_t		mNumThermocouples;
+		int32_t		mPadding;
+		double		mMinAmbientTemperatureInC;
+		double		mMaxAmbientTemperatureInC;
+	};
+
+	struct SpatialMeasure
+	{
+		double		mAccelerationInGs[3];
+		double		mAngularRateInDegPerSec[3];
+		double		mMagneticFieldInGauss[3];
+	};
+
+	struct ThermocoupleInfo
+	{
+		int32_t		mType;				// TemperatureSensor::Thermocouple::Type
+		int32_t		mPadding;
+		double		mMinTemperatureInC;
+		double		mMinPotentialInMV;
+		double		mMaxTemperatureInC;
+		double		mMaxPotentialInMV;
+	};
+
+	struct ThermocoupleMeasure
+	{
+		double		mTemperatureInC;
+		double		mPotentialInMV;
+	};
+
+	enum { kTextSize = 80 };
+
+	uint16_t	mKind;
+	uint16_t	mChannel;
+	int32_t		mSerialNumber;
+	int64_t		mTimeInUs;
+	union
+	{
+		DeviceInfo			mDeviceInfo;
+		SpatialMeasure		mSpatialMeasure;
+		ThermocoupleInfo	mThermocoupleInfo;
+		ThermocoupleMeasure	mThermocoupleMeasure;
+		double				mAmbientTemperatureInC;
+		char				mText[kTextSize];		// Null-terminated, truncated if needed
+	};
+};
+
+struct RecordingIndexHeader
+{
+	char		mMagic[8];				// "RPHIIDX" followed by a null character
+	uint32_t	mVersion;
+	uint32_t	mEntrySize;				// sizeof(RecordingIndexEntry)
+	int64_t		mIntervalInUs;
+	int64_t		mRecordingStartTimeInUs;	// RecordingHeader::mStartTimeInUs of the indexed recording
+};
+
+struct RecordingIndexEntry
+{
+	int32_t		mSerialNumber;
+	int32_t		mPadding;
+	int64_t		mTimeInUs;
+	uint64_t	mRecordIndex;			// Position of the record in the recording (not in bytes)
+};
+
+static const char		kRecordingMagic[8] = { 'R', 'P', 'H', 'I', 'R', 'E', 'C', 0 };
+static const uint32_t	kRecordingVersion = 1;
+static const char		kRecordingIndexMagic[8] = { 'R', 'P', 'H', 'I', 'I', 'D', 'X', 0 };
+static const uint32_t	kRecordingIndexVersion = 1;
+
+}
@@ -0,0 +1,110 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+class RecordingReader;
+
+/*
+	RecordingIndex
+
+	A sparse index from (device, time) to position in a recording. It allows 
+	reading the records of a device over a time range without scanning the 
+	recording from its beginning.
+
+	The Recorder builds the index as it writes the records and saves it next to
+	the recording, in a sidecar file (see getIndexFilename()). If the sidecar is
+	missing, doesn't match the recording or lags behind it (for example because
+	the recording process crashed), loadOrBuild() rebuilds the missing part from
+	the records themselves.
+
+	Entries are added for a device at most once per interval, so the index 
+	stays small: about 24 bytes per device and per second with the default 
+	interval.
+*/
+class RecordingIndex
+{
+public:
+	typedef RecordingIndexEntry Entry;
+	typedef std::vector<Entry> Entries;
+
+	static const int		kAllDevices = 0;
+	static const int64_t	kDefaultIntervalInUs = 1000000;
+
+	RecordingIndex( int64_t intervalInUs=kDefaultIntervalInUs );
+
+	static std::string		getIndexFilename( const std::string& recordingFilename )	{ return recordingFilename + ".idx"; }
+
+	int64_t					getIntervalInUs() const				{ return mIntervalInUs; }
+	uint64_t				getNumRecordsIndexed() const		{ return mNumRecordsIndexed; }
+	const Entries&			getEntries() const					{ return mEntries; }
+	void					clear();
+
+	// Index the given records, which must directly follow the ones already indexed.
+	// The entries created are also appended to newEntries if provided
+	void					addRecords( const Record* records, std::size_t numRecords, Entries* newEntries=NULL );
+
+	// Load the sidecar index of the recording if it matches it, then index the 
+	// records it doesn't cover. Returns false if the sidecar had to be ignored.
+	// The index is then entirely rebuilt from the recording
+	bool					loadOrBuild( const RecordingReader& reader );
+	bool					save( const std::string& filename, int64_t recordingStartTimeInUs ) const;
+	bool					writeHeader( FILE* file, int64_t recordingStartTimeInUs ) const;
+
+	// Position in the recording from where to scan to find the first record of a device
+	// (or of any device with kAllDevices) at or after the given time
+	uint64_t				findStartRecordIndex( int serialNumber, int64_t timeInUs ) const;
+
+	// Call the visitor for each record of the device (or of any device with kAllDevices) 
+	// within [fromTimeInUs, toTimeInUs], in order. Returns the number of records visited
+	class Visitor
+	{
+	public:
+		virtual ~Visitor() {}
+		virtual void onRecord( const Record& record ) = 0;
+	};
+	std::size_t				query( const RecordingReader& reader, int serialNumber, int64_t fromTimeInUs, int64_t toTimeInUs, Visitor& visitor ) const;
+
+private:
+	void					addEntry( int serialNumber, int64_t timeInUs, uint64_t recordIndex, Entries* newEntries );
+	bool					load( const std::string& filename, const RecordingReader& reader );
+
+	int64_t					mIntervalInUs;
+	uint64_t				mNumRecordsIndexed;
+	Entries					mEntries;
+	typedef std::vector<std::size_t> EntryIndices;
+	typedef std::map<int, EntryIndices> EntryIndicesBySerialNumber;
+	EntryIndicesBySerialNumber mEntryIndicesBySerialNumber;		// Positions in mEntries, per device
+};
+
+}
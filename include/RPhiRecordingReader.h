@@ -0,0 +1,75 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	RecordingReader
+
+	Gives read access to a recording file written by a Recorder. 
+	
+	The file is memory-mapped and the records are returned as pointers into the 
+	mapping, so reading doesn't copy any data. The pointers remain valid for the 
+	lifetime of the RecordingReader.
+
+	A recording that was being written when the process stopped can still be 
+	read: a trailing partial record is ignored.
+*/
+class RecordingReader
+{
+public:
+	RecordingReader( const std::string& filename );
+	~RecordingReader();
+
+	bool					isOpen() const						{ return mHeader!=NULL; }
+	const std::string&		getFilename() const					{ return mFilename; }
+
+	const RecordingHeader*	getHeader() const					{ return mHeader; }
+	std::size_t				getNumRecords() const				{ return mNumRecords; }
+	const Record*			getRecords() const					{ return mRecords; }
+	const Record&			getRecord( std::size_t index ) const	{ return mRecords[index]; }
+
+private:
+	RecordingReader( const RecordingReader& );
+	RecordingReader& operator=( const RecordingReader& );
+
+	void					close();
+
+	std::string				mFilename;
+	void*					mFileHandle;		// Only used on Windows
+	void*					mMappingHandle;		// Only used on Windows
+	void*					mData;
+	std::size_t				mSize;
+	const RecordingHeader*	mHeader;
+	const Record*			mRecords;
+	std::size_t				mNumRecords;
+};
+
+}
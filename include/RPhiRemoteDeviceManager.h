@@ -36,6 +36,7 @@ class RemoteDeviceManager : public DeviceManager
 public:
 	RemoteDeviceManager( const std::string& serverID, const std::string& password );
 	RemoteDeviceManager( const std::string& serverAddress, int port, const std::string& password );
+	virtual ~RemoteDeviceManager();
 	
 	bool					openedUsingServerID() const		{ return mOpenedUsingServerID; }
 	const std::string&		getPassword() const				{ return mPassword; }
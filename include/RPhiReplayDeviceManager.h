@@ -0,0 +1,99 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <map>
+#include "RPhiDeviceManager.h"
+#include "RPhiRecordingReader.h"
+
+namespace RPhi
+{
+
+/*
+	ReplayDeviceManager
+
+	The ReplayDeviceManager plays back a recording written by a Recorder. The 
+	recorded devices are exposed as objects of their registered type (see 
+	DeviceTypes) which get connected, changed and disconnected like real devices,
+	so existing listeners work unchanged without any Phidget hardware.
+
+	As with the other DeviceManagers, everything happens during update(). The 
+	playback speed is a factor applied to the recorded time: 1 plays back in 
+	real time, N plays back N times faster and kAsFastAsPossible applies the 
+	records of the next recorded instant at each update(), whatever the time 
+	elapsed. In timed modes, if a device got several measures since the previous 
+	update(), only the last one is reported, as it would be when polling a real 
+	device.
+*/
+class ReplayDeviceManager : public DeviceManager
+{
+public:
+	ReplayDeviceManager( const std::string& filename, double speed=1.0 );
+	virtual ~ReplayDeviceManager();
+
+	bool					isOpen() const					{ return mReader.isOpen(); }
+	const std::string&		getFilename() const				{ return mReader.getFilename(); }
+
+	static const double		kAsFastAsPossible;
+	void					setSpeed( double speed );
+	double					getSpeed() const				{ return mSpeed; }
+
+	// The position of the playback in the recorded time (in microseconds since the Epoch)
+	int64_t					getReplayTimeInUs() const		{ return mReplayTimeInUs; }
+	bool					isFinished() const				{ return mNextRecordIndex>=mReader.getNumRecords(); }
+
+	// Restart the playback from the beginning of the recording
+	void					rewind();
+
+protected:
+	virtual void			openDevice( CPhidgetHandle phidgetHandle, int serialNumber );
+	virtual void			updateDeviceList();
+
+	void					applyRecords( int64_t untilTimeInUs );
+	void					createDevice( std::size_t attachedRecordIndex );
+	Device*					findDevice( int serialNumber ) const;
+
+private:
+	// A replayed device, of one of the types registered in DeviceTypes
+	class ReplayDevice;
+	template<typename T> class TypedReplayDevice;
+
+	// Walk the DeviceTypes registry to find the type of the recorded device
+	static ReplayDevice*	createReplayDevice( int /*type*/, const std::string& /*name*/, const std::string& /*typeName*/, 
+												const Record* /*records*/, std::size_t /*numRecords*/, DeviceTypeList<> ) { return NULL; }
+	template<typename T, typename... Rest>
+	static ReplayDevice*	createReplayDevice( int type, const std::string& name, const std::string& typeName, 
+												const Record* records, std::size_t numRecords, DeviceTypeList<T, Rest...> );
+
+	RecordingReader			mReader;
+	double					mSpeed;
+	int64_t					mReplayTimeInUs;
+	int64_t					mAnchorReplayTimeInUs;		// The replay time at the anchor...
+	int64_t					mAnchorTimeInUs;			// ...and the corresponding wall-clock time
+	std::size_t				mNextRecordIndex;
+	typedef std::map<int, ReplayDevice*> DevicesBySerialNumber;
+	DevicesBySerialNumber	mDevicesBySerialNumber;
+};
+
+}
@@ -0,0 +1,165 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include <map>
+#include "RPhiDeviceManager.h"
+#include "RPhiSpatial.h"
+
+namespace RPhi
+{
+
+/*
+	Resampler
+
+	Brings the measures of several Spatials on a common time base. Each Spatial 
+	changes at its own data rate and is read whenever the update reaches it, so 
+	its measures come at irregular times (see Spatial::getMeasureTimeInUs()). 
+	The Resampler interpolates them on a grid of fixed period, aligned on the 
+	multiples of the period, and hands the Consumer one Frame per grid time with
+	the measure of every Spatial at that time.
+
+	The streams of measures are merged in time order: a frame is emitted as soon
+	as every Spatial has a measure at or after its time. To bound the latency, 
+	a late or silent Spatial holds the frames back by at most maxLatencyInUs, 
+	measured on the time of the newest measure received from any Spatial. Past
+	that, the frame is emitted with the last measure of the late Spatial held. 
+	Since the latency is measured on the measure times, a recording replayed as
+	fast as possible is resampled the same way as the live devices.
+
+	kLinear interpolates between the two measures around the frame time. kCubic 
+	uses a cubic Hermite spline through them, with tangents taken from their 
+	neighbours, and so waits for one more measure.
+
+	Each Spatial keeps a ring of numSamplesPerStream measures, so the memory 
+	doesn't grow with time nor with the latency. The ring must cover the 
+	measures a Spatial can get ahead of the frame time, ie maxLatencyInUs at the 
+	data rate of the fastest Spatial. Nothing is allocated besides when a 
+	Spatial gets connected.
+
+	The Resampler runs on the thread calling DeviceManager::update(). The other
+	types of devices are ignored.
+*/
+class Resampler : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	enum Interpolation
+	{
+		kLinear,
+		kCubic
+	};
+
+	struct Entry
+	{
+		enum State
+		{
+			kInterpolated,
+			kHeld,				// No measure after the frame time arrived in time, the closest one is held
+			kNoMeasure			// The Spatial hasn't provided any measure yet
+		};
+
+		const Spatial*		mSpatial;
+		Spatial::Measure	mMeasure;
+		State				mState;
+	};
+
+	struct Frame
+	{
+		int64_t				mTimeInUs;
+		const Entry*		mEntries;			// One per Spatial, in connection order
+		std::size_t			mNumEntries;
+	};
+
+	class Consumer
+	{
+	public:
+		virtual ~Consumer() {}
+		virtual void onFrame( const Frame& frame ) = 0;
+	};
+
+	Resampler( DeviceManager* deviceManager, Consumer* consumer, int periodInUs=1000, Interpolation interpolation=kLinear, 
+			   int maxLatencyInUs=20000, std::size_t numSamplesPerStream=64 );
+	virtual ~Resampler();
+
+	// Emit the pending frames up to the newest measure received, without waiting 
+	// for the late Spatials
+	void				flush();
+
+	int					getPeriodInUs() const				{ return mPeriodInUs; }
+	Interpolation		getInterpolation() const			{ return mInterpolation; }
+	uint64_t			getNumFrames() const				{ return mNumFrames; }
+	uint64_t			getNumHeldMeasures() const			{ return mNumHeldMeasures; }
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	Resampler( const Resampler& );
+	Resampler& operator=( const Resampler& );
+
+	struct Sample
+	{
+		int64_t				mTimeInUs;
+		Spatial::Measure	mMeasure;
+	};
+
+	struct Stream
+	{
+		Spatial*			mSpatial;
+		std::vector<Sample>	mSamples;			// Ring buffer
+		std::size_t			mNumSamples;
+		std::size_t			mNewestIndex;
+		bool				mReady;				// Whether the stream has what it takes to resample at mFrameTimeInUs
+	};
+
+	// The age of the newest sample is 0
+	const Sample&		getSample( const Stream& stream, std::size_t age ) const;
+	void				addSample( Stream& stream, int64_t timeInUs, const Spatial::Measure& measure );
+	bool				isReady( const Stream& stream ) const;
+	void				updateReadyStreams();
+	void				emitFrames( bool force );
+	void				resample( const Stream& stream, Entry& entry ) const;
+
+	DeviceManager*		mDeviceManager;
+	Consumer*			mConsumer;
+	int					mPeriodInUs;
+	Interpolation		mInterpolation;
+	int					mMaxLatencyInUs;
+	std::size_t			mNumSamplesPerStream;
+
+	std::vector<Stream*> mStreams;
+	typedef std::map<const Device*, Stream*> StreamsByDevice;
+	StreamsByDevice		mStreamsByDevice;
+	std::vector<Entry>	mEntries;
+	std::size_t			mNumReadyStreams;
+	int64_t				mFrameTimeInUs;			// The next frame to emit, or -1 until the first measure
+	int64_t				mNewestTimeInUs;
+
+	uint64_t			mNumFrames;
+	uint64_t			mNumHeldMeasures;
+};
+
+}
@@ -0,0 +1,196 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include <map>
+#include "RPhiDeviceManager.h"
+
+namespace RPhi
+{
+
+/*
+	RuleEngine
+
+	Watches the measures of the devices against a set of declarative rules and 
+	raises alarms, instead of each application checking them in onDeviceChanged().
+	A Rule compares one quantity of a device to a threshold:
+	- the acceleration, angular rate or magnetic field of a Spatial, either one 
+	  axis or the magnitude of the vector
+	- the temperature or potential of one Thermocouple, or the ambient temperature
+	  of a TemperatureSensor
+	The alarm is raised when the quantity goes above (or below) the threshold and
+	stays there for the duration of the rule. It is cleared when the quantity comes
+	back past the threshold by more than the hysteresis, so a noisy quantity close 
+	to the threshold doesn't raise and clear alarms in turn.
+
+	A rule applies to the device with the given serial number, or to every device
+	having the quantity with kAnyDevice. When a device gets connected, the rules 
+	are compiled for it into flat arrays, one entry per rule, with the comparisons
+	folded into a single "above" comparison. Each change of the device then 
+	evaluates all its rules in one batch, without branching per rule, and only the 
+	rules whose state changes go further. 
+
+	A pending rule (past its threshold but not for long enough yet) is promoted by
+	the next change of its device, or by update() when the device doesn't change.
+	A stale channel doesn't change the state of its rules. The active alarms of a
+	device are cleared when it gets disconnected.
+
+	The RuleEngine subscribes to the channels its rules need only. It runs on the
+	thread calling DeviceManager::update().
+*/
+class RuleEngine : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	struct Rule
+	{
+		enum Quantity
+		{
+			kAcceleration,				// Spatial, in Gs. The Spatial quantities are in the order of Spatial::Sensor
+			kAngularRate,				// Spatial, in degrees per second
+			kMagneticField,				// Spatial, in Gauss
+			kTemperature,				// Thermocouple, in Celsius
+			kPotential,					// Thermocouple, in millivolts
+			kAmbientTemperature			// TemperatureSensor, in Celsius
+		};
+
+		enum Comparison
+		{
+			kAbove,
+			kBelow
+		};
+
+		static const int kAnyDevice = -1;
+		static const int kMagnitude = -1;
+
+		Rule();
+		Rule( int serialNumber, Quantity quantity, int channel, Comparison comparison, double threshold, 
+			  double hysteresis=0.0, int64_t durationInUs=0 );
+
+		int				mSerialNumber;			// Or kAnyDevice
+		Quantity		mQuantity;
+		int				mChannel;				// The axis (or kMagnitude) of a Spatial quantity, the index of the Thermocouple
+		Comparison		mComparison;
+		double			mThreshold;
+		double			mHysteresis;
+		int64_t			mDurationInUs;
+	};
+
+	struct Alarm
+	{
+		std::size_t		mRuleIndex;				// As returned by addRule(), see getRule()
+		Device*			mDevice;
+		double			mValue;					// NaN when cleared by the disconnection of the device
+		int64_t			mTimeInUs;
+	};
+
+	class Consumer
+	{
+	public:
+		virtual ~Consumer() {}
+		virtual void onAlarmRaised( const Alarm& /*alarm*/ ) {}
+		virtual void onAlarmCleared( const Alarm& /*alarm*/ ) {}
+	};
+
+	RuleEngine( DeviceManager* deviceManager, Consumer* consumer );
+	virtual ~RuleEngine();
+
+	// Returns the index of the rule, used in the Alarms
+	std::size_t			addRule( const Rule& rule );
+	const Rule&			getRule( std::size_t index ) const	{ return mRules[index]; }
+	std::size_t			getNumRules() const					{ return mRules.size(); }
+
+	// Promote the pending rules whose duration elapsed, for the devices that didn't
+	// change. Call it after DeviceManager::update()
+	void				update();
+
+	std::size_t			getNumActiveAlarms() const			{ return mNumActiveAlarms; }
+	uint64_t			getNumEvaluations() const			{ return mNumEvaluations; }
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	RuleEngine( const RuleEngine& );
+	RuleEngine& operator=( const RuleEngine& );
+
+	struct Signal
+	{
+		Rule::Quantity	mQuantity;
+		int				mChannel;
+	};
+
+	enum State
+	{
+		kIdle,
+		kPending,
+		kActive
+	};
+
+	// The rules of one device, compiled as structure of arrays
+	struct Block
+	{
+		Device*					mDevice;
+		Device::ChannelMask		mChannelMask;
+		std::vector<Signal>		mSignals;
+		std::vector<double>		mValues;			// One per Signal
+
+		std::vector<std::size_t> mRuleIndices;
+		std::vector<uint32_t>	mSignalIndices;
+		std::vector<double>		mSigns;				// -1 for kBelow, so that every comparison is "above"
+		std::vector<double>		mRaiseThresholds;
+		std::vector<double>		mClearThresholds;
+		std::vector<int64_t>	mDurationsInUs;
+		std::vector<uint8_t>	mRaises;			// Results of the batch
+		std::vector<uint8_t>	mClears;
+		std::vector<uint8_t>	mStates;
+		std::vector<int64_t>	mPendingTimesInUs;	// When the rule went past its threshold
+
+		std::size_t				mNumPending;
+		int64_t					mTimeInUs;			// Of the last evaluation
+		int64_t					mClockTimeInUs;
+	};
+
+	static bool			hasSignal( const Device* device, const Signal& signal );
+	void				compileRule( Block& block, std::size_t ruleIndex );
+	void				subscribe( Block& block );
+	void				readValues( Block& block ) const;
+	void				evaluate( Block& block );
+	void				promote( Block& block, int64_t timeInUs );
+	void				notify( Block& block, std::size_t index, bool raised, int64_t timeInUs );
+
+	DeviceManager*		mDeviceManager;
+	Consumer*			mConsumer;
+	std::vector<Rule>	mRules;
+
+	std::vector<Block*>	mBlocks;
+	typedef std::map<const Device*, Block*> BlocksByDevice;
+	BlocksByDevice		mBlocksByDevice;
+
+	std::size_t			mNumActiveAlarms;
+	uint64_t			mNumEvaluations;
+};
+
+}
@@ -0,0 +1,154 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	Shared memory format
+
+	A SharedMemoryPublisher mirrors the devices of a DeviceManager into a named 
+	shared memory segment, which any number of processes can map and read using 
+	a SharedMemoryReader.
+
+	The segment is made of a SharedMemoryHeader followed by mNumSlots slots of 
+	mSlotSize bytes. Each slot holds one device, identified by its serial number, 
+	and is made of a SharedMemorySlot followed by a ring of mRingSize 
+	SharedMemoryRingEntries.
+
+	The data is stored as Records (see RPhiRecording.h):
+	- mAttachedRecord is the kDeviceAttached record of the device
+	- mLatestRecords holds the latest measure of each channel: the kSpatialMeasure 
+	  of a Spatial, the kThermocoupleMeasure of each Thermocouple (up to 
+	  kMaxNumLatestThermocouples) and the kAmbientTemperature of a TemperatureSensor
+	- the ring holds the recent records of the device, in the same order as in 
+	  a recording: the description of the device when it gets attached, then its 
+	  measures and finally its kDeviceDetached record. mNumRingRecords is the 
+	  total number of records ever written in the ring, record n being stored in 
+	  entry n % mRingSize
+
+	There is a single writer (the publisher) and the readers never write to the 
+	segment. Consistency is ensured by sequence counters rather than locks, so a 
+	reader can never block the publisher:
+	- mSequence protects the slot (everything but the ring). The publisher makes 
+	  it odd while it modifies the slot and even again when it's done. A reader 
+	  copies what it needs and retries if the counter was odd or has changed
+	- the mSequence of a ring entry is 2*(n+1) once record n has been completely
+	  written in it, and odd while it is being written
+*/
+struct SharedMemoryHeader
+{
+	char		mMagic[8];				// "RPHISHM" followed by a null character
+	uint32_t	mVersion;
+	uint32_t	mRecordSize;			// sizeof(Record)
+	uint32_t	mNumSlots;
+	uint32_t	mRingSize;
+	uint64_t	mSlotSize;				// In bytes, ring included
+	int64_t		mStartTimeInUs;			// When the publisher created the segment
+	std::atomic<uint32_t>	mPublishing;	// 0 once the publisher has stopped
+	uint8_t		mReserved[20];
+};
+
+struct SharedMemoryRingEntry
+{
+	std::atomic<uint64_t>	mSequence;
+	uint64_t				mPadding;
+	Record					mRecord;
+};
+
+struct SharedMemorySlot
+{
+	enum 
+	{
+		kMaxNumLatestThermocouples = 8,
+		kNumLatestRecords = kMaxNumLatestThermocouples + 1
+	};
+
+	// Index in mLatestRecords of the latest measure of a channel of the device, -1 if it isn't kept
+	static int				getLatestRecordIndex( const Record& record );
+
+	// Size of a slot followed by its ring, in bytes
+	static std::size_t		getSize( uint32_t ringSize )	{ return sizeof(SharedMemorySlot) + ringSize * sizeof(SharedMemoryRingEntry); }
+
+	SharedMemoryRingEntry*		getRingEntries()		{ return reinterpret_cast<SharedMemoryRingEntry*>(this+1); }
+	const SharedMemoryRingEntry*	getRingEntries() const	{ return reinterpret_cast<const SharedMemoryRingEntry*>(this+1); }
+
+	std::atomic<uint32_t>	mSequence;
+	int32_t					mSerialNumber;		// 0 when the slot has never been used
+	int32_t					mAttached;
+	int32_t					mPadding;
+	std::atomic<uint64_t>	mNumRingRecords;
+	Record					mAttachedRecord;
+	Record					mLatestRecords[kNumLatestRecords];	// mKind==0 when the channel hasn't been measured yet
+};
+
+static const char		kSharedMemoryMagic[8] = { 'R', 'P', 'H', 'I', 'S', 'H', 'M', 0 };
+static const uint32_t	kSharedMemoryVersion = 1;
+
+/*
+	SharedMemorySegment
+
+	A named shared memory segment mapped in the address space of the process. 
+	POSIX shared memory (shm_open) is used on Linux and MacOS, and named file 
+	mappings on Windows. 
+*/
+class SharedMemorySegment
+{
+public:
+	// Create a segment of the given size, replacing any existing segment with 
+	// the same name. The segment is zero-filled, mapped for reading and writing 
+	// and removed when the SharedMemorySegment is destroyed
+	SharedMemorySegment( const std::string& name, std::size_t size );
+	
+	// Map an existing segment for reading only
+	explicit SharedMemorySegment( const std::string& name );
+	
+	~SharedMemorySegment();
+
+	bool				isOpen() const		{ return mData!=NULL; }
+	const std::string&	getName() const		{ return mName; }
+	void*				getData() const		{ return mData; }
+	std::size_t			getSize() const		{ return mSize; }
+
+private:
+	SharedMemorySegment( const SharedMemorySegment& );
+	SharedMemorySegment& operator=( const SharedMemorySegment& );
+
+	std::string			getSystemName() const;
+
+	std::string			mName;
+	bool				mOwner;
+	void*				mMappingHandle;		// Only used on Windows
+	void*				mData;
+	std::size_t			mSize;
+};
+
+}
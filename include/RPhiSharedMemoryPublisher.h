@@ -0,0 +1,95 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include "RPhiDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiSharedMemory.h"
+
+namespace RPhi
+{
+
+/*
+	SharedMemoryPublisher
+
+	A Phidget can only be opened by one process at a time. The SharedMemoryPublisher 
+	lets other processes use the devices of a DeviceManager anyway: it mirrors the 
+	latest measures of each device, as well as a ring of its recent records, into 
+	a named shared memory segment (see RPhiSharedMemory.h). Other processes read 
+	the segment directly using a SharedMemoryReader, without opening the device 
+	and without talking to the publishing process.
+
+	The segment is written by the thread that calls DeviceManager::update(), 
+	without locking and without allocating memory once the working buffers have 
+	grown. Each device takes one of the numSlots slots of the segment for the 
+	lifetime of the publisher, so a device that gets detached and re-attached 
+	keeps its slot. When all the slots are used, the slot of a detached device 
+	is reused, and the devices that don't fit are not published.
+
+	The segment is removed when the publisher is destroyed.
+*/
+class SharedMemoryPublisher : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	enum 
+	{
+		kDefaultNumSlots = 16,
+		kDefaultRingSize = 1024
+	};
+
+	SharedMemoryPublisher( DeviceManager* deviceManager, const std::string& name, int numSlots=kDefaultNumSlots, int ringSize=kDefaultRingSize );
+	virtual ~SharedMemoryPublisher();
+
+	bool				isOpen() const				{ return mHeader!=NULL; }
+	const std::string&	getName() const				{ return mSegment.getName(); }
+	DeviceManager*		getDeviceManager() const	{ return mDeviceManager; }
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	SharedMemoryPublisher( const SharedMemoryPublisher& );
+	SharedMemoryPublisher& operator=( const SharedMemoryPublisher& );
+
+	SharedMemorySlot*	getSlot( int index ) const;
+	SharedMemorySlot*	findSlot( int serialNumber ) const;
+	SharedMemorySlot*	allocateSlot( int serialNumber );
+	
+	void				beginSlotWrite( SharedMemorySlot* slot );
+	void				endSlotWrite( SharedMemorySlot* slot );
+	void				appendToRing( SharedMemorySlot* slot, const Record* records, std::size_t numRecords );
+
+	DeviceManager*			mDeviceManager;
+	SharedMemorySegment		mSegment;
+	SharedMemoryHeader*		mHeader;
+	typedef std::map<int, int> SlotIndices;
+	SlotIndices				mSlotIndices;		// Serial number to slot index
+	std::vector<Record>		mRecords;			// Working buffer
+};
+
+}
@@ -0,0 +1,102 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include "RPhiSharedMemory.h"
+
+namespace RPhi
+{
+
+/*
+	SharedMemoryReader
+
+	Gives read access to the devices published by a SharedMemoryPublisher, 
+	possibly running in another process. The reader doesn't need the Phidget21 
+	library at runtime and never opens the devices.
+
+	The segment is mapped read-only and the read functions copy the data straight 
+	from the mapping, checking the sequence counters to make sure the copy is 
+	consistent (see RPhiSharedMemory.h). For the latest measures, the slot can also 
+	be accessed in place between beginRead() and endRead():
+
+		uint32_t sequence;
+		do 
+		{
+			sequence = reader.beginRead( slotIndex );
+			... read from reader.getSlot( slotIndex ) ...
+		} 
+		while ( !reader.endRead( slotIndex, sequence ) );
+
+	The reader keeps working on the segment it mapped, even after the publisher 
+	has stopped (see isPublishing()). A reader must be re-created to follow a 
+	publisher that has been restarted.
+*/
+class SharedMemoryReader
+{
+public:
+	explicit SharedMemoryReader( const std::string& name );
+
+	bool						isOpen() const			{ return mHeader!=NULL; }
+	const std::string&			getName() const			{ return mSegment.getName(); }
+	const SharedMemoryHeader*	getHeader() const		{ return mHeader; }
+	bool						isPublishing() const;
+	
+	int							getNumSlots() const;
+	const SharedMemorySlot*		getSlot( int slotIndex ) const;
+
+	// Return the index of the slot of the device, or -1 if it isn't published
+	int							findSlot( int serialNumber ) const;
+
+	// Zero-copy access to a slot. beginRead() waits until the slot isn't being 
+	// written and returns the sequence to pass to endRead(), which returns false
+	// if the slot has been modified in the meantime and must be read again
+	uint32_t					beginRead( int slotIndex ) const;
+	bool						endRead( int slotIndex, uint32_t sequence ) const;
+
+	// Copy the device information of a slot. Return false if the slot has never been used
+	bool						readDevice( int slotIndex, int& serialNumber, bool& attached, Record& attachedRecord ) const;
+
+	// Copy the latest measure of a channel (see SharedMemorySlot::getLatestRecordIndex()).
+	// Return false if the channel hasn't been measured yet
+	bool						readLatestRecord( int slotIndex, int latestRecordIndex, Record& record ) const;
+
+	// Copy the records of the ring of a slot starting at record number cursor, 
+	// and advance cursor past the last record copied. Pass a cursor of 0 to start 
+	// from the oldest record available, or getNumRingRecords() to only get the 
+	// records published from now on.
+	// The records overwritten before they could be read are skipped and counted 
+	// in numLostRecords, if given. Return the number of records copied
+	std::size_t					readRingRecords( int slotIndex, uint64_t& cursor, Record* records, std::size_t maxNumRecords, uint64_t* numLostRecords=NULL ) const;
+	uint64_t					getNumRingRecords( int slotIndex ) const;
+
+private:
+	SharedMemoryReader( const SharedMemoryReader& );
+	SharedMemoryReader& operator=( const SharedMemoryReader& );
+
+	SharedMemorySegment			mSegment;
+	const SharedMemoryHeader*	mHeader;
+};
+
+}
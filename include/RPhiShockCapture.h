@@ -0,0 +1,146 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include "RPhiDeviceManager.h"
+#include "RPhiSpatial.h"
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	ShockCapture
+
+	A black box for the Spatials: it keeps the last measures of each Spatial in a 
+	circular pre-trigger buffer, and when a trigger fires, it freezes the measures
+	from a window before the trigger to a window after it into a Capture. This 
+	gives the high-rate data around a shock without keeping everything.
+
+	A trigger fires when the magnitude of the acceleration (gravity included) or 
+	of the jerk, its rate of change between two measures, goes above its 
+	threshold, or when trigger() is called. Once the post-trigger window has 
+	elapsed, in measure time (see Spatial::getMeasureTimeInUs()), the Capture is 
+	handed to the Consumer and, if an output directory is given, written there as 
+	a recording (see RPhiRecording.h) which the ReplayDeviceManager can play. The 
+	triggers firing while a Spatial is already capturing are ignored.
+
+	The buffer of each Spatial holds numSamplesPerStream measures, which must cover
+	the pre-trigger window at the data rate of the Spatial. Outside of the captures,
+	a new measure is written in place into the buffer: nothing is allocated. The
+	memory of a capture is allocated when its trigger fires. Writing the recording
+	happens on the thread calling DeviceManager::update(), once per capture.
+*/
+class ShockCapture : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	struct Configuration
+	{
+		Configuration();
+
+		int64_t			mPreTriggerInUs;
+		int64_t			mPostTriggerInUs;
+		double			mAccelerationThresholdInGs;			// 0 disables the trigger
+		double			mJerkThresholdInGsPerSecond;		// 0 disables the trigger
+		std::size_t		mNumSamplesPerStream;
+		std::string		mOutputDirectory;					// Where to write the captures, none if empty
+	};
+
+	enum Reason
+	{
+		kAcceleration,
+		kJerk,
+		kExternal
+	};
+
+	struct Sample
+	{
+		int64_t				mTimeInUs;
+		Spatial::Measure	mMeasure;
+	};
+
+	struct Capture
+	{
+		const Spatial*		mSpatial;
+		Reason				mReason;
+		double				mTriggerValue;			// The acceleration or jerk magnitude, 0 for kExternal
+		int64_t				mTriggerTimeInUs;
+		std::vector<Sample>	mSamples;				// From mTriggerTimeInUs-mPreTriggerInUs to mTriggerTimeInUs+mPostTriggerInUs
+		std::vector<Record>	mDescription;			// The records describing the Spatial
+		std::string			mFilename;				// Of the recording written, if any
+
+		// Write the capture as a recording
+		bool				write( const std::string& filename ) const;
+	};
+
+	class Consumer
+	{
+	public:
+		virtual ~Consumer() {}
+		virtual void onCapture( const Capture& /*capture*/ ) {}
+	};
+
+	ShockCapture( DeviceManager* deviceManager, Consumer* consumer, const Configuration& configuration=Configuration() );
+	virtual ~ShockCapture();
+
+	// Fire a trigger on the given Spatial, or on all of them
+	void				trigger( const Spatial* spatial=NULL );
+
+	const Configuration& getConfiguration() const			{ return mConfiguration; }
+	uint64_t			getNumCaptures() const				{ return mNumCaptures; }
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	ShockCapture( const ShockCapture& );
+	ShockCapture& operator=( const ShockCapture& );
+
+	struct Stream
+	{
+		Spatial*			mSpatial;
+		std::vector<Sample>	mSamples;				// Ring buffer
+		std::size_t			mNumSamples;
+		std::size_t			mNewestIndex;
+		Capture*			mCapture;				// While capturing the post-trigger window
+	};
+
+	void				addSample( Stream& stream, int64_t timeInUs, const Spatial::Measure& measure );
+	void				startCapture( Stream& stream, Reason reason, double triggerValue, int64_t triggerTimeInUs );
+	void				endCapture( Stream& stream );
+
+	DeviceManager*		mDeviceManager;
+	Consumer*			mConsumer;
+	Configuration		mConfiguration;
+
+	typedef std::map<const Device*, Stream*> StreamsByDevice;
+	StreamsByDevice		mStreamsByDevice;
+	uint64_t			mNumCaptures;
+};
+
+}
@@ -0,0 +1,82 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace RPhi
+{
+
+/*
+	Socket
+
+	A thin portable layer over BSD sockets and Winsock, used by the StreamServer 
+	and the StreamClient. All the sockets are non-blocking.
+*/
+class Socket
+{
+public:
+#if _WIN32
+	typedef uintptr_t Handle;
+#else
+	typedef int Handle;
+#endif
+	static const Handle	kInvalidHandle;
+
+	// A TCP socket listening on all the interfaces. A port of 0 picks any free port,
+	// returned in boundPort
+	static Handle		createTcpListener( int port, int& boundPort );
+	static Handle		accept( Handle listener );
+	static Handle		connectTcp( const std::string& host, int port );
+	
+	// A UDP socket sending to, or receiving from, a multicast group
+	static Handle		createMulticastSender( const std::string& groupAddress, int port, int timeToLive );
+	static Handle		createMulticastReceiver( const std::string& groupAddress, int port );
+	
+	static void			close( Handle handle );
+
+	// Return the number of bytes sent or received, 0 if the operation would 
+	// block and -1 if the connection is closed or has failed
+	static int			send( Handle handle, const void* data, std::size_t size );
+	static int			receive( Handle handle, void* data, std::size_t size );
+
+	struct PollEntry
+	{
+		Handle		mHandle;
+		bool		mWantRead;
+		bool		mWantWrite;
+		bool		mReadable;		// Also set on errors, so that the next receive() reports them
+		bool		mWritable;
+	};
+	typedef std::vector<PollEntry> PollEntries;
+
+	// Wait until one of the sockets can be read or written, or until the timeout 
+	// has elapsed. Return false on failure
+	static bool			poll( PollEntries& entries, int timeoutInMs );
+};
+
+}
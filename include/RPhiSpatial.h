@@ -23,6 +23,7 @@
 */
 #pragma once
 
+#include <map>
 #include "RPhiVector3.h"
 #include "RPhiDevice.h"
 typedef struct _CPhidgetSpatial *CPhidgetSpatialHandle;
@@ -66,13 +67,52 @@ namespace RPhi
 class Spatial : public Device
 {
 public: 
+	static const Type		kType = kSpatial;
+
 	virtual void			update();
 
+	// Return false if the device doesn't support the rate. While listeners declare 
+	// a data rate (see below), the device isn't changed: the rate is only checked 
+	// against the range of the device, and gets applied once no listener declares 
+	// a rate anymore, snapped to the closest supported rate which is at least as fast
 	bool					setDataRateInMs( int dataRateInMs );
 	int						getDataRateInMs() const					{ return mDataRateInMs; }
 
+	// Instead of setting the data rate, the listeners can declare the one they need. 
+	// The Spatial then runs at the fastest rate declared, snapped to a supported 
+	// one, and notifies the listeners needing a slower rate once every few measures
+	// only. When no listener declares a rate anymore, it goes back to the rate given 
+	// to setDataRateInMs() or to the one of the device when opened. 0 removes the 
+	// declaration of the listener, which must have been added first
+	void					setListenerDataRateInMs( Listener* listener, int dataRateInMs );
+	int						getListenerDataRateInMs( Listener* listener ) const;
+
 	void					zeroGyro();
 
+	// The sensors of a Spatial, which are also its channels: a listener can subscribe
+	// to the sensors it cares about (see Device::addListener())
+	enum Sensor
+	{
+		kAccelerometer,
+		kGyroscope,
+		kMagnetometer,
+		kNumSensors
+	};
+
+	// Each sensor can be disabled, or polled every periodInUs instead of on every update,
+	// for example the magnetometer which refreshes slowly. A sensor which isn't polled
+	// keeps its last value, read at getSensorTimeInUs(), and saves its C API calls
+	void					setSensorEnabled( Sensor sensor, bool enabled )	{ mSensorEnabled[sensor] = enabled; }
+	bool					isSensorEnabled( Sensor sensor ) const	{ return mSensorEnabled[sensor]; }
+	void					setSensorPollingPeriodInUs( Sensor sensor, int64_t periodInUs )	{ mSensorPollingPeriodsInUs[sensor] = periodInUs; }
+	int64_t					getSensorPollingPeriodInUs( Sensor sensor ) const	{ return mSensorPollingPeriodsInUs[sensor]; }
+
+	// When the value of the sensor in the current measure was read, or -1. With the 
+	// background acquisition, a read giving the same measure as the previous one 
+	// isn't handed over (see DeviceManager), so this is when the value was read 
+	// last with a change or a resync
+	int64_t					getSensorTimeInUs( Sensor sensor ) const	{ return mSensorTimesInUs[sensor]; }
+
 	int						getNumAccelerationAxes() const			{ return mNumAccelerationAxes; }
 	int						getNumAngularRateAxes() const			{ return mNumAngularRateAxes; }
 	int						getNumMagneticFieldAxes() const			{ return mNumMagneticFieldAxes; }
@@ -81,6 +121,15 @@ public:
 	const Measure&			getMeasure() const						{ return mMeasure; }
 	const Measure&			getMinMeasure() const					{ return mMinMeasure; }
 	const Measure&			getMaxMeasure() const					{ return mMaxMeasure; }
+
+	// The number of samples lost between the previous measure and the current one, 
+	// estimated from the data rate and the time each measure is read at. A non-zero 
+	// value flags a measure following a gap (see Device::Gap)
+	uint64_t				getNumLostSamplesBeforeMeasure() const	{ return mNumLostSamplesBeforeMeasure; }
+
+	// When the current measure was read (see Clock::getTimeInUs()), or the time it 
+	// was recorded at when replaying. -1 until the first measure
+	int64_t					getMeasureTimeInUs() const				{ return mMeasureTimeInUs; }
 	
 	class Measure
 	{
@@ -107,27 +156,75 @@ public:
 protected:
 	friend class DeviceManager;
 	Spatial( CPhidgetHandle phidgetSpecificHandle );
+	static bool				isPhidgetDeviceID( int deviceID );
+	static CPhidgetHandle	createPhidgetHandle();
+	Spatial( const std::string& name, int serialNumber, int version, const std::string& typeName );
 	virtual ~Spatial();
 
+	// Used by Spatials which aren't backed by a Phidget to provide their information and measures
+	void					setSpatialInformation( int numAccelerationAxes, int numAngularRateAxes, int numMagneticFieldAxes,
+												   const Measure& minMeasure, const Measure& maxMeasure, int dataRateInMs );
+	// Take the new measure, of which the given sensors were read at timeInUs
+	void					setMeasure( const Measure& measure, int64_t timeInUs, ChannelMask readSensors=kAllChannels );
+	static ChannelMask		getChangedSensors( const Measure& measure, const Measure& previousMeasure );
+	void					addMeasureDelta( const Measure& oldMeasure, const Measure& newMeasure );
+
 	CPhidgetSpatialHandle	getSpatialHandle() const { return reinterpret_cast<CPhidgetSpatialHandle>(getPhidgetHandle()); }
 
-	void					updateMeasure( Measure& measure, const Vector3d& fallbackMagneticFieldInGauss );
-	
+	// Read a new measure from the enabled sensors due at timeInUs and return them. 
+	// The values which aren't read are taken from the fallback measure
+	ChannelMask				updateMeasure( Measure& measure, const Measure& fallbackMeasure, ChannelMask enabledSensors, int64_t timeInUs );
+	double					checkValue( int ret, double value, double fallbackValue );
+
+	// Called when a new measure read at the given time is about to replace the current one.
+	// Only the sensors polled on every update tell about the samples of the device
+	void					detectGap( int64_t timeInUs, ChannelMask changedSensors );
+	void					resetGapDetection()		{ mLastSampleTimeInUs = -1; }
+
+	virtual ChannelMask		getPolledChannels() const;
+	virtual void			acquire( ChannelMask polledChannels, bool resync, int64_t timeInUs, std::vector<Record>& records );
+	virtual ChannelMask		applyRecord( const Record& record );
+	virtual ChannelMask		getRecordChannels( const Record& record ) const;
+
+	virtual void			appendDescription( std::size_t attachedRecordIndex, int64_t timeInUs, std::vector<Record>& records ) const;
+	virtual void			appendMeasures( ChannelMask channels, int64_t timeInUs, std::vector<Record>& records ) const;
+	virtual void			setDescription( const Record* records, std::size_t numRecords );
+
 	void					getSpatialInformation();
 	void					getAccelerationInformation( int& numAxes, Vector3d& min, Vector3d& max ) const;
 	void					getAngularRateInformation( int& numAxes, Vector3d& min, Vector3d& max ) const;
 	void					getMagneticFieldInformation( int& numAxes, Vector3d& min, Vector3d& max ) const;
 	void					internalGetDataRateInMs();
 
+	// Set the data rate required by the listeners and their decimations
+	void					applyDataRate();
+	virtual void			onListenerRemoved( Listener* listener );
+
 private:
+	void					initializeSensors();
+
 	double					mAngularRateZSignFix;	// The gyrometer of one of our Spatials seems to be mounted incorrectly on the board!
 	int						mNumAccelerationAxes;
 	int						mNumAngularRateAxes;
 	int						mNumMagneticFieldAxes;
 	int						mDataRateInMs;
+	int						mBaseDataRateInMs;		// When no listener declares a data rate
+	int						mFastestDataRateInMs;
+	int						mSlowestDataRateInMs;
+	typedef std::map<Listener*, int> ListenerDataRates;
+	ListenerDataRates		mListenerDataRatesInMs;
 	Measure					mMeasure;
 	Measure					mMinMeasure;
 	Measure					mMaxMeasure;
+	Measure					mAcquiredMeasure;		// Only accessed by the acquisition thread
+	int64_t					mMeasureTimeInUs;
+	int64_t					mLastSampleTimeInUs;	// mMeasureTimeInUs, or -1 after a reset of the gap detection
+	int64_t					mSampleClockInUs;		// Latest estimate of when the hardware produced the current measure
+	uint64_t				mNumLostSamplesBeforeMeasure;
+	std::atomic<bool>		mSensorEnabled[kNumSensors];
+	std::atomic<int64_t>	mSensorPollingPeriodsInUs[kNumSensors];
+	int64_t					mSensorPollTimesInUs[kNumSensors];		// Only accessed by the polling thread (see updateMeasure())
+	int64_t					mSensorTimesInUs[kNumSensors];
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace RPhi
+{
+
+/*
+	SpscQueue
+
+	A bounded lock-free queue with a single producer thread and a single consumer 
+	thread. The capacity is rounded up to a power of two. push() and pop() never 
+	block nor allocate: they return false when the queue is respectively full or 
+	empty.
+
+	The read and write positions are kept on separate cache lines so that the 
+	producer and the consumer don't invalidate each other's cache line on every 
+	operation.
+*/
+template<typename T>
+class SpscQueue
+{
+public:
+	explicit SpscQueue( std::size_t capacity )
+		: mItems(),
+		  mMask(0),
+		  mReadPosition(0),
+		  mWritePosition(0)
+	{
+		std::size_t size = 1;
+		while ( size<capacity )
+			size <<= 1;
+		mItems.resize( size );
+		mMask = size - 1;
+	}
+
+	std::size_t	getCapacity() const	{ return mItems.size(); }
+
+	// Producer side
+	bool push( const T& item )
+	{
+		std::size_t writePosition = mWritePosition.load( std::memory_order_relaxed );
+		if ( writePosition - mReadPosition.load( std::memory_order_acquire ) >= mItems.size() )
+			return false;
+		mItems[writePosition & mMask] = item;
+		mWritePosition.store( writePosition + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Push all the items or none of them. The consumer sees them all at once
+	bool push( const T* items, std::size_t numItems )
+	{
+		std::size_t writePosition = mWritePosition.load( std::memory_order_relaxed );
+		if ( writePosition - mReadPosition.load( std::memory_order_acquire ) + numItems > mItems.size() )
+			return false;
+		for ( std::size_t i=0; i<numItems; ++i )
+			mItems[(writePosition + i) & mMask] = items[i];
+		mWritePosition.store( writePosition + numItems, std::memory_order_release );
+		return true;
+	}
+
+	// Consumer side
+	bool pop( T& item )
+	{
+		std::size_t readPosition = mReadPosition.load( std::memory_order_relaxed );
+		if ( readPosition==mWritePosition.load( std::memory_order_acquire ) )
+			return false;
+		item = mItems[readPosition & mMask];
+		mReadPosition.store( readPosition + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Approximate when called while the other thread is working on the queue
+	std::size_t getSize() const
+	{
+		return mWritePosition.load( std::memory_order_acquire ) - mReadPosition.load( std::memory_order_acquire );
+	}
+
+private:
+	SpscQueue( const SpscQueue& );
+	SpscQueue& operator=( const SpscQueue& );
+
+	enum { kCacheLineSize = 64 };
+
+	std::vector<T>				mItems;
+	std::size_t					mMask;
+	char						mPadding0[kCacheLineSize];
+	std::atomic<std::size_t>	mReadPosition;
+	char						mPadding1[kCacheLineSize];
+	std::atomic<std::size_t>	mWritePosition;
+	char						mPadding2[kCacheLineSize];
+};
+
+}
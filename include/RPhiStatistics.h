@@ -0,0 +1,173 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace RPhi
+{
+
+class DeviceManager;
+
+/*
+	LatencyHistogram
+
+	A histogram of durations in nanoseconds, with log-linear buckets in the 
+	fashion of HDR histograms: each power of two is split into kNumSubBuckets 
+	buckets, so a value is known within 12.5% from 8ns up to about an hour 
+	(longer values land in the last bucket). Values below 8ns are exact.
+
+	record() can be called from any thread and doesn't lock nor allocate. The
+	counts are read through a Snapshot, which is consistent enough for 
+	monitoring but not atomic as a whole.
+*/
+class LatencyHistogram
+{
+public:
+	enum 
+	{
+		kNumSubBuckets = 8,
+		kNumBuckets = 40 * kNumSubBuckets
+	};
+
+	LatencyHistogram();
+
+	void				record( uint64_t durationInNs );
+
+	struct Snapshot
+	{
+		Snapshot();
+
+		// Upper bound of the bucket containing the given percentile (between 0 and 100)
+		uint64_t		getPercentileInNs( double percentile ) const;
+
+		// Number of values strictly below the given power of two
+		uint64_t		getCountBelowPowerOfTwo( int exponent ) const;
+
+		uint64_t		mCounts[kNumBuckets];
+		uint64_t		mCount;
+		uint64_t		mSumInNs;
+		uint64_t		mMaxInNs;
+	};
+	void				getSnapshot( Snapshot& snapshot ) const;
+
+	static int			getBucketIndex( uint64_t durationInNs );
+	static uint64_t		getBucketLowerBoundInNs( int index );
+
+private:
+	LatencyHistogram( const LatencyHistogram& );
+	LatencyHistogram& operator=( const LatencyHistogram& );
+
+	std::atomic<uint64_t>	mCounts[kNumBuckets];
+	std::atomic<uint64_t>	mCount;
+	std::atomic<uint64_t>	mSumInNs;
+	std::atomic<uint64_t>	mMaxInNs;
+};
+
+/*
+	DeviceStatistics
+
+	Runtime counters of a Device, updated by the library as the device is polled
+	(see Device::getStatistics()). The counters are atomic so that they can be 
+	updated from the background acquisition thread (see DeviceManager::startAcquisition())
+*/
+struct DeviceStatistics
+{
+	DeviceStatistics();
+
+	std::atomic<uint64_t>	mNumPolls;				// Updates, or acquisitions in background acquisition mode
+	std::atomic<uint64_t>	mNumChanges;			// Changes notified to the listeners
+	std::atomic<uint64_t>	mNumFailedCalls;		// C API calls which failed. The previous value is kept
+	std::atomic<uint64_t>	mNumUnknownValues;		// C API calls which returned EPHIDGET_UNKNOWNVAL. The previous value is kept
+	std::atomic<uint64_t>	mNumGaps;				// See Device::Gap
+	std::atomic<uint64_t>	mNumLostSamples;
+	LatencyHistogram		mPollDuration;
+	LatencyHistogram		mListenerDuration;		// Notification of all the listeners of a change
+	LatencyHistogram		mSampleAge;				// In background acquisition mode, from the acquisition to the dispatch
+};
+
+/*
+	DeviceManagerStatistics
+
+	Runtime counters of a DeviceManager (see DeviceManager::getStatistics())
+*/
+struct DeviceManagerStatistics
+{
+	DeviceManagerStatistics();
+
+	std::atomic<uint64_t>	mNumUpdates;
+	std::atomic<uint64_t>	mNumConnections;
+	std::atomic<uint64_t>	mNumDisconnections;
+	std::atomic<uint64_t>	mNumReattachments;		// Devices back before the end of their hold-off (see DeviceManager::setHoldOffInUs())
+	LatencyHistogram		mUpdateDuration;		// update(), or dispatch() in background acquisition mode
+	LatencyHistogram		mUpdateDeviceListDuration;
+};
+
+/*
+	StatisticsSnapshot
+
+	A copy of the statistics of a DeviceManager and of its devices at a given
+	time. It must be taken on the thread calling DeviceManager::update(), but can
+	then be handed over to any thread, for example to serve a Prometheus scrape.
+*/
+struct StatisticsSnapshot
+{
+	struct Device
+	{
+		int							mSerialNumber;
+		std::string					mTypeName;
+		uint64_t					mNumPolls;
+		uint64_t					mNumChanges;
+		uint64_t					mNumFailedCalls;
+		uint64_t					mNumUnknownValues;
+		uint64_t					mNumGaps;
+		uint64_t					mNumLostSamples;
+		LatencyHistogram::Snapshot	mPollDuration;
+		LatencyHistogram::Snapshot	mListenerDuration;
+		LatencyHistogram::Snapshot	mSampleAge;
+	};
+
+	StatisticsSnapshot();
+
+	void							take( const DeviceManager& deviceManager );
+
+	// Write the snapshot in the Prometheus text exposition format. The metric 
+	// names start with the given prefix
+	std::string						toPrometheusText( const char* prefix="rphi" ) const;
+
+	int64_t							mTimeInUs;
+	uint64_t						mNumUpdates;
+	uint64_t						mNumConnections;
+	uint64_t						mNumDisconnections;
+	uint64_t						mNumReattachments;
+	uint64_t						mNumDroppedAcquisitionRecords;		// See DeviceManager::getNumDroppedAcquisitionRecords()
+	LatencyHistogram::Snapshot		mUpdateDuration;
+	LatencyHistogram::Snapshot		mUpdateDeviceListDuration;
+	std::vector<Device>				mDevices;
+};
+
+}
@@ -0,0 +1,94 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include "RPhiDevice.h"
+#include "RPhiRecording.h"
+#include "RPhiSocket.h"
+#include "RPhiStreamProtocol.h"
+
+namespace RPhi
+{
+
+/*
+	StreamClient
+
+	Receives the Records streamed by a StreamServer, either over TCP or from a 
+	UDP multicast group. 
+
+	Over TCP, the filters are applied by the server, which only sends what has 
+	been subscribed to. The multicast group receives everything, so the filters 
+	are applied by the client.
+
+	The values of the measures are quantized to StreamProtocol::kValueResolution.
+*/
+class StreamClient
+{
+public:
+	StreamClient();
+	~StreamClient();
+
+	bool			connect( const std::string& host, int port );
+	bool			joinMulticastGroup( const std::string& groupAddress, int port );
+	void			close();
+	bool			isConnected() const				{ return mHandle!=Socket::kInvalidHandle; }
+
+	// Restrict the records received to the given device (0 for all of them) 
+	// and channels. Each call adds to the previous ones. Until the first call,
+	// everything is received
+	bool			subscribe( int serialNumber, Device::ChannelMask channelMask=Device::kAllChannels );
+
+	// Wait up to timeoutInMs for data and append the records received to records.
+	// Return false once the connection is closed
+	bool			receive( std::vector<Record>& records, int timeoutInMs );
+
+	uint64_t		getNumFramesReceived() const	{ return mNumFramesReceived; }
+	
+	// The records dropped by the server because this client didn't keep up
+	uint64_t		getNumRecordsDropped() const	{ return mNumRecordsDropped; }
+	
+	// The frames lost in the network, when using multicast
+	uint64_t		getNumFramesLost() const		{ return mNumFramesLost; }
+
+private:
+	StreamClient( const StreamClient& );
+	StreamClient& operator=( const StreamClient& );
+
+	bool			decodeFrame( const uint8_t* data, std::size_t size, std::vector<Record>& records );
+
+	Socket::Handle			mHandle;
+	bool					mIsMulticast;
+	StreamProtocol::Filters	mFilters;
+	std::vector<uint8_t>	mInput;
+	StreamFrameDecoder		mDecoder;
+	uint64_t				mNextSequenceNumber;
+	uint64_t				mNumFramesReceived;
+	uint64_t				mNumRecordsDropped;
+	uint64_t				mNumFramesLost;
+	Socket::PollEntries		mPollEntries;
+};
+
+}
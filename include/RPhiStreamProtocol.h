@@ -0,0 +1,181 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "RPhiRecording.h"
+
+namespace RPhi
+{
+
+/*
+	Stream protocol
+
+	The protocol used by the StreamServer to send Records (see RPhiRecording.h)
+	to its subscribers, over TCP or UDP multicast.
+
+	The data is sent in frames. Over TCP, each frame is preceded by its size 
+	encoded as a varint. Over UDP, each datagram holds one frame. A frame starts
+	with its type (one byte):
+	- kRecordsFrame, sent by the server:
+		varint		sequence number of the frame
+		varint		number of records dropped for this subscriber since the previous frame
+		varint		base time in microseconds
+		varint		number of records
+		records
+	- kSubscribeFrame, sent by a client to choose what it receives:
+		varint		number of filters
+		filters		varint serial number (0 for all the devices), varint channel mask
+
+	Each record is made of its kind (one byte), the signed varint difference 
+	between its serial number and the one of the previous record, its channel
+	(varint) and the signed varint difference between its time and the one of 
+	the previous record (or the base time). Then comes its payload:
+	- for the measures (kSpatialMeasure, kThermocoupleMeasure, kAmbientTemperature),
+	  each value is quantized to kValueResolution and sent as the signed varint 
+	  difference with the same value in the previous record of the same device,
+	  kind and channel in the frame (or with 0)
+	- for the other records, the payload is sent as is
+
+	Signed values are zigzag encoded, so that small negative differences remain 
+	small. A frame can always be decoded on its own, which matters when datagrams 
+	are lost.
+*/
+class StreamProtocol
+{
+public:
+	enum FrameType
+	{
+		kRecordsFrame = 1,
+		kSubscribeFrame = 2
+	};
+
+	static const double	kValueResolution;
+	enum { kMaxNumValues = 9 };
+
+	// The values carried by a measure record. Return the number of values, 0 if the record isn't a measure
+	static int			getValues( const Record& record, int64_t* values );
+	static void			setValues( Record& record, const int64_t* values );
+
+	// The last values of a device, kind and channel in a frame, against which the next ones are encoded
+	struct Stream
+	{
+		int32_t		mSerialNumber;
+		uint16_t	mKind;
+		uint16_t	mChannel;
+		int64_t		mValues[kMaxNumValues];
+	};
+	typedef std::vector<Stream> Streams;
+	static Stream&		getStream( Streams& streams, const Record& record );
+
+	// What a subscriber receives: the records of the devices with the given serial 
+	// number (0 for all of them). The channel mask only applies to the measures,
+	// bit N standing for channel N (see Device::ChannelMask). A Spatial measure 
+	// matches if any of the sensors it was read from is in the mask
+	struct Filter
+	{
+		int32_t		mSerialNumber;
+		uint32_t	mChannelMask;
+	};
+	typedef std::vector<Filter> Filters;
+	static bool			matches( const Filters& filters, const Record& record );
+	static bool			isMeasure( uint16_t kind );
+
+	// Append a kSubscribeFrame to buffer, preceded by its size
+	static void			writeSubscribeFrame( std::vector<uint8_t>& buffer, const Filters& filters );
+	
+	// Read a kSubscribeFrame (without its size prefix). Return false if it's invalid
+	static bool			readSubscribeFrame( const uint8_t* data, std::size_t size, Filters& filters );
+
+	static void			writeVarint( std::vector<uint8_t>& buffer, uint64_t value );
+	static void			writeSignedVarint( std::vector<uint8_t>& buffer, int64_t value );
+	
+	// Read a varint starting at position and move position past it. Return false if the data is truncated
+	static bool			readVarint( const uint8_t* data, std::size_t size, std::size_t& position, uint64_t& value );
+	static bool			readSignedVarint( const uint8_t* data, std::size_t size, std::size_t& position, int64_t& value );
+};
+
+/*
+	StreamFrameEncoder
+
+	Encodes Records into kRecordsFrames. The encoder doesn't allocate memory once
+	its buffers have grown to their working size.
+*/
+class StreamFrameEncoder
+{
+public:
+	StreamFrameEncoder();
+	
+	// Start a frame. The previous frame is discarded 
+	void						begin( uint64_t sequenceNumber, uint64_t numDroppedRecords, int64_t baseTimeInUs );
+	
+	// Add a record to the frame
+	void						addRecord( const Record& record );
+	
+	std::size_t					getNumRecords() const	{ return mNumRecords; }
+	
+	// Size of the frame encoded so far, roughly (the header isn't complete yet)
+	std::size_t					getSize() const			{ return mHeader.size() + mRecords.size(); }
+
+	// Append the frame to buffer, preceded by its size if sizePrefixed is true
+	void						end( std::vector<uint8_t>& buffer, bool sizePrefixed );
+
+	// The largest size a single record can take once encoded
+	static const std::size_t	kMaxRecordSize;
+
+private:
+	std::vector<uint8_t>		mHeader;
+	std::vector<uint8_t>		mRecords;
+	std::size_t					mNumRecords;
+	int32_t						mPreviousSerialNumber;
+	int64_t						mPreviousTimeInUs;
+	StreamProtocol::Streams		mStreams;
+};
+
+/*
+	StreamFrameDecoder
+
+	Decodes the kRecordsFrames written by a StreamFrameEncoder.
+*/
+class StreamFrameDecoder
+{
+public:
+	StreamFrameDecoder();
+
+	// Decode a frame (without its size prefix) and append its records to records.
+	// Return false if the frame is invalid, in which case records is left unchanged
+	bool					decode( const uint8_t* data, std::size_t size, std::vector<Record>& records );
+
+	uint64_t				getSequenceNumber() const		{ return mSequenceNumber; }
+	uint64_t				getNumDroppedRecords() const	{ return mNumDroppedRecords; }
+
+private:
+	uint64_t				mSequenceNumber;
+	uint64_t				mNumDroppedRecords;
+	StreamProtocol::Streams	mStreams;
+};
+
+}
@@ -0,0 +1,148 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "RPhiDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiRecording.h"
+#include "RPhiSocket.h"
+#include "RPhiStreamProtocol.h"
+
+namespace RPhi
+{
+
+/*
+	StreamServer
+
+	The StreamServer streams the measures of the devices of a DeviceManager to 
+	any number of subscribers over TCP, and optionally to a UDP multicast group, 
+	using the compact protocol described in RPhiStreamProtocol.h. The measures 
+	are sent as Records, batched into delta-encoded frames.
+
+	A subscriber receives the description of the devices (see RPhiRecording.h) 
+	when it connects, followed by their measures. It can restrict what it 
+	receives to some devices and channels by sending a kSubscribeFrame (see 
+	StreamClient::subscribe()). The multicast group receives everything and the 
+	device descriptions are repeated every second for late joiners.
+
+	The records are queued by the thread that calls DeviceManager::update() and 
+	sent by a dedicated network thread, every flush interval. Each subscriber 
+	has its own bounded queue: when a subscriber doesn't read fast enough, its 
+	queue fills up and the new measures are dropped for this subscriber only (the
+	attachment, description and detachment of the devices still go through). 
+	The number of records dropped is reported to the subscriber in the next frame. 
+	The acquisition is never slowed down by the network.
+*/
+class StreamServer : public DeviceManager::Listener, public Device::Listener
+{
+public:
+	enum
+	{
+		kDefaultMaxNumQueuedRecords = 4096,
+		kMaxDatagramSize = 1400
+	};
+
+	// A port of 0 picks any free port (see getPort())
+	StreamServer( DeviceManager* deviceManager, int port, int maxNumQueuedRecords=kDefaultMaxNumQueuedRecords );
+	virtual ~StreamServer();
+
+	bool				isOpen() const						{ return mListenerHandle!=Socket::kInvalidHandle; }
+	int					getPort() const						{ return mPort; }
+	DeviceManager*		getDeviceManager() const			{ return mDeviceManager; }
+
+	// Also send everything to a multicast group
+	bool				enableMulticast( const std::string& groupAddress, int port, int timeToLive=1 );
+
+	// How often the queued records are sent
+	void				setFlushIntervalInMs( int flushIntervalInMs );
+	int					getFlushIntervalInMs() const		{ return mFlushIntervalInMs; }
+
+	int					getNumSubscribers() const;
+	uint64_t			getNumFramesSent() const			{ return mNumFramesSent; }
+	uint64_t			getNumRecordsDropped() const		{ return mNumRecordsDropped; }
+
+	virtual void		onDeviceConnected( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceDisconnecting( DeviceManager* deviceManager, Device* device );
+	virtual void		onDeviceChanged( Device* device );
+
+private:
+	StreamServer( const StreamServer& );
+	StreamServer& operator=( const StreamServer& );
+
+	struct Subscriber
+	{
+		Socket::Handle			mHandle;
+		bool					mIsMulticast;
+		StreamProtocol::Filters	mFilters;
+		std::vector<Record>		mQueuedRecords;		// Filled by the acquisition thread, under mMutex
+		uint64_t				mNumDroppedRecords;	// Under mMutex
+		std::vector<Record>		mSendingRecords;	// The rest is only accessed by the network thread 
+		uint64_t				mNumFrames;
+		std::vector<uint8_t>	mOutput;
+		std::size_t				mOutputPosition;
+		std::vector<uint8_t>	mInput;
+	};
+	typedef std::vector<Subscriber*> Subscribers;
+
+	Subscriber*			createSubscriber( Socket::Handle handle, bool isMulticast );
+	void				queueRecords( const Record* records, std::size_t numRecords );
+	void				queueRecords( Subscriber* subscriber, const Record* records, std::size_t numRecords );
+	static bool			isMeasure( const Record& record );
+	void				queueDescriptions( Subscriber* subscriber );
+	
+	void				networkThreadMain();
+	void				acceptSubscribers();
+	bool				receiveFromSubscriber( Subscriber* subscriber );
+	bool				sendToSubscriber( Subscriber* subscriber );
+	void				encodeFrames( Subscriber* subscriber, uint64_t numDroppedRecords );
+	void				removeSubscriber( Subscriber* subscriber );
+
+	DeviceManager*				mDeviceManager;
+	int							mPort;
+	Socket::Handle				mListenerHandle;
+	std::size_t					mMaxNumQueuedRecords;
+	std::atomic<int>			mFlushIntervalInMs;
+	std::vector<Record>			mRecords;					// Working buffer of the acquisition thread
+
+	typedef std::map< int, std::vector<Record> > Descriptions;
+	Descriptions				mDescriptions;				// The description records of the connected devices, by serial number
+	Subscribers					mSubscribers;
+	Subscriber*					mMulticastSubscriber;
+	mutable std::mutex			mMutex;						// Protects mDescriptions, mSubscribers and the subscriber queues
+
+	StreamFrameEncoder			mEncoder;					// Only accessed by the network thread
+	Socket::PollEntries			mPollEntries;
+	std::atomic<uint64_t>		mNumFramesSent;
+	std::atomic<uint64_t>		mNumRecordsDropped;
+	std::atomic<bool>			mStopRequested;
+	std::thread					mNetworkThread;
+};
+
+}
@@ -35,12 +35,19 @@ namespace RPhi
 	A TemperatureSensor is a device which contains one or more Thermocouples. 
 	Each Thermocouple provides a temperature reading/measure in Celsius degrees.
 	This is the temperature at the end of the wire. There's also the raw measure 
-	which is in millivolts. The millivolts gets converted into C by Phidget
+	which is in millivolts. The millivolts gets converted into �C by Phidget
 	based on the type of the Thermocouple (K, J, E and T).
 
 	The TemperatureSensor also has a built-in sensor which gives the "ambient"
 	temperature. This is the temperature at the board.
 
+	Each Thermocouple is a channel of the device (channel N is the Thermocouple
+	at index N) and so is the ambient sensor (kAmbientChannel). Channels can be 
+	disabled individually and listeners can subscribe to specific channels only. 
+	A channel that is disabled, or that no listener is subscribed to, is not 
+	polled: its measure is kept but marked as stale. When the device has no 
+	listener at all, every enabled channel is polled.
+
 	Thermocouple primer
 	http://www.phidgets.com/docs/Thermocouple_Primer
 
@@ -54,6 +61,8 @@ namespace RPhi
 class TemperatureSensor : public Device
 {
 public: 
+	static const Type		kType = kTemperatureSensor;
+
 	virtual void			update();
 
 	// Return the list of Thermocouples present on the TemperatureSensor device
@@ -65,6 +74,14 @@ public:
 	double getAmbientTemperatureInC() const			{ return mAmbientTemperatureInC; }
 	double getMinAmbientTemperatureInC() const		{ return mMinAmbientTemperatureInC; }
 	double getMaxAmbientTemperatureInC() const		{ return mMaxAmbientTemperatureInC; }
+	bool isAmbientTemperatureStale() const			{ return mAmbientTemperatureStale; }
+
+	// Enable or disable the polling of a channel
+	static const int kAmbientChannel = 31;
+	void setChannelEnabled( int channel, bool enabled );
+	bool isChannelEnabled( int channel ) const		{ return ( mEnabledChannels & getChannelMask(channel) )!=0; }
+	ChannelMask getEnabledChannels() const			{ return mEnabledChannels; }
+	void setEnabledChannels( ChannelMask channels )	{ mEnabledChannels = channels; }
 
 	class Thermocouple 
 	{
@@ -73,6 +90,10 @@ public:
 		// parent TemperatureSensor can notify of the change
 		bool	update(); 
 
+		// Whether the measure wasn't refreshed during the last update of the parent 
+		// TemperatureSensor (because the channel is disabled or has no subscriber)
+		bool	isMeasureStale() const { return mMeasureStale; }
+
 		// The index of the Thermocouple in the parent device
 		int		getIndex() const { return mIndex; }
 
@@ -115,9 +136,11 @@ public:
 	protected:
 		friend class TemperatureSensor;
 		Thermocouple( CPhidgetTemperatureSensorHandle parentTemperatureSensorHandle, int index );
+		Thermocouple( int index, Type type, const Measure& minMeasure, const Measure& maxMeasure );
 	
 		void					getThermocoupleInformation();
-		void					updateMeasure( Measure& measure );
+		// Return false, leaving the measure untouched, if the Thermocouple can't be read
+		bool					updateMeasure( Measure& measure );
 	
 	private:
 		CPhidgetTemperatureSensorHandle mParentTemperatureSensorHandle;
@@ -126,6 +149,7 @@ public:
 		Measure					mMeasure;
 		Measure					mMinMeasure;
 		Measure					mMaxMeasure;
+		bool					mMeasureStale;
 	};
 	
 	virtual std::string		toString() const;
@@ -133,17 +157,50 @@ public:
 protected:
 	friend class DeviceManager;
 	TemperatureSensor( CPhidgetHandle phidgetSpecificHandle );
+	static bool						isPhidgetDeviceID( int deviceID );
+	static CPhidgetHandle			createPhidgetHandle();
+	TemperatureSensor( const std::string& name, int serialNumber, int version, const std::string& typeName );
 	virtual ~TemperatureSensor();
 
+	// Used by TemperatureSensors which aren't backed by a Phidget to provide their information 
+	// and measures. The setters return whether the measure changed
+	void							addThermocouple( int index, Thermocouple::Type type, const Thermocouple::Measure& minMeasure, const Thermocouple::Measure& maxMeasure );
+	void							setAmbientTemperatureRangeInC( double minTemperatureInC, double maxTemperatureInC );
+	bool							setThermocoupleMeasure( int index, const Thermocouple::Measure& measure );
+	bool							setAmbientTemperatureInC( double temperatureInC );
+	void							setThermocoupleMeasureStale( int index )	{ mThermocouples[index]->mMeasureStale = true; }
+	void							setAmbientTemperatureStale()				{ mAmbientTemperatureStale = true; }
+
+	// The enabled channels somebody is interested in
+	virtual ChannelMask				getPolledChannels() const;
+	virtual void					setStaleChannels( ChannelMask channels );
+
+	virtual void					acquire( ChannelMask polledChannels, bool resync, int64_t timeInUs, std::vector<Record>& records );
+	virtual ChannelMask				applyRecord( const Record& record );
+
+	virtual void					appendDescription( std::size_t attachedRecordIndex, int64_t timeInUs, std::vector<Record>& records ) const;
+	virtual void					appendMeasures( ChannelMask channels, int64_t timeInUs, std::vector<Record>& records ) const;
+	virtual void					setDescription( const Record* records, std::size_t numRecords );
+
 	CPhidgetTemperatureSensorHandle	getTemperatureSensorHandle() const  { return reinterpret_cast<CPhidgetTemperatureSensorHandle>(getPhidgetHandle()); }
 
 	void							getTemperatureSensorInformation();
 
+	// Return false, leaving the temperature untouched, if the ambient temperature can't be read
+	bool							updateAmbientTemperature( double& temperatureInC );
+
 private:
 	Thermocouples					mThermocouples;
 	double							mAmbientTemperatureInC;
 	double							mMinAmbientTemperatureInC;
 	double							mMaxAmbientTemperatureInC;
+	bool							mAmbientTemperatureStale;
+	ChannelMask						mEnabledChannels;
+
+	// Only accessed by the acquisition thread
+	std::vector<Thermocouple::Measure> mAcquiredThermocoupleMeasures;
+	double							mAcquiredAmbientTemperatureInC;
+	ChannelMask						mAcquiredChannels;		// The channels polled by the previous acquire()
 };
 
 }
\ No newline at end of file
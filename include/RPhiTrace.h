@@ -0,0 +1,116 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace RPhi
+{
+
+/*
+	Trace
+
+	Records scoped events on each thread and writes them in the Chrome trace event 
+	format, to be opened with chrome://tracing or https://ui.perfetto.dev. The 
+	library instruments the DeviceManager updates, the polling of each device, the 
+	C API calls and the notification of the listeners with the RPHI_TRACE_* macros 
+	below.
+
+	The macros only expand to something when the library is built with the 
+	RAPAPHIDGET_USE_TRACING CMake option (which defines RPHI_TRACING). Otherwise 
+	they compile to nothing. When compiled in, a scope costs a single atomic load 
+	until start() is called.
+
+	Each thread writes its events into its own lock-free buffer, so tracing 
+	doesn't add any contention between the application thread and the acquisition 
+	thread. The buffers are drained into the file by flush(), which the 
+	application calls from time to time from a single thread (for example after 
+	each DeviceManager::update()). The events which don't fit in a full buffer are
+	dropped and counted.
+
+	The names of the events and of their argument must outlive the trace: use 
+	string literals.
+*/
+class Trace
+{
+public:
+	// Open the file and start recording. Each thread gets a buffer of 
+	// numEventsPerThread events, the first time it records one
+	static bool			start( const std::string& filename, std::size_t numEventsPerThread=65536 );
+	static void			flush();
+	static void			stop();
+	static bool			isStarted();
+
+	// Name the calling thread in the trace
+	static void			setThreadName( const char* name );
+
+	static uint64_t		getNumDroppedEvents();
+
+	struct Event
+	{
+		const char*		mName;
+		const char*		mArgName;			// Optional
+		int64_t			mArgValue;
+		long long		mStartTimeInNs;
+		long long		mDurationInNs;
+	};
+	static void			addEvent( const Event& event );
+};
+
+/*
+	TraceScope
+
+	Records an event from its construction to its destruction, if tracing is 
+	started. Use it through RPHI_TRACE_SCOPE() and RPHI_TRACE_SCOPE_ARG()
+*/
+class TraceScope
+{
+public:
+	explicit TraceScope( const char* name, const char* argName=NULL, int64_t argValue=0 );
+	~TraceScope();
+
+private:
+	TraceScope( const TraceScope& );
+	TraceScope& operator=( const TraceScope& );
+
+	const char*		mName;
+	const char*		mArgName;
+	int64_t			mArgValue;
+	long long		mStartTimeInNs;		// Negative if tracing wasn't started
+};
+
+}
+
+#if defined(RPHI_TRACING)
+	#define RPHI_TRACE_CONCAT_IMPL( a, b )						a##b
+	#define RPHI_TRACE_CONCAT( a, b )							RPHI_TRACE_CONCAT_IMPL( a, b )
+	#define RPHI_TRACE_SCOPE( name )							RPhi::TraceScope RPHI_TRACE_CONCAT( rphiTraceScope, __LINE__ )( name )
+	#define RPHI_TRACE_SCOPE_ARG( name, argName, argValue )	RPhi::TraceScope RPHI_TRACE_CONCAT( rphiTraceScope, __LINE__ )( name, argName, argValue )
+	#define RPHI_TRACE_THREAD_NAME( name )						RPhi::Trace::setThreadName( name )
+#else
+	#define RPHI_TRACE_SCOPE( name )
+	#define RPHI_TRACE_SCOPE_ARG( name, argName, argValue )
+	#define RPHI_TRACE_THREAD_NAME( name )
+#endif
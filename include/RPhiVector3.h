@@ -23,6 +23,8 @@
 */
 #pragma once
 
+#include <math.h>
+
 namespace RPhi
 {
 
@@ -30,7 +32,8 @@ namespace RPhi
 	Vector3
 
 	A templated class for representing a Vector3 value. 
-	The class provides data storage but no geometrical methods at all.
+	The class provides data storage and the magnitude of the vector, but no 
+	other geometrical methods.
 */
 template<typename T>
 struct Vector3
@@ -83,6 +86,11 @@ public:
 	
 	T& z()				{ return mZ; }
 	const T& z() const	{ return mZ; }
+
+	T getMagnitude() const
+	{
+		return static_cast<T>( sqrt( static_cast<double>( mX*mX + mY*mY + mZ*mZ ) ) );
+	}
 	
 private:
 	T mX;
@@ -0,0 +1,318 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiSimulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+	Benchmarks the DeviceManager against the simulated Phidget21 backend and
+	writes the results as JSON, to track regressions:
+	- update: DeviceManager::update() per device, for a growing number of devices
+	- updateDeviceList: the reconciliation of the device list alone
+	- notification: the cost of each listener notified when a device changes
+	- toString: Device::toString() per device
+	Each result gives the time, the heap allocations and the C API calls per
+	operation.
+
+	Usage: RapaPhidgetBench [durationPerCaseInMs] [callLatencyInUs] [outputFile]
+	The JSON goes to the standard output when no output file is given.
+*/
+
+// Count the heap allocations of the whole program
+static std::atomic<unsigned long long> gNumAllocations( 0 );
+
+void* operator new( std::size_t size )
+{
+	++gNumAllocations;
+	void* pointer = malloc( size ? size : 1 );
+	if ( !pointer )
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void operator delete( void* pointer ) noexcept
+{
+	free( pointer );
+}
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+	volatile std::size_t gNumCharacters = 0;
+
+	// Gives access to the reconciliation of the device list
+	class BenchDeviceManager : public RPhi::LocalDeviceManager
+	{
+	public:
+		using RPhi::LocalDeviceManager::updateDeviceList;
+	};
+
+	class CountingListener : public RPhi::Device::Listener
+	{
+	public:
+		CountingListener() : mNumChanged(0) {}
+		virtual void onDeviceChanged( RPhi::Device* /*device*/ ) { mNumChanged++; }
+		unsigned long long mNumChanged;
+	};
+
+	struct Result
+	{
+		std::string			mName;
+		int					mNumDevices;
+		int					mNumListeners;
+		unsigned long long	mNumOperations;
+		double				mNsPerOperation;
+		double				mAllocationsPerOperation;
+		double				mCallsPerOperation;
+	};
+
+	// Measures the time, heap allocations and C API calls from its creation to getResult()
+	class Measurement
+	{
+	public:
+		Measurement()
+			: mStartTime( Clock::now() ),
+			  mNumAllocations( gNumAllocations ),
+			  mNumCalls( RPhi::Simulator::getNumCalls() )
+		{
+		}
+
+		Result getResult( const char* name, int numDevices, int numListeners, unsigned long long numOperations ) const
+		{
+			double durationInNs = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-mStartTime).count() );
+			double numOps = numOperations>0 ? static_cast<double>(numOperations) : 1.0;
+			Result result;
+			result.mName = name;
+			result.mNumDevices = numDevices;
+			result.mNumListeners = numListeners;
+			result.mNumOperations = numOperations;
+			result.mNsPerOperation = durationInNs / numOps;
+			result.mAllocationsPerOperation = static_cast<double>(gNumAllocations - mNumAllocations) / numOps;
+			result.mCallsPerOperation = static_cast<double>(RPhi::Simulator::getNumCalls() - mNumCalls) / numOps;
+			return result;
+		}
+
+	private:
+		Clock::time_point	mStartTime;
+		unsigned long long	mNumAllocations;
+		unsigned long long	mNumCalls;
+	};
+
+	bool isRunning( Clock::time_point startTime, int durationInMs )
+	{
+		return Clock::now() - startTime < std::chrono::milliseconds( durationInMs );
+	}
+
+	void configure( int numSpatials, int numTemperatureSensors, int callLatencyInUs )
+	{
+		RPhi::Simulator::Configuration configuration;
+		configuration.mNumSpatials = numSpatials;
+		configuration.mNumTemperatureSensors = numTemperatureSensors;
+		configuration.mCallLatencyInUs = callLatencyInUs;
+		RPhi::Simulator::configure( configuration );
+	}
+
+	// DeviceManager::update() with half Spatials and half TemperatureSensors, per device
+	Result benchUpdate( int numDevices, int callLatencyInUs, int durationInMs )
+	{
+		configure( numDevices - numDevices/2, numDevices/2, callLatencyInUs );
+		BenchDeviceManager deviceManager;
+		deviceManager.update();
+
+		unsigned long long numUpdates = 0;
+		Measurement measurement;
+		Clock::time_point startTime = Clock::now();
+		while ( isRunning( startTime, durationInMs ) )
+		{
+			deviceManager.update();
+			numUpdates++;
+		}
+		return measurement.getResult( "update", numDevices, 0, numUpdates * numDevices );
+	}
+
+	// DeviceManager::updateDeviceList() when nothing changes, per call
+	Result benchUpdateDeviceList( int numDevices, int callLatencyInUs, int durationInMs )
+	{
+		configure( numDevices - numDevices/2, numDevices/2, callLatencyInUs );
+		BenchDeviceManager deviceManager;
+		deviceManager.updateDeviceList();
+
+		unsigned long long numCalls = 0;
+		Measurement measurement;
+		Clock::time_point startTime = Clock::now();
+		while ( isRunning( startTime, durationInMs ) )
+		{
+			deviceManager.updateDeviceList();
+			numCalls++;
+		}
+		return measurement.getResult( "updateDeviceList", numDevices, 0, numCalls );
+	}
+
+	// Brackets the listeners of a device to time their notification
+	class TimingListener : public RPhi::Device::Listener
+	{
+	public:
+		TimingListener( bool first, Clock::time_point& startTime, Clock::duration& duration ) 
+			: mFirst(first), mStartTime(startTime), mDuration(duration) 
+		{
+		}
+
+		virtual void onDeviceChanged( RPhi::Device* /*device*/ )
+		{
+			if ( mFirst )
+				mStartTime = Clock::now();
+			else
+				mDuration += Clock::now() - mStartTime;
+		}
+
+	private:
+		bool				mFirst;
+		Clock::time_point&	mStartTime;
+		Clock::duration&	mDuration;
+	};
+
+	// The notification of numListeners listeners of a Spatial, per listener notified
+	Result benchNotification( int numListeners, int callLatencyInUs, int durationInMs )
+	{
+		RPhi::Simulator::Configuration configuration;
+		configuration.mNumSpatials = 1;
+		configuration.mNumTemperatureSensors = 0;
+		configuration.mCallLatencyInUs = callLatencyInUs;
+		configuration.mDataRateInMs = 1;		// The measures change once per data rate period
+		RPhi::Simulator::configure( configuration );
+		BenchDeviceManager deviceManager;
+		deviceManager.update();
+		RPhi::Device* device = deviceManager.getDevices()[0];
+
+		Clock::time_point startTime;
+		Clock::duration notificationDuration = Clock::duration::zero();
+		TimingListener firstListener( true, startTime, notificationDuration );
+		TimingListener lastListener( false, startTime, notificationDuration );
+		std::vector<CountingListener> listeners( numListeners );
+		device->addListener( &firstListener );
+		for ( int i=0; i<numListeners; ++i )
+			device->addListener( &listeners[i] );
+		device->addListener( &lastListener );
+
+		Measurement measurement;
+		Clock::time_point benchStartTime = Clock::now();
+		while ( isRunning( benchStartTime, durationInMs ) )
+			deviceManager.update();
+
+		unsigned long long numNotifications = 0;
+		for ( int i=0; i<numListeners; ++i )
+			numNotifications += listeners[i].mNumChanged;
+		Result result = measurement.getResult( "notification", 1, numListeners, numNotifications );
+		double durationInNs = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(notificationDuration).count() );
+		result.mNsPerOperation = numNotifications>0 ? durationInNs / numNotifications : 0.0;
+		result.mCallsPerOperation = 0.0;		// Includes the update of the device, which isn't what's measured here
+		return result;
+	}
+
+	// Device::toString(), per device
+	Result benchToString( int numDevices, int durationInMs )
+	{
+		configure( numDevices - numDevices/2, numDevices/2, 0 );
+		BenchDeviceManager deviceManager;
+		deviceManager.update();
+		const RPhi::DeviceManager::Devices& devices = deviceManager.getDevices();
+
+		unsigned long long numCalls = 0;
+		std::size_t numCharacters = 0;
+		Measurement measurement;
+		Clock::time_point startTime = Clock::now();
+		while ( isRunning( startTime, durationInMs ) )
+		{
+			for ( std::size_t i=0; i<devices.size(); ++i )
+				numCharacters += devices[i]->toString().size();
+			numCalls += devices.size();
+		}
+		gNumCharacters = numCharacters;		// Keep the strings from being optimized away
+		return measurement.getResult( "toString", numDevices, 0, numCalls );
+	}
+
+	void writeJson( FILE* file, int durationPerCaseInMs, int callLatencyInUs, const std::vector<Result>& results )
+	{
+		fprintf( file, "{\n" );
+		fprintf( file, "  \"benchmark\": \"RapaPhidgetBench\",\n" );
+		fprintf( file, "  \"durationPerCaseInMs\": %d,\n", durationPerCaseInMs );
+		fprintf( file, "  \"callLatencyInUs\": %d,\n", callLatencyInUs );
+		fprintf( file, "  \"results\": [\n" );
+		for ( std::size_t i=0; i<results.size(); ++i )
+		{
+			const Result& result = results[i];
+			fprintf( file, "    { \"name\": \"%s\", \"numDevices\": %d, \"numListeners\": %d, \"numOperations\": %llu, "
+						   "\"nsPerOperation\": %.1f, \"allocationsPerOperation\": %.3f, \"callsPerOperation\": %.3f }%s\n",
+				result.mName.c_str(), result.mNumDevices, result.mNumListeners, result.mNumOperations,
+				result.mNsPerOperation, result.mAllocationsPerOperation, result.mCallsPerOperation,
+				i+1<results.size() ? "," : "" );
+		}
+		fprintf( file, "  ]\n" );
+		fprintf( file, "}\n" );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int durationPerCaseInMs = argc>1 ? atoi(argv[1]) : 500;
+	int callLatencyInUs = argc>2 ? atoi(argv[2]) : 0;
+	const char* outputFileName = argc>3 ? argv[3] : NULL;
+
+	std::vector<Result> results;
+	const int numDevicesCases[] = { 1, 10, 100, 1000 };
+	for ( int i=0; i<4; ++i )
+		results.push_back( benchUpdate( numDevicesCases[i], callLatencyInUs, durationPerCaseInMs ) );
+	for ( int i=0; i<4; ++i )
+		results.push_back( benchUpdateDeviceList( numDevicesCases[i], callLatencyInUs, durationPerCaseInMs ) );
+
+	const int numListenersCases[] = { 1, 10, 100 };
+	for ( int i=0; i<3; ++i )
+		results.push_back( benchNotification( numListenersCases[i], callLatencyInUs, durationPerCaseInMs ) );
+
+	results.push_back( benchToString( 10, durationPerCaseInMs ) );
+
+	FILE* file = stdout;
+	if ( outputFileName )
+	{
+		file = fopen( outputFileName, "w" );
+		if ( !file )
+		{
+			fprintf( stderr, "Can't open %s\n", outputFileName );
+			return 1;
+		}
+	}
+	writeJson( file, durationPerCaseInMs, callLatencyInUs, results );
+	if ( file!=stdout )
+		fclose( file );
+	return 0;
+}
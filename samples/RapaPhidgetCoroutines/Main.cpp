@@ -0,0 +1,129 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiCoroutines.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// A fire-and-forget coroutine: it starts right away and its frame is freed when it returns
+struct Task
+{
+	struct promise_type
+	{
+		Task					get_return_object()			{ return Task(); }
+		std::suspend_never		initial_suspend() noexcept	{ return std::suspend_never(); }
+		std::suspend_never		final_suspend() noexcept	{ return std::suspend_never(); }
+		void					return_void()				{}
+		void					unhandled_exception()		{ std::terminate(); }
+	};
+};
+
+static const std::size_t kBlockSize = 32;
+static unsigned long long gNumTasks = 0;
+static unsigned long long gNumChanges = 0;
+static unsigned long long gNumBlocks = 0;
+
+// Average the acceleration of a Spatial over blocks of measures
+Task watchSpatial( RPhi::DeviceManager& deviceManager, RPhi::Spatial& spatial, RPhi::Executor& executor )
+{
+	gNumTasks++;
+	int serialNumber = spatial.getSerialNumber();
+	RPhi::AsyncSpatial asyncSpatial( deviceManager, spatial, executor );
+	RPhi::Spatial::Measure block[kBlockSize];
+	while ( co_await asyncSpatial.nextMeasures( block, kBlockSize )==kBlockSize )
+	{
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for ( std::size_t i=0; i<kBlockSize; ++i )
+		{
+			RPhi::Vector3d acceleration = block[i].getAccelerationInGs();
+			sum[0] += acceleration.x();
+			sum[1] += acceleration.y();
+			sum[2] += acceleration.z();
+		}
+		if ( gNumBlocks++ % 1000==0 )
+			printf("%d average acceleration: %.3f %.3f %.3f\n", serialNumber, sum[0] / kBlockSize, sum[1] / kBlockSize, sum[2] / kBlockSize );
+	}
+	gNumTasks--;
+}
+
+// Count the changes of any device
+Task watchDevice( RPhi::DeviceManager& deviceManager, RPhi::Device& device, RPhi::Executor& executor )
+{
+	gNumTasks++;
+	RPhi::AsyncDevice asyncDevice( deviceManager, device, executor );
+	while ( co_await asyncDevice.nextChange() )
+		gNumChanges++;
+	gNumTasks--;
+}
+
+// Start watching each device as it gets connected
+Task watchDeviceManager( RPhi::AsyncDeviceManager& asyncDeviceManager )
+{
+	RPhi::DeviceManager& deviceManager = asyncDeviceManager.getDeviceManager();
+	RPhi::Executor& executor = asyncDeviceManager.getExecutor();
+	while ( RPhi::Device* device = co_await asyncDeviceManager.nextDeviceConnected() )
+	{
+		const RPhi::DeviceManager::Devices& devices = deviceManager.getDevices();
+		if ( std::find( devices.begin(), devices.end(), device )==devices.end() )
+			continue;
+		printf("%s connected (%d)\n", device->getName().c_str(), device->getSerialNumber() );
+		watchDevice( deviceManager, *device, executor );
+		if ( RPhi::Spatial* spatial = RPhi::deviceCast<RPhi::Spatial>( device ) )
+			watchSpatial( deviceManager, *spatial, executor );
+	}
+}
+
+// Usage: RapaPhidgetCoroutines [durationInS]
+// All the coroutines run on the main thread, resumed by a ManualExecutor after each update
+int main( int argc, char** argv )
+{
+	double durationInS = argc>1 ? atof(argv[1]) : 10.0;
+
+	RPhi::ManualExecutor executor;
+	{
+		RPhi::LocalDeviceManager deviceManager;
+		RPhi::AsyncDeviceManager asyncDeviceManager( deviceManager, executor );
+		watchDeviceManager( asyncDeviceManager );
+
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point endTime = Clock::now() + std::chrono::microseconds( static_cast<long long>(durationInS * 1000000.0) );
+		while ( Clock::now()<endTime )
+		{
+			deviceManager.update();
+			executor.run();
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+		printf("tasks: %llu, device changes: %llu, blocks: %llu\n", gNumTasks, gNumChanges, gNumBlocks );
+	}
+
+	// The destruction of the managers closed the awaited events. Let the coroutines return
+	executor.run();
+	printf("tasks left: %llu\n", gNumTasks );
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiFlightRecorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+/*
+	Keeps the last minutes of the local devices in a flight recording, or reads 
+	them back after a crash into a recording that the ReplayDeviceManager can play.
+
+	Usage: 
+		RapaPhidgetFlightRecorder record [file] [durationInS] [numEntries]
+		RapaPhidgetFlightRecorder recover [file] [recording] [lastMinutes]
+	The whole file is recovered when lastMinutes is 0.
+*/
+namespace
+{
+	int record( const char* filename, int durationInS, std::size_t numEntries )
+	{
+		RPhi::LocalDeviceManager deviceManager;
+		RPhi::FlightRecorder flightRecorder( &deviceManager, filename, numEntries );
+		if ( !flightRecorder.isOpen() )
+		{
+			printf("Failed to open %s\n", filename );
+			return 1;
+		}
+		printf("Recording to %s, from record %llu\n", filename, static_cast<unsigned long long>( flightRecorder.getLastSequence()+1 ) );
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now() + std::chrono::seconds(durationInS);
+		while ( std::chrono::steady_clock::now()<endTime )
+		{
+			deviceManager.update();
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+		printf("Last record: %llu\n", static_cast<unsigned long long>( flightRecorder.getLastSequence() ) );
+		return 0;
+	}
+
+	int recover( const char* filename, const char* recordingFilename, double lastMinutes )
+	{
+		RPhi::FlightRecorder::Recovery recovery;
+		int64_t durationInUs = static_cast<int64_t>( lastMinutes * 60.0 * 1000000.0 );
+		if ( !RPhi::FlightRecorder::recover( filename, durationInUs, recovery ) )
+		{
+			printf("%s isn't a flight recording\n", filename );
+			return 1;
+		}
+		printf("Records %llu to %llu, %llu lost\n", 
+			static_cast<unsigned long long>( recovery.mFirstSequence ), 
+			static_cast<unsigned long long>( recovery.mLastSequence ),
+			static_cast<unsigned long long>( recovery.mNumLostRecords ) );
+		if ( !recovery.mRecords.empty() )
+		{
+			double spanInS = static_cast<double>( recovery.mRecords.back().mTimeInUs - recovery.mRecords.front().mTimeInUs ) / 1000000.0;
+			printf("Recovered %llu records over %.1fs, %llu measures of undescribed devices dropped\n", 
+				static_cast<unsigned long long>( recovery.mRecords.size() ), spanInS,
+				static_cast<unsigned long long>( recovery.mNumDroppedRecords ) );
+		}
+		if ( !recovery.write( recordingFilename ) )
+		{
+			printf("Failed to write %s\n", recordingFilename );
+			return 1;
+		}
+		printf("Written to %s\n", recordingFilename );
+		return 0;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	bool isRecovery = argc>1 && strcmp( argv[1], "recover" )==0;
+	const char* filename = argc>2 ? argv[2] : "RapaPhidget.flight";
+	if ( isRecovery )
+	{
+		const char* recordingFilename = argc>3 ? argv[3] : "RapaPhidget.rec";
+		double lastMinutes = argc>4 ? atof( argv[4] ) : 5.0;
+		return recover( filename, recordingFilename, lastMinutes );
+	}
+	int durationInS = argc>3 ? atoi( argv[3] ) : 60;
+	std::size_t numEntries = argc>4 ? static_cast<std::size_t>( atol( argv[4] ) ) : RPhi::FlightRecorder::kDefaultNumEntries;
+	return record( filename, durationInS, numEntries );
+}
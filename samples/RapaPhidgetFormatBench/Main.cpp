@@ -0,0 +1,137 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiMeasureWriter.h"
+#include "RPhiClock.h"
+#include "RPhiSimulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+
+/*
+	Compares the cost of formatting the devices with toString() and with the 
+	MeasureWriter in its different formats, in time and in heap allocations.
+
+	Usage: RapaPhidgetFormatBench [numIterations] [numSpatials] [numTemperatureSensors]
+*/
+
+// Count the heap allocations of the whole program
+static std::atomic<unsigned long long> gNumAllocations( 0 );
+
+void* operator new( std::size_t size )
+{
+	++gNumAllocations;
+	void* pointer = malloc( size ? size : 1 );
+	if ( !pointer )
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void operator delete( void* pointer ) noexcept
+{
+	free( pointer );
+}
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	void printResult( const char* name, Clock::duration duration, unsigned long long numAllocations, unsigned long long numCalls, unsigned long long numBytes )
+	{
+		double durationInNs = static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() );
+		printf("%-26s %10.1f ns/call %8.2f allocations/call %8.1f bytes/call\n", name, durationInNs / numCalls, 
+			static_cast<double>(numAllocations) / numCalls, static_cast<double>(numBytes) / numCalls );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int numIterations = argc>1 ? atoi(argv[1]) : 20000;
+	RPhi::Simulator::Configuration configuration;
+	configuration.mNumSpatials = argc>2 ? atoi(argv[2]) : 4;
+	configuration.mNumTemperatureSensors = argc>3 ? atoi(argv[3]) : 4;
+	RPhi::Simulator::configure( configuration );
+
+	RPhi::LocalDeviceManager deviceManager;
+	deviceManager.update();
+	const RPhi::DeviceManager::Devices& devices = deviceManager.getDevices();
+	if ( devices.empty() )
+	{
+		printf("No devices\n");
+		return 1;
+	}
+	unsigned long long numCalls = static_cast<unsigned long long>(numIterations) * devices.size();
+	printf("Formatting %d devices %d times\n", static_cast<int>(devices.size()), numIterations );
+
+	// toString()
+	{
+		unsigned long long numBytes = 0;
+		unsigned long long numAllocations = gNumAllocations;
+		Clock::time_point startTime = Clock::now();
+		for ( int i=0; i<numIterations; ++i )
+		{
+			for ( std::size_t j=0; j<devices.size(); ++j )
+				numBytes += devices[j]->toString().size();
+		}
+		printResult( "toString()", Clock::now()-startTime, gNumAllocations-numAllocations, numCalls, numBytes );
+	}
+
+	// MeasureWriter
+	const RPhi::MeasureWriter::Format formats[] = { RPhi::MeasureWriter::kText, RPhi::MeasureWriter::kJsonLines, RPhi::MeasureWriter::kCsv, RPhi::MeasureWriter::kBinary };
+	const char* formatNames[] = { "MeasureWriter text", "MeasureWriter json", "MeasureWriter csv", "MeasureWriter binary" };
+	char buffer[8192];
+	for ( int k=0; k<4; ++k )
+	{
+		for ( int p=0; p<2; ++p )
+		{
+			int precision = p==0 ? RPhi::MeasureWriter::kDefaultPrecision : RPhi::MeasureWriter::kFullPrecision;
+			if ( formats[k]==RPhi::MeasureWriter::kBinary && p==1 )
+				continue;
+			RPhi::MeasureWriter writer( formats[k], precision );
+			
+			// Warm the working buffer up
+			for ( std::size_t j=0; j<devices.size(); ++j )
+				writer.writeMeasures( devices[j], 0, buffer, sizeof(buffer) );
+
+			unsigned long long numBytes = 0;
+			unsigned long long numAllocations = gNumAllocations;
+			Clock::time_point startTime = Clock::now();
+			for ( int i=0; i<numIterations; ++i )
+			{
+				long long timeInUs = RPhi::Clock::getTimeInUs();
+				for ( std::size_t j=0; j<devices.size(); ++j )
+					numBytes += writer.writeMeasures( devices[j], timeInUs, buffer, sizeof(buffer) );
+			}
+			char name[64];
+			snprintf( name, sizeof(name), "%s%s", formatNames[k], p==1 ? " (full)" : "" );
+			printResult( name, Clock::now()-startTime, gNumAllocations-numAllocations, numCalls, numBytes );
+		}
+	}
+	return 0;
+}
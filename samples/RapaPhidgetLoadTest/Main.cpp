@@ -0,0 +1,132 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiRemoteDeviceManager.h"
+#include "RPhiDevice.h"
+#include "RPhiSimulator.h"
+#include "RPhiTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+// Count the events received from the DeviceManager and its devices
+class CountingListener : public RPhi::DeviceManager::Listener, public RPhi::Device::Listener
+{
+public:
+	CountingListener()
+		: mNumConnected(0), mNumDisconnecting(0), mNumChanged(0)
+	{
+	}
+
+	virtual void onDeviceConnected( RPhi::DeviceManager* /*deviceManager*/, RPhi::Device* device )
+	{
+		mNumConnected++;
+		device->addListener( this );
+	}
+
+	virtual void onDeviceDisconnecting( RPhi::DeviceManager* /*deviceManager*/, RPhi::Device* device )
+	{
+		mNumDisconnecting++;
+		device->removeListener( this );
+	}
+
+	virtual void onDeviceChanged( RPhi::Device* /*device*/ )
+	{
+		mNumChanged++;
+	}
+
+	unsigned long long mNumConnected;
+	unsigned long long mNumDisconnecting;
+	unsigned long long mNumChanged;
+};
+
+// Usage: RapaPhidgetLoadTest [numSpatials] [numTemperatureSensors] [durationInS] [callLatencyInUs] [remoteCallLatencyInUs] [meanAttachedTimeInS] [acquisitionIntervalInUs] [traceFilename]
+// A positive acquisitionIntervalInUs polls the devices on a background acquisition thread.
+// The trace is only filled when the library is built with RAPAPHIDGET_USE_TRACING
+int main( int argc, char** argv )
+{
+	RPhi::Simulator::Configuration configuration;
+	configuration.mNumSpatials = argc>1 ? atoi(argv[1]) : 500;
+	configuration.mNumTemperatureSensors = argc>2 ? atoi(argv[2]) : 500;
+	double durationInS = argc>3 ? atof(argv[3]) : 5.0;
+	configuration.mCallLatencyInUs = argc>4 ? atoi(argv[4]) : 0;
+	configuration.mRemoteCallLatencyInUs = argc>5 ? atoi(argv[5]) : 0;
+	configuration.mMeanAttachedTimeInS = argc>6 ? atof(argv[6]) : 0.0;
+	configuration.mMeanDetachedTimeInS = configuration.mMeanAttachedTimeInS / 10.0;
+	configuration.mDropoutProbability = 0.01;
+	int acquisitionIntervalInUs = argc>7 ? atoi(argv[7]) : 0;
+	const char* traceFilename = argc>8 ? argv[8] : NULL;
+	RPhi::Simulator::configure( configuration );
+	if ( traceFilename && !RPhi::Trace::start( traceFilename ) )
+		printf("Can't open %s\n", traceFilename );
+
+	RPhi::DeviceManager* deviceManager = NULL;
+	if ( configuration.mRemoteCallLatencyInUs>0 )
+		deviceManager = new RPhi::RemoteDeviceManager( "127.0.0.1", 5001, "" );
+	else
+		deviceManager = new RPhi::LocalDeviceManager();
+	CountingListener listener;
+	deviceManager->addListener( &listener );
+	if ( acquisitionIntervalInUs>0 )
+		deviceManager->startAcquisition( acquisitionIntervalInUs );
+
+	printf("Simulating %d Spatials and %d TemperatureSensors (%d thermocouples) for %.1fs\n", 
+		configuration.mNumSpatials, configuration.mNumTemperatureSensors, 
+		configuration.mNumTemperatureSensors * configuration.mNumThermocouplesPerSensor, durationInS );
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point startTime = Clock::now();
+	Clock::time_point endTime = startTime + std::chrono::microseconds( static_cast<long long>(durationInS * 1000000.0) );
+	unsigned long long numUpdates = 0;
+	double maxUpdateTimeInS = 0.0;
+	Clock::time_point time = startTime;
+	while ( time<endTime )
+	{
+		deviceManager->update();
+		RPhi::Trace::flush();
+		numUpdates++;
+		Clock::time_point now = Clock::now();
+		double updateTimeInS = std::chrono::duration<double>( now - time ).count();
+		if ( updateTimeInS>maxUpdateTimeInS )
+			maxUpdateTimeInS = updateTimeInS;
+		time = now;
+	}
+	double elapsedInS = std::chrono::duration<double>( time - startTime ).count();
+	deviceManager->stopAcquisition();
+	RPhi::Trace::stop();
+	unsigned long long numCalls = RPhi::Simulator::getNumCalls();
+
+	printf("updates: %llu (%.1f/s)\n", numUpdates, numUpdates / elapsedInS );
+	printf("mean update time: %.3f ms, max: %.3f ms\n", elapsedInS * 1000.0 / numUpdates, maxUpdateTimeInS * 1000.0 );
+	printf("device changes: %llu (%.1f/s)\n", listener.mNumChanged, listener.mNumChanged / elapsedInS );
+	printf("connections: %llu, disconnections: %llu\n", listener.mNumConnected, listener.mNumDisconnecting );
+	printf("dropped acquisition records: %llu\n", static_cast<unsigned long long>(deviceManager->getNumDroppedAcquisitionRecords()) );
+	printf("C API calls: %llu (%.1f per update)\n", numCalls, static_cast<double>(numCalls) / numUpdates );
+	if ( traceFilename )
+		printf("dropped trace events: %llu\n", static_cast<unsigned long long>(RPhi::Trace::getNumDroppedEvents()) );
+
+	delete deviceManager;
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiSharedMemoryPublisher.h"
+#include "RPhiSharedMemoryReader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+/*
+	Shares the local devices with other processes, or monitors them from another process.
+
+	Usage: 
+		RapaPhidgetSharedMemoryMonitor publish [name] [durationInS]
+		RapaPhidgetSharedMemoryMonitor [name] [durationInS]
+*/
+namespace
+{
+	void printRecord( const RPhi::Record& record )
+	{
+		switch ( record.mKind )
+		{
+			case RPhi::Record::kSpatialMeasure:
+			{
+				const RPhi::Record::SpatialMeasure& measure = record.mSpatialMeasure;
+				printf("  acc=(%.3f %.3f %.3f) ang=(%.3f %.3f %.3f) mag=(%.3f %.3f %.3f)\n", 
+					measure.mAccelerationInGs[0], measure.mAccelerationInGs[1], measure.mAccelerationInGs[2],
+					measure.mAngularRateInDegPerSec[0], measure.mAngularRateInDegPerSec[1], measure.mAngularRateInDegPerSec[2],
+					measure.mMagneticFieldInGauss[0], measure.mMagneticFieldInGauss[1], measure.mMagneticFieldInGauss[2] );
+			}
+			break;
+			case RPhi::Record::kThermocoupleMeasure:
+				printf("  thermocouple %d: %.2fC\n", record.mChannel, record.mThermocoupleMeasure.mTemperatureInC );
+				break;
+			case RPhi::Record::kAmbientTemperature:
+				printf("  ambient: %.2fC\n", record.mAmbientTemperatureInC );
+				break;
+		}
+	}
+
+	int publish( const char* name, int durationInS )
+	{
+		RPhi::LocalDeviceManager deviceManager;
+		RPhi::SharedMemoryPublisher publisher( &deviceManager, name );
+		if ( !publisher.isOpen() )
+		{
+			printf("Failed to create shared memory segment '%s'\n", name );
+			return 1;
+		}
+		printf("Publishing to '%s'\n", name );
+		std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now() + std::chrono::seconds(durationInS);
+		while ( std::chrono::steady_clock::now()<endTime )
+		{
+			deviceManager.update();
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+		return 0;
+	}
+
+	int monitor( const char* name, int durationInS )
+	{
+		RPhi::SharedMemoryReader reader( name );
+		if ( !reader.isOpen() )
+		{
+			printf("No publisher found for '%s'\n", name );
+			return 1;
+		}
+
+		for ( int i=0; i<durationInS && reader.isPublishing(); ++i )
+		{
+			for ( int slotIndex=0; slotIndex<reader.getNumSlots(); ++slotIndex )
+			{
+				int serialNumber = 0;
+				bool attached = false;
+				RPhi::Record attachedRecord;
+				if ( !reader.readDevice( slotIndex, serialNumber, attached, attachedRecord ) )
+					continue;
+				printf("Device %d %s (%llu records)\n", serialNumber, attached ? "attached" : "detached", 
+					static_cast<unsigned long long>( reader.getNumRingRecords(slotIndex) ) );
+				for ( int j=0; j<RPhi::SharedMemorySlot::kNumLatestRecords; ++j )
+				{
+					RPhi::Record record;
+					if ( reader.readLatestRecord( slotIndex, j, record ) )
+						printRecord( record );
+				}
+			}
+			std::this_thread::sleep_for( std::chrono::seconds(1) );
+		}
+		return 0;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int argIndex = 1;
+	bool isPublisher = argc>argIndex && strcmp( argv[argIndex], "publish" )==0;
+	if ( isPublisher )
+		++argIndex;
+	const char* name = argc>argIndex ? argv[argIndex] : "RapaPhidget";
+	++argIndex;
+	int durationInS = argc>argIndex ? atoi( argv[argIndex] ) : 60;
+
+	if ( isPublisher )
+		return publish( name, durationInS );
+	return monitor( name, durationInS );
+}
@@ -23,8 +23,10 @@
 */
 #include "RPhiLocalDeviceManager.h"
 #include "RPhiRemoteDeviceManager.h"
+#include "RPhiReplayDeviceManager.h"
 #include "RPhiSpatial.h"
 #include "RPhiTemperatureSensor.h"
+#include "RPhiDeviceTypes.h"
 
 #include <map> 
 #include <assert.h> 
@@ -53,40 +55,34 @@ private:
 };
 
 int i = 0;
-class DebugDeviceListener : public RPhi::Device::Listener
+class DebugSpatialListener : public RPhi::TypedDeviceListener<RPhi::Spatial>
 {
 public:
-	void onDeviceChanged( RPhi::Device* device ) 
+	void onChanged( RPhi::Spatial* spatial ) 
 	{
-		switch ( device->getType() )
+		printf("%s\n", spatial->toString().c_str() );
+
+		i++;
+		if ( i==20 )
+		{
+			if ( !spatial->setDataRateInMs( 400 ) )
+				printf("\n\nFAILED TO SET RATE\n\n");
+		}	
+	}
+};
+
+class DebugTemperatureSensorListener : public RPhi::TypedDeviceListener<RPhi::TemperatureSensor>
+{
+public:
+	void onChanged( RPhi::TemperatureSensor* temperatureSensor ) 
+	{
+		printf("%s\n", temperatureSensor->toString().c_str() );
+
+		i++;
+		if ( i==20 )
 		{
-			case RPhi::Device::kSpatial:
-			{
-				RPhi::Spatial* spatial = static_cast<RPhi::Spatial*>(device);
-				printf("%s\n", spatial->toString().c_str() );
-
-				i++;
-				if ( i==20 )
-				{
-					if ( !spatial->setDataRateInMs( 400 ) )
-						printf("\n\nFAILED TO SET RATE\n\n");
-				}	
-			}
-			break;
-
-			case RPhi::Device::kTemperatureSensor:
-			{
-				RPhi::TemperatureSensor* temperatureSensor = static_cast<RPhi::TemperatureSensor*>(device);
-				printf("%s\n", temperatureSensor->toString().c_str() );
-
-				i++;
-				if ( i==20 )
-				{
-					temperatureSensor->getThermocouples()[0]->setType( RPhi::TemperatureSensor::Thermocouple::E_Type );
-				}	
-			}
-			break;
-		}
+			temperatureSensor->getThermocouples()[0]->setType( RPhi::TemperatureSensor::Thermocouple::E_Type );
+		}	
 	}
 };
 
@@ -98,7 +94,11 @@ public:
 		printf("Device %d %d - Connected\n", device->getSerialNumber(), device->isAttached() );
 		
 		// Create a listener for the Device, register it and remember it
-		RPhi::Device::Listener* listener = new DebugDeviceListener();
+		RPhi::Device::Listener* listener = NULL;
+		if ( RPhi::deviceCast<RPhi::Spatial>( device ) )
+			listener = new DebugSpatialListener();
+		else
+			listener = new DebugTemperatureSensorListener();
 		mListeners.insert( std::make_pair( device, listener ) );
 		device->addListener( listener );
 	}
@@ -120,11 +120,17 @@ private:
 	std::map<RPhi::Device*, RPhi::Device::Listener*> mListeners;	
 };
 
-int main( int /*argc*/, char** /*argv*/ )
+int main( int argc, char** argv )
 {
-	RPhi::LocalDeviceManager deviceManager;
-	//RPhi::RemoteDeviceManager deviceManager( "BOB-PC", "" );
-	//RPhi::RemoteDeviceManager deviceManager( "192.168.1.56", 5001, "" );
+	// Play back the recording given as argument, if any. Otherwise use the local devices
+	RPhi::DeviceManager* deviceManagerPtr = NULL;
+	if ( argc>1 )
+		deviceManagerPtr = new RPhi::ReplayDeviceManager( argv[1] );
+	else
+		deviceManagerPtr = new RPhi::LocalDeviceManager();
+	//deviceManagerPtr = new RPhi::RemoteDeviceManager( "BOB-PC", "" );
+	//deviceManagerPtr = new RPhi::RemoteDeviceManager( "192.168.1.56", 5001, "" );
+	RPhi::DeviceManager& deviceManager = *deviceManagerPtr;
 	
 //	printf("version: %s\n", deviceManager.getLibraryVersion() );(
 
@@ -141,6 +147,7 @@ int main( int /*argc*/, char** /*argv*/ )
 		fflush( stdout );
 	}
 
+	delete deviceManagerPtr;
 	return 0;
 }
 
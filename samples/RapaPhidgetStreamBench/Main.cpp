@@ -0,0 +1,157 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiLocalDeviceManager.h"
+#include "RPhiStreamServer.h"
+#include "RPhiStreamClient.h"
+#include "RPhiClock.h"
+#include "RPhiSimulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/*
+	Streams simulated devices to several clients over the loopback interface and 
+	reports the throughput and latency seen by each client. The latency is the 
+	time between the measure being read by the server and the client receiving it.
+
+	Usage: RapaPhidgetStreamBench [numClients] [numSpatials] [numTemperatureSensors] [durationInS] [slowClientDelayInMs]
+	
+	When slowClientDelayInMs is given, the last client sleeps that long between 
+	two receptions, to show that it doesn't slow the others down.
+*/
+namespace
+{
+	struct ClientResult
+	{
+		ClientResult()
+			: mNumFrames(0), mNumRecords(0), mNumMeasures(0), mNumDropped(0), mLatenciesInUs()
+		{
+		}
+
+		unsigned long long	mNumFrames;
+		unsigned long long	mNumRecords;
+		unsigned long long	mNumMeasures;
+		unsigned long long	mNumDropped;
+		std::vector<long long> mLatenciesInUs;
+	};
+
+	void runClient( int port, int delayInMs, const std::atomic<bool>* stopRequested, ClientResult* result )
+	{
+		RPhi::StreamClient client;
+		if ( !client.connect( "127.0.0.1", port ) )
+			return;
+		result->mLatenciesInUs.reserve( 1000000 );
+		std::vector<RPhi::Record> records;
+		records.reserve( 4096 );
+		while ( !*stopRequested && client.receive( records, 10 ) )
+		{
+			long long timeInUs = RPhi::Clock::getTimeInUs();
+			for ( std::size_t i=0; i<records.size(); ++i )
+			{
+				const RPhi::Record& record = records[i];
+				if ( record.mKind==RPhi::Record::kSpatialMeasure || record.mKind==RPhi::Record::kThermocoupleMeasure || record.mKind==RPhi::Record::kAmbientTemperature )
+				{
+					result->mNumMeasures++;
+					if ( result->mLatenciesInUs.size()<result->mLatenciesInUs.capacity() )
+						result->mLatenciesInUs.push_back( timeInUs - record.mTimeInUs );
+				}
+			}
+			result->mNumRecords += records.size();
+			records.clear();
+			if ( delayInMs>0 )
+				std::this_thread::sleep_for( std::chrono::milliseconds(delayInMs) );
+		}
+		result->mNumFrames = client.getNumFramesReceived();
+		result->mNumDropped = client.getNumRecordsDropped();
+	}
+
+	long long getPercentile( std::vector<long long>& values, double percentile )
+	{
+		if ( values.empty() )
+			return 0;
+		std::size_t index = static_cast<std::size_t>( percentile * (values.size()-1) );
+		std::nth_element( values.begin(), values.begin()+index, values.end() );
+		return values[index];
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int numClients = argc>1 ? atoi(argv[1]) : 8;
+	RPhi::Simulator::Configuration configuration;
+	configuration.mNumSpatials = argc>2 ? atoi(argv[2]) : 20;
+	configuration.mNumTemperatureSensors = argc>3 ? atoi(argv[3]) : 20;
+	double durationInS = argc>4 ? atof(argv[4]) : 5.0;
+	int slowClientDelayInMs = argc>5 ? atoi(argv[5]) : 0;
+	RPhi::Simulator::configure( configuration );
+
+	RPhi::LocalDeviceManager deviceManager;
+	RPhi::StreamServer server( &deviceManager, 0 );
+	if ( !server.isOpen() )
+	{
+		printf("Failed to start the server\n");
+		return 1;
+	}
+	printf("Streaming %d Spatials and %d TemperatureSensors to %d clients on port %d for %.1fs\n", 
+		configuration.mNumSpatials, configuration.mNumTemperatureSensors, numClients, server.getPort(), durationInS );
+
+	std::atomic<bool> stopRequested( false );
+	std::vector<ClientResult> results( numClients );
+	std::vector<std::thread> clients;
+	for ( int i=0; i<numClients; ++i )
+	{
+		int delayInMs = ( i==numClients-1 ) ? slowClientDelayInMs : 0;
+		clients.push_back( std::thread( runClient, server.getPort(), delayInMs, &stopRequested, &results[i] ) );
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point startTime = Clock::now();
+	Clock::time_point endTime = startTime + std::chrono::microseconds( static_cast<long long>(durationInS * 1000000.0) );
+	while ( Clock::now()<endTime )
+	{
+		deviceManager.update();
+		std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+	}
+	stopRequested = true;
+	for ( std::size_t i=0; i<clients.size(); ++i )
+		clients[i].join();
+	double elapsedInS = std::chrono::duration<double>( Clock::now() - startTime ).count();
+
+	printf("server: %llu frames sent (%.1f/s), %llu records dropped\n", 
+		static_cast<unsigned long long>(server.getNumFramesSent()), server.getNumFramesSent() / elapsedInS,
+		static_cast<unsigned long long>(server.getNumRecordsDropped()) );
+	for ( int i=0; i<numClients; ++i )
+	{
+		ClientResult& result = results[i];
+		printf("client %d: %.1f frames/s, %.1f measures/s, %llu dropped, latency p50=%lldus p99=%lldus max=%lldus\n", i,
+			result.mNumFrames / elapsedInS, result.mNumMeasures / elapsedInS, result.mNumDropped,
+			getPercentile( result.mLatenciesInUs, 0.5 ), getPercentile( result.mLatenciesInUs, 0.99 ), getPercentile( result.mLatenciesInUs, 1.0 ) );
+	}
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiStreamClient.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+	Prints the records streamed by a StreamServer.
+
+	Usage: 
+		RapaPhidgetStreamClient host port [serialNumber] [channelMask]
+		RapaPhidgetStreamClient multicast groupAddress port [serialNumber] [channelMask]
+*/
+namespace
+{
+	void printRecord( const RPhi::Record& record )
+	{
+		switch ( record.mKind )
+		{
+			case RPhi::Record::kDeviceAttached:
+				printf("%d attached\n", record.mSerialNumber );
+				break;
+			case RPhi::Record::kDeviceDetached:
+				printf("%d detached\n", record.mSerialNumber );
+				break;
+			case RPhi::Record::kDeviceName:
+				printf("%d name: %s\n", record.mSerialNumber, record.mText );
+				break;
+			case RPhi::Record::kSpatialMeasure:
+			{
+				const RPhi::Record::SpatialMeasure& measure = record.mSpatialMeasure;
+				printf("%d %lld acc=(%.3f %.3f %.3f) ang=(%.3f %.3f %.3f) mag=(%.3f %.3f %.3f)\n", record.mSerialNumber, static_cast<long long>(record.mTimeInUs),
+					measure.mAccelerationInGs[0], measure.mAccelerationInGs[1], measure.mAccelerationInGs[2],
+					measure.mAngularRateInDegPerSec[0], measure.mAngularRateInDegPerSec[1], measure.mAngularRateInDegPerSec[2],
+					measure.mMagneticFieldInGauss[0], measure.mMagneticFieldInGauss[1], measure.mMagneticFieldInGauss[2] );
+			}
+			break;
+			case RPhi::Record::kThermocoupleMeasure:
+				printf("%d %lld thermocouple %d: %.3fC\n", record.mSerialNumber, static_cast<long long>(record.mTimeInUs), record.mChannel, record.mThermocoupleMeasure.mTemperatureInC );
+				break;
+			case RPhi::Record::kAmbientTemperature:
+				printf("%d %lld ambient: %.3fC\n", record.mSerialNumber, static_cast<long long>(record.mTimeInUs), record.mAmbientTemperatureInC );
+				break;
+		}
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int argIndex = 1;
+	bool isMulticast = argc>argIndex && strcmp( argv[argIndex], "multicast" )==0;
+	if ( isMulticast )
+		++argIndex;
+	if ( argc<argIndex+2 )
+	{
+		printf("Usage: RapaPhidgetStreamClient [multicast] address port [serialNumber] [channelMask]\n");
+		return 1;
+	}
+	const char* address = argv[argIndex++];
+	int port = atoi( argv[argIndex++] );
+	
+	RPhi::StreamClient client;
+	bool connected = isMulticast ? client.joinMulticastGroup( address, port ) : client.connect( address, port );
+	if ( !connected )
+	{
+		printf("Failed to connect to %s:%d\n", address, port );
+		return 1;
+	}
+	if ( argc>argIndex )
+	{
+		int serialNumber = atoi( argv[argIndex++] );
+		RPhi::Device::ChannelMask channelMask = argc>argIndex ? static_cast<RPhi::Device::ChannelMask>( strtoul( argv[argIndex], NULL, 0 ) ) : RPhi::Device::kAllChannels;
+		client.subscribe( serialNumber, channelMask );
+	}
+
+	std::vector<RPhi::Record> records;
+	while ( client.receive( records, 1000 ) )
+	{
+		for ( std::size_t i=0; i<records.size(); ++i )
+			printRecord( records[i] );
+		records.clear();
+	}
+	printf("Disconnected\n");
+	return 0;
+}
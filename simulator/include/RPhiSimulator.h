@@ -0,0 +1,115 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+namespace RPhi
+{
+
+/*
+	Simulator
+
+	The Simulator is a stand-in for the Phidget21 library. It implements the 
+	Phidget21 C API (see the phidget21.h header next to this one) on top of 
+	synthetic Spatial and TemperatureSensor devices, so the real DeviceManager 
+	and Device code paths can be exercised and profiled without any hardware, 
+	with as many devices as needed.
+
+	Each measure follows a configurable waveform to which noise is added. Like 
+	on real devices, a Spatial only produces a new sample every data-rate period: 
+	reading it several times within a period returns the same values. Magnetometer
+	samples can randomly be unavailable (dropouts) and devices can randomly detach 
+	and re-attach (churn). A latency can be injected in each C API call to mimic USB 
+	transfers or, for devices opened remotely, webservice round trips.
+
+	The Simulator must be configured before creating any DeviceManager, as 
+	configure() replaces all the simulated devices.
+
+	To build RapaPhidget against the Simulator instead of Phidget21, configure 
+	the project with -DRAPAPHIDGET_USE_SIMULATOR=ON
+*/
+class Simulator
+{
+public:
+	enum Waveform
+	{
+		kConstant,
+		kSine,
+		kSquare,
+		kTriangle
+	};
+
+	struct Signal
+	{
+		Signal( Waveform waveform=kSine, double offset=0.0, double amplitude=1.0, double periodInS=1.0, double noiseAmplitude=0.0 );
+		
+		Waveform	mWaveform;
+		double		mOffset;
+		double		mAmplitude;
+		double		mPeriodInS;
+		double		mNoiseAmplitude;		// Uniform noise in [-mNoiseAmplitude, mNoiseAmplitude]
+	};
+
+	struct Configuration
+	{
+		Configuration();
+
+		int			mNumSpatials;
+		int			mNumTemperatureSensors;
+		int			mNumThermocouplesPerSensor;
+		
+		Signal		mAccelerationSignal;			// In Gs
+		Signal		mAngularRateSignal;				// In degrees per second
+		Signal		mMagneticFieldSignal;			// In Gauss
+		Signal		mTemperatureSignal;				// In Celsius degrees
+		Signal		mAmbientTemperatureSignal;		// In Celsius degrees
+		int			mDataRateInMs;					// Initial data rate of the Spatials
+
+		// Probability for a magnetometer sample to be unavailable. CPhidgetSpatial_getMagneticField()
+		// then returns EPHIDGET_UNKNOWNVAL, as it regularly does on real devices
+		double		mDropoutProbability;
+
+		// Average time a device stays attached, then detached. Zero disables the churn
+		double		mMeanAttachedTimeInS;
+		double		mMeanDetachedTimeInS;
+
+		// Latency added to every C API call, plus an extra latency for the calls on a 
+		// manager or device opened remotely
+		int			mCallLatencyInUs;
+		int			mRemoteCallLatencyInUs;
+
+		unsigned int mSeed;
+	};
+
+	static void					configure( const Configuration& configuration );
+	static Configuration		getConfiguration();
+
+	// Serial numbers of the simulated devices 
+	static int					getSpatialSerialNumber( int index )				{ return 100000 + index; }
+	static int					getTemperatureSensorSerialNumber( int index )	{ return 200000 + index; }
+
+	// Number of C API calls made since the last configure()
+	static unsigned long long	getNumCalls();
+};
+
+}
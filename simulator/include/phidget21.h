@@ -0,0 +1,153 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+/*
+	phidget21.h (simulator)
+
+	Drop-in replacement for the subset of the Phidget21 C API used by RapaPhidget.
+	The functions are implemented by the RapaPhidgetSimulator library on top of
+	synthetic devices (see RPhiSimulator.h). Constants match the values of the 
+	official header.
+
+	C-API reference
+	http://www.phidgets.com/documentation/web/cdoc/index.html
+*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _CPhidget *CPhidgetHandle;
+typedef struct _CPhidgetManager *CPhidgetManagerHandle;
+typedef struct _CPhidgetSpatial *CPhidgetSpatialHandle;
+typedef struct _CPhidgetTemperatureSensor *CPhidgetTemperatureSensorHandle;
+
+#define EPHIDGET_OK						0
+#define EPHIDGET_NOTFOUND				1
+#define EPHIDGET_NOMEMORY				2
+#define EPHIDGET_UNEXPECTED				3
+#define EPHIDGET_INVALIDARG				4
+#define EPHIDGET_NOTATTACHED			5
+#define EPHIDGET_INTERRUPTED			6
+#define EPHIDGET_INVALID				7
+#define EPHIDGET_NETWORK				8
+#define EPHIDGET_UNKNOWNVAL				9
+#define EPHIDGET_BADPASSWORD			10
+#define EPHIDGET_UNSUPPORTED			11
+#define EPHIDGET_DUPLICATE				12
+#define EPHIDGET_TIMEOUT				13
+#define EPHIDGET_OUTOFBOUNDS			14
+#define EPHIDGET_EVENT					15
+#define EPHIDGET_NETWORK_NOTCONNECTED	16
+#define EPHIDGET_WRONGDEVICE			17
+#define EPHIDGET_CLOSED					18
+#define EPHIDGET_BADVERSION				19
+
+#define PUNK_DBL						1e300
+#define PUNK_INT						0x7FFFFFFF
+
+#define PHIDGET_ATTACHED				0x1
+#define PHIDGET_NOTATTACHED				0x0
+
+typedef enum 
+{
+	PHIDID_SPATIAL_ACCEL_GYRO_COMPASS	= 0x033,
+	PHIDID_TEMPERATURESENSOR			= 0x070
+} CPhidget_DeviceID;
+
+typedef enum 
+{
+	PHIDGET_TEMPERATURE_SENSOR_K_TYPE	= 1,
+	PHIDGET_TEMPERATURE_SENSOR_J_TYPE,
+	PHIDGET_TEMPERATURE_SENSOR_E_TYPE,
+	PHIDGET_TEMPERATURE_SENSOR_T_TYPE
+} CPhidgetTemperatureSensor_ThermocoupleType;
+
+/* Common */
+int CPhidget_open( CPhidgetHandle phid, int serialNumber );
+int CPhidget_openRemote( CPhidgetHandle phid, int serial, const char *serverID, const char *password );
+int CPhidget_openRemoteIP( CPhidgetHandle phid, int serial, const char *address, int port, const char *password );
+int CPhidget_close( CPhidgetHandle phid );
+int CPhidget_delete( CPhidgetHandle phid );
+int CPhidget_waitForAttachment( CPhidgetHandle phid, int milliseconds );
+int CPhidget_getDeviceName( CPhidgetHandle phid, const char **deviceName );
+int CPhidget_getSerialNumber( CPhidgetHandle phid, int *serialNumber );
+int CPhidget_getDeviceVersion( CPhidgetHandle phid, int *deviceVersion );
+int CPhidget_getDeviceStatus( CPhidgetHandle phid, int *deviceStatus );
+int CPhidget_getDeviceType( CPhidgetHandle phid, const char **deviceType );
+int CPhidget_getDeviceLabel( CPhidgetHandle phid, const char **deviceLabel );
+int CPhidget_setDeviceLabel( CPhidgetHandle phid, const char *deviceLabel );
+int CPhidget_getDeviceID( CPhidgetHandle phid, CPhidget_DeviceID *deviceID );
+int CPhidget_getLibraryVersion( const char **libraryVersion );
+int CPhidget_getErrorDescription( int errorCode, const char **errorString );
+
+/* Manager */
+int CPhidgetManager_create( CPhidgetManagerHandle *phidm );
+int CPhidgetManager_open( CPhidgetManagerHandle phidm );
+int CPhidgetManager_openRemote( CPhidgetManagerHandle phidm, const char *serverID, const char *password );
+int CPhidgetManager_openRemoteIP( CPhidgetManagerHandle phidm, const char *address, int port, const char *password );
+int CPhidgetManager_close( CPhidgetManagerHandle phidm );
+int CPhidgetManager_delete( CPhidgetManagerHandle phidm );
+int CPhidgetManager_getAttachedDevices( CPhidgetManagerHandle phidm, CPhidgetHandle *devArray[], int *count );
+int CPhidgetManager_freeAttachedDevicesArray( CPhidgetHandle devArray[] );
+int CPhidgetManager_getServerStatus( CPhidgetManagerHandle phidm, int *serverStatus );
+
+/* Spatial */
+int CPhidgetSpatial_create( CPhidgetSpatialHandle *phid );
+int CPhidgetSpatial_getAccelerationAxisCount( CPhidgetSpatialHandle phid, int *count );
+int CPhidgetSpatial_getGyroAxisCount( CPhidgetSpatialHandle phid, int *count );
+int CPhidgetSpatial_getCompassAxisCount( CPhidgetSpatialHandle phid, int *count );
+int CPhidgetSpatial_getAcceleration( CPhidgetSpatialHandle phid, int index, double *acceleration );
+int CPhidgetSpatial_getAccelerationMax( CPhidgetSpatialHandle phid, int index, double *max );
+int CPhidgetSpatial_getAccelerationMin( CPhidgetSpatialHandle phid, int index, double *min );
+int CPhidgetSpatial_getAngularRate( CPhidgetSpatialHandle phid, int index, double *angularRate );
+int CPhidgetSpatial_getAngularRateMax( CPhidgetSpatialHandle phid, int index, double *max );
+int CPhidgetSpatial_getAngularRateMin( CPhidgetSpatialHandle phid, int index, double *min );
+int CPhidgetSpatial_getMagneticField( CPhidgetSpatialHandle phid, int index, double *magneticField );
+int CPhidgetSpatial_getMagneticFieldMax( CPhidgetSpatialHandle phid, int index, double *max );
+int CPhidgetSpatial_getMagneticFieldMin( CPhidgetSpatialHandle phid, int index, double *min );
+int CPhidgetSpatial_zeroGyro( CPhidgetSpatialHandle phid );
+int CPhidgetSpatial_getDataRate( CPhidgetSpatialHandle phid, int *milliseconds );
+int CPhidgetSpatial_setDataRate( CPhidgetSpatialHandle phid, int milliseconds );
+int CPhidgetSpatial_getDataRateMax( CPhidgetSpatialHandle phid, int *max );
+int CPhidgetSpatial_getDataRateMin( CPhidgetSpatialHandle phid, int *min );
+
+/* TemperatureSensor */
+int CPhidgetTemperatureSensor_create( CPhidgetTemperatureSensorHandle *phid );
+int CPhidgetTemperatureSensor_getTemperatureInputCount( CPhidgetTemperatureSensorHandle phid, int *count );
+int CPhidgetTemperatureSensor_getTemperature( CPhidgetTemperatureSensorHandle phid, int index, double *temperature );
+int CPhidgetTemperatureSensor_getTemperatureMax( CPhidgetTemperatureSensorHandle phid, int index, double *max );
+int CPhidgetTemperatureSensor_getTemperatureMin( CPhidgetTemperatureSensorHandle phid, int index, double *min );
+int CPhidgetTemperatureSensor_getPotential( CPhidgetTemperatureSensorHandle phid, int index, double *potential );
+int CPhidgetTemperatureSensor_getPotentialMax( CPhidgetTemperatureSensorHandle phid, int index, double *max );
+int CPhidgetTemperatureSensor_getPotentialMin( CPhidgetTemperatureSensorHandle phid, int index, double *min );
+int CPhidgetTemperatureSensor_getAmbientTemperature( CPhidgetTemperatureSensorHandle phid, double *ambient );
+int CPhidgetTemperatureSensor_getAmbientTemperatureMax( CPhidgetTemperatureSensorHandle phid, double *max );
+int CPhidgetTemperatureSensor_getAmbientTemperatureMin( CPhidgetTemperatureSensorHandle phid, double *min );
+int CPhidgetTemperatureSensor_getThermocoupleType( CPhidgetTemperatureSensorHandle phid, int index, CPhidgetTemperatureSensor_ThermocoupleType *type );
+int CPhidgetTemperatureSensor_setThermocoupleType( CPhidgetTemperatureSensorHandle phid, int index, CPhidgetTemperatureSensor_ThermocoupleType type );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,858 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiSimulator.h"
+#include "phidget21.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*
+	Notes:
+	- The handles returned by CPhidgetManager_getAttachedDevices() are owned by 
+	  the simulated devices. Each device alternates between two of them on 
+	  re-attachment, so that a DeviceManager sees a re-attached device as a new one
+	- Churn is applied when the attached devices are enumerated. This way a device
+	  never disappears between the moment the DeviceManager reconciles its list 
+	  and the moment it updates the devices
+	- Noise and dropouts are derived from a hash of the device, the axis and the 
+	  sample index, so reading the same sample several times gives the same result
+*/
+struct _CPhidget
+{
+	CPhidget_DeviceID		mDeviceID;
+	int						mDeviceIndex;		// Index of the simulated device, -1 if none
+	bool					mIsRemote;
+};
+
+struct _CPhidgetManager
+{
+	bool					mIsOpen;
+	bool					mIsRemote;
+};
+
+namespace RPhi
+{
+
+namespace
+{
+
+const int kTemperatureSamplePeriodInMs = 100;
+const double kPi = 3.14159265358979323846;
+
+struct SimulatedDevice
+{
+	CPhidget_DeviceID		mDeviceID;
+	int						mSerialNumber;
+	bool					mAttached;
+	double					mNextChurnTimeInS;
+	_CPhidget				mManagerHandles[2];
+	int						mManagerHandleIndex;
+	int						mDataRateInMs;
+	std::string				mLabel;
+	std::vector<CPhidgetTemperatureSensor_ThermocoupleType> mThermocoupleTypes;
+};
+
+struct State
+{
+	State();
+
+	std::mutex							mMutex;
+	Simulator::Configuration			mConfiguration;
+	std::vector<SimulatedDevice>		mDevices;
+	std::map<int, int>					mDeviceIndicesBySerialNumber;
+	std::chrono::steady_clock::time_point	mStartTime;
+	uint64_t							mRandomState;
+	std::atomic<unsigned long long>		mNumCalls;
+	std::atomic<int>					mCallLatencyInUs;
+	std::atomic<int>					mRemoteCallLatencyInUs;
+};
+
+State& getState()
+{
+	static State state;
+	return state;
+}
+
+uint64_t hash( uint64_t value )
+{
+	// splitmix64 finalizer
+	value += 0x9e3779b97f4a7c15ULL;
+	value = ( value ^ (value >> 30) ) * 0xbf58476d1ce4e5b9ULL;
+	value = ( value ^ (value >> 27) ) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+
+uint64_t hash( uint64_t a, uint64_t b, uint64_t c, uint64_t d )
+{
+	return hash( hash( hash( hash(a) ^ b ) ^ c ) ^ d );
+}
+
+// Uniform value in [0, 1)
+double toUnit( uint64_t value )
+{
+	return static_cast<double>( value >> 11 ) / 9007199254740992.0;
+}
+
+double drawExponential( State& state, double mean )
+{
+	state.mRandomState = hash( state.mRandomState );
+	return -mean * log( 1.0 - toUnit( state.mRandomState ) );
+}
+
+double getTimeInS( const State& state )
+{
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - state.mStartTime;
+	return std::chrono::duration<double>( elapsed ).count();
+}
+
+void resetDevices( State& state )
+{
+	const Simulator::Configuration& configuration = state.mConfiguration;
+	state.mDevices.clear();
+	state.mDevices.resize( configuration.mNumSpatials + configuration.mNumTemperatureSensors );
+	state.mDeviceIndicesBySerialNumber.clear();
+	state.mRandomState = configuration.mSeed;
+	state.mStartTime = std::chrono::steady_clock::now();
+	state.mNumCalls = 0;
+	state.mCallLatencyInUs = configuration.mCallLatencyInUs;
+	state.mRemoteCallLatencyInUs = configuration.mRemoteCallLatencyInUs;
+
+	for ( std::size_t i=0; i<state.mDevices.size(); ++i )
+	{
+		SimulatedDevice& device = state.mDevices[i];
+		int index = static_cast<int>(i);
+		if ( index<configuration.mNumSpatials )
+		{
+			device.mDeviceID = PHIDID_SPATIAL_ACCEL_GYRO_COMPASS;
+			device.mSerialNumber = Simulator::getSpatialSerialNumber( index );
+		}
+		else
+		{
+			device.mDeviceID = PHIDID_TEMPERATURESENSOR;
+			device.mSerialNumber = Simulator::getTemperatureSensorSerialNumber( index - configuration.mNumSpatials );
+			device.mThermocoupleTypes.assign( configuration.mNumThermocouplesPerSensor, PHIDGET_TEMPERATURE_SENSOR_K_TYPE );
+		}
+		device.mAttached = true;
+		device.mNextChurnTimeInS = 0.0;
+		if ( configuration.mMeanAttachedTimeInS>0.0 )
+			device.mNextChurnTimeInS = drawExponential( state, configuration.mMeanAttachedTimeInS );
+		for ( int j=0; j<2; ++j )
+		{
+			device.mManagerHandles[j].mDeviceID = device.mDeviceID;
+			device.mManagerHandles[j].mDeviceIndex = index;
+			device.mManagerHandles[j].mIsRemote = false;
+		}
+		device.mManagerHandleIndex = 0;
+		device.mDataRateInMs = configuration.mDataRateInMs;
+		device.mLabel = "";
+		state.mDeviceIndicesBySerialNumber[device.mSerialNumber] = index;
+	}
+}
+
+State::State()
+	: mMutex(),
+	  mConfiguration(),
+	  mDevices(),
+	  mDeviceIndicesBySerialNumber(),
+	  mStartTime(),
+	  mRandomState(0),
+	  mNumCalls(0),
+	  mCallLatencyInUs(0),
+	  mRemoteCallLatencyInUs(0)
+{
+	resetDevices( *this );
+}
+
+// Account for a C API call and wait for the simulated latency
+void simulateCall( bool isRemote )
+{
+	State& state = getState();
+	++state.mNumCalls;
+	int latencyInUs = state.mCallLatencyInUs;
+	if ( isRemote )
+		latencyInUs += state.mRemoteCallLatencyInUs;
+	if ( latencyInUs<=0 )
+		return;
+	
+	// Sleeping isn't precise enough for short latencies
+	std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now() + std::chrono::microseconds(latencyInUs);
+	if ( latencyInUs>=1000 )
+		std::this_thread::sleep_until( endTime );
+	else
+		while ( std::chrono::steady_clock::now()<endTime ) {}
+}
+
+void simulateCall( CPhidgetHandle phid )
+{
+	simulateCall( phid && phid->mIsRemote );
+}
+
+// Return the device the handle refers to if it is attached. State::mMutex must be locked
+SimulatedDevice* getAttachedDevice( State& state, CPhidgetHandle phid )
+{
+	if ( !phid || phid->mDeviceIndex<0 || phid->mDeviceIndex>=static_cast<int>(state.mDevices.size()) )
+		return NULL;
+	SimulatedDevice& device = state.mDevices[phid->mDeviceIndex];
+	if ( !device.mAttached || device.mDeviceID!=phid->mDeviceID )
+		return NULL;
+	return &device;
+}
+
+double evaluateSignal( const Simulator::Signal& signal, double timeInS, double phase, uint64_t noiseKey )
+{
+	double position = 0.0;
+	if ( signal.mPeriodInS>0.0 )
+		position = fmod( timeInS / signal.mPeriodInS + phase, 1.0 );
+	double value = 0.0;
+	switch ( signal.mWaveform )
+	{
+		case Simulator::kConstant:	value = 0.0; break;
+		case Simulator::kSine:		value = sin( 2.0 * kPi * position ); break;
+		case Simulator::kSquare:	value = position<0.5 ? 1.0 : -1.0; break;
+		case Simulator::kTriangle:	value = 1.0 - 4.0 * fabs( position - 0.5 ); break;
+	}
+	double noise = ( toUnit( hash(noiseKey) ) * 2.0 - 1.0 ) * signal.mNoiseAmplitude;
+	return signal.mOffset + signal.mAmplitude * value + noise;
+}
+
+enum Quantity
+{
+	kAcceleration,
+	kAngularRate,
+	kMagneticField,
+	kTemperature,
+	kAmbientTemperature,
+	kDropout
+};
+
+// Value of a quantity for the current sample of the device. State::mMutex must be locked
+double getSampleValue( State& state, const SimulatedDevice& device, Quantity quantity, int axis, const Simulator::Signal& signal, int samplePeriodInMs, uint64_t* sampleKey=NULL )
+{
+	double timeInS = getTimeInS( state );
+	int64_t sampleIndex = static_cast<int64_t>( timeInS * 1000.0 ) / ( samplePeriodInMs>0 ? samplePeriodInMs : 1 );
+	double sampleTimeInS = static_cast<double>( sampleIndex * samplePeriodInMs ) / 1000.0;
+	double phase = toUnit( hash( device.mSerialNumber, quantity, axis, 0 ) );
+	uint64_t key = hash( state.mConfiguration.mSeed, device.mSerialNumber, quantity * 16 + axis, sampleIndex );
+	if ( sampleKey )
+		*sampleKey = hash( state.mConfiguration.mSeed, device.mSerialNumber, kDropout, sampleIndex );
+	return evaluateSignal( signal, sampleTimeInS, phase, key );
+}
+
+void applyChurn( State& state )
+{
+	const Simulator::Configuration& configuration = state.mConfiguration;
+	if ( configuration.mMeanAttachedTimeInS<=0.0 || configuration.mMeanDetachedTimeInS<=0.0 )
+		return;
+	double timeInS = getTimeInS( state );
+	for ( std::size_t i=0; i<state.mDevices.size(); ++i )
+	{
+		SimulatedDevice& device = state.mDevices[i];
+		while ( timeInS>=device.mNextChurnTimeInS )
+		{
+			device.mAttached = !device.mAttached;
+			if ( device.mAttached )
+			{
+				device.mManagerHandleIndex = 1 - device.mManagerHandleIndex;
+				device.mNextChurnTimeInS += drawExponential( state, configuration.mMeanAttachedTimeInS );
+			}
+			else
+			{
+				device.mNextChurnTimeInS += drawExponential( state, configuration.mMeanDetachedTimeInS );
+			}
+		}
+	}
+}
+
+int openDevice( CPhidgetHandle phid, int serialNumber, bool isRemote )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( isRemote );
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	phid->mIsRemote = isRemote;
+	phid->mDeviceIndex = -1;
+	std::map<int, int>::const_iterator itr = state.mDeviceIndicesBySerialNumber.find( serialNumber );
+	if ( itr!=state.mDeviceIndicesBySerialNumber.end() )
+		phid->mDeviceIndex = itr->second;
+	return EPHIDGET_OK;
+}
+
+CPhidgetHandle createHandle( CPhidget_DeviceID deviceID )
+{
+	CPhidgetHandle phid = new _CPhidget;
+	phid->mDeviceID = deviceID;
+	phid->mDeviceIndex = -1;
+	phid->mIsRemote = false;
+	return phid;
+}
+
+CPhidgetHandle toHandle( CPhidgetSpatialHandle phid )					{ return reinterpret_cast<CPhidgetHandle>(phid); }
+CPhidgetHandle toHandle( CPhidgetTemperatureSensorHandle phid )		{ return reinterpret_cast<CPhidgetHandle>(phid); }
+
+// Common prologue of the device calls: simulate the call, lock the state and resolve the device
+#define RPHI_SIMULATOR_GET_DEVICE( handle, expectedDeviceID )						\
+	if ( !handle )																	\
+		return EPHIDGET_INVALIDARG;													\
+	simulateCall( handle );															\
+	State& state = getState();														\
+	std::lock_guard<std::mutex> lock( state.mMutex );								\
+	SimulatedDevice* device = getAttachedDevice( state, handle );					\
+	if ( !device )																	\
+		return EPHIDGET_NOTATTACHED;												\
+	if ( expectedDeviceID!=0 && device->mDeviceID!=expectedDeviceID )				\
+		return EPHIDGET_WRONGDEVICE;
+
+#define RPHI_SIMULATOR_CHECK_INDEX( result, index, count )							\
+	if ( !result || index<0 || index>=count )										\
+		return EPHIDGET_OUTOFBOUNDS;
+
+int getSpatialValue( CPhidgetSpatialHandle phidgetSpatial, Quantity quantity, int index, double* value )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	RPHI_SIMULATOR_CHECK_INDEX( value, index, 3 )
+	const Simulator::Configuration& configuration = state.mConfiguration;
+	const Simulator::Signal* signal = &configuration.mAccelerationSignal;
+	if ( quantity==kAngularRate )
+		signal = &configuration.mAngularRateSignal;
+	else if ( quantity==kMagneticField )
+		signal = &configuration.mMagneticFieldSignal;
+	uint64_t sampleKey = 0;
+	*value = getSampleValue( state, *device, quantity, index, *signal, device->mDataRateInMs, &sampleKey );
+	if ( quantity==kMagneticField && toUnit(sampleKey)<configuration.mDropoutProbability )
+	{
+		*value = PUNK_DBL;
+		return EPHIDGET_UNKNOWNVAL;
+	}
+	return EPHIDGET_OK;
+}
+
+int getSpatialRange( CPhidgetSpatialHandle phidgetSpatial, int index, double* value, double range )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	RPHI_SIMULATOR_CHECK_INDEX( value, index, 3 )
+	*value = range;
+	return EPHIDGET_OK;
+}
+
+int getSpatialAxisCount( CPhidgetSpatialHandle phidgetSpatial, int* count )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	if ( !count )
+		return EPHIDGET_INVALIDARG;
+	*count = 3;
+	return EPHIDGET_OK;
+}
+
+int getThermocoupleValue( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, int index, double* value, bool potential )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	RPHI_SIMULATOR_CHECK_INDEX( value, index, static_cast<int>(device->mThermocoupleTypes.size()) )
+	double temperature = getSampleValue( state, *device, kTemperature, index, state.mConfiguration.mTemperatureSignal, kTemperatureSamplePeriodInMs );
+	*value = potential ? temperature * 0.041 : temperature;		// Roughly the Seebeck coefficient of a K-type (mV/C)
+	return EPHIDGET_OK;
+}
+
+int getThermocoupleRange( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, int index, double* value, double range )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	RPHI_SIMULATOR_CHECK_INDEX( value, index, static_cast<int>(device->mThermocoupleTypes.size()) )
+	*value = range;
+	return EPHIDGET_OK;
+}
+
+int getAmbientTemperatureValue( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, double* value, double range, bool useRange )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	if ( !value )
+		return EPHIDGET_INVALIDARG;
+	if ( useRange )
+		*value = range;
+	else
+		*value = getSampleValue( state, *device, kAmbientTemperature, 0, state.mConfiguration.mAmbientTemperatureSignal, kTemperatureSamplePeriodInMs );
+	return EPHIDGET_OK;
+}
+
+}
+
+/*
+	Simulator
+*/
+Simulator::Signal::Signal( Waveform waveform, double offset, double amplitude, double periodInS, double noiseAmplitude )
+	: mWaveform(waveform),
+	  mOffset(offset),
+	  mAmplitude(amplitude),
+	  mPeriodInS(periodInS),
+	  mNoiseAmplitude(noiseAmplitude)
+{
+}
+
+Simulator::Configuration::Configuration()
+	: mNumSpatials(1),
+	  mNumTemperatureSensors(1),
+	  mNumThermocouplesPerSensor(4),
+	  mAccelerationSignal( kSine, 0.0, 1.0, 2.0, 0.01 ),
+	  mAngularRateSignal( kSine, 0.0, 90.0, 4.0, 0.5 ),
+	  mMagneticFieldSignal( kSine, 0.3, 0.2, 10.0, 0.005 ),
+	  mTemperatureSignal( kSine, 60.0, 20.0, 60.0, 0.1 ),
+	  mAmbientTemperatureSignal( kTriangle, 25.0, 1.0, 600.0, 0.05 ),
+	  mDataRateInMs(8),
+	  mDropoutProbability(0.0),
+	  mMeanAttachedTimeInS(0.0),
+	  mMeanDetachedTimeInS(0.0),
+	  mCallLatencyInUs(0),
+	  mRemoteCallLatencyInUs(0),
+	  mSeed(1)
+{
+}
+
+void Simulator::configure( const Configuration& configuration )
+{
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	state.mConfiguration = configuration;
+	resetDevices( state );
+}
+
+Simulator::Configuration Simulator::getConfiguration()
+{
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	return state.mConfiguration;
+}
+
+unsigned long long Simulator::getNumCalls()
+{
+	return getState().mNumCalls;
+}
+
+}
+
+/*
+	Phidget21 C API
+*/
+using namespace RPhi;
+
+int CPhidget_open( CPhidgetHandle phid, int serialNumber )
+{
+	return openDevice( phid, serialNumber, false );
+}
+
+int CPhidget_openRemote( CPhidgetHandle phid, int serial, const char* /*serverID*/, const char* /*password*/ )
+{
+	return openDevice( phid, serial, true );
+}
+
+int CPhidget_openRemoteIP( CPhidgetHandle phid, int serial, const char* /*address*/, int /*port*/, const char* /*password*/ )
+{
+	return openDevice( phid, serial, true );
+}
+
+int CPhidget_close( CPhidgetHandle phid )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phid );
+	phid->mDeviceIndex = -1;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_delete( CPhidgetHandle phid )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	delete phid;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_waitForAttachment( CPhidgetHandle phid, int /*milliseconds*/ )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phid );
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	if ( !getAttachedDevice( state, phid ) )
+		return EPHIDGET_TIMEOUT;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceName( CPhidgetHandle phid, const char** deviceName )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceName )
+		return EPHIDGET_INVALIDARG;
+	*deviceName = device->mDeviceID==PHIDID_SPATIAL_ACCEL_GYRO_COMPASS ? "Phidget Spatial 3/3/3" : "Phidget Temperature Sensor 4-input";
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getSerialNumber( CPhidgetHandle phid, int* serialNumber )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !serialNumber )
+		return EPHIDGET_INVALIDARG;
+	*serialNumber = device->mSerialNumber;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceVersion( CPhidgetHandle phid, int* deviceVersion )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceVersion )
+		return EPHIDGET_INVALIDARG;
+	*deviceVersion = device->mDeviceID==PHIDID_SPATIAL_ACCEL_GYRO_COMPASS ? 400 : 200;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceStatus( CPhidgetHandle phid, int* deviceStatus )
+{
+	if ( !phid || !deviceStatus )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phid );
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	*deviceStatus = getAttachedDevice( state, phid ) ? PHIDGET_ATTACHED : PHIDGET_NOTATTACHED;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceType( CPhidgetHandle phid, const char** deviceType )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceType )
+		return EPHIDGET_INVALIDARG;
+	*deviceType = device->mDeviceID==PHIDID_SPATIAL_ACCEL_GYRO_COMPASS ? "PhidgetSpatial" : "PhidgetTemperatureSensor";
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceLabel( CPhidgetHandle phid, const char** deviceLabel )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceLabel )
+		return EPHIDGET_INVALIDARG;
+	*deviceLabel = device->mLabel.c_str();
+	return EPHIDGET_OK;
+}
+
+int CPhidget_setDeviceLabel( CPhidgetHandle phid, const char* deviceLabel )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceLabel )
+		return EPHIDGET_INVALIDARG;
+	device->mLabel = deviceLabel;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getDeviceID( CPhidgetHandle phid, CPhidget_DeviceID* deviceID )
+{
+	RPHI_SIMULATOR_GET_DEVICE( phid, 0 )
+	if ( !deviceID )
+		return EPHIDGET_INVALIDARG;
+	*deviceID = device->mDeviceID;
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getLibraryVersion( const char** libraryVersion )
+{
+	if ( !libraryVersion )
+		return EPHIDGET_INVALIDARG;
+	*libraryVersion = "Phidget21 Simulator - Version 2.1.8";
+	return EPHIDGET_OK;
+}
+
+int CPhidget_getErrorDescription( int errorCode, const char** errorString )
+{
+	static const char* descriptions[] = 
+	{
+		"Function completed successfully.",
+		"A Phidget matching the type and or serial number could not be found.",
+		"Memory could not be allocated.",
+		"Unexpected Error.  Contact Phidgets Inc. for support.",
+		"Invalid argument passed to function.",
+		"Phidget not physically attached.",
+		"Read/Write operation was interrupted.",
+		"The Error Code is not defined.",
+		"Network Error.",
+		"Value is Unknown (State not yet received from device, or not yet set by user).",
+		"Authorization Failed.",
+		"Not Supported.",
+		"Duplicated request.",
+		"Given timeout has been exceeded.",
+		"Index out of Bounds.",
+		"A non-null error code was returned from an event handler.",
+		"A connection to the server does not exist.",
+		"Function is not applicable for this device.",
+		"Phidget handle was closed.",
+		"Webservice and Client protocol versions don't match. Update to newest release."
+	};
+	if ( !errorString )
+		return EPHIDGET_INVALIDARG;
+	if ( errorCode<0 || errorCode>EPHIDGET_BADVERSION )
+		return EPHIDGET_INVALIDARG;
+	*errorString = descriptions[errorCode];
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_create( CPhidgetManagerHandle* phidm )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	*phidm = new _CPhidgetManager;
+	(*phidm)->mIsOpen = false;
+	(*phidm)->mIsRemote = false;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_open( CPhidgetManagerHandle phidm )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	phidm->mIsOpen = true;
+	phidm->mIsRemote = false;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_openRemote( CPhidgetManagerHandle phidm, const char* /*serverID*/, const char* /*password*/ )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( true );
+	phidm->mIsOpen = true;
+	phidm->mIsRemote = true;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_openRemoteIP( CPhidgetManagerHandle phidm, const char* /*address*/, int /*port*/, const char* /*password*/ )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( true );
+	phidm->mIsOpen = true;
+	phidm->mIsRemote = true;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_close( CPhidgetManagerHandle phidm )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phidm->mIsRemote );
+	phidm->mIsOpen = false;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_delete( CPhidgetManagerHandle phidm )
+{
+	if ( !phidm )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	delete phidm;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_getAttachedDevices( CPhidgetManagerHandle phidm, CPhidgetHandle* devArray[], int* count )
+{
+	if ( !phidm || !devArray || !count )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phidm->mIsRemote );
+	if ( !phidm->mIsOpen )
+		return EPHIDGET_CLOSED;
+
+	State& state = getState();
+	std::lock_guard<std::mutex> lock( state.mMutex );
+	applyChurn( state );
+	
+	*count = 0;
+	*devArray = static_cast<CPhidgetHandle*>( malloc( sizeof(CPhidgetHandle) * (state.mDevices.size() + 1) ) );
+	if ( !*devArray )
+		return EPHIDGET_NOMEMORY;
+	for ( std::size_t i=0; i<state.mDevices.size(); ++i )
+	{
+		SimulatedDevice& device = state.mDevices[i];
+		if ( !device.mAttached )
+			continue;
+		CPhidgetHandle handle = &device.mManagerHandles[device.mManagerHandleIndex];
+		handle->mIsRemote = phidm->mIsRemote;
+		(*devArray)[(*count)++] = handle;
+	}
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_freeAttachedDevicesArray( CPhidgetHandle devArray[] )
+{
+	free( devArray );
+	return EPHIDGET_OK;
+}
+
+int CPhidgetManager_getServerStatus( CPhidgetManagerHandle phidm, int* serverStatus )
+{
+	if ( !phidm || !serverStatus )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( phidm->mIsRemote );
+	*serverStatus = ( phidm->mIsOpen && phidm->mIsRemote ) ? PHIDGET_ATTACHED : PHIDGET_NOTATTACHED;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_create( CPhidgetSpatialHandle* phid )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	*phid = reinterpret_cast<CPhidgetSpatialHandle>( createHandle( PHIDID_SPATIAL_ACCEL_GYRO_COMPASS ) );
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_getAccelerationAxisCount( CPhidgetSpatialHandle phid, int* count )	{ return getSpatialAxisCount( phid, count ); }
+int CPhidgetSpatial_getGyroAxisCount( CPhidgetSpatialHandle phid, int* count )			{ return getSpatialAxisCount( phid, count ); }
+int CPhidgetSpatial_getCompassAxisCount( CPhidgetSpatialHandle phid, int* count )		{ return getSpatialAxisCount( phid, count ); }
+
+int CPhidgetSpatial_getAcceleration( CPhidgetSpatialHandle phid, int index, double* acceleration )		{ return getSpatialValue( phid, kAcceleration, index, acceleration ); }
+int CPhidgetSpatial_getAccelerationMax( CPhidgetSpatialHandle phid, int index, double* max )			{ return getSpatialRange( phid, index, max, 5.0 ); }
+int CPhidgetSpatial_getAccelerationMin( CPhidgetSpatialHandle phid, int index, double* min )			{ return getSpatialRange( phid, index, min, -5.0 ); }
+int CPhidgetSpatial_getAngularRate( CPhidgetSpatialHandle phid, int index, double* angularRate )		{ return getSpatialValue( phid, kAngularRate, index, angularRate ); }
+int CPhidgetSpatial_getAngularRateMax( CPhidgetSpatialHandle phid, int index, double* max )			{ return getSpatialRange( phid, index, max, 400.0 ); }
+int CPhidgetSpatial_getAngularRateMin( CPhidgetSpatialHandle phid, int index, double* min )			{ return getSpatialRange( phid, index, min, -400.0 ); }
+int CPhidgetSpatial_getMagneticField( CPhidgetSpatialHandle phid, int index, double* magneticField )	{ return getSpatialValue( phid, kMagneticField, index, magneticField ); }
+int CPhidgetSpatial_getMagneticFieldMax( CPhidgetSpatialHandle phid, int index, double* max )			{ return getSpatialRange( phid, index, max, 4.0 ); }
+int CPhidgetSpatial_getMagneticFieldMin( CPhidgetSpatialHandle phid, int index, double* min )			{ return getSpatialRange( phid, index, min, -4.0 ); }
+
+int CPhidgetSpatial_zeroGyro( CPhidgetSpatialHandle phidgetSpatial )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_getDataRate( CPhidgetSpatialHandle phidgetSpatial, int* milliseconds )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	if ( !milliseconds )
+		return EPHIDGET_INVALIDARG;
+	*milliseconds = device->mDataRateInMs;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_setDataRate( CPhidgetSpatialHandle phidgetSpatial, int milliseconds )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+
+	// Like the 1056, support 1, 2, 4 and the multiples of 8 up to 1000 ms
+	bool supported = ( milliseconds==1 || milliseconds==2 || milliseconds==4 || 
+					   ( milliseconds>=8 && milliseconds<=1000 && milliseconds%8==0 ) );
+	if ( !supported )
+		return EPHIDGET_INVALIDARG;
+	device->mDataRateInMs = milliseconds;
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_getDataRateMax( CPhidgetSpatialHandle phidgetSpatial, int* max )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	if ( !max )
+		return EPHIDGET_INVALIDARG;
+	*max = 1000;		// The slowest rate
+	return EPHIDGET_OK;
+}
+
+int CPhidgetSpatial_getDataRateMin( CPhidgetSpatialHandle phidgetSpatial, int* min )
+{
+	CPhidgetHandle phid = toHandle( phidgetSpatial );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_SPATIAL_ACCEL_GYRO_COMPASS )
+	if ( !min )
+		return EPHIDGET_INVALIDARG;
+	*min = 1;			// The fastest rate
+	return EPHIDGET_OK;
+}
+
+int CPhidgetTemperatureSensor_create( CPhidgetTemperatureSensorHandle* phid )
+{
+	if ( !phid )
+		return EPHIDGET_INVALIDARG;
+	simulateCall( false );
+	*phid = reinterpret_cast<CPhidgetTemperatureSensorHandle>( createHandle( PHIDID_TEMPERATURESENSOR ) );
+	return EPHIDGET_OK;
+}
+
+int CPhidgetTemperatureSensor_getTemperatureInputCount( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, int* count )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	if ( !count )
+		return EPHIDGET_INVALIDARG;
+	*count = static_cast<int>( device->mThermocoupleTypes.size() );
+	return EPHIDGET_OK;
+}
+
+int CPhidgetTemperatureSensor_getTemperature( CPhidgetTemperatureSensorHandle phid, int index, double* temperature )	{ return getThermocoupleValue( phid, index, temperature, false ); }
+int CPhidgetTemperatureSensor_getTemperatureMax( CPhidgetTemperatureSensorHandle phid, int index, double* max )		{ return getThermocoupleRange( phid, index, max, 1250.0 ); }
+int CPhidgetTemperatureSensor_getTemperatureMin( CPhidgetTemperatureSensorHandle phid, int index, double* min )		{ return getThermocoupleRange( phid, index, min, -200.0 ); }
+int CPhidgetTemperatureSensor_getPotential( CPhidgetTemperatureSensorHandle phid, int index, double* potential )		{ return getThermocoupleValue( phid, index, potential, true ); }
+int CPhidgetTemperatureSensor_getPotentialMax( CPhidgetTemperatureSensorHandle phid, int index, double* max )			{ return getThermocoupleRange( phid, index, max, 55.0 ); }
+int CPhidgetTemperatureSensor_getPotentialMin( CPhidgetTemperatureSensorHandle phid, int index, double* min )			{ return getThermocoupleRange( phid, index, min, -10.0 ); }
+
+int CPhidgetTemperatureSensor_getAmbientTemperature( CPhidgetTemperatureSensorHandle phid, double* ambient )		{ return getAmbientTemperatureValue( phid, ambient, 0.0, false ); }
+int CPhidgetTemperatureSensor_getAmbientTemperatureMax( CPhidgetTemperatureSensorHandle phid, double* max )		{ return getAmbientTemperatureValue( phid, max, 85.0, true ); }
+int CPhidgetTemperatureSensor_getAmbientTemperatureMin( CPhidgetTemperatureSensorHandle phid, double* min )		{ return getAmbientTemperatureValue( phid, min, -40.0, true ); }
+
+int CPhidgetTemperatureSensor_getThermocoupleType( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, int index, CPhidgetTemperatureSensor_ThermocoupleType* type )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	if ( !type || index<0 || index>=static_cast<int>(device->mThermocoupleTypes.size()) )
+		return EPHIDGET_OUTOFBOUNDS;
+	*type = device->mThermocoupleTypes[index];
+	return EPHIDGET_OK;
+}
+
+int CPhidgetTemperatureSensor_setThermocoupleType( CPhidgetTemperatureSensorHandle phidgetTemperatureSensor, int index, CPhidgetTemperatureSensor_ThermocoupleType type )
+{
+	CPhidgetHandle phid = toHandle( phidgetTemperatureSensor );
+	RPHI_SIMULATOR_GET_DEVICE( phid, PHIDID_TEMPERATURESENSOR )
+	if ( index<0 || index>=static_cast<int>(device->mThermocoupleTypes.size()) )
+		return EPHIDGET_OUTOFBOUNDS;
+	if ( type<PHIDGET_TEMPERATURE_SENSOR_K_TYPE || type>PHIDGET_TEMPERATURE_SENSOR_T_TYPE )
+		return EPHIDGET_INVALIDARG;
+	device->mThermocoupleTypes[index] = type;
+	return EPHIDGET_OK;
+}
@@ -28,6 +28,9 @@
 #include <sstream>
 #include <phidget21.h>
 
+#include "RPhiClock.h"
+#include "RPhiTrace.h"
+
 /*
 	Notes:
 	* The Device is created by the DeviceManager which gives it its own generic Phidget handle
@@ -60,7 +63,45 @@ Device::Device( Type type, CPhidgetHandle phidgetSpecificHandle )
 	  mSerialNumber(0),
 	  mVersion(0),
 	  mTypeName(),
-	  mListeners()
+	  mLabel(),
+	  mListeners(),
+	  mListenerChannelMasks(),
+	  mListenerDecimations(),
+	  mListenerNumChanges(),
+	  mNotifiedListeners(),
+	  mNumListenerRemovals(0),
+	  mDeltaFields(),
+	  mLastChangedChannels(0),
+	  mAcquisitionPolledChannels(kAllChannels),
+	  mAcquisitionResync(true),
+	  mExactType(false),
+	  mMissingSinceInUs(-1),
+	  mStatistics()
+{
+}
+
+Device::Device( Type type, const std::string& name, int serialNumber, int version, const std::string& typeName )
+	: mPhidgetHandleFromManager(NULL),
+	  mPhidgetHandle(NULL),
+	  mType(type),
+	  mName(name),
+	  mSerialNumber(serialNumber),
+	  mVersion(version),
+	  mTypeName(typeName),
+	  mLabel(),
+	  mListeners(),
+	  mListenerChannelMasks(),
+	  mListenerDecimations(),
+	  mListenerNumChanges(),
+	  mNotifiedListeners(),
+	  mNumListenerRemovals(0),
+	  mDeltaFields(),
+	  mLastChangedChannels(0),
+	  mAcquisitionPolledChannels(kAllChannels),
+	  mAcquisitionResync(true),
+	  mExactType(false),
+	  mMissingSinceInUs(-1),
+	  mStatistics()
 {
 }
 
@@ -87,15 +128,23 @@ void Device::getInformation()
 	const char* typeName = NULL;
 	ret = CPhidget_getDeviceType( getPhidgetHandle(), &typeName );
 	assert( ret==EPHIDGET_OK );
+
+	const char* label = NULL;
+	ret = CPhidget_getDeviceLabel( getPhidgetHandle(), &label );
+	assert( ret==EPHIDGET_OK );
 		
 	mName = name;
 	mSerialNumber = serialNumber;
 	mVersion = version;
 	mTypeName = typeName;
+	mLabel = label ? label : "";
 }
 
 bool Device::isAttached() const
 {
+	if ( !getPhidgetHandle() )
+		return true;
+
 	int result = 0;
 	int ret = CPhidget_getDeviceStatus( getPhidgetHandle(), &result );
 	assert( ret==EPHIDGET_OK );
@@ -103,25 +152,24 @@ bool Device::isAttached() const
 	return attached;
 }	
 
-const char* Device::getLabel() const
-{
-	const char* label = NULL;
-	int ret = CPhidget_getDeviceLabel( getPhidgetHandle(), &label );
-	assert( ret==EPHIDGET_OK );
-	return label;
-}
-
 void Device::setLabel( const char* label )
 {
 	assert( label );
+	if ( !getPhidgetHandle() )
+		return;
 	int ret = CPhidget_setDeviceLabel( getPhidgetHandle(), label );
 	assert( ret==EPHIDGET_OK );
+	if ( ret==EPHIDGET_OK )
+		mLabel = label;
 }
 
-void Device::addListener( Listener* listener )
+void Device::addListener( Listener* listener, ChannelMask channelMask )
 {
 	assert(listener);
 	mListeners.push_back(listener);
+	mListenerChannelMasks.push_back(channelMask);
+	mListenerDecimations.push_back(1);
+	mListenerNumChanges.push_back(0);
 }
 
 bool Device::removeListener( Listener* listener )
@@ -129,7 +177,13 @@ bool Device::removeListener( Listener* listener )
 	Listeners::iterator itr = std::find( mListeners.begin(), mListeners.end(), listener );
 	if ( itr==mListeners.end() )
 		return false;
+	std::size_t index = itr - mListeners.begin();
+	mListenerChannelMasks.erase( mListenerChannelMasks.begin() + index );
+	mListenerDecimations.erase( mListenerDecimations.begin() + index );
+	mListenerNumChanges.erase( mListenerNumChanges.begin() + index );
 	mListeners.erase( itr );
+	mNumListenerRemovals++;
+	onListenerRemoved( listener );
 	return true;
 }
 
@@ -140,6 +194,115 @@ void Device::removeListeners()
 		removeListener( *itr );
 }
 
+Device::ChannelMask Device::getListenerChannelMask( Listener* listener ) const
+{
+	Listeners::const_iterator itr = std::find( mListeners.begin(), mListeners.end(), listener );
+	if ( itr==mListeners.end() )
+		return 0;
+	return mListenerChannelMasks[ itr - mListeners.begin() ];
+}
+
+Device::ChannelMask Device::getSubscribedChannels() const
+{
+	ChannelMask channels = 0;
+	for ( ChannelMasks::const_iterator itr=mListenerChannelMasks.begin(); itr!=mListenerChannelMasks.end(); ++itr )
+		channels |= *itr;
+	return channels;
+}
+
+void Device::setListenerDecimation( Listener* listener, unsigned int decimation )
+{
+	Listeners::const_iterator itr = std::find( mListeners.begin(), mListeners.end(), listener );
+	assert( itr!=mListeners.end() );
+	if ( itr==mListeners.end() )
+		return;
+	std::size_t index = itr - mListeners.begin();
+	if ( mListenerDecimations[index]==decimation )
+		return;
+	mListenerDecimations[index] = decimation>0 ? decimation : 1;
+	mListenerNumChanges[index] = 0;
+}
+
+void Device::notifyDeviceChanged( ChannelMask changedChannels )
+{
+	mStatistics.mNumChanges.fetch_add( 1, std::memory_order_relaxed );
+	mLastChangedChannels = changedChannels;
+	if ( mListeners.empty() )
+	{
+		mDeltaFields.clear();
+		return;
+	}
+
+	Delta delta;
+	delta.mChangedChannels = changedChannels;
+	delta.mFields = mDeltaFields.empty() ? NULL : &mDeltaFields[0];
+	delta.mNumFields = mDeltaFields.size();
+
+	// Go through a copy of the listeners, as a listener may remove itself or others
+	// when notified (an AsyncDevice resumed inline can get destroyed for instance). 
+	// Adding a listener doesn't move the others, removing one does
+	long long startTimeInNs = Clock::getMonotonicTimeInNs();
+	mNotifiedListeners.assign( mListeners.begin(), mListeners.end() );
+	unsigned int numListenerRemovals = mNumListenerRemovals;
+	for ( std::size_t i=0; i<mNotifiedListeners.size(); ++i )
+	{
+		Listener* listener = mNotifiedListeners[i];
+		std::size_t index = i;
+		if ( mNumListenerRemovals!=numListenerRemovals )
+		{
+			Listeners::const_iterator itr = std::find( mListeners.begin(), mListeners.end(), listener );
+			if ( itr==mListeners.end() )
+				continue;
+			index = itr - mListeners.begin();
+		}
+		if ( mListenerChannelMasks[index] & changedChannels )
+		{
+			if ( mListenerDecimations[index]>1 && ( ++mListenerNumChanges[index] % mListenerDecimations[index] )!=0 )
+				continue;
+			RPHI_TRACE_SCOPE_ARG( "Listener::onDeviceChanged", "serial", getSerialNumber() );
+			unsigned int numRemovalsBefore = mNumListenerRemovals;
+			listener->onDeviceChanged( this );
+			if ( mNumListenerRemovals!=numRemovalsBefore && 
+				 std::find( mListeners.begin(), mListeners.end(), listener )==mListeners.end() )
+				continue;
+			listener->onDeviceDelta( this, delta );
+		}
+	}
+	mStatistics.mListenerDuration.record( static_cast<uint64_t>( Clock::getMonotonicTimeInNs() - startTimeInNs ) );
+	mDeltaFields.clear();
+}
+
+void Device::addDeltaField( int channel, int index, double oldValue, double newValue )
+{
+	if ( oldValue==newValue )
+		return;
+	Delta::Field field;
+	field.mChannel = channel;
+	field.mIndex = index;
+	field.mOldValue = oldValue;
+	field.mNewValue = newValue;
+	mDeltaFields.push_back( field );
+}
+
+void Device::notifyDeviceGap( const Gap& gap )
+{
+	mStatistics.mNumGaps.fetch_add( 1, std::memory_order_relaxed );
+	mStatistics.mNumLostSamples.fetch_add( gap.mNumLostSamples, std::memory_order_relaxed );
+
+	// Through a copy of the listeners, as in notifyDeviceChanged()
+	mNotifiedListeners.assign( mListeners.begin(), mListeners.end() );
+	unsigned int numListenerRemovals = mNumListenerRemovals;
+	for ( std::size_t i=0; i<mNotifiedListeners.size(); ++i )
+	{
+		Listener* listener = mNotifiedListeners[i];
+		if ( mNumListenerRemovals!=numListenerRemovals && 
+			 std::find( mListeners.begin(), mListeners.end(), listener )==mListeners.end() )
+			continue;
+		RPHI_TRACE_SCOPE_ARG( "Listener::onDeviceGap", "serial", getSerialNumber() );
+		listener->onDeviceGap( this, gap );
+	}
+}
+
 std::string	Device::toString() const
 {
 	std::stringstream stream;
@@ -26,17 +26,51 @@
 #include <phidget21.h>
 #include <assert.h>
 #include <algorithm>
+#include <chrono>
+#include <typeinfo>
 
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
 #include "RPhiSpatial.h"
 #include "RPhiTemperatureSensor.h"
+#include "RPhiSpscQueue.h"
+#include "RPhiTrace.h"
 
 /*
 	Notes
 	- Check for changes in connected devices only once in a while instead of at each update 
+	- In background acquisition mode, the acquisition thread owns mAcquiredDevices while the 
+	  thread calling dispatch() owns mDevices and the listeners. A device is added to mDevices 
+	  when its kConnected event is dispatched and deleted when its kDisconnecting event is. 
+	  The acquisition thread doesn't touch a device anymore once it has queued its 
+	  kDisconnecting event
+	- The changes of a device polled at once are queued all together or not at all, and 
+	  published to the dispatching thread at once (see SpscQueue::push()), so that each batch
+	  dispatched ends with an event flagged as the last one, on which the listeners are 
+	  notified. The connection events are never dropped: the acquisition thread waits until
+	  there's room for them
+	- A device held off (see setHoldOffInUs()) stays in the lists, so it keeps its place and
+	  its listeners, but the polling thread skips it. It's recognized by its serial number
+	  when it comes back, as the Phidget manager may give it another handle
 */
 namespace RPhi
 {
 
+struct DeviceManager::DeviceEvent
+{
+	enum Type
+	{
+		kConnected,
+		kDisconnecting,
+		kChanged
+	};
+
+	Type		mType;
+	Device*		mDevice;
+	bool		mLast;			// For kChanged, whether this is the last record of the batch
+	Record		mRecord;		// For kChanged
+};
+
 /*
 	DeviceManager
 */
@@ -44,22 +78,46 @@ DeviceManager::DeviceManager()
 	: mManagerHandle(NULL),
 	  mIsLocal(true),
 	  mDevices(),
-	  mListeners()
+	  mDeviceContainers(),
+	  mListeners(),
+	  mBatchListeners(),
+	  mChanges(),
+	  mChangeRecords(),
+	  mHoldOffInUs(0),
+	  mAcquiring(false),
+	  mAcquisitionStopRequested(false),
+	  mAcquisitionThreadRunning(false),
+	  mNumDroppedAcquisitionRecords(0),
+	  mAcquiredDevices(),
+	  mDeviceEvents(NULL),
+	  mAcquisitionThread(),
+	  mStatistics()
+{
+}
+
+bool DeviceManager::createPhidgetManager()
 {
 	// To activate logging
 	//ret = CPhidget_enableLogging( PHIDGET_LOG_VERBOSE, "c:\\phidget.log");
 	//assert( ret==EPHIDGET_OK );
 
+	assert( !mManagerHandle );
 	int ret = EPHIDGET_OK;
 	ret = CPhidgetManager_create( &mManagerHandle );
 	assert( ret==EPHIDGET_OK );
 	if ( ret!=EPHIDGET_OK  )
-		return;
+	{
+		mManagerHandle = NULL;
+		return false;
+	}
+	return true;
 }
 
 void DeviceManager::openLocally()
 {
 	mIsLocal = true;
+	if ( !createPhidgetManager() )
+		return;
 	int ret = CPhidgetManager_open( mManagerHandle );
 	assert( ret==EPHIDGET_OK );
 	if ( ret!=EPHIDGET_OK  )
@@ -73,6 +131,8 @@ void DeviceManager::openLocally()
 void DeviceManager::openRemotelyWithServerID( const std::string& serverID, const std::string& password )
 {
 	mIsLocal = false;
+	if ( !createPhidgetManager() )
+		return;
 	int ret = CPhidgetManager_openRemote( mManagerHandle, serverID.c_str(), password.c_str() );
 	assert( ret==EPHIDGET_OK );
 	if ( ret!=EPHIDGET_OK  )
@@ -86,6 +146,8 @@ void DeviceManager::openRemotelyWithServerID( const std::string& serverID, const
 void DeviceManager::openRemotelyWithServerAddress( const std::string& address, int port, const std::string& password )
 {
 	mIsLocal = false;
+	if ( !createPhidgetManager() )
+		return;
 	int ret = CPhidgetManager_openRemoteIP( mManagerHandle, address.c_str(), port, password.c_str() );
 	assert( ret==EPHIDGET_OK );
 	if ( ret!=EPHIDGET_OK  )
@@ -98,12 +160,17 @@ void DeviceManager::openRemotelyWithServerAddress( const std::string& address, i
 
 DeviceManager::~DeviceManager()
 {
+	// The sub-classes must stop the acquisition in their destructor, as the 
+	// acquisition thread calls their virtual methods
+	assert( !isAcquiring() );
+	stopAcquisition();
+
+	Devices	devices = mDevices;		// The copy is on purpose
+	for ( Devices::iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		unregisterDevice( *itr );	
+
 	if ( mManagerHandle )
 	{
-		Devices	devices = mDevices;		// The copy is on purpose
-		for ( Devices::iterator itr=devices.begin(); itr!=devices.end(); ++itr )
-			deleteDevice( (*itr)->getPhidgetHandleFromManager() );	
-
 		int ret = EPHIDGET_OK;
 		ret = CPhidgetManager_close( mManagerHandle );
 		assert( ret==EPHIDGET_OK );
@@ -130,35 +197,150 @@ const char*	DeviceManager::getErrorDescription( int errorCode )
 	return description;
 }
 
+struct DeviceManager::DevicePoller
+{
+	explicit DevicePoller( DeviceManager& deviceManager ) 
+		: mDeviceManager( deviceManager ) 
+	{
+	}
+
+	template<typename T>
+	void operator()( const std::vector<T*>& devices )
+	{
+		mDeviceManager.pollDevices( devices );
+	}
+
+	DeviceManager& mDeviceManager;
+};
+
+// Tells whether a device is exactly of the registered type of its container, and 
+// not of a sub-class (see ReplayDeviceManager, or any manager calling registerDevice())
+struct DeviceManager::ExactTypeChecker
+{
+	explicit ExactTypeChecker( const Device* device ) 
+		: mDevice( device ), mExactType( false ) 
+	{
+	}
+
+	template<typename T>
+	void operator()( const std::vector<T*>& /*devices*/ )
+	{
+		if ( mDevice->getType()==T::kType )
+			mExactType = ( typeid(*mDevice)==typeid(T) );
+	}
+
+	const Device* mDevice;
+	bool mExactType;
+};
+
+template<typename T>
+void DeviceManager::pollDevices( const std::vector<T*>& devices )
+{
+	// The devices exactly of type T don't need the virtual call (see connectDevice())
+	for ( std::size_t i=0; i<devices.size(); ++i )
+	{
+		T* device = devices[i];
+		if ( device->mMissingSinceInUs>=0 )
+			continue;
+		uint64_t numChanges = device->mStatistics.mNumChanges.load( std::memory_order_relaxed );
+		long long startTimeInNs = Clock::getMonotonicTimeInNs();
+		if ( device->mExactType )
+			device->T::update();
+		else
+			device->update();
+		if ( !mBatchListeners.empty() && device->mStatistics.mNumChanges.load( std::memory_order_relaxed )!=numChanges )
+			collectChanges( device, Clock::getTimeInUs() );
+		device->mStatistics.mNumPolls.fetch_add( 1, std::memory_order_relaxed );
+		device->mStatistics.mPollDuration.record( static_cast<uint64_t>( Clock::getMonotonicTimeInNs() - startTimeInNs ) );
+	}
+}
+
 void DeviceManager::update()
 {
-	if ( !mManagerHandle )
+	RPHI_TRACE_SCOPE( "DeviceManager::update" );
+	mStatistics.mNumUpdates.fetch_add( 1, std::memory_order_relaxed );
+	long long startTimeInNs = Clock::getMonotonicTimeInNs();
+
+	// In background acquisition mode, the devices are polled by the acquisition thread
+	if ( isAcquiring() )
+	{
+		dispatch();
+	}
+	else
+	{
+		timedUpdateDeviceList();
+		DevicePoller poller( *this );
+		mDeviceContainers.forEach( poller );
+		notifyBatchListeners();
+	}
+
+	mStatistics.mUpdateDuration.record( static_cast<uint64_t>( Clock::getMonotonicTimeInNs() - startTimeInNs ) );
+}
+
+// Turn the last change of a device into records, with the time of the measure for a Spatial
+void DeviceManager::collectChanges( Device* device, int64_t timeInUs )
+{
+	const Spatial* spatial = deviceCast<Spatial>( device );
+	if ( spatial && spatial->getMeasureTimeInUs()>=0 )
+		timeInUs = spatial->getMeasureTimeInUs();
+
+	mChangeRecords.clear();
+	RecordBuilder::appendMeasures( device, timeInUs, mChangeRecords, device->mLastChangedChannels );
+	for ( std::size_t i=0; i<mChangeRecords.size(); ++i )
+	{
+		Change change;
+		change.mDevice = device;
+		change.mRecord = mChangeRecords[i];
+		mChanges.push_back( change );
+	}
+}
+
+void DeviceManager::notifyBatchListeners()
+{
+	if ( mChanges.empty() )
 		return;
-	
+	BatchListeners batchListeners = mBatchListeners;		// The copy is on purpose here. It allows client code to add/remove listeners
+	for ( BatchListeners::iterator itr=batchListeners.begin(); itr!=batchListeners.end(); ++itr )
+	{
+		RPHI_TRACE_SCOPE_ARG( "BatchListener::onDevicesChanged", "changes", mChanges.size() );
+		(*itr)->onDevicesChanged( this, &mChanges[0], mChanges.size() );
+	}
+	mChanges.clear();
+}
+
+void DeviceManager::timedUpdateDeviceList()
+{
+	RPHI_TRACE_SCOPE( "DeviceManager::updateDeviceList" );
+	long long startTimeInNs = Clock::getMonotonicTimeInNs();
 	updateDeviceList();
-	
-	for ( std::size_t i=0; i<mDevices.size(); ++i )
-		mDevices[i]->update();
+	mStatistics.mUpdateDeviceListDuration.record( static_cast<uint64_t>( Clock::getMonotonicTimeInNs() - startTimeInNs ) );
 }
 
 void DeviceManager::updateDeviceList()
 {
-	assert( mManagerHandle );
+	if ( !mManagerHandle )
+		return;
 	
 	// Get the list of connected Phidget devices
 	int ret = EPHIDGET_OK;
 	CPhidgetHandle* currentDeviceHandles = NULL;
 	int currentDeviceCount = 0;
-	ret = CPhidgetManager_getAttachedDevices( mManagerHandle, &currentDeviceHandles, &currentDeviceCount );
+	{
+		RPHI_TRACE_SCOPE( "CPhidgetManager_getAttachedDevices" );
+		ret = CPhidgetManager_getAttachedDevices( mManagerHandle, &currentDeviceHandles, &currentDeviceCount );
+	}
 	assert( ret==EPHIDGET_OK );
 	if ( ret!=EPHIDGET_OK )
 		return;
 	
+	Devices& devices = getPolledDevices();
+
 	// Identify the devices to delete
+	int64_t timeInUs = Clock::getTimeInUs();
 	std::vector<CPhidgetHandle> devicesToDelete;
-	for ( std::size_t i=0; i<mDevices.size(); ++i )
+	for ( std::size_t i=0; i<devices.size(); ++i )
 	{
-		CPhidgetHandle existingDeviceHandle = mDevices[i]->getPhidgetHandleFromManager();
+		CPhidgetHandle existingDeviceHandle = devices[i]->getPhidgetHandleFromManager();
 		bool foundInCurrentDevices = false;
 		for ( int j=0; j<currentDeviceCount; ++j )
 		{
@@ -168,8 +350,18 @@ void DeviceManager::updateDeviceList()
 				break;
 			}
 		}
-		if ( !foundInCurrentDevices )
+		if ( foundInCurrentDevices )
+		{
+			if ( devices[i]->mMissingSinceInUs>=0 )
+			{
+				devices[i]->mMissingSinceInUs = -1;
+				mStatistics.mNumReattachments.fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+		else if ( !isHeldOff( devices[i], timeInUs ) )
+		{
 			devicesToDelete.push_back( existingDeviceHandle );
+		}
 	}
 
 	// Identify the devices to add
@@ -178,9 +370,9 @@ void DeviceManager::updateDeviceList()
 	{
 		CPhidgetHandle currentDeviceHandle = currentDeviceHandles[i];
 		bool foundInExistingDevices = false;
-		for ( std::size_t j=0; j<mDevices.size(); ++j )
+		for ( std::size_t j=0; j<devices.size(); ++j )
 		{
-			if ( mDevices[j]->getPhidgetHandleFromManager()==currentDeviceHandle )
+			if ( devices[j]->getPhidgetHandleFromManager()==currentDeviceHandle )
 			{
 				foundInExistingDevices = true;
 				break;
@@ -194,50 +386,32 @@ void DeviceManager::updateDeviceList()
 	for ( std::size_t i=0; i<devicesToDelete.size(); ++i )
 		deleteDevice( devicesToDelete[i] );
 	
-	// Add new devices
+	// Add new devices, unless they're devices held off coming back
 	for ( std::size_t i=0; i<devicesToAdd.size(); ++i )
-		addDevice( devicesToAdd[i] );	
+	{
+		if ( !reattachDevice( devicesToAdd[i] ) )
+			addDevice( devicesToAdd[i] );	
+	}
 
 	// Free device list
 	ret = CPhidgetManager_freeAttachedDevicesArray( currentDeviceHandles );
 	assert( ret==EPHIDGET_OK );		
 }
 
-CPhidgetHandle DeviceManager::createDeviceSpecificHandle( int deviceID )
+template<typename T, typename... Rest>
+CPhidgetHandle DeviceManager::createDeviceSpecificHandle( int deviceID, DeviceTypeList<T, Rest...> )
 {
-	int ret = EPHIDGET_OK;
-	CPhidgetHandle result = NULL;
-	switch ( deviceID )
-	{
-		case PHIDID_SPATIAL_ACCEL_GYRO_COMPASS : 
-			ret = CPhidgetSpatial_create( reinterpret_cast<CPhidgetSpatialHandle*>(&result) );
-			assert( ret==EPHIDGET_OK );
-			break;
-		case PHIDID_TEMPERATURESENSOR : 
-			ret = CPhidgetTemperatureSensor_create( reinterpret_cast<CPhidgetTemperatureSensorHandle*>(&result) );
-			assert( ret==EPHIDGET_OK );
-			break;
-		default:
-			break;
-	}
-	return result;
+	if ( T::isPhidgetDeviceID( deviceID ) )
+		return T::createPhidgetHandle();
+	return createDeviceSpecificHandle( deviceID, DeviceTypeList<Rest...>() );
 }
 
-Device* DeviceManager::createDevice( int deviceID, CPhidgetHandle deviceSpecificHandle )
+template<typename T, typename... Rest>
+Device* DeviceManager::createDevice( int deviceID, CPhidgetHandle deviceSpecificHandle, DeviceTypeList<T, Rest...> )
 {
-	Device* result = NULL;
-	switch ( deviceID )
-	{
-		case PHIDID_SPATIAL_ACCEL_GYRO_COMPASS : 
-			result = new Spatial( deviceSpecificHandle );
-			break;
-		case PHIDID_TEMPERATURESENSOR : 
-			result = new TemperatureSensor( deviceSpecificHandle );
-			break;
-		default:
-			break;
-	}
-	return result;
+	if ( T::isPhidgetDeviceID( deviceID ) )
+		return new T( deviceSpecificHandle );
+	return createDevice( deviceID, deviceSpecificHandle, DeviceTypeList<Rest...>() );
 }
 
 void DeviceManager::addDevice( CPhidgetHandle phidgetHandle )
@@ -258,7 +432,7 @@ void DeviceManager::addDevice( CPhidgetHandle phidgetHandle )
 		return;
  	
 	// Create a handle specific to the type of Phidget and return it as a generic one
-	CPhidgetHandle deviceSpecificHandle = createDeviceSpecificHandle( deviceID );
+	CPhidgetHandle deviceSpecificHandle = createDeviceSpecificHandle( deviceID, DeviceTypes() );
 	if ( !deviceSpecificHandle )
 		return;
 
@@ -270,7 +444,7 @@ void DeviceManager::addDevice( CPhidgetHandle phidgetHandle )
 	assert( ret==EPHIDGET_OK );
 
 	// Now everything is in place for the Device object to be created
-	Device* device = createDevice( deviceID, deviceSpecificHandle );
+	Device* device = createDevice( deviceID, deviceSpecificHandle, DeviceTypes() );
 	if ( !device )
 		return;
 
@@ -278,36 +452,147 @@ void DeviceManager::addDevice( CPhidgetHandle phidgetHandle )
 	device->setPhidgetHandleFromManager( phidgetHandle );
 		
 	// Add the newly created device
-	mDevices.push_back( device );
-		
-	// Notify
-	Listeners listeners = mListeners;		// The copy is on purpose here. It allows client code to add/remove listeners
-	for ( Listeners::iterator itr=listeners.begin(); itr!=listeners.end(); ++itr )
-		(*itr)->onDeviceConnected( this, device );
+	registerDevice( device );
+}
+
+// Whether a device missing from the Phidget manager is still within its hold-off period
+bool DeviceManager::isHeldOff( Device* device, int64_t timeInUs )
+{
+	int64_t holdOffInUs = mHoldOffInUs;
+	if ( holdOffInUs<=0 )
+		return false;
+	if ( device->mMissingSinceInUs<0 )
+		device->mMissingSinceInUs = timeInUs;
+	return timeInUs - device->mMissingSinceInUs < holdOffInUs;
+}
+
+// Hand a device coming back during its hold-off period over to its existing Device.
+// The handle of the Device was opened with the serial number, so the Phidget 
+// library attaches it again by itself
+bool DeviceManager::reattachDevice( CPhidgetHandle phidgetHandle )
+{
+	Devices& devices = getPolledDevices();
+	Devices::iterator itr = devices.begin();
+	while ( itr!=devices.end() && (*itr)->mMissingSinceInUs<0 )
+		++itr;
+	if ( itr==devices.end() )
+		return false;
+
+	int serialNumber = 0;
+	int ret = CPhidget_getSerialNumber( phidgetHandle, &serialNumber );
+	if ( ret!=EPHIDGET_OK )
+		return false;
+	for ( ; itr!=devices.end(); ++itr )
+	{
+		Device* device = *itr;
+		if ( device->mMissingSinceInUs<0 || device->getSerialNumber()!=serialNumber )
+			continue;
+		device->setPhidgetHandleFromManager( phidgetHandle );
+		device->mMissingSinceInUs = -1;
+		mStatistics.mNumReattachments.fetch_add( 1, std::memory_order_relaxed );
+		return true;
+	}
+	return false;
 }
 
 void DeviceManager::deleteDevice( CPhidgetHandle phidgetHandle )
 {
 	// Find the Device corresponding to the manager Phidget handle
+	Devices& devices = getPolledDevices();
 	Devices::iterator itr;
-	for ( itr=mDevices.begin(); itr!=mDevices.end(); ++itr )
+	for ( itr=devices.begin(); itr!=devices.end(); ++itr )
 	{
 		if ( (*itr)->getPhidgetHandleFromManager()==phidgetHandle )
 			break;
 	}
 
+	assert( itr!=devices.end() );
+	if ( itr==devices.end() )
+		return;
+	
+	unregisterDevice( *itr );
+}
+
+void DeviceManager::registerDevice( Device* device )
+{
+	assert( device );
+	if ( !isAcquiring() )
+	{
+		connectDevice( device );
+		return;
+	}
+
+	// Called from the acquisition thread: the device is handed over to the dispatching thread
+	mAcquiredDevices.push_back( device );
+	DeviceEvent event = DeviceEvent();
+	event.mType = DeviceEvent::kConnected;
+	event.mDevice = device;
+	pushDeviceEvent( event );
+}
+
+void DeviceManager::unregisterDevice( Device* device )
+{
+	if ( !isAcquiring() )
+	{
+		disconnectDevice( device );
+		return;
+	}
+
+	// Called from the acquisition thread: the dispatching thread deletes the device
+	Devices::iterator itr = std::find( mAcquiredDevices.begin(), mAcquiredDevices.end(), device );
+	assert( itr!=mAcquiredDevices.end() );
+	if ( itr==mAcquiredDevices.end() )
+		return;
+	mAcquiredDevices.erase( itr );
+	DeviceEvent event = DeviceEvent();
+	event.mType = DeviceEvent::kDisconnecting;
+	event.mDevice = device;
+	pushDeviceEvent( event );
+}
+
+void DeviceManager::connectDevice( Device* device )
+{
+	assert( device );
+	ExactTypeChecker checker( device );
+	mDeviceContainers.forEach( checker );
+	device->mExactType = checker.mExactType;
+	mDevices.push_back( device );
+	mDeviceContainers.add( device );
+	mStatistics.mNumConnections.fetch_add( 1, std::memory_order_relaxed );
+		
+	// Notify
+	Listeners listeners = mListeners;		// The copy is on purpose here. It allows client code to add/remove listeners
+	for ( Listeners::iterator itr=listeners.begin(); itr!=listeners.end(); ++itr )
+	{
+		RPHI_TRACE_SCOPE_ARG( "Listener::onDeviceConnected", "serial", device->getSerialNumber() );
+		(*itr)->onDeviceConnected( this, device );
+	}
+}
+
+void DeviceManager::disconnectDevice( Device* device )
+{
+	Devices::iterator itr = std::find( mDevices.begin(), mDevices.end(), device );
 	assert( itr!=mDevices.end() );
 	if ( itr==mDevices.end() )
 		return;
-	Device* device = *itr;
+	mStatistics.mNumDisconnections.fetch_add( 1, std::memory_order_relaxed );
 	
 	// Notify 
 	Listeners listeners = mListeners;		// The copy is on purpose here. It allows client code to add/remove listeners
 	for ( Listeners::iterator itrListener=listeners.begin(); itrListener!=listeners.end(); ++itrListener )
+	{
+		RPHI_TRACE_SCOPE_ARG( "Listener::onDeviceDisconnecting", "serial", device->getSerialNumber() );
 		(*itrListener)->onDeviceDisconnecting( this, device );
+	}
 		
-	// Delete the device
+	// Delete the device, and its changes not handed to the batch listeners yet
 	mDevices.erase( itr );
+	mDeviceContainers.remove( device );
+	for ( std::size_t i=mChanges.size(); i>0; --i )
+	{
+		if ( mChanges[i-1].mDevice==device )
+			mChanges.erase( mChanges.begin() + (i-1) );
+	}
 	delete device;
 	device = NULL;
 }
@@ -327,4 +612,193 @@ bool DeviceManager::removeListener( Listener* listener )
 	return true;
 }
 
-}
\ No newline at end of file
+void DeviceManager::addBatchListener( BatchListener* batchListener )
+{
+	assert(batchListener);
+	mBatchListeners.push_back(batchListener);
+}
+
+bool DeviceManager::removeBatchListener( BatchListener* batchListener )
+{
+	BatchListeners::iterator itr = std::find( mBatchListeners.begin(), mBatchListeners.end(), batchListener );
+	if ( itr==mBatchListeners.end() )
+		return false;
+	mBatchListeners.erase( itr );
+	if ( mBatchListeners.empty() )
+		mChanges.clear();
+	return true;
+}
+
+bool DeviceManager::startAcquisition( int intervalInUs, std::size_t queueCapacity )
+{
+	if ( isAcquiring() )
+		return true;
+
+	// The devices must be backed by a Phidget manager 
+	if ( !mManagerHandle )
+		return false;
+
+	assert( intervalInUs>=0 );
+	assert( queueCapacity>0 );
+	mDeviceEvents = new SpscQueue<DeviceEvent>( queueCapacity );
+	mAcquiredDevices = mDevices;
+	mAcquisitionStopRequested = false;
+	mAcquisitionThreadRunning = true;
+	mAcquiring = true;
+	mAcquisitionThread = std::thread( &DeviceManager::acquisitionThreadMain, this, intervalInUs );
+	return true;
+}
+
+void DeviceManager::stopAcquisition()
+{
+	if ( !isAcquiring() )
+		return;
+
+	// Keep dispatching while the acquisition thread stops, in case it waits for room 
+	// in the queue to push a connection event
+	mAcquisitionStopRequested = true;
+	while ( mAcquisitionThreadRunning )
+	{
+		dispatch();
+		std::this_thread::yield();
+	}
+	mAcquisitionThread.join();
+	
+	// Dispatch what's left. This brings mDevices in line with mAcquiredDevices
+	while ( dispatch()>0 )
+	{
+	}
+	assert( mDevices==mAcquiredDevices );
+	mAcquiredDevices.clear();
+	mAcquiring = false;
+
+	delete mDeviceEvents;
+	mDeviceEvents = NULL;
+}
+
+std::size_t DeviceManager::dispatch()
+{
+	if ( !mDeviceEvents )
+		return 0;
+	RPHI_TRACE_SCOPE( "DeviceManager::dispatch" );
+
+	// Let the acquisition thread know which channels to poll
+	for ( std::size_t i=0; i<mDevices.size(); ++i )
+	{
+		Device* device = mDevices[i];
+		Device::ChannelMask polledChannels = device->getPolledChannels();
+		device->mAcquisitionPolledChannels.store( polledChannels, std::memory_order_relaxed );
+		device->setStaleChannels( ~polledChannels );
+	}
+
+	// Only dispatch the events already queued, so that a fast acquisition thread 
+	// can't keep the caller here forever
+	std::size_t numEvents = mDeviceEvents->getSize();
+	Device::ChannelMask changedChannels = 0;
+	DeviceEvent event;
+	for ( std::size_t i=0; i<numEvents; ++i )
+	{
+		bool popped = mDeviceEvents->pop( event );
+		assert( popped );
+		if ( !popped )
+			return i;
+
+		switch ( event.mType )
+		{
+			case DeviceEvent::kConnected:
+				connectDevice( event.mDevice );
+				break;
+
+			case DeviceEvent::kDisconnecting:
+				disconnectDevice( event.mDevice );
+				break;
+
+			case DeviceEvent::kChanged:
+			{
+				Device::ChannelMask recordChangedChannels = event.mDevice->applyRecord( event.mRecord );
+				changedChannels |= recordChangedChannels;
+				if ( recordChangedChannels && !mBatchListeners.empty() )
+				{
+					Change change;
+					change.mDevice = event.mDevice;
+					change.mRecord = event.mRecord;
+					mChanges.push_back( change );
+				}
+				if ( event.mLast )
+				{
+					int64_t sampleAgeInUs = Clock::getTimeInUs() - event.mRecord.mTimeInUs;
+					if ( sampleAgeInUs>=0 )
+						event.mDevice->mStatistics.mSampleAge.record( static_cast<uint64_t>(sampleAgeInUs) * 1000 );
+					if ( changedChannels )
+						event.mDevice->notifyDeviceChanged( changedChannels );
+					changedChannels = 0;
+				}
+			}
+			break;
+		}
+	}
+	notifyBatchListeners();
+	return numEvents;
+}
+
+void DeviceManager::pushDeviceEvent( const DeviceEvent& event )
+{
+	while ( !mDeviceEvents->push( event ) )
+		std::this_thread::sleep_for( std::chrono::microseconds(100) );
+}
+
+void DeviceManager::acquisitionThreadMain( int intervalInUs )
+{
+	RPHI_TRACE_THREAD_NAME( "RapaPhidget acquisition" );
+	std::vector<Record> records;
+	std::vector<DeviceEvent> events;
+	while ( !mAcquisitionStopRequested )
+	{
+		acquireDevices( records, events );
+		std::this_thread::sleep_for( std::chrono::microseconds(intervalInUs) );
+	}
+	mAcquisitionThreadRunning = false;
+}
+
+void DeviceManager::acquireDevices( std::vector<Record>& records, std::vector<DeviceEvent>& events )
+{
+	RPHI_TRACE_SCOPE( "DeviceManager::acquire" );
+	timedUpdateDeviceList();
+	
+	int64_t timeInUs = Clock::getTimeInUs();
+	for ( std::size_t i=0; i<mAcquiredDevices.size(); ++i )
+	{
+		Device* device = mAcquiredDevices[i];
+		if ( device->mMissingSinceInUs>=0 )
+			continue;
+		records.clear();
+		long long startTimeInNs = Clock::getMonotonicTimeInNs();
+		device->acquire( device->mAcquisitionPolledChannels.load( std::memory_order_relaxed ), device->mAcquisitionResync, timeInUs, records );
+		device->mStatistics.mNumPolls.fetch_add( 1, std::memory_order_relaxed );
+		device->mStatistics.mPollDuration.record( static_cast<uint64_t>( Clock::getMonotonicTimeInNs() - startTimeInNs ) );
+		device->mAcquisitionResync = false;
+		if ( records.empty() )
+			continue;
+		
+		DeviceEvent event = DeviceEvent();
+		event.mType = DeviceEvent::kChanged;
+		event.mDevice = device;
+		events.clear();
+		for ( std::size_t j=0; j<records.size(); ++j )
+		{
+			event.mLast = ( j+1==records.size() );
+			event.mRecord = records[j];
+			events.push_back( event );
+		}
+
+		// The batch is published at once, so that dispatch() never sees part of it.
+		// It's dropped as a whole if it doesn't fit
+		if ( !mDeviceEvents->push( &events[0], events.size() ) )
+		{
+			mNumDroppedAcquisitionRecords += records.size();
+			device->mAcquisitionResync = true;
+		}
+	}
+}
+
+}
@@ -0,0 +1,604 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiFlightRecorder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <chrono>
+#include <map>
+
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+
+#if _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+/*
+	Notes
+	- The CRC-32 is the one of zlib and Ethernet (reflected polynomial 0xEDB88320),
+	  computed 8 bytes at a time with the slicing-by-8 tables, so that checksumming
+	  an entry costs about as much as copying it
+	- The entries are written in place with no ordering between the writes: the 
+	  checksum is what tells a complete entry from a partial one, whichever part of
+	  it reached the file
+	- Scanning the file for its last record when carrying on an existing recording
+	  reads every entry once, at construction
+*/
+namespace RPhi
+{
+
+namespace
+{
+	struct Crc32Tables
+	{
+		Crc32Tables()
+		{
+			for ( uint32_t i=0; i<256; ++i )
+			{
+				uint32_t crc = i;
+				for ( int bit=0; bit<8; ++bit )
+					crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+				mTables[0][i] = crc;
+			}
+			for ( uint32_t i=0; i<256; ++i )
+				for ( int slice=1; slice<8; ++slice )
+					mTables[slice][i] = (mTables[slice-1][i] >> 8) ^ mTables[0][ mTables[slice-1][i] & 0xff ];
+		}
+
+		uint32_t	mTables[8][256];
+	};
+
+	uint32_t updateCrc32( uint32_t crc, const void* data, std::size_t size )
+	{
+		static const Crc32Tables tables;
+		const uint32_t (*t)[256] = tables.mTables;
+		const uint8_t* bytes = static_cast<const uint8_t*>( data );
+		crc = ~crc;
+		while ( size>=8 )
+		{
+			uint32_t low;
+			uint32_t high;
+			memcpy( &low, bytes, 4 );
+			memcpy( &high, bytes+4, 4 );
+			low ^= crc;
+			crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+				  t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+			bytes += 8;
+			size -= 8;
+		}
+		while ( size-- )
+			crc = t[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	bool isValidEntry( const FlightRecordingEntry& entry, std::size_t index, std::size_t numEntries )
+	{
+		return entry.mSequence!=0 &&
+			   (entry.mSequence-1) % numEntries==index &&
+			   entry.mChecksum==FlightRecorder::computeChecksum( entry );
+	}
+
+	bool isDescriptionRecord( const Record& record )
+	{
+		switch ( record.mKind )
+		{
+			case Record::kDeviceName:
+			case Record::kDeviceTypeName:
+			case Record::kSpatialMinMeasure:
+			case Record::kSpatialMaxMeasure:
+			case Record::kThermocoupleInfo:
+				return true;
+		}
+		return false;
+	}
+}
+
+/*
+	FlightRecorder::Recovery
+*/
+FlightRecorder::Recovery::Recovery()
+	: mRecords(),
+	  mFirstSequence(0),
+	  mLastSequence(0),
+	  mNumLostRecords(0),
+	  mNumDroppedRecords(0)
+{
+}
+
+bool FlightRecorder::Recovery::write( const std::string& filename ) const
+{
+	FILE* file = fopen( filename.c_str(), "wb" );
+	if ( !file )
+		return false;
+
+	RecordingHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.mMagic, kRecordingMagic, sizeof(header.mMagic) );
+	header.mVersion = kRecordingVersion;
+	header.mRecordSize = sizeof(Record);
+	header.mStartTimeInUs = mRecords.empty() ? 0 : mRecords.front().mTimeInUs;
+
+	bool written = fwrite( &header, sizeof(header), 1, file )==1 &&
+				   ( mRecords.empty() || fwrite( &mRecords[0], sizeof(Record), mRecords.size(), file )==mRecords.size() );
+	written = ( fclose( file )==0 ) && written;
+	return written;
+}
+
+/*
+	FlightRecorder
+*/
+const std::size_t FlightRecorder::kDefaultNumEntries;
+
+FlightRecorder::FlightRecorder( DeviceManager* deviceManager, const std::string& filename, std::size_t numEntries )
+	: mDeviceManager(deviceManager),
+	  mFilename(filename),
+	  mNumEntries(numEntries),
+	  mFileHandle(NULL),
+	  mMappingHandle(NULL),
+	  mData(NULL),
+	  mSize(0),
+	  mHeader(NULL),
+	  mEntries(NULL),
+	  mNextSequence(1),
+	  mNextDescriptionSequence(1),
+	  mDevices(),
+	  mRecords(),
+	  mSyncIntervalInMs(1000),
+	  mStopRequested(false),
+	  mMutex(),
+	  mCondition(),
+	  mSyncThread()
+{
+	assert( mDeviceManager );
+	assert( mNumEntries>0 );
+	
+	bool opened = open();
+	assert( opened );
+	if ( !opened )
+		return;
+
+	mRecords.reserve( 64 );
+	mSyncThread = std::thread( &FlightRecorder::syncThreadMain, this );
+
+	// Record the devices already there and start listening
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	if ( !mHeader )
+		return;
+
+	mDeviceManager->removeListener( this );
+	for ( Devices::iterator itr=mDevices.begin(); itr!=mDevices.end(); ++itr )
+		const_cast<Device*>(*itr)->removeListener( this );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStopRequested = true;
+	}
+	mCondition.notify_all();
+	mSyncThread.join();
+
+	flushMapping();
+	close();
+}
+
+bool FlightRecorder::open()
+{
+	mSize = sizeof(FlightRecordingHeader) + mNumEntries * sizeof(FlightRecordingEntry);
+
+	// Map the whole file in memory, resized if needed. The part added to a file is zero-filled
+#if _WIN32
+	HANDLE fileHandle = CreateFileA( mFilename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( fileHandle==INVALID_HANDLE_VALUE )
+		return false;
+	mFileHandle = fileHandle;
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( fileHandle, &fileSize ) )
+	{
+		close();
+		return false;
+	}
+	if ( fileSize.QuadPart!=static_cast<LONGLONG>(mSize) )
+	{
+		LARGE_INTEGER position;
+		position.QuadPart = 0;
+		bool resized = SetFilePointerEx( fileHandle, position, NULL, FILE_BEGIN ) && SetEndOfFile( fileHandle );
+		position.QuadPart = static_cast<LONGLONG>( mSize );
+		resized = resized && SetFilePointerEx( fileHandle, position, NULL, FILE_BEGIN ) && SetEndOfFile( fileHandle );
+		if ( !resized )
+		{
+			close();
+			return false;
+		}
+	}
+	mMappingHandle = CreateFileMappingA( fileHandle, NULL, PAGE_READWRITE, 0, 0, NULL );
+	if ( mMappingHandle )
+		mData = MapViewOfFile( mMappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, mSize );
+#else
+	int fd = ::open( mFilename.c_str(), O_RDWR | O_CREAT, 0644 );
+	if ( fd<0 )
+		return false;
+	struct stat fileStat;
+	bool sized = fstat( fd, &fileStat )==0;
+	if ( sized && fileStat.st_size!=static_cast<off_t>(mSize) )
+		sized = ftruncate( fd, 0 )==0 && ftruncate( fd, static_cast<off_t>(mSize) )==0;
+	if ( sized )
+	{
+		void* data = mmap( NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if ( data!=MAP_FAILED )
+			mData = data;
+	}
+	::close( fd );		// The mapping stays valid after the file descriptor is closed
+#endif
+	if ( !mData )
+	{
+		close();
+		return false;
+	}
+
+	FlightRecordingHeader* header = static_cast<FlightRecordingHeader*>( mData );
+	mEntries = reinterpret_cast<FlightRecordingEntry*>( static_cast<char*>(mData) + sizeof(FlightRecordingHeader) );
+	if ( memcmp( header->mMagic, kFlightRecordingMagic, sizeof(header->mMagic) )==0 &&
+		 header->mVersion==kFlightRecordingVersion &&
+		 header->mEntrySize==sizeof(FlightRecordingEntry) &&
+		 header->mNumEntries==mNumEntries )
+	{
+		// Carry on after the last record of the file
+		for ( std::size_t i=0; i<mNumEntries; ++i )
+		{
+			const FlightRecordingEntry& entry = mEntries[i];
+			if ( entry.mSequence>=mNextSequence && isValidEntry( entry, i, mNumEntries ) )
+				mNextSequence = entry.mSequence + 1;
+		}
+	}
+	else
+	{
+		// Start a new recording. The magic is written last, once the rest is in place
+		memset( mData, 0, mSize );
+		header->mVersion = kFlightRecordingVersion;
+		header->mEntrySize = sizeof(FlightRecordingEntry);
+		header->mNumEntries = mNumEntries;
+		header->mCreationTimeInUs = Clock::getTimeInUs();
+		memcpy( header->mMagic, kFlightRecordingMagic, sizeof(header->mMagic) );
+	}
+	mHeader = header;
+
+	// The devices get described as they are connected
+	mNextDescriptionSequence = mNextSequence + getDescriptionInterval();
+	return true;
+}
+
+void FlightRecorder::close()
+{
+#if _WIN32
+	if ( mData )
+		UnmapViewOfFile( mData );
+	if ( mMappingHandle )
+		CloseHandle( mMappingHandle );
+	if ( mFileHandle )
+		CloseHandle( mFileHandle );
+#else
+	if ( mData )
+		munmap( mData, mSize );
+#endif
+	mFileHandle = NULL;
+	mMappingHandle = NULL;
+	mData = NULL;
+	mHeader = NULL;
+	mEntries = NULL;
+}
+
+bool FlightRecorder::flushMapping()
+{
+	if ( !mData )
+		return false;
+#if _WIN32
+	return FlushViewOfFile( mData, 0 ) && FlushFileBuffers( mFileHandle );
+#else
+	return msync( mData, mSize, MS_SYNC )==0;
+#endif
+}
+
+uint64_t FlightRecorder::getDescriptionInterval() const
+{
+	return mNumEntries>=4 ? mNumEntries / 4 : 1;
+}
+
+void FlightRecorder::sync()
+{
+	flushMapping();
+}
+
+void FlightRecorder::setSyncIntervalInMs( int syncIntervalInMs )
+{
+	assert( syncIntervalInMs>=0 );
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mSyncIntervalInMs = syncIntervalInMs;
+	}
+	mCondition.notify_all();
+}
+
+int FlightRecorder::getSyncIntervalInMs() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mSyncIntervalInMs;
+}
+
+uint32_t FlightRecorder::computeChecksum( const FlightRecordingEntry& entry )
+{
+	uint32_t crc = updateCrc32( 0, &entry.mSequence, sizeof(entry.mSequence) );
+	return updateCrc32( crc, &entry.mRecord, sizeof(entry.mRecord) );
+}
+
+void FlightRecorder::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	if ( !mHeader )
+		return;
+	mDevices.push_back( device );
+	mRecords.clear();
+	RecordBuilder::appendDeviceDescription( device, Clock::getTimeInUs(), mRecords );
+	writeRecords();
+	device->addListener( this );
+}
+
+void FlightRecorder::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	if ( !mHeader )
+		return;
+	device->removeListener( this );
+	for ( Devices::iterator itr=mDevices.begin(); itr!=mDevices.end(); ++itr )
+	{
+		if ( *itr==device )
+		{
+			mDevices.erase( itr );
+			break;
+		}
+	}
+	mRecords.clear();
+	RecordBuilder::appendRecord( mRecords, Record::kDeviceDetached, device->getSerialNumber(), Clock::getTimeInUs() );
+	writeRecords();
+}
+
+void FlightRecorder::onDeviceChanged( Device* device )
+{
+	int64_t timeInUs = Clock::getTimeInUs();
+	mRecords.clear();
+	if ( mNextSequence>=mNextDescriptionSequence )
+	{
+		// Describe the devices again before their previous descriptions get overwritten
+		for ( Devices::const_iterator itr=mDevices.begin(); itr!=mDevices.end(); ++itr )
+			RecordBuilder::appendDeviceDescription( *itr, timeInUs, mRecords );
+		mNextDescriptionSequence = mNextSequence + mRecords.size() + getDescriptionInterval();
+	}
+	RecordBuilder::appendMeasures( device, timeInUs, mRecords );
+	writeRecords();
+}
+
+void FlightRecorder::writeRecords()
+{
+	for ( std::size_t i=0; i<mRecords.size(); ++i )
+	{
+		FlightRecordingEntry& entry = mEntries[ (mNextSequence-1) % mNumEntries ];
+		entry.mSequence = mNextSequence;
+		entry.mPadding = 0;
+		memcpy( &entry.mRecord, &mRecords[i], sizeof(Record) );
+		entry.mChecksum = computeChecksum( entry );
+		++mNextSequence;
+	}
+}
+
+void FlightRecorder::syncThreadMain()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	while ( !mStopRequested )
+	{
+		if ( mSyncIntervalInMs==0 )
+		{
+			mCondition.wait( lock );
+			continue;
+		}
+		if ( mCondition.wait_for( lock, std::chrono::milliseconds(mSyncIntervalInMs) )==std::cv_status::timeout )
+		{
+			lock.unlock();
+			flushMapping();
+			lock.lock();
+		}
+	}
+}
+
+bool FlightRecorder::recover( const std::string& filename, int64_t durationInUs, Recovery& recovery )
+{
+	recovery = Recovery();
+	FILE* file = fopen( filename.c_str(), "rb" );
+	if ( !file )
+		return false;
+
+	FlightRecordingHeader header;
+	if ( fread( &header, sizeof(header), 1, file )!=1 ||
+		 memcmp( header.mMagic, kFlightRecordingMagic, sizeof(header.mMagic) )!=0 ||
+		 header.mVersion!=kFlightRecordingVersion ||
+		 header.mEntrySize!=sizeof(FlightRecordingEntry) ||
+		 header.mNumEntries==0 )
+	{
+		fclose( file );
+		return false;
+	}
+
+	// A file cut short is read as far as it goes
+	std::size_t numEntries = static_cast<std::size_t>( header.mNumEntries );
+	std::vector<FlightRecordingEntry> entries( numEntries );
+	std::size_t numRead = fread( &entries[0], sizeof(FlightRecordingEntry), numEntries, file );
+	fclose( file );
+	memset( &entries[0] + numRead, 0, (numEntries - numRead) * sizeof(FlightRecordingEntry) );
+
+	// Find the last record and put the records in sequence order
+	uint64_t lastSequence = 0;
+	for ( std::size_t i=0; i<numEntries; ++i )
+	{
+		if ( entries[i].mSequence>lastSequence && isValidEntry( entries[i], i, numEntries ) )
+			lastSequence = entries[i].mSequence;
+	}
+	if ( lastSequence==0 )
+		return true;
+	uint64_t firstSequence = lastSequence>numEntries ? lastSequence - numEntries + 1 : 1;
+	std::vector<const Record*> records;
+	records.reserve( numEntries );
+	for ( uint64_t sequence=firstSequence; sequence<=lastSequence; ++sequence )
+	{
+		std::size_t index = static_cast<std::size_t>( (sequence-1) % numEntries );
+		const FlightRecordingEntry& entry = entries[index];
+		if ( entry.mSequence==sequence && isValidEntry( entry, index, numEntries ) )
+			records.push_back( &entry.mRecord );
+		else
+			recovery.mNumLostRecords++;
+	}
+	recovery.mFirstSequence = firstSequence;
+	recovery.mLastSequence = lastSequence;
+	
+	// Keep the window before the last record, with each device described once, before its measures
+	struct DeviceState
+	{
+		DeviceState() : mDescription(), mDescribing(false), mAttached(false), mPassing(false) {}
+		std::vector<Record>	mDescription;		// The last complete or ongoing description
+		bool				mDescribing;		// The description records of the device are coming
+		bool				mAttached;			// In the recovered records
+		bool				mPassing;			// The description records coming are recovered
+	};
+	typedef std::map<int, DeviceState> DeviceStates;
+	DeviceStates states;
+
+	// The measures at the start of the file may have lost the description of 
+	// their device to the circular buffer: the first description written after
+	// them stands in for it
+	typedef std::map<int, std::vector<Record> > Descriptions;
+	Descriptions firstDescriptions;
+	for ( std::size_t i=0; i<records.size(); ++i )
+	{
+		const Record& record = *records[i];
+		DeviceState& state = states[record.mSerialNumber];
+		if ( record.mKind==Record::kDeviceAttached )
+		{
+			state.mDescribing = firstDescriptions.find( record.mSerialNumber )==firstDescriptions.end();
+			if ( state.mDescribing )
+				firstDescriptions[record.mSerialNumber].push_back( record );
+		}
+		else if ( isDescriptionRecord(record) )
+		{
+			if ( state.mDescribing )
+				firstDescriptions[record.mSerialNumber].push_back( record );
+		}
+		else
+		{
+			state.mDescribing = false;
+		}
+	}
+	states.clear();
+
+	int64_t startTimeInUs = records.back()->mTimeInUs - durationInUs;
+	bool inWindow = false;
+	for ( std::size_t i=0; i<records.size(); ++i )
+	{
+		const Record& record = *records[i];
+		if ( !inWindow && ( durationInUs<=0 || record.mTimeInUs>=startTimeInUs ) )
+		{
+			// Describe the devices attached at the start of the window
+			inWindow = true;
+			for ( DeviceStates::iterator itr=states.begin(); itr!=states.end(); ++itr )
+			{
+				DeviceState& state = itr->second;
+				for ( std::size_t j=0; j<state.mDescription.size(); ++j )
+				{
+					recovery.mRecords.push_back( state.mDescription[j] );
+					recovery.mRecords.back().mTimeInUs = record.mTimeInUs;
+				}
+				state.mAttached = !state.mDescription.empty();
+				state.mPassing = state.mAttached && state.mDescribing;
+			}
+		}
+
+		DeviceState& state = states[record.mSerialNumber];
+		if ( record.mKind==Record::kDeviceAttached )
+		{
+			state.mDescription.assign( 1, record );
+			state.mDescribing = true;
+			state.mPassing = inWindow && !state.mAttached;
+			if ( state.mPassing )
+			{
+				recovery.mRecords.push_back( record );
+				state.mAttached = true;
+			}
+		}
+		else if ( isDescriptionRecord(record) )
+		{
+			if ( state.mDescribing )
+				state.mDescription.push_back( record );
+			if ( state.mPassing )
+				recovery.mRecords.push_back( record );
+		}
+		else 
+		{
+			state.mDescribing = false;
+			state.mPassing = false;
+			if ( record.mKind==Record::kDeviceDetached )
+				state.mDescription.clear();
+			if ( !inWindow )
+				continue;
+			if ( !state.mAttached && record.mKind!=Record::kDeviceDetached )
+			{
+				Descriptions::const_iterator itr = firstDescriptions.find( record.mSerialNumber );
+				if ( itr!=firstDescriptions.end() )
+				{
+					for ( std::size_t j=0; j<itr->second.size(); ++j )
+					{
+						recovery.mRecords.push_back( itr->second[j] );
+						recovery.mRecords.back().mTimeInUs = record.mTimeInUs;
+					}
+					state.mAttached = true;
+				}
+			}
+			if ( state.mAttached )
+				recovery.mRecords.push_back( record );
+			else
+				recovery.mNumDroppedRecords++;
+			if ( record.mKind==Record::kDeviceDetached )
+				state.mAttached = false;
+		}
+	}
+	return true;
+}
+
+}
@@ -35,6 +35,12 @@ LocalDeviceManager::LocalDeviceManager()
 	openLocally();
 }
 
+LocalDeviceManager::~LocalDeviceManager()
+{
+	// The acquisition thread calls openDevice()
+	stopAcquisition();
+}
+
 void LocalDeviceManager::openDevice( CPhidgetHandle phidgetHandle, int serialNumber )
 {
 	int ret = CPhidget_open( phidgetHandle, serialNumber );
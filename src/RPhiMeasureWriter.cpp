@@ -0,0 +1,321 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiMeasureWriter.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RPhiRecordBuilder.h"
+
+namespace RPhi
+{
+
+namespace
+{
+	// Appends formatted text to a fixed-size buffer, remembering if it was too small
+	class TextOutput
+	{
+	public:
+		TextOutput( char* buffer, std::size_t size )
+			: mBuffer(buffer), mSize(size), mPosition(0), mOverflow(size==0)
+		{
+		}
+
+		void append( const char* format, ... )
+		{
+			if ( mOverflow )
+				return;
+			va_list args;
+			va_start( args, format );
+			int numChars = vsnprintf( mBuffer+mPosition, mSize-mPosition, format, args );
+			va_end( args );
+			if ( numChars<0 || static_cast<std::size_t>(numChars)>=mSize-mPosition )
+				mOverflow = true;
+			else
+				mPosition += static_cast<std::size_t>(numChars);
+		}
+
+		void appendValue( const char* valueFormat, double value )
+		{
+			append( valueFormat, value );
+		}
+
+		// A JSON string, quotes included
+		void appendJsonString( const char* text )
+		{
+			append( "\"" );
+			for ( const char* c=text; *c && !mOverflow; ++c )
+			{
+				if ( *c=='"' || *c=='\\' )
+					append( "\\%c", *c );
+				else if ( static_cast<unsigned char>(*c)<0x20 )
+					append( "\\u%04x", static_cast<unsigned char>(*c) );
+				else
+					append( "%c", *c );
+			}
+			append( "\"" );
+		}
+
+		// A CSV field, quoted when needed
+		void appendCsvString( const char* text )
+		{
+			if ( !strpbrk( text, ",\"\n\r" ) )
+			{
+				append( "%s", text );
+				return;
+			}
+			append( "\"" );
+			for ( const char* c=text; *c && !mOverflow; ++c )
+				append( *c=='"' ? "\"\"" : "%c", *c );
+			append( "\"" );
+		}
+
+		std::size_t getSize() const	{ return mOverflow ? 0 : mPosition; }
+
+	private:
+		char*		mBuffer;
+		std::size_t	mSize;
+		std::size_t	mPosition;
+		bool		mOverflow;
+	};
+
+	// The values of a record, in the order of the CSV columns 
+	enum Column
+	{
+		kAccelerationX, kAccelerationY, kAccelerationZ,
+		kAngularRateX, kAngularRateY, kAngularRateZ,
+		kMagneticFieldX, kMagneticFieldY, kMagneticFieldZ,
+		kTemperature, kPotential,
+		kNumColumns
+	};
+	
+	const char* kCsvHeader = "kind,serialNumber,channel,timeInUs,"
+		"accelerationXInGs,accelerationYInGs,accelerationZInGs,"
+		"angularRateXInDegPerSec,angularRateYInDegPerSec,angularRateZInDegPerSec,"
+		"magneticFieldXInGauss,magneticFieldYInGauss,magneticFieldZInGauss,"
+		"temperatureInC,potentialInMV,text\n";
+
+	// Fill the values of the columns that apply to the record. Return false if none does
+	bool getColumnValues( const Record& record, double* values, bool* valid )
+	{
+		memset( valid, 0, sizeof(bool)*kNumColumns );
+		switch ( record.mKind )
+		{
+			case Record::kSpatialMinMeasure:
+			case Record::kSpatialMaxMeasure:
+			case Record::kSpatialMeasure:
+				for ( int i=0; i<3; ++i )
+				{
+					values[kAccelerationX+i] = record.mSpatialMeasure.mAccelerationInGs[i];
+					values[kAngularRateX+i] = record.mSpatialMeasure.mAngularRateInDegPerSec[i];
+					values[kMagneticFieldX+i] = record.mSpatialMeasure.mMagneticFieldInGauss[i];
+				}
+				for ( int i=kAccelerationX; i<=kMagneticFieldZ; ++i )
+					valid[i] = true;
+				return true;
+			case Record::kThermocoupleMeasure:
+				values[kTemperature] = record.mThermocoupleMeasure.mTemperatureInC;
+				values[kPotential] = record.mThermocoupleMeasure.mPotentialInMV;
+				valid[kTemperature] = valid[kPotential] = true;
+				return true;
+			case Record::kAmbientTemperature:
+				values[kTemperature] = record.mAmbientTemperatureInC;
+				valid[kTemperature] = true;
+				return true;
+		}
+		return false;
+	}
+}
+
+MeasureWriter::MeasureWriter( Format format, int precision )
+	: mFormat(format),
+	  mPrecision(0),
+	  mRecords()
+{
+	setPrecision( precision );
+	mRecords.reserve( 64 );
+}
+
+void MeasureWriter::setPrecision( int precision )
+{
+	assert( precision==kFullPrecision || (precision>=0 && precision<=17) );
+	mPrecision = precision;
+	if ( precision==kFullPrecision )
+		snprintf( mValueFormat, sizeof(mValueFormat), "%%.17g" );
+	else
+		snprintf( mValueFormat, sizeof(mValueFormat), "%%.%df", precision );
+}
+
+std::size_t MeasureWriter::writeDescription( const Device* device, int64_t timeInUs, char* buffer, std::size_t size )
+{
+	mRecords.clear();
+	RecordBuilder::appendDeviceDescription( device, timeInUs, mRecords );
+	return writeRecords( buffer, size );
+}
+
+std::size_t MeasureWriter::writeMeasures( const Device* device, int64_t timeInUs, char* buffer, std::size_t size )
+{
+	mRecords.clear();
+	RecordBuilder::appendMeasures( device, timeInUs, mRecords );
+	return writeRecords( buffer, size );
+}
+
+std::size_t MeasureWriter::writeRecords( char* buffer, std::size_t size ) const
+{
+	std::size_t position = 0;
+	for ( std::size_t i=0; i<mRecords.size(); ++i )
+	{
+		std::size_t recordSize = writeRecord( mRecords[i], buffer+position, size-position );
+		if ( recordSize==0 )
+			return 0;
+		position += recordSize;
+	}
+	return position;
+}
+
+std::size_t MeasureWriter::writeCsvHeader( char* buffer, std::size_t size ) const
+{
+	if ( mFormat!=kCsv )
+		return 0;
+	TextOutput output( buffer, size );
+	output.append( "%s", kCsvHeader );
+	return output.getSize();
+}
+
+std::size_t MeasureWriter::writeRecord( const Record& record, char* buffer, std::size_t size ) const
+{
+	if ( mFormat==kBinary )
+	{
+		if ( size<sizeof(Record) )
+			return 0;
+		memcpy( buffer, &record, sizeof(Record) );
+		return sizeof(Record);
+	}
+
+	double values[kNumColumns];
+	bool valid[kNumColumns];
+	bool hasValues = getColumnValues( record, values, valid );
+	bool hasText = record.mKind==Record::kDeviceName || record.mKind==Record::kDeviceTypeName;
+	const char* kindName = getKindName( record.mKind );
+	long long timeInUs = static_cast<long long>( record.mTimeInUs );
+	TextOutput output( buffer, size );
+
+	switch ( mFormat )
+	{
+		case kText:
+		{
+			static const char* const valueNames[kNumColumns] = { "acc:", "", "", "ang:", "", "", "mag:", "", "", "temperatureInC:", "potentialInMV:" };
+			output.append( "%s serialNumber:%d channel:%d timeInUs:%lld", kindName, record.mSerialNumber, record.mChannel, timeInUs );
+			for ( int i=0; i<kNumColumns && hasValues; ++i )
+			{
+				if ( !valid[i] )
+					continue;
+				output.append( " %s", valueNames[i] );
+				output.appendValue( mValueFormat, values[i] );
+			}
+			if ( hasText )
+				output.append( " text:'%s'", record.mText );
+			if ( record.mKind==Record::kDeviceAttached )
+				output.append( " type:%d version:%d", record.mDeviceInfo.mType, record.mDeviceInfo.mVersion );
+			if ( record.mKind==Record::kThermocoupleInfo )
+				output.append( " thermocoupleType:%d", record.mThermocoupleInfo.mType );
+			output.append( "\n" );
+		}
+		break;
+
+		case kJsonLines:
+		{
+			static const char* const valueNames[kNumColumns] = { "acc", "", "", "ang", "", "", "mag", "", "", "temperatureInC", "potentialInMV" };
+			output.append( "{\"kind\":\"%s\",\"serialNumber\":%d,\"channel\":%d,\"timeInUs\":%lld", kindName, record.mSerialNumber, record.mChannel, timeInUs );
+			for ( int i=0; i<kNumColumns && hasValues; ++i )
+			{
+				if ( !valid[i] )
+					continue;
+				
+				// The vectors are written as arrays
+				bool isVector = i<=kMagneticFieldZ;
+				if ( !isVector || i%3==0 )
+					output.append( isVector ? ",\"%s\":[" : ",\"%s\":", valueNames[i] );
+				else
+					output.append( "," );
+				output.appendValue( mValueFormat, values[i] );
+				if ( isVector && i%3==2 )
+					output.append( "]" );
+			}
+			if ( hasText )
+			{
+				output.append( ",\"text\":" );
+				output.appendJsonString( record.mText );
+			}
+			if ( record.mKind==Record::kDeviceAttached )
+				output.append( ",\"type\":%d,\"version\":%d", record.mDeviceInfo.mType, record.mDeviceInfo.mVersion );
+			if ( record.mKind==Record::kThermocoupleInfo )
+				output.append( ",\"thermocoupleType\":%d", record.mThermocoupleInfo.mType );
+			output.append( "}\n" );
+		}
+		break;
+
+		case kCsv:
+		{
+			output.append( "%s,%d,%d,%lld", kindName, record.mSerialNumber, record.mChannel, timeInUs );
+			for ( int i=0; i<kNumColumns; ++i )
+			{
+				output.append( "," );
+				if ( hasValues && valid[i] )
+					output.appendValue( mValueFormat, values[i] );
+			}
+			output.append( "," );
+			if ( hasText )
+				output.appendCsvString( record.mText );
+			output.append( "\n" );
+		}
+		break;
+
+		case kBinary:
+		break;
+	}
+	return output.getSize();
+}
+
+const char* MeasureWriter::getKindName( uint16_t kind )
+{
+	switch ( kind )
+	{
+		case Record::kDeviceAttached:		return "deviceAttached";
+		case Record::kDeviceDetached:		return "deviceDetached";
+		case Record::kDeviceName:			return "deviceName";
+		case Record::kDeviceTypeName:		return "deviceTypeName";
+		case Record::kSpatialMinMeasure:	return "spatialMinMeasure";
+		case Record::kSpatialMaxMeasure:	return "spatialMaxMeasure";
+		case Record::kSpatialMeasure:		return "spatialMeasure";
+		case Record::kThermocoupleInfo:		return "thermocoupleInfo";
+		case Record::kThermocoupleMeasure:	return "thermocoupleMeasure";
+		case Record::kAmbientTemperature:	return "ambientTemperature";
+	}
+	return "unknown";
+}
+
+}
@@ -0,0 +1,263 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiQueuedListener.h"
+
+#include <assert.h>
+
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+
+/*
+	Notes:
+	- A dropped event stays in the queue, flagged as dropped, until the delivery 
+	  thread skips it. This keeps the pointers in mPendingMeasureEvents valid, as 
+	  the deque is only modified at its ends
+	- The pending measure event of a device is forgotten when the device gets 
+	  disconnected, so that coalescing never moves measures across a disconnection
+	- The records of an event are built on the thread calling DeviceManager::update()
+	  (the devices can't be accessed from the delivery thread), into the recycled 
+	  vector of a previous event
+*/
+namespace RPhi
+{
+
+QueuedListener::QueuedListener( DeviceManager* deviceManager, Consumer* consumer, Policy policy, std::size_t capacity, Device::ChannelMask channelMask )
+	: mDeviceManager(deviceManager),
+	  mConsumer(consumer),
+	  mPolicy(policy),
+	  mCapacity(capacity),
+	  mChannelMask(channelMask),
+	  mMutex(),
+	  mEventQueued(),
+	  mEventDelivered(),
+	  mEvents(),
+	  mFreeEvents(),
+	  mPendingMeasureEvents(),
+	  mNumQueuedEvents(0),
+	  mNumQueuedMeasureEvents(0),
+	  mStopRequested(false),
+	  mNumDeliveredEvents(0),
+	  mNumDroppedEvents(0),
+	  mNumCoalescedEvents(0),
+	  mNumBlockedEvents(0),
+	  mDeliveryThread()
+{
+	assert( mDeviceManager );
+	assert( mConsumer );
+	assert( mCapacity>0 );
+
+	mDeliveryThread = std::thread( &QueuedListener::deliveryThreadMain, this );
+
+	// Describe the devices already there and start listening
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+QueuedListener::~QueuedListener()
+{
+	mDeviceManager->removeListener( this );
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		(*itr)->removeListener( this );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStopRequested = true;
+	}
+	mEventQueued.notify_one();
+	mDeliveryThread.join();
+
+	assert( mEvents.empty() );
+	for ( std::size_t i=0; i<mFreeEvents.size(); ++i )
+		delete mFreeEvents[i];
+}
+
+std::size_t QueuedListener::getNumQueuedEvents() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mNumQueuedEvents;
+}
+
+void QueuedListener::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		Event* event = allocateEvent( device->getSerialNumber(), false );
+		RecordBuilder::appendDeviceDescription( device, Clock::getTimeInUs(), event->mRecords );
+		queueEvent( event );
+	}
+	mEventQueued.notify_one();
+	device->addListener( this, mChannelMask );
+}
+
+void QueuedListener::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	device->removeListener( this );
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mPendingMeasureEvents.erase( device->getSerialNumber() );
+		Event* event = allocateEvent( device->getSerialNumber(), false );
+		RecordBuilder::appendRecord( event->mRecords, Record::kDeviceDetached, device->getSerialNumber(), Clock::getTimeInUs() );
+		queueEvent( event );
+	}
+	mEventQueued.notify_one();
+}
+
+void QueuedListener::onDeviceChanged( Device* device )
+{
+	int serialNumber = device->getSerialNumber();
+	int64_t timeInUs = Clock::getTimeInUs();
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		// Replace the measures of the event still queued for the device
+		if ( mPolicy==kCoalesce )
+		{
+			PendingMeasureEvents::iterator itr = mPendingMeasureEvents.find( serialNumber );
+			if ( itr!=mPendingMeasureEvents.end() )
+			{
+				// The previous measures are kept if there's no new one (all the channels 
+				// of a TemperatureSensor gone stale): an event is never empty
+				Event* event = itr->second;
+				std::size_t numPreviousRecords = event->mRecords.size();
+				RecordBuilder::appendMeasures( device, timeInUs, event->mRecords );
+				if ( event->mRecords.size()>numPreviousRecords )
+					event->mRecords.erase( event->mRecords.begin(), event->mRecords.begin() + numPreviousRecords );
+				mNumCoalescedEvents++;
+				return;
+			}
+		}
+
+		// Make room
+		if ( mNumQueuedMeasureEvents>=mCapacity )
+		{
+			if ( mPolicy==kBlock )
+			{
+				mNumBlockedEvents++;
+				while ( mNumQueuedMeasureEvents>=mCapacity )
+					mEventDelivered.wait( lock );
+			}
+			else
+			{
+				dropOldestMeasureEvent();
+			}
+		}
+
+		Event* event = allocateEvent( serialNumber, true );
+		RecordBuilder::appendMeasures( device, timeInUs, event->mRecords );
+		if ( event->mRecords.empty() )
+		{
+			mFreeEvents.push_back( event );
+			return;
+		}
+		queueEvent( event );
+		if ( mPolicy==kCoalesce )
+			mPendingMeasureEvents[serialNumber] = event;
+	}
+	mEventQueued.notify_one();
+}
+
+QueuedListener::Event* QueuedListener::allocateEvent( int serialNumber, bool isMeasure )
+{
+	Event* event = NULL;
+	if ( mFreeEvents.empty() )
+	{
+		event = new Event();
+	}
+	else
+	{
+		event = mFreeEvents.back();
+		mFreeEvents.pop_back();
+	}
+	event->mSerialNumber = serialNumber;
+	event->mIsMeasure = isMeasure;
+	event->mDropped = false;
+	event->mRecords.clear();
+	return event;
+}
+
+void QueuedListener::queueEvent( Event* event )
+{
+	mEvents.push_back( event );
+	mNumQueuedEvents++;
+	if ( event->mIsMeasure )
+		mNumQueuedMeasureEvents++;
+}
+
+void QueuedListener::dropOldestMeasureEvent()
+{
+	for ( std::deque<Event*>::iterator itr=mEvents.begin(); itr!=mEvents.end(); ++itr )
+	{
+		Event* event = *itr;
+		if ( !event->mIsMeasure || event->mDropped )
+			continue;
+
+		event->mDropped = true;
+		mNumQueuedEvents--;
+		mNumQueuedMeasureEvents--;
+		mNumDroppedEvents++;
+		PendingMeasureEvents::iterator pendingItr = mPendingMeasureEvents.find( event->mSerialNumber );
+		if ( pendingItr!=mPendingMeasureEvents.end() && pendingItr->second==event )
+			mPendingMeasureEvents.erase( pendingItr );
+		return;
+	}
+}
+
+void QueuedListener::deliveryThreadMain()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	for ( ;; )
+	{
+		while ( mEvents.empty() && !mStopRequested )
+			mEventQueued.wait( lock );
+		if ( mEvents.empty() )
+			break;
+
+		Event* event = mEvents.front();
+		mEvents.pop_front();
+		if ( !event->mDropped )
+		{
+			mNumQueuedEvents--;
+			if ( event->mIsMeasure )
+			{
+				mNumQueuedMeasureEvents--;
+				PendingMeasureEvents::iterator itr = mPendingMeasureEvents.find( event->mSerialNumber );
+				if ( itr!=mPendingMeasureEvents.end() && itr->second==event )
+					mPendingMeasureEvents.erase( itr );
+			}
+
+			// The event is out of the queue: nobody else touches it while it's delivered
+			lock.unlock();
+			mEventDelivered.notify_one();
+			mConsumer->onRecords( &event->mRecords[0], event->mRecords.size() );
+			mNumDeliveredEvents++;
+			lock.lock();
+		}
+		mFreeEvents.push_back( event );
+	}
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiRecordBuilder.h"
+
+#include <string.h>
+#include <string>
+
+namespace RPhi
+{
+
+namespace
+{
+	void copyText( char* destination, const std::string& text )
+	{
+		strncpy( destination, text.c_str(), Record::kTextSize-1 );
+		destination[Record::kTextSize-1] = '\0';
+	}
+
+	void copyVector( double* destination, const Vector3d& vector )
+	{
+		destination[0] = vector.x();
+		destination[1] = vector.y();
+		destination[2] = vector.z();
+	}
+
+	Vector3d toVector3d( const double* values )
+	{
+		return Vector3d( values[0], values[1], values[2] );
+	}
+}
+
+Record& RecordBuilder::appendRecord( std::vector<Record>& records, Record::Kind kind, int serialNumber, int64_t timeInUs )
+{
+	records.resize( records.size()+1 );
+	Record& record = records.back();
+	memset( &record, 0, sizeof(Record) );
+	record.mKind = static_cast<uint16_t>(kind);
+	record.mSerialNumber = serialNumber;
+	record.mTimeInUs = timeInUs;
+	return record;
+}
+
+void RecordBuilder::appendDeviceDescription( const Device* device, int64_t timeInUs, std::vector<Record>& records )
+{
+	int serialNumber = device->getSerialNumber();
+
+	// The other records may reallocate the vector, so the attached record is referred to by position
+	std::size_t attachedRecordIndex = records.size();
+	Record::DeviceInfo& info = appendRecord( records, Record::kDeviceAttached, serialNumber, timeInUs ).mDeviceInfo;
+	info.mType = device->getType();
+	info.mVersion = device->getVersion();
+	
+	copyText( appendRecord( records, Record::kDeviceName, serialNumber, timeInUs ).mText, device->getName() );
+	copyText( appendRecord( records, Record::kDeviceTypeName, serialNumber, timeInUs ).mText, device->getTypeName() );
+
+	device->appendDescription( attachedRecordIndex, timeInUs, records );
+}
+
+void RecordBuilder::appendMeasures( const Device* device, int64_t timeInUs, std::vector<Record>& records, Device::ChannelMask channels )
+{
+	device->appendMeasures( channels, timeInUs, records );
+}
+
+void RecordBuilder::appendSpatialMeasure( const Spatial::Measure& measure, int serialNumber, int64_t timeInUs, std::vector<Record>& records )
+{
+	Record& record = appendRecord( records, Record::kSpatialMeasure, serialNumber, timeInUs );
+	copySpatialMeasure( record.mSpatialMeasure, measure );
+}
+
+void RecordBuilder::appendThermocoupleMeasure( int index, const TemperatureSensor::Thermocouple::Measure& measure, int serialNumber, int64_t timeInUs, std::vector<Record>& records )
+{
+	Record& record = appendRecord( records, Record::kThermocoupleMeasure, serialNumber, timeInUs );
+	record.mChannel = static_cast<uint16_t>( index );
+	record.mThermocoupleMeasure.mTemperatureInC = measure.getTemperatureInC();
+	record.mThermocoupleMeasure.mPotentialInMV = measure.getPotentialInMV();
+}
+
+void RecordBuilder::appendAmbientTemperature( double temperatureInC, int serialNumber, int64_t timeInUs, std::vector<Record>& records )
+{
+	Record& record = appendRecord( records, Record::kAmbientTemperature, serialNumber, timeInUs );
+	record.mChannel = TemperatureSensor::kAmbientChannel;
+	record.mAmbientTemperatureInC = temperatureInC;
+}
+
+void RecordBuilder::copySpatialMeasure( Record::SpatialMeasure& destination, const Spatial::Measure& measure )
+{
+	copyVector( destination.mAccelerationInGs, measure.getAccelerationInGs() );
+	copyVector( destination.mAngularRateInDegPerSec, measure.getAngularRateInDegPerSec() );
+	copyVector( destination.mMagneticFieldInGauss, measure.getMagneticFieldInGauss() );
+}
+
+Spatial::Measure RecordBuilder::toSpatialMeasure( const Record::SpatialMeasure& measure )
+{
+	return Spatial::Measure( toVector3d( measure.mAccelerationInGs ), 
+							 toVector3d( measure.mAngularRateInDegPerSec ), 
+							 toVector3d( measure.mMagneticFieldInGauss ) );
+}
+
+TemperatureSensor::Thermocouple::Measure RecordBuilder::toThermocoupleMeasure( const Record::ThermocoupleMeasure& measure )
+{
+	return TemperatureSensor::Thermocouple::Measure( measure.mTemperatureInC, measure.mPotentialInMV );
+}
+
+}
@@ -0,0 +1,240 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiRecorder.h"
+
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+
+/*
+	Notes:
+	- The writer thread wakes up either when a full batch is pending or when the
+	  flush interval has elapsed. It swaps the pending and writing buffers so that
+	  the acquisition thread only holds the lock for the time of a few copies
+	- Once both buffers have grown to their working size, recording doesn't 
+	  allocate memory anymore
+*/
+namespace RPhi
+{
+
+namespace
+{
+	const std::size_t kBatchSize = 1024;
+}
+
+Recorder::Recorder( DeviceManager* deviceManager, const std::string& filename, int64_t indexIntervalInUs )
+	: mDeviceManager(deviceManager),
+	  mFilename(filename),
+	  mFile(NULL),
+	  mIndexFile(NULL),
+	  mIndex(indexIntervalInUs),
+	  mNewIndexEntries(),
+	  mFlushIntervalInMs(100),
+	  mPendingRecords(),
+	  mWritingRecords(),
+	  mNumRecordsQueued(0),
+	  mNumRecordsWritten(0),
+	  mFlushRequested(false),
+	  mStopRequested(false),
+	  mMutex(),
+	  mCondition(),
+	  mWriterThread()
+{
+	assert( mDeviceManager );
+
+	mFile = fopen( mFilename.c_str(), "wb" );
+	assert( mFile );
+	if ( !mFile )
+		return;
+
+	// Write the file header
+	RecordingHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.mMagic, kRecordingMagic, sizeof(header.mMagic) );
+	header.mVersion = kRecordingVersion;
+	header.mRecordSize = sizeof(Record);
+	header.mStartTimeInUs = Clock::getTimeInUs();
+	size_t numWritten = fwrite( &header, sizeof(header), 1, mFile );
+	assert( numWritten==1 );
+	if ( numWritten!=1 )
+	{
+		fclose( mFile );
+		mFile = NULL;
+		return;
+	}
+
+	// The index is optional: the recording remains usable without it
+	mIndexFile = fopen( RecordingIndex::getIndexFilename(mFilename).c_str(), "wb" );
+	if ( mIndexFile && !mIndex.writeHeader( mIndexFile, header.mStartTimeInUs ) )
+	{
+		fclose( mIndexFile );
+		mIndexFile = NULL;
+	}
+
+	mPendingRecords.reserve( kBatchSize );
+	mWritingRecords.reserve( kBatchSize );
+	mWriterThread = std::thread( &Recorder::writerThreadMain, this );
+
+	// Record the devices already there and start listening
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+Recorder::~Recorder()
+{
+	if ( !mFile )
+		return;
+
+	mDeviceManager->removeListener( this );
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		(*itr)->removeListener( this );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStopRequested = true;
+	}
+	mCondition.notify_all();
+	mWriterThread.join();
+
+	fclose( mFile );
+	mFile = NULL;
+	if ( mIndexFile )
+	{
+		fclose( mIndexFile );
+		mIndexFile = NULL;
+	}
+}
+
+void Recorder::setFlushIntervalInMs( int flushIntervalInMs )
+{
+	assert( flushIntervalInMs>0 );
+	std::lock_guard<std::mutex> lock( mMutex );
+	mFlushIntervalInMs = flushIntervalInMs;
+}
+
+uint64_t Recorder::getNumRecordsWritten() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mNumRecordsWritten;
+}
+
+void Recorder::flush()
+{
+	if ( !mFile )
+		return;
+	std::unique_lock<std::mutex> lock( mMutex );
+	uint64_t numRecordsToWrite = mNumRecordsQueued;
+	mFlushRequested = true;
+	mCondition.notify_all();
+	while ( mNumRecordsWritten<numRecordsToWrite )
+		mCondition.wait( lock );
+}
+
+void Recorder::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	int64_t timeInUs = Clock::getTimeInUs();
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		std::size_t numRecords = mPendingRecords.size();
+		RecordBuilder::appendDeviceDescription( device, timeInUs, mPendingRecords );
+		onRecordsAdded( numRecords );
+	}
+	device->addListener( this );
+}
+
+void Recorder::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	device->removeListener( this );
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::size_t numRecords = mPendingRecords.size();
+	RecordBuilder::appendRecord( mPendingRecords, Record::kDeviceDetached, device->getSerialNumber(), Clock::getTimeInUs() );
+	onRecordsAdded( numRecords );
+}
+
+void Recorder::onDeviceChanged( Device* device )
+{
+	int64_t timeInUs = Clock::getTimeInUs();
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::size_t numRecords = mPendingRecords.size();
+	RecordBuilder::appendMeasures( device, timeInUs, mPendingRecords );
+	onRecordsAdded( numRecords );
+}
+
+void Recorder::onRecordsAdded( std::size_t previousNumPendingRecords )
+{
+	mNumRecordsQueued += mPendingRecords.size() - previousNumPendingRecords;
+	if ( previousNumPendingRecords<kBatchSize && mPendingRecords.size()>=kBatchSize )
+		mCondition.notify_all();
+}
+
+void Recorder::writerThreadMain()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	for ( ;; )
+	{
+		// Wait for a full batch, a flush request or the end of the flush interval
+		mCondition.wait_for( lock, std::chrono::milliseconds(mFlushIntervalInMs), [this]() 
+			{ return mStopRequested || mFlushRequested || mPendingRecords.size()>=kBatchSize; } );
+		
+		if ( mPendingRecords.empty() )
+		{
+			mFlushRequested = false;
+			if ( mStopRequested )
+				break;
+			continue;
+		}
+
+		// Swap the buffers and write outside of the lock
+		mWritingRecords.swap( mPendingRecords );
+		lock.unlock();
+		size_t numWritten = fwrite( &mWritingRecords[0], sizeof(Record), mWritingRecords.size(), mFile );
+		assert( numWritten==mWritingRecords.size() );
+		fflush( mFile );
+		
+		// Index what has been written. The index never refers to records which are not in the file yet
+		if ( mIndexFile )
+		{
+			mNewIndexEntries.clear();
+			mIndex.addRecords( &mWritingRecords[0], numWritten, &mNewIndexEntries );
+			if ( !mNewIndexEntries.empty() )
+			{
+				fwrite( &mNewIndexEntries[0], sizeof(RecordingIndex::Entry), mNewIndexEntries.size(), mIndexFile );
+				fflush( mIndexFile );
+			}
+		}
+		lock.lock();
+
+		mNumRecordsWritten += mWritingRecords.size();
+		mWritingRecords.clear();
+		mCondition.notify_all();
+	}
+}
+
+}
@@ -0,0 +1,253 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiRecordingIndex.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "RPhiRecordingReader.h"
+
+/*
+	Notes:
+	- Records are written in the order they are produced, so within a device 
+	  they are sorted by time. Across devices, times are only roughly sorted 
+	  (each device is timestamped when it notifies), which is why the entries 
+	  are looked up per device
+	- An entry is added for a device when the interval has elapsed since its 
+	  previous entry, so the scan of a query starts at most one interval before 
+	  the requested time
+*/
+namespace RPhi
+{
+
+namespace
+{
+	// Order entry positions by the time of the entry they refer to
+	class EntryTimeLess
+	{
+	public:
+		EntryTimeLess( const RecordingIndex::Entries& entries ) : mEntries(entries) {}
+		bool operator()( int64_t timeInUs, std::size_t entryIndex ) const	{ return timeInUs<mEntries[entryIndex].mTimeInUs; }
+	private:
+		const RecordingIndex::Entries& mEntries;
+	};
+}
+
+RecordingIndex::RecordingIndex( int64_t intervalInUs )
+	: mIntervalInUs(intervalInUs),
+	  mNumRecordsIndexed(0),
+	  mEntries(),
+	  mEntryIndicesBySerialNumber()
+{
+	assert( mIntervalInUs>0 );
+}
+
+void RecordingIndex::clear()
+{
+	mNumRecordsIndexed = 0;
+	mEntries.clear();
+	mEntryIndicesBySerialNumber.clear();
+}
+
+void RecordingIndex::addRecords( const Record* records, std::size_t numRecords, Entries* newEntries )
+{
+	for ( std::size_t i=0; i<numRecords; ++i )
+	{
+		const Record& record = records[i];
+		uint64_t recordIndex = mNumRecordsIndexed + i;
+		addEntry( kAllDevices, record.mTimeInUs, recordIndex, newEntries );
+		addEntry( record.mSerialNumber, record.mTimeInUs, recordIndex, newEntries );
+	}
+	mNumRecordsIndexed += numRecords;
+}
+
+void RecordingIndex::addEntry( int serialNumber, int64_t timeInUs, uint64_t recordIndex, Entries* newEntries )
+{
+	EntryIndices& entryIndices = mEntryIndicesBySerialNumber[serialNumber];
+	if ( !entryIndices.empty() && timeInUs < mEntries[entryIndices.back()].mTimeInUs + mIntervalInUs )
+		return;
+
+	Entry entry;
+	memset( &entry, 0, sizeof(entry) );
+	entry.mSerialNumber = serialNumber;
+	entry.mTimeInUs = timeInUs;
+	entry.mRecordIndex = recordIndex;
+	entryIndices.push_back( mEntries.size() );
+	mEntries.push_back( entry );
+	if ( newEntries )
+		newEntries->push_back( entry );
+}
+
+bool RecordingIndex::load( const std::string& filename, const RecordingReader& reader )
+{
+	clear();
+
+	FILE* file = fopen( filename.c_str(), "rb" );
+	if ( !file )
+		return false;
+
+	RecordingIndexHeader header;
+	bool valid = fread( &header, sizeof(header), 1, file )==1 &&
+				 memcmp( header.mMagic, kRecordingIndexMagic, sizeof(header.mMagic) )==0 &&
+				 header.mVersion==kRecordingIndexVersion &&
+				 header.mEntrySize==sizeof(Entry) &&
+				 header.mIntervalInUs>0 &&
+				 header.mRecordingStartTimeInUs==reader.getHeader()->mStartTimeInUs;
+	if ( valid )
+	{
+		mIntervalInUs = header.mIntervalInUs;
+
+		// Keep the entries that match the recording. A crash can leave a partial last entry 
+		Entry entry;
+		while ( fread( &entry, sizeof(entry), 1, file )==1 )
+		{
+			if ( entry.mRecordIndex<mNumRecordsIndexed || entry.mRecordIndex>=reader.getNumRecords() )
+			{
+				valid = false;
+				break;
+			}
+			const Record& record = reader.getRecord( static_cast<std::size_t>(entry.mRecordIndex) );
+			if ( record.mTimeInUs!=entry.mTimeInUs || ( entry.mSerialNumber!=kAllDevices && record.mSerialNumber!=entry.mSerialNumber ) )
+			{
+				valid = false;
+				break;
+			}
+			mEntryIndicesBySerialNumber[entry.mSerialNumber].push_back( mEntries.size() );
+			mEntries.push_back( entry );
+			mNumRecordsIndexed = entry.mRecordIndex;	
+		}
+	}
+	fclose( file );
+
+	if ( !valid )
+	{
+		clear();
+		return false;
+	}
+
+	// The records after the last entry are indexed again, so we start from the record of the 
+	// last entry. Entries of the same record are always written together, so none is missing
+	if ( !mEntries.empty() )
+	{
+		uint64_t lastRecordIndex = mEntries.back().mRecordIndex;
+		while ( !mEntries.empty() && mEntries.back().mRecordIndex==lastRecordIndex )
+		{
+			EntryIndices& entryIndices = mEntryIndicesBySerialNumber[mEntries.back().mSerialNumber];
+			entryIndices.pop_back();
+			if ( entryIndices.empty() )
+				mEntryIndicesBySerialNumber.erase( mEntries.back().mSerialNumber );
+			mEntries.pop_back();
+		}
+		mNumRecordsIndexed = lastRecordIndex;
+	}
+	return true;
+}
+
+bool RecordingIndex::loadOrBuild( const RecordingReader& reader )
+{
+	if ( !reader.isOpen() )
+	{
+		clear();
+		return false;
+	}
+
+	bool loaded = load( getIndexFilename( reader.getFilename() ), reader );
+	
+	// Index the records the sidecar doesn't cover
+	std::size_t firstRecordIndex = static_cast<std::size_t>( mNumRecordsIndexed );
+	if ( firstRecordIndex<reader.getNumRecords() )
+		addRecords( reader.getRecords() + firstRecordIndex, reader.getNumRecords() - firstRecordIndex );
+	return loaded;
+}
+
+bool RecordingIndex::writeHeader( FILE* file, int64_t recordingStartTimeInUs ) const
+{
+	RecordingIndexHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.mMagic, kRecordingIndexMagic, sizeof(header.mMagic) );
+	header.mVersion = kRecordingIndexVersion;
+	header.mEntrySize = sizeof(Entry);
+	header.mIntervalInUs = mIntervalInUs;
+	header.mRecordingStartTimeInUs = recordingStartTimeInUs;
+	return fwrite( &header, sizeof(header), 1, file )==1;
+}
+
+bool RecordingIndex::save( const std::string& filename, int64_t recordingStartTimeInUs ) const
+{
+	FILE* file = fopen( filename.c_str(), "wb" );
+	if ( !file )
+		return false;
+
+	bool ok = writeHeader( file, recordingStartTimeInUs );
+	if ( ok && !mEntries.empty() )
+		ok = fwrite( &mEntries[0], sizeof(Entry), mEntries.size(), file )==mEntries.size();
+	fclose( file );
+	return ok;
+}
+
+uint64_t RecordingIndex::findStartRecordIndex( int serialNumber, int64_t timeInUs ) const
+{
+	EntryIndicesBySerialNumber::const_iterator itr = mEntryIndicesBySerialNumber.find( serialNumber );
+	if ( itr==mEntryIndicesBySerialNumber.end() )
+		return mNumRecordsIndexed;
+	
+	// Find the last entry at or before the time. Start from the first entry if there's none
+	const EntryIndices& entryIndices = itr->second;
+	EntryIndices::const_iterator entryItr = std::upper_bound( entryIndices.begin(), entryIndices.end(), timeInUs, EntryTimeLess(mEntries) );
+	if ( entryItr!=entryIndices.begin() )
+		--entryItr;
+	return mEntries[*entryItr].mRecordIndex;
+}
+
+std::size_t RecordingIndex::query( const RecordingReader& reader, int serialNumber, int64_t fromTimeInUs, int64_t toTimeInUs, Visitor& visitor ) const
+{
+	std::size_t numVisited = 0;
+	std::size_t numRecords = reader.getNumRecords();
+	uint64_t startRecordIndex = findStartRecordIndex( serialNumber, fromTimeInUs );
+	
+	// The records of a device are sorted by time, so the scan stops at the first one past the range. 
+	// The records of the devices are only roughly sorted between them: the scan also stops at the 
+	// first record of any device an interval past the range, in case the device has no record after it
+	int64_t scanEndTimeInUs = toTimeInUs<INT64_MAX - mIntervalInUs ? toTimeInUs + mIntervalInUs : INT64_MAX;
+	for ( std::size_t i=static_cast<std::size_t>(startRecordIndex); i<numRecords; ++i )
+	{
+		const Record& record = reader.getRecord(i);
+		if ( record.mTimeInUs>scanEndTimeInUs )
+			break;
+		if ( serialNumber!=kAllDevices && record.mSerialNumber!=serialNumber )
+			continue;
+		if ( record.mTimeInUs>toTimeInUs )
+			break;
+		if ( record.mTimeInUs>=fromTimeInUs )
+		{
+			visitor.onRecord( record );
+			++numVisited;
+		}
+	}
+	return numVisited;
+}
+
+}
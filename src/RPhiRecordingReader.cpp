@@ -0,0 +1,129 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiRecordingReader.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+namespace RPhi
+{
+
+RecordingReader::RecordingReader( const std::string& filename )
+	: mFilename(filename),
+	  mFileHandle(NULL),
+	  mMappingHandle(NULL),
+	  mData(NULL),
+	  mSize(0),
+	  mHeader(NULL),
+	  mRecords(NULL),
+	  mNumRecords(0)
+{
+	// Map the whole file in memory
+#if _WIN32
+	HANDLE fileHandle = CreateFileA( mFilename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( fileHandle==INVALID_HANDLE_VALUE )
+		return;
+	mFileHandle = fileHandle;
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( fileHandle, &fileSize ) || fileSize.QuadPart<static_cast<LONGLONG>(sizeof(RecordingHeader)) )
+	{
+		close();
+		return;
+	}
+	mSize = static_cast<std::size_t>( fileSize.QuadPart );
+	mMappingHandle = CreateFileMappingA( fileHandle, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( mMappingHandle )
+		mData = MapViewOfFile( mMappingHandle, FILE_MAP_READ, 0, 0, 0 );
+#else
+	int fd = open( mFilename.c_str(), O_RDONLY );
+	if ( fd<0 )
+		return;
+	struct stat fileStat;
+	if ( fstat( fd, &fileStat )==0 && fileStat.st_size>=static_cast<off_t>(sizeof(RecordingHeader)) )
+	{
+		mSize = static_cast<std::size_t>( fileStat.st_size );
+		void* data = mmap( NULL, mSize, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( data!=MAP_FAILED )
+			mData = data;
+	}
+	::close( fd );		// The mapping stays valid after the file descriptor is closed
+#endif
+	if ( !mData )
+	{
+		close();
+		return;
+	}
+
+	// Check the header
+	const RecordingHeader* header = static_cast<const RecordingHeader*>( mData );
+	if ( memcmp( header->mMagic, kRecordingMagic, sizeof(header->mMagic) )!=0 ||
+		 header->mVersion!=kRecordingVersion ||
+		 header->mRecordSize!=sizeof(Record) )
+	{
+		close();
+		return;
+	}
+
+	mHeader = header;
+	mRecords = reinterpret_cast<const Record*>( static_cast<const char*>(mData) + sizeof(RecordingHeader) );
+	mNumRecords = ( mSize - sizeof(RecordingHeader) ) / sizeof(Record);
+}
+
+RecordingReader::~RecordingReader()
+{
+	close();
+}
+
+void RecordingReader::close()
+{
+#if _WIN32
+	if ( mData )
+		UnmapViewOfFile( mData );
+	if ( mMappingHandle )
+		CloseHandle( mMappingHandle );
+	if ( mFileHandle )
+		CloseHandle( mFileHandle );
+#else
+	if ( mData )
+		munmap( mData, mSize );
+#endif
+	mFileHandle = NULL;
+	mMappingHandle = NULL;
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mRecords = NULL;
+	mNumRecords = 0;
+}
+
+}
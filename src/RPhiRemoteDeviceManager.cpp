@@ -51,6 +51,12 @@ RemoteDeviceManager::RemoteDeviceManager( const std::string& serverAddress, int
 	openRemotelyWithServerAddress( serverAddress, port, password );
 }
 
+RemoteDeviceManager::~RemoteDeviceManager()
+{
+	// The acquisition thread calls openDevice()
+	stopAcquisition();
+}
+
 bool RemoteDeviceManager::isConnected() const
 {
 	int result = 0;
@@ -0,0 +1,275 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiReplayDeviceManager.h"
+
+#include <assert.h>
+#include <vector>
+
+#include "RPhiClock.h"
+
+/*
+	Notes:
+	- The replayed devices store the measures found in the recording as pending 
+	  and only apply them (and notify) when the DeviceManager updates them, as 
+	  real devices do when they are polled. They are applied with the same 
+	  Device::applyRecord() as the records of the background acquisition, so 
+	  nothing here depends on the type of the devices
+	- The records describing a device directly follow its kDeviceAttached record
+	  (see Recorder), so a device is created in one go when that record is reached
+*/
+namespace RPhi
+{
+
+/*
+	ReplayDeviceManager::ReplayDevice
+*/
+class ReplayDeviceManager::ReplayDevice
+{
+public:
+	virtual ~ReplayDevice() {}
+	virtual Device*		getDevice() = 0;
+
+	// Keep the measure record until the device gets updated. Only the last measure 
+	// of each channel is kept
+	virtual void		setPendingRecord( const Record& record ) = 0;
+};
+
+/*
+	ReplayDeviceManager::TypedReplayDevice
+*/
+template<typename T>
+class ReplayDeviceManager::TypedReplayDevice : public T, public ReplayDeviceManager::ReplayDevice
+{
+public:
+	TypedReplayDevice( const std::string& name, const std::string& typeName, const Record* records, std::size_t numRecords )
+		: T( name, records[0].mSerialNumber, records[0].mDeviceInfo.mVersion, typeName ),
+		  mPendingRecords()
+	{
+		this->setDescription( records, numRecords );
+	}
+
+	virtual Device* getDevice()
+	{
+		return this;
+	}
+
+	virtual void setPendingRecord( const Record& record )
+	{
+		for ( std::vector<Record>::iterator itr=mPendingRecords.begin(); itr!=mPendingRecords.end(); ++itr )
+		{
+			if ( itr->mKind==record.mKind && itr->mChannel==record.mChannel )
+			{
+				*itr = record;
+				return;
+			}
+		}
+		mPendingRecords.push_back( record );
+	}
+
+	// Apply the pending records as the DeviceManager applies the acquired ones 
+	// (see DeviceManager::dispatch()), leaving out the channels not polled
+	virtual void update()
+	{
+		Device::ChannelMask polledChannels = this->getPolledChannels();
+		this->setStaleChannels( ~polledChannels );
+		Device::ChannelMask changedChannels = 0;
+		for ( std::vector<Record>::const_iterator itr=mPendingRecords.begin(); itr!=mPendingRecords.end(); ++itr )
+		{
+			if ( this->getRecordChannels( *itr ) & polledChannels )
+				changedChannels |= this->applyRecord( *itr );
+		}
+		mPendingRecords.clear();
+		if ( changedChannels )
+			this->notifyDeviceChanged( changedChannels );
+	}
+
+private:
+	std::vector<Record>	mPendingRecords;
+};
+
+/*
+	ReplayDeviceManager
+*/
+const double ReplayDeviceManager::kAsFastAsPossible = 0.0;
+
+ReplayDeviceManager::ReplayDeviceManager( const std::string& filename, double speed )
+	: DeviceManager(),
+	  mReader( filename ),
+	  mSpeed( speed ),
+	  mReplayTimeInUs( 0 ),
+	  mAnchorReplayTimeInUs( 0 ),
+	  mAnchorTimeInUs( 0 ),
+	  mNextRecordIndex( 0 ),
+	  mDevicesBySerialNumber()
+{
+	assert( mSpeed>=0.0 );
+	if ( mReader.isOpen() )
+		mReplayTimeInUs = mReader.getHeader()->mStartTimeInUs;
+}
+
+ReplayDeviceManager::~ReplayDeviceManager()
+{
+}
+
+void ReplayDeviceManager::openDevice( CPhidgetHandle /*phidgetHandle*/, int /*serialNumber*/ )
+{
+	// Replayed devices are not backed by any Phidget, there's nothing to open
+	assert( false );
+}
+
+void ReplayDeviceManager::setSpeed( double speed )
+{
+	assert( speed>=0.0 );
+	mSpeed = speed;
+	
+	// Restart the time measurement from the current position
+	mAnchorTimeInUs = 0;
+}
+
+void ReplayDeviceManager::rewind()
+{
+	Devices devices = getDevices();		// The copy is on purpose
+	for ( Devices::iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		unregisterDevice( *itr );
+	mDevicesBySerialNumber.clear();
+
+	mNextRecordIndex = 0;
+	mAnchorTimeInUs = 0;
+	if ( mReader.isOpen() )
+		mReplayTimeInUs = mReader.getHeader()->mStartTimeInUs;
+}
+
+void ReplayDeviceManager::updateDeviceList()
+{
+	if ( isFinished() )
+		return;
+
+	if ( mSpeed==kAsFastAsPossible )
+	{
+		// Jump to the next recorded instant
+		mReplayTimeInUs = mReader.getRecord( mNextRecordIndex ).mTimeInUs;
+	}
+	else
+	{
+		int64_t timeInUs = Clock::getTimeInUs();
+		if ( mAnchorTimeInUs==0 )
+		{
+			mAnchorTimeInUs = timeInUs;
+			mAnchorReplayTimeInUs = mReplayTimeInUs;
+		}
+		mReplayTimeInUs = mAnchorReplayTimeInUs + static_cast<int64_t>( static_cast<double>(timeInUs - mAnchorTimeInUs) * mSpeed );
+	}
+
+	applyRecords( mReplayTimeInUs );
+}
+
+void ReplayDeviceManager::applyRecords( int64_t untilTimeInUs )
+{
+	while ( mNextRecordIndex<mReader.getNumRecords() )
+	{
+		const Record& record = mReader.getRecord( mNextRecordIndex );
+		if ( record.mTimeInUs>untilTimeInUs )
+			break;
+		
+		switch ( record.mKind )
+		{
+			case Record::kDeviceAttached:
+				createDevice( mNextRecordIndex );
+				break;
+
+			case Record::kDeviceDetached:
+			{
+				Device* device = findDevice( record.mSerialNumber );
+				if ( device )
+				{
+					mDevicesBySerialNumber.erase( record.mSerialNumber );
+					unregisterDevice( device );
+				}
+			}
+			break;
+
+			default:
+			{
+				// Device description records are consumed by createDevice(), the 
+				// measure records by the device itself
+				DevicesBySerialNumber::const_iterator itr = mDevicesBySerialNumber.find( record.mSerialNumber );
+				if ( itr!=mDevicesBySerialNumber.end() )
+					itr->second->setPendingRecord( record );
+			}
+			break;
+		}
+		++mNextRecordIndex;
+	}
+}
+
+void ReplayDeviceManager::createDevice( std::size_t attachedRecordIndex )
+{
+	const Record& attachedRecord = mReader.getRecord( attachedRecordIndex );
+	int serialNumber = attachedRecord.mSerialNumber;
+	if ( findDevice( serialNumber ) )
+		return;
+
+	// Gather the records of the device that follow. The ones specific to its type
+	// are handed to the device (see Device::setDescription())
+	std::string name;
+	std::string typeName;
+	std::size_t endRecordIndex = attachedRecordIndex+1;
+	for ( ; endRecordIndex<mReader.getNumRecords(); ++endRecordIndex )
+	{
+		const Record& record = mReader.getRecord( endRecordIndex );
+		if ( record.mSerialNumber!=serialNumber || record.mKind==Record::kDeviceAttached || record.mKind==Record::kDeviceDetached )
+			break;
+		if ( record.mKind==Record::kDeviceName )
+			name = std::string( record.mText );
+		else if ( record.mKind==Record::kDeviceTypeName )
+			typeName = std::string( record.mText );
+	}
+
+	ReplayDevice* replayDevice = createReplayDevice( attachedRecord.mDeviceInfo.mType, name, typeName, &attachedRecord, 
+													 endRecordIndex-attachedRecordIndex, DeviceTypes() );
+	if ( !replayDevice )
+		return;
+
+	mDevicesBySerialNumber[serialNumber] = replayDevice;
+	registerDevice( replayDevice->getDevice() );
+}
+
+template<typename T, typename... Rest>
+ReplayDeviceManager::ReplayDevice* ReplayDeviceManager::createReplayDevice( int type, const std::string& name, const std::string& typeName, 
+																			const Record* records, std::size_t numRecords, DeviceTypeList<T, Rest...> )
+{
+	if ( type==T::kType )
+		return new TypedReplayDevice<T>( name, typeName, records, numRecords );
+	return createReplayDevice( type, name, typeName, records, numRecords, DeviceTypeList<Rest...>() );
+}
+
+Device* ReplayDeviceManager::findDevice( int serialNumber ) const
+{
+	DevicesBySerialNumber::const_iterator itr = mDevicesBySerialNumber.find( serialNumber );
+	if ( itr==mDevicesBySerialNumber.end() )
+		return NULL;
+	return itr->second->getDevice();
+}
+
+}
@@ -0,0 +1,349 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiResampler.h"
+
+#include <assert.h>
+#include <algorithm>
+
+#include "RPhiClock.h"
+#include "RPhiDeviceTypes.h"
+
+/*
+	Notes
+	- Each stream knows whether it has what it takes to resample at the next frame
+	  time, and the Resampler counts the ready streams. A new measure only updates the
+	  readiness of its own stream, so the merge costs O(1) per measure plus O(number of
+	  streams) per frame, which is what building the frame costs anyway
+	- The measures are interpolated component by component, as 9 doubles
+	- A measure older than the newest one of its stream is ignored
+*/
+namespace RPhi
+{
+
+namespace
+{
+	enum { kNumComponents = 9 };
+
+	void toComponents( const Spatial::Measure& measure, double* components )
+	{
+		Vector3d vectors[3] = { measure.getAccelerationInGs(), measure.getAngularRateInDegPerSec(), measure.getMagneticFieldInGauss() };
+		for ( int i=0; i<3; ++i )
+		{
+			components[i*3] = vectors[i].x();
+			components[i*3+1] = vectors[i].y();
+			components[i*3+2] = vectors[i].z();
+		}
+	}
+
+	Spatial::Measure fromComponents( const double* components )
+	{
+		return Spatial::Measure( Vector3d( components[0], components[1], components[2] ), 
+								 Vector3d( components[3], components[4], components[5] ), 
+								 Vector3d( components[6], components[7], components[8] ) );
+	}
+}
+
+/*
+	Resampler
+*/
+Resampler::Resampler( DeviceManager* deviceManager, Consumer* consumer, int periodInUs, Interpolation interpolation, 
+					  int maxLatencyInUs, std::size_t numSamplesPerStream )
+	: mDeviceManager(deviceManager),
+	  mConsumer(consumer),
+	  mPeriodInUs(periodInUs),
+	  mInterpolation(interpolation),
+	  mMaxLatencyInUs(maxLatencyInUs),
+	  mNumSamplesPerStream( std::max( numSamplesPerStream, static_cast<std::size_t>(4) ) ),
+	  mStreams(),
+	  mStreamsByDevice(),
+	  mEntries(),
+	  mNumReadyStreams(0),
+	  mFrameTimeInUs(-1),
+	  mNewestTimeInUs(-1),
+	  mNumFrames(0),
+	  mNumHeldMeasures(0)
+{
+	assert( mDeviceManager );
+	assert( mConsumer );
+	assert( mPeriodInUs>0 );
+
+	// Start with the Spatials already there
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+Resampler::~Resampler()
+{
+	mDeviceManager->removeListener( this );
+	for ( std::size_t i=0; i<mStreams.size(); ++i )
+	{
+		mStreams[i]->mSpatial->removeListener( this );
+		delete mStreams[i];
+	}
+}
+
+void Resampler::flush()
+{
+	emitFrames( true );
+}
+
+void Resampler::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	Spatial* spatial = deviceCast<Spatial>( device );
+	if ( !spatial )
+		return;
+
+	Stream* stream = new Stream();
+	stream->mSpatial = spatial;
+	stream->mSamples.resize( mNumSamplesPerStream );
+	stream->mNumSamples = 0;
+	stream->mNewestIndex = 0;
+	stream->mReady = false;
+	mStreams.push_back( stream );
+	mStreamsByDevice[device] = stream;
+	mEntries.resize( mStreams.size() );
+	spatial->addListener( this );
+
+	if ( spatial->getMeasureTimeInUs()>=0 )
+		addSample( *stream, spatial->getMeasureTimeInUs(), spatial->getMeasure() );
+}
+
+void Resampler::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	StreamsByDevice::iterator itr = mStreamsByDevice.find( device );
+	if ( itr==mStreamsByDevice.end() )
+		return;
+
+	Stream* stream = itr->second;
+	device->removeListener( this );
+	mStreamsByDevice.erase( itr );
+	mStreams.erase( std::find( mStreams.begin(), mStreams.end(), stream ) );
+	if ( stream->mReady )
+		mNumReadyStreams--;
+	delete stream;
+	mEntries.resize( mStreams.size() );
+
+	// The frames may have been waiting for this Spatial only
+	emitFrames( false );
+}
+
+void Resampler::onDeviceChanged( Device* device )
+{
+	StreamsByDevice::iterator itr = mStreamsByDevice.find( device );
+	if ( itr==mStreamsByDevice.end() )
+		return;
+
+	Stream* stream = itr->second;
+	int64_t timeInUs = stream->mSpatial->getMeasureTimeInUs();
+	if ( timeInUs<0 )
+		timeInUs = Clock::getTimeInUs();
+	addSample( *stream, timeInUs, stream->mSpatial->getMeasure() );
+	emitFrames( false );
+}
+
+const Resampler::Sample& Resampler::getSample( const Stream& stream, std::size_t age ) const
+{
+	assert( age<stream.mNumSamples );
+	std::size_t capacity = stream.mSamples.size();
+	return stream.mSamples[ ( stream.mNewestIndex + capacity - age ) % capacity ];
+}
+
+void Resampler::addSample( Stream& stream, int64_t timeInUs, const Spatial::Measure& measure )
+{
+	if ( stream.mNumSamples>0 )
+	{
+		Sample& newestSample = stream.mSamples[stream.mNewestIndex];
+		if ( timeInUs<newestSample.mTimeInUs )
+			return;
+		if ( timeInUs==newestSample.mTimeInUs )
+		{
+			newestSample.mMeasure = measure;
+			return;
+		}
+		stream.mNewestIndex = ( stream.mNewestIndex + 1 ) % stream.mSamples.size();
+	}
+
+	Sample& sample = stream.mSamples[stream.mNewestIndex];
+	sample.mTimeInUs = timeInUs;
+	sample.mMeasure = measure;
+	if ( stream.mNumSamples<stream.mSamples.size() )
+		stream.mNumSamples++;
+
+	if ( timeInUs>mNewestTimeInUs )
+		mNewestTimeInUs = timeInUs;
+
+	// The grid starts with the first measure
+	if ( mFrameTimeInUs<0 )
+		mFrameTimeInUs = ( ( timeInUs + mPeriodInUs - 1 ) / mPeriodInUs ) * mPeriodInUs;
+
+	if ( !stream.mReady && isReady( stream ) )
+	{
+		stream.mReady = true;
+		mNumReadyStreams++;
+	}
+}
+
+bool Resampler::isReady( const Stream& stream ) const
+{
+	if ( mFrameTimeInUs<0 || stream.mNumSamples==0 )
+		return false;
+	
+	int64_t newestTimeInUs = getSample( stream, 0 ).mTimeInUs;
+	if ( newestTimeInUs<mFrameTimeInUs )
+		return false;
+	if ( mInterpolation==kLinear || newestTimeInUs==mFrameTimeInUs )
+		return true;
+
+	// The tangent at the measure following the frame time needs the next measure
+	return stream.mNumSamples>=2 && getSample( stream, 1 ).mTimeInUs>=mFrameTimeInUs;
+}
+
+void Resampler::updateReadyStreams()
+{
+	mNumReadyStreams = 0;
+	for ( std::size_t i=0; i<mStreams.size(); ++i )
+	{
+		Stream* stream = mStreams[i];
+		stream->mReady = isReady( *stream );
+		if ( stream->mReady )
+			mNumReadyStreams++;
+	}
+}
+
+void Resampler::emitFrames( bool force )
+{
+	while ( mFrameTimeInUs>=0 && !mStreams.empty() )
+	{
+		bool allReady = ( mNumReadyStreams==mStreams.size() );
+		bool late = ( mNewestTimeInUs - mFrameTimeInUs>=mMaxLatencyInUs );
+		bool forced = ( force && mFrameTimeInUs<=mNewestTimeInUs );
+		if ( !allReady && !late && !forced )
+			break;
+
+		for ( std::size_t i=0; i<mStreams.size(); ++i )
+		{
+			resample( *mStreams[i], mEntries[i] );
+			if ( mEntries[i].mState==Entry::kHeld )
+				mNumHeldMeasures++;
+		}
+
+		Frame frame;
+		frame.mTimeInUs = mFrameTimeInUs;
+		frame.mEntries = &mEntries[0];
+		frame.mNumEntries = mEntries.size();
+		mConsumer->onFrame( frame );
+		mNumFrames++;
+
+		mFrameTimeInUs += mPeriodInUs;
+		updateReadyStreams();
+	}
+}
+
+void Resampler::resample( const Stream& stream, Entry& entry ) const
+{
+	entry.mSpatial = stream.mSpatial;
+	if ( stream.mNumSamples==0 )
+	{
+		entry.mMeasure = Spatial::Measure();
+		entry.mState = Entry::kNoMeasure;
+		return;
+	}
+
+	// Find the newest measure at or before the frame time
+	std::size_t age = 0;
+	while ( age<stream.mNumSamples && getSample( stream, age ).mTimeInUs>mFrameTimeInUs )
+		age++;
+	
+	// The ring doesn't go back far enough: hold the oldest measure
+	if ( age==stream.mNumSamples )
+	{
+		entry.mMeasure = getSample( stream, age-1 ).mMeasure;
+		entry.mState = Entry::kHeld;
+		return;
+	}
+
+	const Sample& sample1 = getSample( stream, age );
+	if ( sample1.mTimeInUs==mFrameTimeInUs )
+	{
+		entry.mMeasure = sample1.mMeasure;
+		entry.mState = Entry::kInterpolated;
+		return;
+	}
+
+	// No measure after the frame time yet: hold the last one
+	if ( age==0 )
+	{
+		entry.mMeasure = sample1.mMeasure;
+		entry.mState = Entry::kHeld;
+		return;
+	}
+
+	const Sample& sample2 = getSample( stream, age-1 );
+	double components1[kNumComponents];
+	double components2[kNumComponents];
+	double result[kNumComponents];
+	toComponents( sample1.mMeasure, components1 );
+	toComponents( sample2.mMeasure, components2 );
+	double interval = static_cast<double>( sample2.mTimeInUs - sample1.mTimeInUs );
+	double u = static_cast<double>( mFrameTimeInUs - sample1.mTimeInUs ) / interval;
+
+	if ( mInterpolation==kLinear )
+	{
+		for ( int i=0; i<kNumComponents; ++i )
+			result[i] = components1[i] + u * ( components2[i] - components1[i] );
+	}
+	else
+	{
+		// Cubic Hermite spline, with the tangents taken from the neighbours. At the ends 
+		// of the ring, the measures around the frame time stand for the missing neighbours
+		const Sample& sample0 = age+1<stream.mNumSamples ? getSample( stream, age+1 ) : sample1;
+		const Sample& sample3 = age>=2 ? getSample( stream, age-2 ) : sample2;
+		double components0[kNumComponents];
+		double components3[kNumComponents];
+		toComponents( sample0.mMeasure, components0 );
+		toComponents( sample3.mMeasure, components3 );
+		double interval02 = static_cast<double>( sample2.mTimeInUs - sample0.mTimeInUs );
+		double interval13 = static_cast<double>( sample3.mTimeInUs - sample1.mTimeInUs );
+
+		double u2 = u * u;
+		double u3 = u2 * u;
+		double h00 = 2.0 * u3 - 3.0 * u2 + 1.0;
+		double h10 = u3 - 2.0 * u2 + u;
+		double h01 = -2.0 * u3 + 3.0 * u2;
+		double h11 = u3 - u2;
+		for ( int i=0; i<kNumComponents; ++i )
+		{
+			double tangent1 = ( components2[i] - components0[i] ) / interval02 * interval;
+			double tangent2 = ( components3[i] - components1[i] ) / interval13 * interval;
+			result[i] = h00 * components1[i] + h10 * tangent1 + h01 * components2[i] + h11 * tangent2;
+		}
+	}
+
+	entry.mMeasure = fromComponents( result );
+	entry.mState = Entry::kInterpolated;
+}
+
+}
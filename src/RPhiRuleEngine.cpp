@@ -0,0 +1,418 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiRuleEngine.h"
+
+#include <assert.h>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+#include "RPhiClock.h"
+#include "RPhiDeviceTypes.h"
+
+/*
+	Notes
+	- The batch reads each Signal once, then computes the raise and clear conditions 
+	  of every rule over contiguous arrays, with the signal value gathered by index. 
+	  There's no branch in that loop so the compiler can vectorize it. The state
+	  machine then only does work for the rules whose condition is met, which are few
+	- A NaN value (stale channel) fails both conditions, which is what keeps the 
+	  state of the active rules. The pending ones check for it explicitly
+	- Nothing is allocated after a device got connected, unless a rule gets added
+*/
+namespace RPhi
+{
+
+namespace
+{
+	double getComponent( const Vector3d& vector, int channel )
+	{
+		switch ( channel )
+		{
+			case 0: return vector.x();
+			case 1: return vector.y();
+			case 2: return vector.z();
+		}
+		return vector.getMagnitude();
+	}
+}
+
+/*
+	RuleEngine::Rule
+*/
+RuleEngine::Rule::Rule()
+	: mSerialNumber(kAnyDevice),
+	  mQuantity(kAcceleration),
+	  mChannel(kMagnitude),
+	  mComparison(kAbove),
+	  mThreshold(0.0),
+	  mHysteresis(0.0),
+	  mDurationInUs(0)
+{
+}
+
+RuleEngine::Rule::Rule( int serialNumber, Quantity quantity, int channel, Comparison comparison, double threshold, 
+						double hysteresis, int64_t durationInUs )
+	: mSerialNumber(serialNumber),
+	  mQuantity(quantity),
+	  mChannel(channel),
+	  mComparison(comparison),
+	  mThreshold(threshold),
+	  mHysteresis(hysteresis),
+	  mDurationInUs(durationInUs)
+{
+}
+
+/*
+	RuleEngine
+*/
+RuleEngine::RuleEngine( DeviceManager* deviceManager, Consumer* consumer )
+	: mDeviceManager(deviceManager),
+	  mConsumer(consumer),
+	  mRules(),
+	  mBlocks(),
+	  mBlocksByDevice(),
+	  mNumActiveAlarms(0),
+	  mNumEvaluations(0)
+{
+	assert( mDeviceManager );
+	assert( mConsumer );
+
+	// Start with the devices already there
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+RuleEngine::~RuleEngine()
+{
+	mDeviceManager->removeListener( this );
+	for ( std::size_t i=0; i<mBlocks.size(); ++i )
+	{
+		mBlocks[i]->mDevice->removeListener( this );
+		delete mBlocks[i];
+	}
+}
+
+std::size_t RuleEngine::addRule( const Rule& rule )
+{
+	std::size_t ruleIndex = mRules.size();
+	mRules.push_back( rule );
+	for ( std::size_t i=0; i<mBlocks.size(); ++i )
+	{
+		Block& block = *mBlocks[i];
+		std::size_t numSignals = block.mSignals.size();
+		compileRule( block, ruleIndex );
+		if ( block.mSignals.size()!=numSignals )
+			subscribe( block );
+	}
+	return ruleIndex;
+}
+
+void RuleEngine::update()
+{
+	int64_t clockTimeInUs = Clock::getTimeInUs();
+	for ( std::size_t i=0; i<mBlocks.size(); ++i )
+	{
+		// The time of the device goes on from its last evaluation, so that this 
+		// works the same with the measure times of a replay
+		Block& block = *mBlocks[i];
+		if ( block.mNumPending>0 )
+			promote( block, block.mTimeInUs + ( clockTimeInUs - block.mClockTimeInUs ) );
+	}
+}
+
+void RuleEngine::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	Block* block = new Block();
+	block->mDevice = device;
+	block->mChannelMask = 0;
+	block->mNumPending = 0;
+	block->mTimeInUs = 0;
+	block->mClockTimeInUs = 0;
+	for ( std::size_t i=0; i<mRules.size(); ++i )
+		compileRule( *block, i );
+	mBlocks.push_back( block );
+	mBlocksByDevice[device] = block;
+	subscribe( *block );
+}
+
+void RuleEngine::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	BlocksByDevice::iterator itr = mBlocksByDevice.find( device );
+	if ( itr==mBlocksByDevice.end() )
+		return;
+
+	Block* block = itr->second;
+	device->removeListener( this );
+	mBlocksByDevice.erase( itr );
+	mBlocks.erase( std::find( mBlocks.begin(), mBlocks.end(), block ) );
+
+	for ( std::size_t i=0; i<block->mStates.size(); ++i )
+	{
+		if ( block->mStates[i]!=kActive )
+			continue;
+		block->mStates[i] = kIdle;
+		block->mValues[ block->mSignalIndices[i] ] = std::numeric_limits<double>::quiet_NaN();
+		notify( *block, i, false, Clock::getTimeInUs() );
+	}
+	delete block;
+}
+
+void RuleEngine::onDeviceChanged( Device* device )
+{
+	BlocksByDevice::iterator itr = mBlocksByDevice.find( device );
+	if ( itr==mBlocksByDevice.end() )
+		return;
+	evaluate( *itr->second );
+}
+
+bool RuleEngine::hasSignal( const Device* device, const Signal& signal )
+{
+	switch ( signal.mQuantity )
+	{
+		case Rule::kAcceleration:
+		case Rule::kAngularRate:
+		case Rule::kMagneticField:
+			return deviceCast<Spatial>( device ) && signal.mChannel>=Rule::kMagnitude && signal.mChannel<3;
+
+		case Rule::kTemperature:
+		case Rule::kPotential:
+		{
+			const TemperatureSensor* temperatureSensor = deviceCast<TemperatureSensor>( device );
+			return temperatureSensor && signal.mChannel>=0 && 
+				   signal.mChannel<static_cast<int>( temperatureSensor->getThermocouples().size() );
+		}
+
+		case Rule::kAmbientTemperature:
+			return deviceCast<TemperatureSensor>( device )!=NULL;
+	}
+	return false;
+}
+
+void RuleEngine::compileRule( Block& block, std::size_t ruleIndex )
+{
+	const Rule& rule = mRules[ruleIndex];
+	if ( rule.mSerialNumber!=Rule::kAnyDevice && rule.mSerialNumber!=block.mDevice->getSerialNumber() )
+		return;
+
+	Signal signal;
+	signal.mQuantity = rule.mQuantity;
+	signal.mChannel = rule.mQuantity==Rule::kAmbientTemperature ? TemperatureSensor::kAmbientChannel : rule.mChannel;
+	if ( !hasSignal( block.mDevice, signal ) )
+		return;
+
+	// The rules of a device share its signals
+	std::size_t signalIndex = 0;
+	while ( signalIndex<block.mSignals.size() && 
+			( block.mSignals[signalIndex].mQuantity!=signal.mQuantity || block.mSignals[signalIndex].mChannel!=signal.mChannel ) )
+		signalIndex++;
+	if ( signalIndex==block.mSignals.size() )
+	{
+		block.mSignals.push_back( signal );
+		block.mValues.push_back( std::numeric_limits<double>::quiet_NaN() );
+	}
+
+	double sign = rule.mComparison==Rule::kAbove ? 1.0 : -1.0;
+	block.mRuleIndices.push_back( ruleIndex );
+	block.mSignalIndices.push_back( static_cast<uint32_t>(signalIndex) );
+	block.mSigns.push_back( sign );
+	block.mRaiseThresholds.push_back( sign * rule.mThreshold );
+	block.mClearThresholds.push_back( sign * rule.mThreshold - fabs(rule.mHysteresis) );
+	block.mDurationsInUs.push_back( rule.mDurationInUs );
+	block.mRaises.push_back( 0 );
+	block.mClears.push_back( 0 );
+	block.mStates.push_back( kIdle );
+	block.mPendingTimesInUs.push_back( 0 );
+}
+
+void RuleEngine::subscribe( Block& block )
+{
+	// The channels of a Spatial are its sensors, in the order of the quantities
+	Device::ChannelMask channelMask = 0;
+	bool isSpatial = deviceCast<Spatial>( block.mDevice )!=NULL;
+	for ( std::size_t i=0; i<block.mSignals.size(); ++i )
+	{
+		const Signal& signal = block.mSignals[i];
+		channelMask |= Device::getChannelMask( isSpatial ? static_cast<int>(signal.mQuantity) : signal.mChannel );
+	}
+
+	if ( channelMask==block.mChannelMask )
+		return;
+	if ( block.mChannelMask!=0 )
+		block.mDevice->removeListener( this );
+	if ( channelMask!=0 )
+		block.mDevice->addListener( this, channelMask );
+	block.mChannelMask = channelMask;
+}
+
+void RuleEngine::readValues( Block& block ) const
+{
+	const double kNaN = std::numeric_limits<double>::quiet_NaN();
+	const Spatial* spatial = deviceCast<Spatial>( block.mDevice );
+	const TemperatureSensor* temperatureSensor = deviceCast<TemperatureSensor>( block.mDevice );
+	for ( std::size_t i=0; i<block.mSignals.size(); ++i )
+	{
+		const Signal& signal = block.mSignals[i];
+		double value = kNaN;
+		switch ( signal.mQuantity )
+		{
+			case Rule::kAcceleration:
+				value = getComponent( spatial->getMeasure().getAccelerationInGs(), signal.mChannel );
+				break;
+			case Rule::kAngularRate:
+				value = getComponent( spatial->getMeasure().getAngularRateInDegPerSec(), signal.mChannel );
+				break;
+			case Rule::kMagneticField:
+				value = getComponent( spatial->getMeasure().getMagneticFieldInGauss(), signal.mChannel );
+				break;
+			case Rule::kTemperature:
+			case Rule::kPotential:
+			{
+				const TemperatureSensor::Thermocouple* thermocouple = temperatureSensor->getThermocouples()[signal.mChannel];
+				if ( !thermocouple->isMeasureStale() )
+					value = signal.mQuantity==Rule::kTemperature ? thermocouple->getMeasure().getTemperatureInC() : thermocouple->getMeasure().getPotentialInMV();
+				break;
+			}
+			case Rule::kAmbientTemperature:
+				if ( !temperatureSensor->isAmbientTemperatureStale() )
+					value = temperatureSensor->getAmbientTemperatureInC();
+				break;
+		}
+		block.mValues[i] = value;
+	}
+}
+
+void RuleEngine::evaluate( Block& block )
+{
+	std::size_t numRules = block.mStates.size();
+	if ( numRules==0 )
+		return;
+
+	int64_t clockTimeInUs = Clock::getTimeInUs();
+	int64_t timeInUs = clockTimeInUs;
+	const Spatial* spatial = deviceCast<Spatial>( block.mDevice );
+	if ( spatial && spatial->getMeasureTimeInUs()>=0 )
+		timeInUs = spatial->getMeasureTimeInUs();
+	block.mTimeInUs = timeInUs;
+	block.mClockTimeInUs = clockTimeInUs;
+
+	readValues( block );
+
+	// The batch
+	const double* values = &block.mValues[0];
+	const uint32_t* signalIndices = &block.mSignalIndices[0];
+	const double* signs = &block.mSigns[0];
+	const double* raiseThresholds = &block.mRaiseThresholds[0];
+	const double* clearThresholds = &block.mClearThresholds[0];
+	uint8_t* raises = &block.mRaises[0];
+	uint8_t* clears = &block.mClears[0];
+	for ( std::size_t i=0; i<numRules; ++i )
+	{
+		double value = signs[i] * values[ signalIndices[i] ];
+		raises[i] = value>raiseThresholds[i];
+		clears[i] = value<clearThresholds[i];
+	}
+	mNumEvaluations += numRules;
+
+	// The transitions
+	uint8_t* states = &block.mStates[0];
+	for ( std::size_t i=0; i<numRules; ++i )
+	{
+		switch ( states[i] )
+		{
+			case kIdle:
+				if ( !raises[i] )
+					break;
+				if ( block.mDurationsInUs[i]<=0 )
+				{
+					states[i] = kActive;
+					notify( block, i, true, timeInUs );
+				}
+				else
+				{
+					states[i] = kPending;
+					block.mPendingTimesInUs[i] = timeInUs;
+					block.mNumPending++;
+				}
+				break;
+
+			case kPending:
+			{
+				double value = values[ signalIndices[i] ];
+				if ( !raises[i] && value==value )
+				{
+					states[i] = kIdle;
+					block.mNumPending--;
+				}
+				break;
+			}
+
+			case kActive:
+				if ( clears[i] )
+				{
+					states[i] = kIdle;
+					notify( block, i, false, timeInUs );
+				}
+				break;
+		}
+	}
+
+	if ( block.mNumPending>0 )
+		promote( block, timeInUs );
+}
+
+void RuleEngine::promote( Block& block, int64_t timeInUs )
+{
+	for ( std::size_t i=0; i<block.mStates.size() && block.mNumPending>0; ++i )
+	{
+		if ( block.mStates[i]!=kPending || timeInUs - block.mPendingTimesInUs[i]<block.mDurationsInUs[i] )
+			continue;
+		block.mStates[i] = kActive;
+		block.mNumPending--;
+		notify( block, i, true, timeInUs );
+	}
+}
+
+void RuleEngine::notify( Block& block, std::size_t index, bool raised, int64_t timeInUs )
+{
+	Alarm alarm;
+	alarm.mRuleIndex = block.mRuleIndices[index];
+	alarm.mDevice = block.mDevice;
+	alarm.mValue = block.mValues[ block.mSignalIndices[index] ];
+	alarm.mTimeInUs = timeInUs;
+	if ( raised )
+	{
+		mNumActiveAlarms++;
+		mConsumer->onAlarmRaised( alarm );
+	}
+	else
+	{
+		mNumActiveAlarms--;
+		mConsumer->onAlarmCleared( alarm );
+	}
+}
+
+}
@@ -0,0 +1,173 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiSharedMemory.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+namespace RPhi
+{
+
+int SharedMemorySlot::getLatestRecordIndex( const Record& record )
+{
+	switch ( record.mKind )
+	{
+		case Record::kSpatialMeasure:
+			return 0;
+		case Record::kThermocoupleMeasure:
+			if ( record.mChannel<kMaxNumLatestThermocouples )
+				return record.mChannel;
+			break;
+		case Record::kAmbientTemperature:
+			return kNumLatestRecords-1;
+	}
+	return -1;
+}
+
+SharedMemorySegment::SharedMemorySegment( const std::string& name, std::size_t size )
+	: mName(name),
+	  mOwner(true),
+	  mMappingHandle(NULL),
+	  mData(NULL),
+	  mSize(size)
+{
+	assert( size>0 );
+	std::string systemName = getSystemName();
+#if _WIN32
+	// The mapping is backed by the paging file and is zero-filled
+	DWORD sizeHigh = static_cast<DWORD>( static_cast<unsigned long long>(mSize) >> 32 );
+	DWORD sizeLow = static_cast<DWORD>( mSize & 0xffffffff );
+	HANDLE mappingHandle = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, sizeHigh, sizeLow, systemName.c_str() );
+	if ( !mappingHandle )
+		return;
+	mMappingHandle = mappingHandle;
+	mData = MapViewOfFile( mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, mSize );
+	if ( !mData )
+	{
+		CloseHandle( mappingHandle );
+		mMappingHandle = NULL;
+	}
+#else
+	// Start from a fresh segment: readers still mapping a previous one keep it 
+	// until they close it
+	shm_unlink( systemName.c_str() );
+	int fd = shm_open( systemName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+	if ( fd<0 )
+		return;
+	if ( ftruncate( fd, static_cast<off_t>(mSize) )==0 )
+	{
+		void* data = mmap( NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if ( data!=MAP_FAILED )
+			mData = data;
+	}
+	::close( fd );
+	if ( !mData )
+		shm_unlink( systemName.c_str() );
+#endif
+}
+
+SharedMemorySegment::SharedMemorySegment( const std::string& name )
+	: mName(name),
+	  mOwner(false),
+	  mMappingHandle(NULL),
+	  mData(NULL),
+	  mSize(0)
+{
+	std::string systemName = getSystemName();
+#if _WIN32
+	HANDLE mappingHandle = OpenFileMappingA( FILE_MAP_READ, FALSE, systemName.c_str() );
+	if ( !mappingHandle )
+		return;
+	mMappingHandle = mappingHandle;
+	mData = MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+	MEMORY_BASIC_INFORMATION info;
+	if ( mData && VirtualQuery( mData, &info, sizeof(info) )==sizeof(info) )
+	{
+		mSize = info.RegionSize;
+	}
+	else 
+	{
+		if ( mData )
+			UnmapViewOfFile( mData );
+		mData = NULL;
+		CloseHandle( mappingHandle );
+		mMappingHandle = NULL;
+	}
+#else
+	int fd = shm_open( systemName.c_str(), O_RDONLY, 0 );
+	if ( fd<0 )
+		return;
+	struct stat fileStat;
+	if ( fstat( fd, &fileStat )==0 && fileStat.st_size>0 )
+	{
+		mSize = static_cast<std::size_t>( fileStat.st_size );
+		void* data = mmap( NULL, mSize, PROT_READ, MAP_SHARED, fd, 0 );
+		if ( data!=MAP_FAILED )
+			mData = data;
+	}
+	::close( fd );		// The mapping stays valid after the file descriptor is closed
+	if ( !mData )
+		mSize = 0;
+#endif
+}
+
+SharedMemorySegment::~SharedMemorySegment()
+{
+#if _WIN32
+	if ( mData )
+		UnmapViewOfFile( mData );
+	if ( mMappingHandle )
+		CloseHandle( mMappingHandle );
+#else
+	if ( mData )
+	{
+		munmap( mData, mSize );
+		if ( mOwner )
+			shm_unlink( getSystemName().c_str() );
+	}
+#endif
+}
+
+std::string SharedMemorySegment::getSystemName() const
+{
+#if _WIN32
+	return mName;
+#else
+	// POSIX shared memory names start with a single slash
+	if ( !mName.empty() && mName[0]=='/' )
+		return mName;
+	return "/" + mName;
+#endif
+}
+
+}
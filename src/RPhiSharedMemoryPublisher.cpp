@@ -0,0 +1,229 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiSharedMemoryPublisher.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+
+namespace RPhi
+{
+
+SharedMemoryPublisher::SharedMemoryPublisher( DeviceManager* deviceManager, const std::string& name, int numSlots, int ringSize )
+	: mDeviceManager(deviceManager),
+	  mSegment( name, sizeof(SharedMemoryHeader) + numSlots * SharedMemorySlot::getSize(ringSize) ),
+	  mHeader(NULL),
+	  mSlotIndices(),
+	  mRecords()
+{
+	assert( mDeviceManager );
+	assert( numSlots>0 );
+	assert( ringSize>0 );
+	assert( mSegment.isOpen() );
+	if ( !mSegment.isOpen() )
+		return;
+
+	// The segment is zero-filled. The magic is written last so that a reader 
+	// never sees a partially initialized header
+	SharedMemoryHeader* header = static_cast<SharedMemoryHeader*>( mSegment.getData() );
+	header->mVersion = kSharedMemoryVersion;
+	header->mRecordSize = sizeof(Record);
+	header->mNumSlots = static_cast<uint32_t>( numSlots );
+	header->mRingSize = static_cast<uint32_t>( ringSize );
+	header->mSlotSize = SharedMemorySlot::getSize( header->mRingSize );
+	header->mStartTimeInUs = Clock::getTimeInUs();
+	header->mPublishing.store( 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	memcpy( header->mMagic, kSharedMemoryMagic, sizeof(header->mMagic) );
+	mHeader = header;
+
+	mRecords.reserve( 64 );
+
+	// Publish the devices already there and start listening
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher()
+{
+	if ( !mHeader )
+		return;
+
+	mDeviceManager->removeListener( this );
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		(*itr)->removeListener( this );
+	
+	// Readers that still have the segment mapped can tell that nothing will change anymore
+	mHeader->mPublishing.store( 0, std::memory_order_release );
+}
+
+void SharedMemoryPublisher::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	SharedMemorySlot* slot = allocateSlot( device->getSerialNumber() );
+	if ( !slot )
+		return;
+
+	mRecords.clear();
+	RecordBuilder::appendDeviceDescription( device, Clock::getTimeInUs(), mRecords );
+	
+	beginSlotWrite( slot );
+	slot->mAttached = 1;
+	slot->mAttachedRecord = mRecords[0];
+	endSlotWrite( slot );
+	appendToRing( slot, &mRecords[0], mRecords.size() );
+
+	device->addListener( this );
+}
+
+void SharedMemoryPublisher::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	device->removeListener( this );
+	SharedMemorySlot* slot = findSlot( device->getSerialNumber() );
+	if ( !slot )
+		return;
+
+	mRecords.clear();
+	RecordBuilder::appendRecord( mRecords, Record::kDeviceDetached, device->getSerialNumber(), Clock::getTimeInUs() );
+
+	beginSlotWrite( slot );
+	slot->mAttached = 0;
+	endSlotWrite( slot );
+	appendToRing( slot, &mRecords[0], mRecords.size() );
+}
+
+void SharedMemoryPublisher::onDeviceChanged( Device* device )
+{
+	SharedMemorySlot* slot = findSlot( device->getSerialNumber() );
+	if ( !slot )
+		return;
+
+	mRecords.clear();
+	RecordBuilder::appendMeasures( device, Clock::getTimeInUs(), mRecords );
+	if ( mRecords.empty() )
+		return;
+
+	beginSlotWrite( slot );
+	for ( std::size_t i=0; i<mRecords.size(); ++i )
+	{
+		int index = SharedMemorySlot::getLatestRecordIndex( mRecords[i] );
+		if ( index>=0 )
+			slot->mLatestRecords[index] = mRecords[i];
+	}
+	endSlotWrite( slot );
+	appendToRing( slot, &mRecords[0], mRecords.size() );
+}
+
+SharedMemorySlot* SharedMemoryPublisher::getSlot( int index ) const
+{
+	char* slots = static_cast<char*>( mSegment.getData() ) + sizeof(SharedMemoryHeader);
+	return reinterpret_cast<SharedMemorySlot*>( slots + index * mHeader->mSlotSize );
+}
+
+SharedMemorySlot* SharedMemoryPublisher::findSlot( int serialNumber ) const
+{
+	SlotIndices::const_iterator itr = mSlotIndices.find( serialNumber );
+	if ( itr==mSlotIndices.end() )
+		return NULL;
+	return getSlot( itr->second );
+}
+
+SharedMemorySlot* SharedMemoryPublisher::allocateSlot( int serialNumber )
+{
+	if ( !mHeader )
+		return NULL;
+
+	SharedMemorySlot* slot = findSlot( serialNumber );
+	if ( slot )
+		return slot;
+
+	// Take the first free slot, or else the slot of a detached device
+	int numSlots = static_cast<int>( mHeader->mNumSlots );
+	int index = -1;
+	if ( static_cast<int>(mSlotIndices.size())<numSlots )
+	{
+		index = static_cast<int>( mSlotIndices.size() );
+	}
+	else
+	{
+		for ( SlotIndices::iterator itr=mSlotIndices.begin(); itr!=mSlotIndices.end(); ++itr )
+		{
+			if ( !getSlot(itr->second)->mAttached )
+			{
+				index = itr->second;
+				mSlotIndices.erase( itr );
+				break;
+			}
+		}
+	}
+	if ( index<0 )
+		return NULL;
+	
+	mSlotIndices[serialNumber] = index;
+	slot = getSlot( index );
+	
+	// The ring isn't cleared: readers tell the devices apart by the serial number of the records
+	beginSlotWrite( slot );
+	slot->mSerialNumber = serialNumber;
+	slot->mAttached = 0;
+	memset( &slot->mAttachedRecord, 0, sizeof(Record) );
+	memset( slot->mLatestRecords, 0, sizeof(slot->mLatestRecords) );
+	endSlotWrite( slot );
+	return slot;
+}
+
+void SharedMemoryPublisher::beginSlotWrite( SharedMemorySlot* slot )
+{
+	uint32_t sequence = slot->mSequence.load( std::memory_order_relaxed );
+	slot->mSequence.store( sequence+1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+}
+
+void SharedMemoryPublisher::endSlotWrite( SharedMemorySlot* slot )
+{
+	uint32_t sequence = slot->mSequence.load( std::memory_order_relaxed );
+	slot->mSequence.store( sequence+1, std::memory_order_release );
+}
+
+void SharedMemoryPublisher::appendToRing( SharedMemorySlot* slot, const Record* records, std::size_t numRecords )
+{
+	SharedMemoryRingEntry* entries = slot->getRingEntries();
+	uint64_t numRingRecords = slot->mNumRingRecords.load( std::memory_order_relaxed );
+	for ( std::size_t i=0; i<numRecords; ++i )
+	{
+		SharedMemoryRingEntry& entry = entries[numRingRecords % mHeader->mRingSize];
+		entry.mSequence.store( 2*numRingRecords+1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		entry.mRecord = records[i];
+		entry.mSequence.store( 2*(numRingRecords+1), std::memory_order_release );
+		++numRingRecords;
+		slot->mNumRingRecords.store( numRingRecords, std::memory_order_release );
+	}
+}
+
+}
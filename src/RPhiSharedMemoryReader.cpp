@@ -0,0 +1,193 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiSharedMemoryReader.h"
+
+#include <assert.h>
+#include <string.h>
+#include <thread>
+
+namespace RPhi
+{
+
+SharedMemoryReader::SharedMemoryReader( const std::string& name )
+	: mSegment(name),
+	  mHeader(NULL)
+{
+	if ( !mSegment.isOpen() || mSegment.getSize()<sizeof(SharedMemoryHeader) )
+		return;
+
+	// Check the header. The magic is written last by the publisher
+	const SharedMemoryHeader* header = static_cast<const SharedMemoryHeader*>( mSegment.getData() );
+	if ( memcmp( header->mMagic, kSharedMemoryMagic, sizeof(header->mMagic) )!=0 )
+		return;
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if ( header->mVersion!=kSharedMemoryVersion ||
+		 header->mRecordSize!=sizeof(Record) ||
+		 header->mRingSize==0 ||
+		 header->mSlotSize!=SharedMemorySlot::getSize(header->mRingSize) ||
+		 sizeof(SharedMemoryHeader) + header->mNumSlots * header->mSlotSize > mSegment.getSize() )
+		return;
+
+	mHeader = header;
+}
+
+bool SharedMemoryReader::isPublishing() const
+{
+	if ( !mHeader )
+		return false;
+	return mHeader->mPublishing.load( std::memory_order_acquire )!=0;
+}
+
+int SharedMemoryReader::getNumSlots() const
+{
+	if ( !mHeader )
+		return 0;
+	return static_cast<int>( mHeader->mNumSlots );
+}
+
+const SharedMemorySlot* SharedMemoryReader::getSlot( int slotIndex ) const
+{
+	assert( slotIndex>=0 && slotIndex<getNumSlots() );
+	const char* slots = static_cast<const char*>( mSegment.getData() ) + sizeof(SharedMemoryHeader);
+	return reinterpret_cast<const SharedMemorySlot*>( slots + slotIndex * mHeader->mSlotSize );
+}
+
+int SharedMemoryReader::findSlot( int serialNumber ) const
+{
+	int numSlots = getNumSlots();
+	for ( int i=0; i<numSlots; ++i )
+	{
+		int slotSerialNumber = 0;
+		uint32_t sequence;
+		do
+		{
+			sequence = beginRead( i );
+			slotSerialNumber = getSlot(i)->mSerialNumber;
+		}
+		while ( !endRead( i, sequence ) );
+		if ( slotSerialNumber==serialNumber )
+			return i;
+	}
+	return -1;
+}
+
+uint32_t SharedMemoryReader::beginRead( int slotIndex ) const
+{
+	const SharedMemorySlot* slot = getSlot( slotIndex );
+	uint32_t sequence = slot->mSequence.load( std::memory_order_acquire );
+	while ( sequence & 1 )
+	{
+		std::this_thread::yield();
+		sequence = slot->mSequence.load( std::memory_order_acquire );
+	}
+	return sequence;
+}
+
+bool SharedMemoryReader::endRead( int slotIndex, uint32_t sequence ) const
+{
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return getSlot(slotIndex)->mSequence.load( std::memory_order_relaxed )==sequence;
+}
+
+bool SharedMemoryReader::readDevice( int slotIndex, int& serialNumber, bool& attached, Record& attachedRecord ) const
+{
+	const SharedMemorySlot* slot = getSlot( slotIndex );
+	uint32_t sequence;
+	do
+	{
+		sequence = beginRead( slotIndex );
+		serialNumber = slot->mSerialNumber;
+		attached = slot->mAttached!=0;
+		attachedRecord = slot->mAttachedRecord;
+	}
+	while ( !endRead( slotIndex, sequence ) );
+	return serialNumber!=0;
+}
+
+bool SharedMemoryReader::readLatestRecord( int slotIndex, int latestRecordIndex, Record& record ) const
+{
+	assert( latestRecordIndex>=0 && latestRecordIndex<SharedMemorySlot::kNumLatestRecords );
+	const SharedMemorySlot* slot = getSlot( slotIndex );
+	uint32_t sequence;
+	do
+	{
+		sequence = beginRead( slotIndex );
+		record = slot->mLatestRecords[latestRecordIndex];
+	}
+	while ( !endRead( slotIndex, sequence ) );
+	return record.mKind!=0;
+}
+
+uint64_t SharedMemoryReader::getNumRingRecords( int slotIndex ) const
+{
+	return getSlot(slotIndex)->mNumRingRecords.load( std::memory_order_acquire );
+}
+
+std::size_t SharedMemoryReader::readRingRecords( int slotIndex, uint64_t& cursor, Record* records, std::size_t maxNumRecords, uint64_t* numLostRecords ) const
+{
+	const SharedMemorySlot* slot = getSlot( slotIndex );
+	const SharedMemoryRingEntry* entries = slot->getRingEntries();
+	uint64_t ringSize = mHeader->mRingSize;
+	std::size_t numRecords = 0;
+	while ( numRecords<maxNumRecords )
+	{
+		uint64_t numRingRecords = slot->mNumRingRecords.load( std::memory_order_acquire );
+		if ( cursor>=numRingRecords )
+			break;
+		
+		// Skip what the ring doesn't hold anymore
+		if ( numRingRecords-cursor > ringSize )
+		{
+			uint64_t oldestAvailable = numRingRecords - ringSize;
+			if ( numLostRecords )
+				*numLostRecords += oldestAvailable - cursor;
+			cursor = oldestAvailable;
+		}
+
+		// Copy the record and check it hasn't been overwritten in the meantime
+		const SharedMemoryRingEntry& entry = entries[cursor % ringSize];
+		uint64_t expectedSequence = 2*(cursor+1);
+		uint64_t sequence = entry.mSequence.load( std::memory_order_acquire );
+		if ( sequence==expectedSequence )
+		{
+			records[numRecords] = entry.mRecord;
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if ( entry.mSequence.load( std::memory_order_relaxed )==expectedSequence )
+			{
+				++numRecords;
+				++cursor;
+				continue;
+			}
+		}
+		
+		// The entry has been (or is being) overwritten: the publisher has lapped 
+		// the cursor. The next iteration moves on to the oldest record available
+		if ( numLostRecords )
+			*numLostRecords += 1;
+		++cursor;
+	}
+	return numRecords;
+}
+
+}
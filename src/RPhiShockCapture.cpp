@@ -0,0 +1,267 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiShockCapture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sstream>
+
+#include "RPhiClock.h"
+#include "RPhiDeviceTypes.h"
+#include "RPhiRecordBuilder.h"
+
+/*
+	Notes
+	- At the trigger, the samples of the pre-trigger window are copied out of the ring 
+	  into the Capture, whose vector is sized for the post-trigger window as well. So 
+	  the measures of the post-trigger window are appended without allocating
+	- The capture file has no index: RecordingReader works without it
+*/
+namespace RPhi
+{
+
+/*
+	ShockCapture::Configuration
+*/
+ShockCapture::Configuration::Configuration()
+	: mPreTriggerInUs(2000000),
+	  mPostTriggerInUs(1000000),
+	  mAccelerationThresholdInGs(4.0),
+	  mJerkThresholdInGsPerSecond(0.0),
+	  mNumSamplesPerStream(4096),
+	  mOutputDirectory()
+{
+}
+
+/*
+	ShockCapture::Capture
+*/
+bool ShockCapture::Capture::write( const std::string& filename ) const
+{
+	FILE* file = fopen( filename.c_str(), "wb" );
+	if ( !file )
+		return false;
+
+	RecordingHeader header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.mMagic, kRecordingMagic, sizeof(header.mMagic) );
+	header.mVersion = kRecordingVersion;
+	header.mRecordSize = sizeof(Record);
+	header.mStartTimeInUs = mSamples.empty() ? mTriggerTimeInUs : mSamples.front().mTimeInUs;
+
+	// The description is timestamped with the first sample, so that the replay starts there
+	std::vector<Record> records( mDescription );
+	for ( std::size_t i=0; i<records.size(); ++i )
+		records[i].mTimeInUs = header.mStartTimeInUs;
+	int serialNumber = mSpatial->getSerialNumber();
+	for ( std::size_t i=0; i<mSamples.size(); ++i )
+		RecordBuilder::appendSpatialMeasure( mSamples[i].mMeasure, serialNumber, mSamples[i].mTimeInUs, records );
+	int64_t endTimeInUs = mSamples.empty() ? mTriggerTimeInUs : mSamples.back().mTimeInUs;
+	RecordBuilder::appendRecord( records, Record::kDeviceDetached, serialNumber, endTimeInUs );
+
+	bool written = fwrite( &header, sizeof(header), 1, file )==1 &&
+				   fwrite( &records[0], sizeof(Record), records.size(), file )==records.size();
+	written = ( fclose( file )==0 ) && written;
+	return written;
+}
+
+/*
+	ShockCapture
+*/
+ShockCapture::ShockCapture( DeviceManager* deviceManager, Consumer* consumer, const Configuration& configuration )
+	: mDeviceManager(deviceManager),
+	  mConsumer(consumer),
+	  mConfiguration(configuration),
+	  mStreamsByDevice(),
+	  mNumCaptures(0)
+{
+	assert( mDeviceManager );
+	assert( mConsumer );
+	assert( mConfiguration.mNumSamplesPerStream>0 );
+
+	// Start with the Spatials already there
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+ShockCapture::~ShockCapture()
+{
+	mDeviceManager->removeListener( this );
+	for ( StreamsByDevice::iterator itr=mStreamsByDevice.begin(); itr!=mStreamsByDevice.end(); ++itr )
+	{
+		Stream* stream = itr->second;
+		stream->mSpatial->removeListener( this );
+		delete stream->mCapture;
+		delete stream;
+	}
+}
+
+void ShockCapture::trigger( const Spatial* spatial )
+{
+	for ( StreamsByDevice::iterator itr=mStreamsByDevice.begin(); itr!=mStreamsByDevice.end(); ++itr )
+	{
+		Stream& stream = *itr->second;
+		if ( spatial && stream.mSpatial!=spatial )
+			continue;
+		if ( stream.mCapture )
+			continue;
+
+		// The trigger time follows the measure times, which may be those of a replay
+		int64_t timeInUs = stream.mNumSamples>0 ? stream.mSamples[stream.mNewestIndex].mTimeInUs : Clock::getTimeInUs();
+		startCapture( stream, kExternal, 0.0, timeInUs );
+	}
+}
+
+void ShockCapture::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	Spatial* spatial = deviceCast<Spatial>( device );
+	if ( !spatial )
+		return;
+
+	Stream* stream = new Stream();
+	stream->mSpatial = spatial;
+	stream->mSamples.resize( mConfiguration.mNumSamplesPerStream );
+	stream->mNumSamples = 0;
+	stream->mNewestIndex = 0;
+	stream->mCapture = NULL;
+	mStreamsByDevice[device] = stream;
+	spatial->addListener( this );
+}
+
+void ShockCapture::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	StreamsByDevice::iterator itr = mStreamsByDevice.find( device );
+	if ( itr==mStreamsByDevice.end() )
+		return;
+
+	// Hand over what was captured so far
+	Stream* stream = itr->second;
+	if ( stream->mCapture )
+		endCapture( *stream );
+	device->removeListener( this );
+	mStreamsByDevice.erase( itr );
+	delete stream;
+}
+
+void ShockCapture::onDeviceChanged( Device* device )
+{
+	StreamsByDevice::iterator itr = mStreamsByDevice.find( device );
+	if ( itr==mStreamsByDevice.end() )
+		return;
+
+	Stream& stream = *itr->second;
+	int64_t timeInUs = stream.mSpatial->getMeasureTimeInUs();
+	if ( timeInUs<0 )
+		timeInUs = Clock::getTimeInUs();
+	addSample( stream, timeInUs, stream.mSpatial->getMeasure() );
+}
+
+void ShockCapture::addSample( Stream& stream, int64_t timeInUs, const Spatial::Measure& measure )
+{
+	// The jerk from the previous sample
+	double jerk = 0.0;
+	if ( stream.mNumSamples>0 )
+	{
+		const Sample& previousSample = stream.mSamples[stream.mNewestIndex];
+		int64_t durationInUs = timeInUs - previousSample.mTimeInUs;
+		if ( durationInUs<=0 )
+			return;
+		Vector3d acceleration = measure.getAccelerationInGs();
+		Vector3d previousAcceleration = previousSample.mMeasure.getAccelerationInGs();
+		Vector3d change( acceleration.x() - previousAcceleration.x(), acceleration.y() - previousAcceleration.y(), acceleration.z() - previousAcceleration.z() );
+		jerk = change.getMagnitude() * 1000000.0 / static_cast<double>( durationInUs );
+		stream.mNewestIndex = ( stream.mNewestIndex + 1 ) % stream.mSamples.size();
+	}
+
+	Sample& sample = stream.mSamples[stream.mNewestIndex];
+	sample.mTimeInUs = timeInUs;
+	sample.mMeasure = measure;
+	if ( stream.mNumSamples<stream.mSamples.size() )
+		stream.mNumSamples++;
+
+	if ( stream.mCapture )
+	{
+		stream.mCapture->mSamples.push_back( sample );
+		if ( timeInUs - stream.mCapture->mTriggerTimeInUs >= mConfiguration.mPostTriggerInUs )
+			endCapture( stream );
+		return;
+	}
+
+	double acceleration = measure.getAccelerationInGs().getMagnitude();
+	if ( mConfiguration.mAccelerationThresholdInGs>0.0 && acceleration>mConfiguration.mAccelerationThresholdInGs )
+		startCapture( stream, kAcceleration, acceleration, timeInUs );
+	else if ( mConfiguration.mJerkThresholdInGsPerSecond>0.0 && jerk>mConfiguration.mJerkThresholdInGsPerSecond )
+		startCapture( stream, kJerk, jerk, timeInUs );
+}
+
+void ShockCapture::startCapture( Stream& stream, Reason reason, double triggerValue, int64_t triggerTimeInUs )
+{
+	Capture* capture = new Capture();
+	capture->mSpatial = stream.mSpatial;
+	capture->mReason = reason;
+	capture->mTriggerValue = triggerValue;
+	capture->mTriggerTimeInUs = triggerTimeInUs;
+	RecordBuilder::appendDeviceDescription( stream.mSpatial, triggerTimeInUs, capture->mDescription );
+
+	// Room for the post-trigger window at the current data rate
+	int64_t periodInUs = static_cast<int64_t>( stream.mSpatial->getDataRateInMs() ) * 1000;
+	std::size_t numPostTriggerSamples = periodInUs>0 ? static_cast<std::size_t>( mConfiguration.mPostTriggerInUs / periodInUs ) : 0;
+	capture->mSamples.reserve( stream.mNumSamples + numPostTriggerSamples + 16 );
+
+	// The pre-trigger window, oldest sample first
+	std::size_t capacity = stream.mSamples.size();
+	for ( std::size_t age=stream.mNumSamples; age>0; --age )
+	{
+		const Sample& sample = stream.mSamples[ ( stream.mNewestIndex + capacity - (age-1) ) % capacity ];
+		if ( triggerTimeInUs - sample.mTimeInUs <= mConfiguration.mPreTriggerInUs )
+			capture->mSamples.push_back( sample );
+	}
+	stream.mCapture = capture;
+
+	if ( mConfiguration.mPostTriggerInUs<=0 )
+		endCapture( stream );
+}
+
+void ShockCapture::endCapture( Stream& stream )
+{
+	Capture* capture = stream.mCapture;
+	stream.mCapture = NULL;
+	mNumCaptures++;
+
+	if ( !mConfiguration.mOutputDirectory.empty() )
+	{
+		std::stringstream filename;
+		filename << mConfiguration.mOutputDirectory << "/capture_" << stream.mSpatial->getSerialNumber() << "_" << capture->mTriggerTimeInUs << ".rec";
+		if ( capture->write( filename.str() ) )
+			capture->mFilename = filename.str();
+	}
+
+	mConsumer->onCapture( *capture );
+	delete capture;
+}
+
+}
@@ -0,0 +1,315 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiSocket.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <mutex>
+
+#if _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <netdb.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <arpa/inet.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <sys/socket.h>
+#endif
+
+namespace RPhi
+{
+
+#if _WIN32
+	const Socket::Handle Socket::kInvalidHandle = INVALID_SOCKET;
+#else
+	const Socket::Handle Socket::kInvalidHandle = -1;
+#endif
+
+namespace
+{
+	void initialize()
+	{
+#if _WIN32
+		static std::once_flag initialized;
+		std::call_once( initialized, []() 
+			{
+				WSADATA data;
+				WSAStartup( MAKEWORD(2, 2), &data );
+			} );
+#endif
+	}
+
+	bool setNonBlocking( Socket::Handle handle )
+	{
+#if _WIN32
+		u_long nonBlocking = 1;
+		return ioctlsocket( handle, FIONBIO, &nonBlocking )==0;
+#else
+		int flags = fcntl( handle, F_GETFL, 0 );
+		return flags>=0 && fcntl( handle, F_SETFL, flags | O_NONBLOCK )==0;
+#endif
+	}
+
+	bool wouldBlock()
+	{
+#if _WIN32
+		int error = WSAGetLastError();
+		return error==WSAEWOULDBLOCK || error==WSAEINPROGRESS;
+#else
+		return errno==EAGAIN || errno==EWOULDBLOCK || errno==EINPROGRESS || errno==EINTR;
+#endif
+	}
+
+	void setupStreamSocket( Socket::Handle handle )
+	{
+		// Frames are sent as soon as they are ready
+		int noDelay = 1;
+		setsockopt( handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay) );
+#ifdef SO_NOSIGPIPE
+		int noSigPipe = 1;
+		setsockopt( handle, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe) );
+#endif
+		setNonBlocking( handle );
+	}
+
+	bool resolveAddress( const std::string& host, int port, int socketType, sockaddr_in& address )
+	{
+		addrinfo hints;
+		memset( &hints, 0, sizeof(hints) );
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = socketType;
+		char portText[16];
+		snprintf( portText, sizeof(portText), "%d", port );
+		addrinfo* result = NULL;
+		if ( getaddrinfo( host.c_str(), portText, &hints, &result )!=0 || !result )
+			return false;
+		memcpy( &address, result->ai_addr, sizeof(address) );
+		freeaddrinfo( result );
+		return true;
+	}
+}
+
+Socket::Handle Socket::createTcpListener( int port, int& boundPort )
+{
+	initialize();
+	Handle handle = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if ( handle==kInvalidHandle )
+		return kInvalidHandle;
+
+	int reuseAddress = 1;
+	setsockopt( handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress) );
+
+	sockaddr_in address;
+	memset( &address, 0, sizeof(address) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl( INADDR_ANY );
+	address.sin_port = htons( static_cast<unsigned short>(port) );
+	socklen_t addressSize = sizeof(address);
+	if ( bind( handle, reinterpret_cast<sockaddr*>(&address), sizeof(address) )!=0 ||
+		 listen( handle, 16 )!=0 ||
+		 getsockname( handle, reinterpret_cast<sockaddr*>(&address), &addressSize )!=0 ||
+		 !setNonBlocking( handle ) )
+	{
+		close( handle );
+		return kInvalidHandle;
+	}
+	boundPort = ntohs( address.sin_port );
+	return handle;
+}
+
+Socket::Handle Socket::accept( Handle listener )
+{
+	Handle handle = ::accept( listener, NULL, NULL );
+	if ( handle==kInvalidHandle )
+		return kInvalidHandle;
+	setupStreamSocket( handle );
+	return handle;
+}
+
+Socket::Handle Socket::connectTcp( const std::string& host, int port )
+{
+	initialize();
+	sockaddr_in address;
+	if ( !resolveAddress( host, port, SOCK_STREAM, address ) )
+		return kInvalidHandle;
+
+	Handle handle = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if ( handle==kInvalidHandle )
+		return kInvalidHandle;
+
+	// Connect in blocking mode, then switch to non-blocking
+	if ( connect( handle, reinterpret_cast<sockaddr*>(&address), sizeof(address) )!=0 )
+	{
+		close( handle );
+		return kInvalidHandle;
+	}
+	setupStreamSocket( handle );
+	return handle;
+}
+
+Socket::Handle Socket::createMulticastSender( const std::string& groupAddress, int port, int timeToLive )
+{
+	initialize();
+	sockaddr_in address;
+	if ( !resolveAddress( groupAddress, port, SOCK_DGRAM, address ) )
+		return kInvalidHandle;
+	
+	Handle handle = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( handle==kInvalidHandle )
+		return kInvalidHandle;
+
+	// The loopback is enabled so that subscribers can run on the publishing machine
+	unsigned char ttl = static_cast<unsigned char>(timeToLive);
+	unsigned char loop = 1;
+	setsockopt( handle, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&ttl), sizeof(ttl) );
+	setsockopt( handle, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char*>(&loop), sizeof(loop) );
+	
+	// Connecting a UDP socket only sets its default destination
+	if ( connect( handle, reinterpret_cast<sockaddr*>(&address), sizeof(address) )!=0 || !setNonBlocking( handle ) )
+	{
+		close( handle );
+		return kInvalidHandle;
+	}
+	return handle;
+}
+
+Socket::Handle Socket::createMulticastReceiver( const std::string& groupAddress, int port )
+{
+	initialize();
+	sockaddr_in groupSocketAddress;
+	if ( !resolveAddress( groupAddress, port, SOCK_DGRAM, groupSocketAddress ) )
+		return kInvalidHandle;
+
+	Handle handle = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( handle==kInvalidHandle )
+		return kInvalidHandle;
+
+	// Several receivers can listen to the same group on the same machine
+	int reuseAddress = 1;
+	setsockopt( handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress) );
+#ifdef SO_REUSEPORT
+	setsockopt( handle, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress) );
+#endif
+
+	sockaddr_in address;
+	memset( &address, 0, sizeof(address) );
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl( INADDR_ANY );
+	address.sin_port = htons( static_cast<unsigned short>(port) );
+
+	ip_mreq request;
+	memset( &request, 0, sizeof(request) );
+	request.imr_multiaddr = groupSocketAddress.sin_addr;
+	request.imr_interface.s_addr = htonl( INADDR_ANY );
+
+	if ( bind( handle, reinterpret_cast<sockaddr*>(&address), sizeof(address) )!=0 ||
+		 setsockopt( handle, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>(&request), sizeof(request) )!=0 ||
+		 !setNonBlocking( handle ) )
+	{
+		close( handle );
+		return kInvalidHandle;
+	}
+	return handle;
+}
+
+void Socket::close( Handle handle )
+{
+	if ( handle==kInvalidHandle )
+		return;
+#if _WIN32
+	closesocket( handle );
+#else
+	::close( handle );
+#endif
+}
+
+int Socket::send( Handle handle, const void* data, std::size_t size )
+{
+#if _WIN32
+	int result = ::send( handle, static_cast<const char*>(data), static_cast<int>(size), 0 );
+#elif defined(MSG_NOSIGNAL)
+	int result = static_cast<int>( ::send( handle, data, size, MSG_NOSIGNAL ) );
+#else
+	int result = static_cast<int>( ::send( handle, data, size, 0 ) );
+#endif
+	if ( result<0 )
+		return wouldBlock() ? 0 : -1;
+	return result;
+}
+
+int Socket::receive( Handle handle, void* data, std::size_t size )
+{
+#if _WIN32
+	int result = ::recv( handle, static_cast<char*>(data), static_cast<int>(size), 0 );
+#else
+	int result = static_cast<int>( ::recv( handle, data, size, 0 ) );
+#endif
+	if ( result<0 )
+		return wouldBlock() ? 0 : -1;
+	if ( result==0 )
+		return -1;
+	return result;
+}
+
+bool Socket::poll( PollEntries& entries, int timeoutInMs )
+{
+#if _WIN32
+	typedef WSAPOLLFD PollFd;
+#else
+	typedef pollfd PollFd;
+#endif
+	// Reused from one call to the next to avoid allocating memory
+	static thread_local std::vector<PollFd> pollFds;
+	pollFds.resize( entries.size() );
+	for ( std::size_t i=0; i<entries.size(); ++i )
+	{
+		pollFds[i].fd = entries[i].mHandle;
+		pollFds[i].events = static_cast<short>( ( entries[i].mWantRead ? POLLIN : 0 ) | ( entries[i].mWantWrite ? POLLOUT : 0 ) );
+		pollFds[i].revents = 0;
+	}
+
+#if _WIN32
+	int result = entries.empty() ? 0 : WSAPoll( &pollFds[0], static_cast<ULONG>(pollFds.size()), timeoutInMs );
+#else
+	int result = ::poll( entries.empty() ? NULL : &pollFds[0], static_cast<nfds_t>(pollFds.size()), timeoutInMs );
+#endif
+	if ( result<0 )
+		return false;
+
+	for ( std::size_t i=0; i<entries.size(); ++i )
+	{
+		short events = pollFds[i].revents;
+		entries[i].mReadable = ( events & (POLLIN | POLLERR | POLLHUP) )!=0;
+		entries[i].mWritable = ( events & POLLOUT )!=0;
+	}
+	return true;
+}
+
+}
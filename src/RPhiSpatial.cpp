@@ -25,8 +25,13 @@
 
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
 #include <phidget21.h>
 
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+#include "RPhiTrace.h"
+
 /*
 	Notes:
 	- Compass calibration support
@@ -44,10 +49,21 @@ Spatial::Spatial( CPhidgetHandle phidgetSpecificHandle )
 	  mNumAngularRateAxes(0),
 	  mNumMagneticFieldAxes(0),
 	  mDataRateInMs(0),
+	  mBaseDataRateInMs(0),
+	  mFastestDataRateInMs(0),
+	  mSlowestDataRateInMs(0),
+	  mListenerDataRatesInMs(),
 	  mMeasure(),
 	  mMinMeasure(),
-	  mMaxMeasure()
+	  mMaxMeasure(),
+	  mAcquiredMeasure(),
+	  mMeasureTimeInUs(-1),
+	  mLastSampleTimeInUs(-1),
+	  mSampleClockInUs(0),
+	  mNumLostSamplesBeforeMeasure(0)
 {	
+	initializeSensors();
+
 	// Get common Phidget information
 	getInformation();
 
@@ -59,8 +75,45 @@ Spatial::Spatial( CPhidgetHandle phidgetSpecificHandle )
 		mAngularRateZSignFix = -1.0;
 }
 
+Spatial::Spatial( const std::string& name, int serialNumber, int version, const std::string& typeName )
+	: Device( kSpatial, name, serialNumber, version, typeName ),
+	  mAngularRateZSignFix(1.0),
+	  mNumAccelerationAxes(0),
+	  mNumAngularRateAxes(0),
+	  mNumMagneticFieldAxes(0),
+	  mDataRateInMs(0),
+	  mBaseDataRateInMs(0),
+	  mFastestDataRateInMs(0),
+	  mSlowestDataRateInMs(0),
+	  mListenerDataRatesInMs(),
+	  mMeasure(),
+	  mMinMeasure(),
+	  mMaxMeasure(),
+	  mAcquiredMeasure(),
+	  mMeasureTimeInUs(-1),
+	  mLastSampleTimeInUs(-1),
+	  mSampleClockInUs(0),
+	  mNumLostSamplesBeforeMeasure(0)
+{
+	initializeSensors();
+}
+
+void Spatial::initializeSensors()
+{
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		mSensorEnabled[i] = true;
+		mSensorPollingPeriodsInUs[i] = 0;
+		mSensorPollTimesInUs[i] = -1;
+		mSensorTimesInUs[i] = -1;
+	}
+}
+
 Spatial::~Spatial()
 {
+	if ( !getPhidgetHandle() )
+		return;
+
 	// Close the device
 	int ret = EPHIDGET_OK;
 	ret = CPhidget_close( getPhidgetHandle() );
@@ -71,10 +124,38 @@ Spatial::~Spatial()
 	assert( ret==EPHIDGET_OK );
 }
 
+bool Spatial::isPhidgetDeviceID( int deviceID )
+{
+	return deviceID==PHIDID_SPATIAL_ACCEL_GYRO_COMPASS;
+}
+
+CPhidgetHandle Spatial::createPhidgetHandle()
+{
+	CPhidgetHandle handle = NULL;
+	int ret = CPhidgetSpatial_create( reinterpret_cast<CPhidgetSpatialHandle*>(&handle) );
+	assert( ret==EPHIDGET_OK );
+	if ( ret!=EPHIDGET_OK )
+		return NULL;
+	return handle;
+}
+
 // Not all data rates are available. 
 // See http://www.phidgets.com/docs/General_Phidget_Programming#Data_Rate
 bool Spatial::setDataRateInMs( int dataRateInMs )
 {
+	if ( !getPhidgetHandle() )
+		return false;
+
+	// The listeners declaring a data rate take precedence: the rate is only 
+	// checked against the range of the device, and applied later by applyDataRate()
+	if ( !mListenerDataRatesInMs.empty() )
+	{
+		if ( dataRateInMs<mFastestDataRateInMs || dataRateInMs>mSlowestDataRateInMs )
+			return false;
+		mBaseDataRateInMs = dataRateInMs;
+		return true;
+	}
+
 	int ret = CPhidgetSpatial_setDataRate( getSpatialHandle(), dataRateInMs );
 	
 	// Update cache value from Phidget device
@@ -83,94 +164,324 @@ bool Spatial::setDataRateInMs( int dataRateInMs )
 	if ( ret==EPHIDGET_INVALIDARG )
 		return false;
 	assert( ret==EPHIDGET_OK );
+	mBaseDataRateInMs = mDataRateInMs;
 	return true;
 }	
 
+void Spatial::setListenerDataRateInMs( Listener* listener, int dataRateInMs )
+{
+	assert( listener );
+	if ( dataRateInMs>0 )
+	{
+		mListenerDataRatesInMs[listener] = dataRateInMs;
+	}
+	else
+	{
+		if ( mListenerDataRatesInMs.erase( listener )==0 )
+			return;
+		setListenerDecimation( listener, 1 );		// The listener gets all the measures again
+	}
+	applyDataRate();
+}
+
+int Spatial::getListenerDataRateInMs( Listener* listener ) const
+{
+	ListenerDataRates::const_iterator itr = mListenerDataRatesInMs.find( listener );
+	if ( itr==mListenerDataRatesInMs.end() )
+		return 0;
+	return itr->second;
+}
+
+void Spatial::onListenerRemoved( Listener* listener )
+{
+	if ( mListenerDataRatesInMs.erase( listener )>0 )
+		applyDataRate();
+}
+
+void Spatial::applyDataRate()
+{
+	int dataRateInMs = mBaseDataRateInMs;
+	if ( !mListenerDataRatesInMs.empty() )
+	{
+		dataRateInMs = mSlowestDataRateInMs;
+		for ( ListenerDataRates::const_iterator itr=mListenerDataRatesInMs.begin(); itr!=mListenerDataRatesInMs.end(); ++itr )
+			dataRateInMs = std::min( dataRateInMs, itr->second );
+	}
+	dataRateInMs = std::max( dataRateInMs, mFastestDataRateInMs );
+
+	// Snap to the closest supported rate which is at least as fast
+	if ( getPhidgetHandle() && dataRateInMs!=mDataRateInMs )
+	{
+		int ret = CPhidgetSpatial_setDataRate( getSpatialHandle(), dataRateInMs );
+		while ( ret==EPHIDGET_INVALIDARG && dataRateInMs>mFastestDataRateInMs )
+			ret = CPhidgetSpatial_setDataRate( getSpatialHandle(), --dataRateInMs );
+		if ( ret!=EPHIDGET_OK )
+			countFailedCall();
+		internalGetDataRateInMs();
+	}
+	if ( mListenerDataRatesInMs.empty() )
+		mBaseDataRateInMs = mDataRateInMs;		// The deferred base rate, as snapped
+
+	// The listeners which need less get a subset of the measures
+	for ( ListenerDataRates::const_iterator itr=mListenerDataRatesInMs.begin(); itr!=mListenerDataRatesInMs.end(); ++itr )
+	{
+		unsigned int decimation = mDataRateInMs>0 ? static_cast<unsigned int>( itr->second / mDataRateInMs ) : 1;
+		setListenerDecimation( itr->first, decimation );
+	}
+}
+
 void Spatial::zeroGyro()
 {
+	if ( !getPhidgetHandle() )
+		return;
+
 	int ret = CPhidgetSpatial_zeroGyro( getSpatialHandle() );
 	assert( ret==EPHIDGET_OK );
 }
 
 void Spatial::update()
 {
-	// Get a new measure
+	RPHI_TRACE_SCOPE_ARG( "Spatial::update", "serial", getSerialNumber() );
+
+	// Get a new measure and update the current measure with it
+	int64_t timeInUs = Clock::getTimeInUs();
 	Measure measure;
-	updateMeasure( measure, mMeasure.getMagneticFieldInGauss() );
+	ChannelMask readSensors = updateMeasure( measure, mMeasure, getPolledChannels(), timeInUs );
+	setMeasure( measure, timeInUs, readSensors );
+}
 
-	// Update the current measure with the new one
-	if ( measure!=mMeasure )
+Spatial::ChannelMask Spatial::getPolledChannels() const
+{
+	ChannelMask enabledSensors = 0;
+	for ( int i=0; i<kNumSensors; ++i )
 	{
+		if ( mSensorEnabled[i] )
+			enabledSensors |= getChannelMask(i);
+	}
+	return enabledSensors;
+}
+
+void Spatial::acquire( ChannelMask polledChannels, bool resync, int64_t timeInUs, std::vector<Record>& records )
+{
+	RPHI_TRACE_SCOPE_ARG( "Spatial::acquire", "serial", getSerialNumber() );
+	Measure measure;
+	ChannelMask readSensors = updateMeasure( measure, mAcquiredMeasure, polledChannels, timeInUs );
+	
+	// An unchanged measure isn't handed over, so getSensorTimeInUs() keeps the time 
+	// of the last read which changed the measure
+	if ( measure==mAcquiredMeasure && !resync )
+		return;
+
+	// The channel of the record tells which sensors were read. As 0 stands for all of
+	// them (see getRecordChannels()), a resync which read none gets the bit past them
+	mAcquiredMeasure = measure;
+	RecordBuilder::appendSpatialMeasure( measure, getSerialNumber(), timeInUs, records );
+	records.back().mChannel = static_cast<uint16_t>( readSensors ? readSensors : getChannelMask(kNumSensors) );
+}
+
+Spatial::ChannelMask Spatial::applyRecord( const Record& record )
+{
+	if ( record.mKind!=Record::kSpatialMeasure )
+		return 0;
+
+	ChannelMask readSensors = getRecordChannels( record );
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		if ( readSensors & getChannelMask(i) )
+			mSensorTimesInUs[i] = record.mTimeInUs;
+	}
+
+	Measure measure = RecordBuilder::toSpatialMeasure( record.mSpatialMeasure );
+	ChannelMask changedSensors = getChangedSensors( measure, mMeasure );
+	if ( !changedSensors )
+		return 0;
+	detectGap( record.mTimeInUs, changedSensors );
+	addMeasureDelta( mMeasure, measure );
+	mMeasure = measure;
+	return changedSensors;
+}
+
+Spatial::ChannelMask Spatial::getRecordChannels( const Record& record ) const
+{
+	// The channel of a measure record tells which sensors were read. The records 
+	// which don't tell (recordings) have them all
+	return record.mChannel ? record.mChannel : kAllChannels;
+}
+
+void Spatial::appendDescription( std::size_t attachedRecordIndex, int64_t timeInUs, std::vector<Record>& records ) const
+{
+	Record::DeviceInfo& info = records[attachedRecordIndex].mDeviceInfo;
+	info.mNumAccelerationAxes = mNumAccelerationAxes;
+	info.mNumAngularRateAxes = mNumAngularRateAxes;
+	info.mNumMagneticFieldAxes = mNumMagneticFieldAxes;
+	info.mDataRateInMs = mDataRateInMs;
+	RecordBuilder::copySpatialMeasure( RecordBuilder::appendRecord( records, Record::kSpatialMinMeasure, getSerialNumber(), timeInUs ).mSpatialMeasure, mMinMeasure );
+	RecordBuilder::copySpatialMeasure( RecordBuilder::appendRecord( records, Record::kSpatialMaxMeasure, getSerialNumber(), timeInUs ).mSpatialMeasure, mMaxMeasure );
+}
+
+void Spatial::appendMeasures( ChannelMask channels, int64_t timeInUs, std::vector<Record>& records ) const
+{
+	if ( channels )
+		RecordBuilder::appendSpatialMeasure( mMeasure, getSerialNumber(), timeInUs, records );
+}
+
+void Spatial::setDescription( const Record* records, std::size_t numRecords )
+{
+	Measure minMeasure;
+	Measure maxMeasure;
+	for ( std::size_t i=1; i<numRecords; ++i )
+	{
+		if ( records[i].mKind==Record::kSpatialMinMeasure )
+			minMeasure = RecordBuilder::toSpatialMeasure( records[i].mSpatialMeasure );
+		else if ( records[i].mKind==Record::kSpatialMaxMeasure )
+			maxMeasure = RecordBuilder::toSpatialMeasure( records[i].mSpatialMeasure );
+	}
+	const Record::DeviceInfo& info = records[0].mDeviceInfo;
+	setSpatialInformation( info.mNumAccelerationAxes, info.mNumAngularRateAxes, info.mNumMagneticFieldAxes, 
+						   minMeasure, maxMeasure, info.mDataRateInMs );
+}
+
+void Spatial::setMeasure( const Measure& measure, int64_t timeInUs, ChannelMask readSensors )
+{
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		if ( readSensors & getChannelMask(i) )
+			mSensorTimesInUs[i] = timeInUs;
+	}
+
+	ChannelMask changedSensors = getChangedSensors( measure, mMeasure );
+	if ( changedSensors )
+	{
+		detectGap( timeInUs, changedSensors );
+		addMeasureDelta( mMeasure, measure );
 		mMeasure = measure;
 
 		// Notify
-		const Listeners& listeners = getListeners();
-		for ( Listeners::const_iterator itr=listeners.begin(); itr!=listeners.end(); ++itr )
-			(*itr)->onDeviceChanged( this );
+		notifyDeviceChanged( changedSensors );
+	}
+}
+
+void Spatial::addMeasureDelta( const Measure& oldMeasure, const Measure& newMeasure )
+{
+	Vector3d oldVectors[kNumSensors] = { oldMeasure.getAccelerationInGs(), oldMeasure.getAngularRateInDegPerSec(), oldMeasure.getMagneticFieldInGauss() };
+	Vector3d newVectors[kNumSensors] = { newMeasure.getAccelerationInGs(), newMeasure.getAngularRateInDegPerSec(), newMeasure.getMagneticFieldInGauss() };
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		addDeltaField( i, 0, oldVectors[i].x(), newVectors[i].x() );
+		addDeltaField( i, 1, oldVectors[i].y(), newVectors[i].y() );
+		addDeltaField( i, 2, oldVectors[i].z(), newVectors[i].z() );
 	}
 }
 
-void Spatial::updateMeasure( Measure& measure, const Vector3d& fallbackMagneticFieldInGauss )
+Spatial::ChannelMask Spatial::getChangedSensors( const Measure& measure, const Measure& previousMeasure )
+{
+	ChannelMask changedSensors = 0;
+	if ( measure.getAccelerationInGs()!=previousMeasure.getAccelerationInGs() )
+		changedSensors |= getChannelMask( kAccelerometer );
+	if ( measure.getAngularRateInDegPerSec()!=previousMeasure.getAngularRateInDegPerSec() )
+		changedSensors |= getChannelMask( kGyroscope );
+	if ( measure.getMagneticFieldInGauss()!=previousMeasure.getMagneticFieldInGauss() )
+		changedSensors |= getChannelMask( kMagnetometer );
+	return changedSensors;
+}
+
+void Spatial::setSpatialInformation( int numAccelerationAxes, int numAngularRateAxes, int numMagneticFieldAxes,
+									 const Measure& minMeasure, const Measure& maxMeasure, int dataRateInMs )
+{
+	mNumAccelerationAxes = numAccelerationAxes;
+	mNumAngularRateAxes = numAngularRateAxes;
+	mNumMagneticFieldAxes = numMagneticFieldAxes;
+	mMinMeasure = minMeasure;
+	mMaxMeasure = maxMeasure;
+	mDataRateInMs = dataRateInMs;
+	mBaseDataRateInMs = dataRateInMs;
+	mFastestDataRateInMs = dataRateInMs;
+	mSlowestDataRateInMs = dataRateInMs;
+	resetGapDetection();
+}
+
+Spatial::ChannelMask Spatial::updateMeasure( Measure& measure, const Measure& fallbackMeasure, ChannelMask enabledSensors, int64_t timeInUs )
 {	
 	CPhidgetSpatialHandle handle = getSpatialHandle();
 	int ret = EPHIDGET_OK;
-		
+
+	// Find the sensors due. The periods are atomic: they can be set while the acquisition thread polls
+	ChannelMask readSensors = 0;
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		if ( !(enabledSensors & getChannelMask(i)) )
+			continue;
+		int64_t periodInUs = mSensorPollingPeriodsInUs[i];
+		if ( periodInUs>0 && mSensorPollTimesInUs[i]>=0 && timeInUs - mSensorPollTimesInUs[i]<periodInUs && timeInUs>=mSensorPollTimesInUs[i] )
+			continue;
+		mSensorPollTimesInUs[i] = timeInUs;
+		readSensors |= getChannelMask(i);
+	}
+	
 	// Acceleration
-	double acc[3] = { 0.0, 0.0, 0.0 };
-	for ( int i=0; i<getNumAccelerationAxes(); ++i )
+	// It seems that on linux we can get a EPHIDGET_UNKNOWNVAL just after plugging a Spatial 
+	// back into the machine... The previous value is kept then
+	Vector3d fallbackAcc = fallbackMeasure.getAccelerationInGs();
+	double acc[3] = { fallbackAcc.x(), fallbackAcc.y(), fallbackAcc.z() };
+	int numAccelerationAxes = ( readSensors & getChannelMask(kAccelerometer) ) ? getNumAccelerationAxes() : 0;
+	for ( int i=0; i<numAccelerationAxes; ++i )
 	{
-		ret = CPhidgetSpatial_getAcceleration( handle, i, &acc[i] );
-		
-		// It seems that on linux we can get a EPHIDGET_UNKNOWNVAL just after 
-		// plugging a Spatial back into the machine... 
-		// Will need to fail more elegantly instead of asserting
-		//assert( ret==EPHIDGET_OK );
-		//assert( acc[i]!=PUNK_DBL );
-		if ( ret!=EPHIDGET_OK )
-			return;
+		RPHI_TRACE_SCOPE( "CPhidgetSpatial_getAcceleration" );
+		double value = 0.0;
+		ret = CPhidgetSpatial_getAcceleration( handle, i, &value );
+		acc[i] = checkValue( ret, value, acc[i] );
 	}
 	Vector3d accelerationInGs = Vector3d( acc[0], acc[1], acc[2] );
 	
 	// Angular rate 
-	double ang[3] = { 0.0, 0.0, 0.0 };
-	for ( int i=0; i<getNumAngularRateAxes(); ++i )
+	Vector3d fallbackAng = fallbackMeasure.getAngularRateInDegPerSec();
+	double ang[3] = { fallbackAng.x(), fallbackAng.y(), fallbackAng.z() };
+	int numAngularRateAxes = ( readSensors & getChannelMask(kGyroscope) ) ? getNumAngularRateAxes() : 0;
+	for ( int i=0; i<numAngularRateAxes; ++i )
 	{
-		ret = CPhidgetSpatial_getAngularRate( handle, i, &ang[i] );
-		assert( ret==EPHIDGET_OK );
-		assert( ang[i]!=PUNK_DBL );
+		RPHI_TRACE_SCOPE( "CPhidgetSpatial_getAngularRate" );
+		double value = 0.0;
+		ret = CPhidgetSpatial_getAngularRate( handle, i, &value );
+		if ( i==2 )
+			value *= mAngularRateZSignFix;	// Correct the value for the broken Spatial we've got
+		ang[i] = checkValue( ret, value, ang[i] );
 	}
-	ang[2] *= mAngularRateZSignFix;	// Correct the value for the broken Spatial we've got
 	Vector3d angularRateInDegPerSec = Vector3d( ang[0], ang[1], ang[2] );
 	
 	// Magnetic field
-	double mag[3] = { 0.0, 0.0, 0.0 };
-	for ( int i=0; i<getNumMagneticFieldAxes(); ++i )
+	// Every 2 seconds or so, the magnetometer is unavailable PUNK_DBL is returned as value, 
+	// while the call to CPhidgetSpatial_getMagneticField() as above returns EPHIDGET_UNKNOWNVAL.
+	// When this happens, we return the last valid magnetic field value. This seems like the 
+	// most sensible thing to do
+	Vector3d fallbackMag = fallbackMeasure.getMagneticFieldInGauss();
+	double mag[3] = { fallbackMag.x(), fallbackMag.y(), fallbackMag.z() };
+	int numMagneticFieldAxes = ( readSensors & getChannelMask(kMagnetometer) ) ? getNumMagneticFieldAxes() : 0;
+	for ( int i=0; i<numMagneticFieldAxes; ++i )
 	{
-		ret = CPhidgetSpatial_getMagneticField( handle, i, &mag[i] );
-		
-		// Every 2 seconds or so, the magnetometer is unavailable PUNK_DBL is returned as value, 
-		// while the call to CPhidgetSpatial_getMagneticField() as above returns EPHIDGET_UNKNOWNVAL.
-		// When this happens, we return the last valid magnetic field value. This seems like the 
-		// most sensible thing to do
-		if ( ret==EPHIDGET_UNKNOWNVAL )
-		{
-			assert( mag[i]==PUNK_DBL );
-			if (i==0)
-				mag[i] = fallbackMagneticFieldInGauss.x();
-			else if (i==1)
-				mag[i] = fallbackMagneticFieldInGauss.y();
-			else if (i==2)
-				mag[i] = fallbackMagneticFieldInGauss.z();
-		}
-		else
-		{
-			assert( mag[i]!=PUNK_DBL );
-		}
+		RPHI_TRACE_SCOPE( "CPhidgetSpatial_getMagneticField" );
+		double value = 0.0;
+		ret = CPhidgetSpatial_getMagneticField( handle, i, &value );
+		mag[i] = checkValue( ret, value, mag[i] );
 	}
 	Vector3d magneticFieldInGauss = Vector3d( mag[0], mag[1], mag[2] );
 
 	// Construct the new measure
 	measure = Measure( accelerationInGs, angularRateInDegPerSec, magneticFieldInGauss );
+	return readSensors;
+}
+
+double Spatial::checkValue( int ret, double value, double fallbackValue )
+{
+	if ( ret==EPHIDGET_OK )
+	{
+		assert( value!=PUNK_DBL );
+		return value;
+	}
+	if ( ret==EPHIDGET_UNKNOWNVAL )
+		countUnknownValue();
+	else
+		countFailedCall();
+	return fallbackValue;
 }
 
 void Spatial::getSpatialInformation()
@@ -191,6 +502,13 @@ void Spatial::getSpatialInformation()
 	mMaxMeasure = Measure( maxAcc, maxAng, maxMag );
 
 	internalGetDataRateInMs();
+	mBaseDataRateInMs = mDataRateInMs;
+
+	// The fastest rate is the smallest period
+	int ret = CPhidgetSpatial_getDataRateMin( getSpatialHandle(), &mFastestDataRateInMs );
+	assert( ret==EPHIDGET_OK );
+	ret = CPhidgetSpatial_getDataRateMax( getSpatialHandle(), &mSlowestDataRateInMs );
+	assert( ret==EPHIDGET_OK );
 }
 
 void Spatial::getAccelerationInformation( int& numAxes, Vector3d& min, Vector3d& max ) const
@@ -250,12 +568,58 @@ void Spatial::getMagneticFieldInformation( int& numAxes, Vector3d& min, Vector3d
 	max = Vector3d( maxValues[0], maxValues[1], maxValues[2] );
 }
 
+void Spatial::detectGap( int64_t timeInUs, ChannelMask changedSensors )
+{
+	mMeasureTimeInUs = timeInUs;
+	mNumLostSamplesBeforeMeasure = 0;
+
+	// A sensor polled less often skips samples on purpose
+	bool fullRate = false;
+	for ( int i=0; i<kNumSensors; ++i )
+	{
+		if ( ( changedSensors & getChannelMask(i) ) && mSensorEnabled[i] && mSensorPollingPeriodsInUs[i]<=0 )
+			fullRate = true;
+	}
+	if ( !fullRate )
+		return;
+
+	int64_t periodInUs = static_cast<int64_t>( mDataRateInMs ) * 1000;
+	if ( mLastSampleTimeInUs<0 || periodInUs<=0 || timeInUs<mLastSampleTimeInUs )
+	{
+		mLastSampleTimeInUs = timeInUs;
+		mSampleClockInUs = timeInUs;
+		return;
+	}
+
+	// Count the whole sample periods since the hardware produced the previous measure.
+	// A new measure can't be read before it's produced, so the sample clock is pulled 
+	// back to the read time whenever it runs ahead of it
+	int64_t numPeriods = ( timeInUs - mSampleClockInUs ) / periodInUs;
+	if ( numPeriods<1 )
+		numPeriods = 1;
+	mSampleClockInUs += numPeriods * periodInUs;
+	if ( mSampleClockInUs>timeInUs )
+		mSampleClockInUs = timeInUs;
+
+	Gap gap;
+	gap.mStartTimeInUs = mLastSampleTimeInUs;
+	gap.mEndTimeInUs = timeInUs;
+	gap.mNumLostSamples = static_cast<uint64_t>( numPeriods - 1 );
+	mLastSampleTimeInUs = timeInUs;
+	if ( gap.mNumLostSamples>0 )
+	{
+		mNumLostSamplesBeforeMeasure = gap.mNumLostSamples;
+		notifyDeviceGap( gap );
+	}
+}
+
 void Spatial::internalGetDataRateInMs()
 {
 	int dataRateInMs = 0;
 	int ret = CPhidgetSpatial_getDataRate( getSpatialHandle(), &dataRateInMs );
 	assert( ret==EPHIDGET_OK );
 	mDataRateInMs = dataRateInMs;
+	resetGapDetection();
 }
 
 std::string Spatial::toString() const
@@ -0,0 +1,358 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiStatistics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "RPhiClock.h"
+#include "RPhiDevice.h"
+#include "RPhiDeviceManager.h"
+
+/*
+	Notes:
+	- The bucket of a value v>=kNumSubBuckets is found from the position e of its 
+	  highest bit: the 3 bits below it give the sub-bucket. The buckets of the 
+	  power of two 2^e start at index (e-2)*kNumSubBuckets, right after the exact 
+	  buckets of the values below kNumSubBuckets
+	- The Prometheus histograms only expose the buckets starting at even powers 
+	  of two, from about 1us to about 17s: the power of two boundaries are exact
+	  in a LatencyHistogram, and that's plenty for dashboards
+*/
+namespace RPhi
+{
+
+namespace
+{
+	int getHighestBit( uint64_t value )
+	{
+		int bit = 0;
+		if ( value>>32 ) { value >>= 32; bit += 32; }
+		if ( value>>16 ) { value >>= 16; bit += 16; }
+		if ( value>>8 ) { value >>= 8; bit += 8; }
+		if ( value>>4 ) { value >>= 4; bit += 4; }
+		if ( value>>2 ) { value >>= 2; bit += 2; }
+		if ( value>>1 ) { bit += 1; }
+		return bit;
+	}
+
+	void copyCounts( const std::atomic<uint64_t>* counts, uint64_t* destination, int numCounts )
+	{
+		for ( int i=0; i<numCounts; ++i )
+			destination[i] = counts[i].load( std::memory_order_relaxed );
+	}
+}
+
+/*
+	LatencyHistogram
+*/
+LatencyHistogram::LatencyHistogram()
+	: mCount(0),
+	  mSumInNs(0),
+	  mMaxInNs(0)
+{
+	for ( int i=0; i<kNumBuckets; ++i )
+		mCounts[i].store( 0, std::memory_order_relaxed );
+}
+
+int LatencyHistogram::getBucketIndex( uint64_t durationInNs )
+{
+	if ( durationInNs<kNumSubBuckets )
+		return static_cast<int>(durationInNs);
+	int exponent = getHighestBit( durationInNs );
+	int index = (exponent-2) * kNumSubBuckets + static_cast<int>( (durationInNs >> (exponent-3)) & (kNumSubBuckets-1) );
+	return index<kNumBuckets ? index : kNumBuckets-1;
+}
+
+uint64_t LatencyHistogram::getBucketLowerBoundInNs( int index )
+{
+	if ( index<kNumSubBuckets )
+		return static_cast<uint64_t>(index);
+	int exponent = index / kNumSubBuckets + 2;
+	uint64_t subBucket = static_cast<uint64_t>( index % kNumSubBuckets );
+	return (kNumSubBuckets + subBucket) << (exponent-3);
+}
+
+void LatencyHistogram::record( uint64_t durationInNs )
+{
+	mCounts[ getBucketIndex(durationInNs) ].fetch_add( 1, std::memory_order_relaxed );
+	mCount.fetch_add( 1, std::memory_order_relaxed );
+	mSumInNs.fetch_add( durationInNs, std::memory_order_relaxed );
+	uint64_t maxInNs = mMaxInNs.load( std::memory_order_relaxed );
+	while ( durationInNs>maxInNs && !mMaxInNs.compare_exchange_weak( maxInNs, durationInNs, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+void LatencyHistogram::getSnapshot( Snapshot& snapshot ) const
+{
+	copyCounts( mCounts, snapshot.mCounts, kNumBuckets );
+	snapshot.mCount = mCount.load( std::memory_order_relaxed );
+	snapshot.mSumInNs = mSumInNs.load( std::memory_order_relaxed );
+	snapshot.mMaxInNs = mMaxInNs.load( std::memory_order_relaxed );
+}
+
+LatencyHistogram::Snapshot::Snapshot()
+	: mCount(0),
+	  mSumInNs(0),
+	  mMaxInNs(0)
+{
+	memset( mCounts, 0, sizeof(mCounts) );
+}
+
+uint64_t LatencyHistogram::Snapshot::getPercentileInNs( double percentile ) const
+{
+	if ( mCount==0 )
+		return 0;
+	uint64_t target = static_cast<uint64_t>( percentile / 100.0 * static_cast<double>(mCount) + 0.5 );
+	if ( target<1 )
+		target = 1;
+	uint64_t count = 0;
+	for ( int i=0; i<kNumBuckets; ++i )
+	{
+		count += mCounts[i];
+		if ( count>=target )
+		{
+			uint64_t upperBound = i+1<kNumBuckets ? getBucketLowerBoundInNs(i+1) : mMaxInNs;
+			return upperBound<mMaxInNs ? upperBound : mMaxInNs;
+		}
+	}
+	return mMaxInNs;
+}
+
+uint64_t LatencyHistogram::Snapshot::getCountBelowPowerOfTwo( int exponent ) const
+{
+	int endIndex = exponent<3 ? (1 << exponent) : (exponent-2) * kNumSubBuckets;
+	if ( endIndex>kNumBuckets )
+		endIndex = kNumBuckets;
+	uint64_t count = 0;
+	for ( int i=0; i<endIndex; ++i )
+		count += mCounts[i];
+	return count;
+}
+
+/*
+	DeviceStatistics
+*/
+DeviceStatistics::DeviceStatistics()
+	: mNumPolls(0),
+	  mNumChanges(0),
+	  mNumFailedCalls(0),
+	  mNumUnknownValues(0),
+	  mNumGaps(0),
+	  mNumLostSamples(0),
+	  mPollDuration(),
+	  mListenerDuration(),
+	  mSampleAge()
+{
+}
+
+/*
+	DeviceManagerStatistics
+*/
+DeviceManagerStatistics::DeviceManagerStatistics()
+	: mNumUpdates(0),
+	  mNumConnections(0),
+	  mNumDisconnections(0),
+	  mNumReattachments(0),
+	  mUpdateDuration(),
+	  mUpdateDeviceListDuration()
+{
+}
+
+/*
+	StatisticsSnapshot
+*/
+StatisticsSnapshot::StatisticsSnapshot()
+	: mTimeInUs(0),
+	  mNumUpdates(0),
+	  mNumConnections(0),
+	  mNumDisconnections(0),
+	  mNumReattachments(0),
+	  mNumDroppedAcquisitionRecords(0),
+	  mUpdateDuration(),
+	  mUpdateDeviceListDuration(),
+	  mDevices()
+{
+}
+
+void StatisticsSnapshot::take( const DeviceManager& deviceManager )
+{
+	const DeviceManagerStatistics& statistics = deviceManager.getStatistics();
+	mTimeInUs = Clock::getTimeInUs();
+	mNumUpdates = statistics.mNumUpdates;
+	mNumConnections = statistics.mNumConnections;
+	mNumDisconnections = statistics.mNumDisconnections;
+	mNumReattachments = statistics.mNumReattachments;
+	mNumDroppedAcquisitionRecords = deviceManager.getNumDroppedAcquisitionRecords();
+	statistics.mUpdateDuration.getSnapshot( mUpdateDuration );
+	statistics.mUpdateDeviceListDuration.getSnapshot( mUpdateDeviceListDuration );
+
+	const DeviceManager::Devices& devices = deviceManager.getDevices();
+	mDevices.resize( devices.size() );
+	for ( std::size_t i=0; i<devices.size(); ++i )
+	{
+		const RPhi::Device* device = devices[i];
+		const DeviceStatistics& deviceStatistics = device->getStatistics();
+		Device& deviceSnapshot = mDevices[i];
+		deviceSnapshot.mSerialNumber = device->getSerialNumber();
+		deviceSnapshot.mTypeName = device->getTypeName();
+		deviceSnapshot.mNumPolls = deviceStatistics.mNumPolls;
+		deviceSnapshot.mNumChanges = deviceStatistics.mNumChanges;
+		deviceSnapshot.mNumFailedCalls = deviceStatistics.mNumFailedCalls;
+		deviceSnapshot.mNumUnknownValues = deviceStatistics.mNumUnknownValues;
+		deviceSnapshot.mNumGaps = deviceStatistics.mNumGaps;
+		deviceSnapshot.mNumLostSamples = deviceStatistics.mNumLostSamples;
+		deviceStatistics.mPollDuration.getSnapshot( deviceSnapshot.mPollDuration );
+		deviceStatistics.mListenerDuration.getSnapshot( deviceSnapshot.mListenerDuration );
+		deviceStatistics.mSampleAge.getSnapshot( deviceSnapshot.mSampleAge );
+	}
+}
+
+namespace
+{
+	void appendFormat( std::string& text, const char* format, ... )
+	{
+		char buffer[512];
+		va_list arguments;
+		va_start( arguments, format );
+		int size = vsnprintf( buffer, sizeof(buffer), format, arguments );
+		va_end( arguments );
+		if ( size>0 )
+			text.append( buffer, static_cast<std::size_t>(size)<sizeof(buffer) ? static_cast<std::size_t>(size) : sizeof(buffer)-1 );
+	}
+
+	void appendHeader( std::string& text, const char* prefix, const char* name, const char* type, const char* help )
+	{
+		appendFormat( text, "# HELP %s_%s %s\n", prefix, name, help );
+		appendFormat( text, "# TYPE %s_%s %s\n", prefix, name, type );
+	}
+
+	// The labels of a device, escaped as required by the format
+	std::string getDeviceLabels( const StatisticsSnapshot::Device& device )
+	{
+		std::string labels;
+		appendFormat( labels, "serial=\"%d\",type=\"", device.mSerialNumber );
+		for ( std::size_t i=0; i<device.mTypeName.size(); ++i )
+		{
+			char c = device.mTypeName[i];
+			if ( c=='\\' || c=='"' )
+				labels += '\\';
+			if ( c=='\n' )
+				labels += "\\n";
+			else
+				labels += c;
+		}
+		labels += "\"";
+		return labels;
+	}
+
+	void appendHistogram( std::string& text, const char* prefix, const char* name, const std::string& labels, const LatencyHistogram::Snapshot& histogram )
+	{
+		const char* separator = labels.empty() ? "" : ",";
+		for ( int exponent=10; exponent<=34; exponent+=2 )
+		{
+			double boundInS = static_cast<double>( static_cast<uint64_t>(1) << exponent ) * 1e-9;
+			appendFormat( text, "%s_%s_bucket{%s%sle=\"%.9g\"} %llu\n", prefix, name, labels.c_str(), separator, boundInS, 
+						  static_cast<unsigned long long>( histogram.getCountBelowPowerOfTwo(exponent) ) );
+		}
+		appendFormat( text, "%s_%s_bucket{%s%sle=\"+Inf\"} %llu\n", prefix, name, labels.c_str(), separator, static_cast<unsigned long long>(histogram.mCount) );
+		const char* braceOpen = labels.empty() ? "" : "{";
+		const char* braceClose = labels.empty() ? "" : "}";
+		appendFormat( text, "%s_%s_sum%s%s%s %.9g\n", prefix, name, braceOpen, labels.c_str(), braceClose, static_cast<double>(histogram.mSumInNs) * 1e-9 );
+		appendFormat( text, "%s_%s_count%s%s%s %llu\n", prefix, name, braceOpen, labels.c_str(), braceClose, static_cast<unsigned long long>(histogram.mCount) );
+	}
+
+	void appendCounter( std::string& text, const char* prefix, const char* name, const char* help, uint64_t value )
+	{
+		appendHeader( text, prefix, name, "counter", help );
+		appendFormat( text, "%s_%s %llu\n", prefix, name, static_cast<unsigned long long>(value) );
+	}
+}
+
+std::string StatisticsSnapshot::toPrometheusText( const char* prefix ) const
+{
+	std::string text;
+
+	// DeviceManager
+	appendCounter( text, prefix, "updates_total", "Number of DeviceManager updates", mNumUpdates );
+	appendCounter( text, prefix, "device_connections_total", "Number of devices connected", mNumConnections );
+	appendCounter( text, prefix, "device_disconnections_total", "Number of devices disconnected", mNumDisconnections );
+	appendCounter( text, prefix, "device_reattachments_total", "Number of devices back before the end of their hold-off", mNumReattachments );
+	appendCounter( text, prefix, "dropped_acquisition_records_total", "Number of records dropped by the background acquisition", mNumDroppedAcquisitionRecords );
+	appendHeader( text, prefix, "update_duration_seconds", "histogram", "Duration of DeviceManager updates" );
+	appendHistogram( text, prefix, "update_duration_seconds", std::string(), mUpdateDuration );
+	appendHeader( text, prefix, "update_device_list_duration_seconds", "histogram", "Duration of the reconciliation of the device list" );
+	appendHistogram( text, prefix, "update_device_list_duration_seconds", std::string(), mUpdateDeviceListDuration );
+
+	// Devices. The samples of a metric must be grouped together
+	std::vector<std::string> labels( mDevices.size() );
+	for ( std::size_t i=0; i<mDevices.size(); ++i )
+		labels[i] = getDeviceLabels( mDevices[i] );
+
+	struct Counter
+	{
+		const char*					mName;
+		const char*					mHelp;
+		uint64_t Device::*			mValue;
+	};
+	const Counter counters[] = 
+	{
+		{ "device_polls_total", "Number of times the device was polled", &Device::mNumPolls },
+		{ "device_changes_total", "Number of changes of the device notified to the listeners", &Device::mNumChanges },
+		{ "device_failed_calls_total", "Number of C API calls on the device which failed", &Device::mNumFailedCalls },
+		{ "device_unknown_values_total", "Number of C API calls on the device which returned an unknown value", &Device::mNumUnknownValues },
+		{ "device_gaps_total", "Number of gaps detected in the measures of the device", &Device::mNumGaps },
+		{ "device_lost_samples_total", "Number of samples of the device lost in the gaps", &Device::mNumLostSamples }
+	};
+	for ( std::size_t c=0; c<sizeof(counters)/sizeof(counters[0]); ++c )
+	{
+		appendHeader( text, prefix, counters[c].mName, "counter", counters[c].mHelp );
+		for ( std::size_t i=0; i<mDevices.size(); ++i )
+			appendFormat( text, "%s_%s{%s} %llu\n", prefix, counters[c].mName, labels[i].c_str(), static_cast<unsigned long long>( mDevices[i].*counters[c].mValue ) );
+	}
+
+	struct Histogram
+	{
+		const char*							mName;
+		const char*							mHelp;
+		LatencyHistogram::Snapshot Device::*	mValue;
+	};
+	const Histogram histograms[] = 
+	{
+		{ "device_poll_duration_seconds", "Duration of the polling of the device", &Device::mPollDuration },
+		{ "device_listener_duration_seconds", "Duration of the notification of the listeners of the device", &Device::mListenerDuration },
+		{ "device_sample_age_seconds", "Age of the samples of the device when dispatched", &Device::mSampleAge }
+	};
+	for ( std::size_t h=0; h<sizeof(histograms)/sizeof(histograms[0]); ++h )
+	{
+		appendHeader( text, prefix, histograms[h].mName, "histogram", histograms[h].mHelp );
+		for ( std::size_t i=0; i<mDevices.size(); ++i )
+			appendHistogram( text, prefix, histograms[h].mName, labels[i], mDevices[i].*histograms[h].mValue );
+	}
+	return text;
+}
+
+}
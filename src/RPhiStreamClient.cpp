@@ -0,0 +1,196 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiStreamClient.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace RPhi
+{
+
+StreamClient::StreamClient()
+	: mHandle(Socket::kInvalidHandle),
+	  mIsMulticast(false),
+	  mFilters(),
+	  mInput(),
+	  mDecoder(),
+	  mNextSequenceNumber(0),
+	  mNumFramesReceived(0),
+	  mNumRecordsDropped(0),
+	  mNumFramesLost(0),
+	  mPollEntries(1)
+{
+}
+
+StreamClient::~StreamClient()
+{
+	close();
+}
+
+bool StreamClient::connect( const std::string& host, int port )
+{
+	close();
+	mHandle = Socket::connectTcp( host, port );
+	mIsMulticast = false;
+	return isConnected();
+}
+
+bool StreamClient::joinMulticastGroup( const std::string& groupAddress, int port )
+{
+	close();
+	mHandle = Socket::createMulticastReceiver( groupAddress, port );
+	mIsMulticast = true;
+	return isConnected();
+}
+
+void StreamClient::close()
+{
+	Socket::close( mHandle );
+	mHandle = Socket::kInvalidHandle;
+	mFilters.clear();
+	mInput.clear();
+	mNextSequenceNumber = 0;
+}
+
+bool StreamClient::subscribe( int serialNumber, Device::ChannelMask channelMask )
+{
+	if ( !isConnected() )
+		return false;
+
+	StreamProtocol::Filter filter;
+	filter.mSerialNumber = serialNumber;
+	filter.mChannelMask = channelMask;
+	mFilters.push_back( filter );
+	if ( mIsMulticast )
+		return true;
+
+	// Sending the request is done in blocking fashion, as it's small and rare
+	std::vector<uint8_t> buffer;
+	StreamProtocol::writeSubscribeFrame( buffer, mFilters );
+	std::size_t position = 0;
+	while ( position<buffer.size() )
+	{
+		int numSent = Socket::send( mHandle, &buffer[position], buffer.size()-position );
+		if ( numSent<0 )
+			return false;
+		if ( numSent==0 )
+		{
+			mPollEntries[0].mHandle = mHandle;
+			mPollEntries[0].mWantRead = false;
+			mPollEntries[0].mWantWrite = true;
+			Socket::poll( mPollEntries, 100 );
+		}
+		position += static_cast<std::size_t>(numSent);
+	}
+	return true;
+}
+
+bool StreamClient::receive( std::vector<Record>& records, int timeoutInMs )
+{
+	if ( !isConnected() )
+		return false;
+
+	mPollEntries[0].mHandle = mHandle;
+	mPollEntries[0].mWantRead = true;
+	mPollEntries[0].mWantWrite = false;
+	if ( !Socket::poll( mPollEntries, timeoutInMs ) )
+		return false;
+	if ( !mPollEntries[0].mReadable )
+		return true;
+
+	if ( mIsMulticast )
+	{
+		// One frame per datagram
+		uint8_t datagram[8192];
+		for ( ;; )
+		{
+			int numReceived = Socket::receive( mHandle, datagram, sizeof(datagram) );
+			if ( numReceived<=0 )
+				break;
+			decodeFrame( datagram, static_cast<std::size_t>(numReceived), records );
+		}
+		return true;
+	}
+
+	uint8_t buffer[16384];
+	for ( ;; )
+	{
+		int numReceived = Socket::receive( mHandle, buffer, sizeof(buffer) );
+		if ( numReceived<0 )
+		{
+			close();
+			return false;
+		}
+		if ( numReceived==0 )
+			break;
+		mInput.insert( mInput.end(), buffer, buffer+numReceived );
+	}
+
+	// Decode the complete frames
+	std::size_t position = 0;
+	for ( ;; )
+	{
+		std::size_t framePosition = position;
+		uint64_t frameSize = 0;
+		if ( !StreamProtocol::readVarint( mInput.empty() ? NULL : &mInput[0], mInput.size(), framePosition, frameSize ) || 
+			 mInput.size()-framePosition<frameSize )
+			break;
+		if ( !decodeFrame( &mInput[framePosition], static_cast<std::size_t>(frameSize), records ) )
+		{
+			close();
+			return false;
+		}
+		position = framePosition + static_cast<std::size_t>(frameSize);
+	}
+	mInput.erase( mInput.begin(), mInput.begin()+position );
+	return true;
+}
+
+bool StreamClient::decodeFrame( const uint8_t* data, std::size_t size, std::vector<Record>& records )
+{
+	std::size_t numInitialRecords = records.size();
+	if ( !mDecoder.decode( data, size, records ) )
+		return false;
+	
+	++mNumFramesReceived;
+	mNumRecordsDropped += mDecoder.getNumDroppedRecords();
+	if ( mDecoder.getSequenceNumber()>mNextSequenceNumber )
+		mNumFramesLost += mDecoder.getSequenceNumber() - mNextSequenceNumber;
+	mNextSequenceNumber = mDecoder.getSequenceNumber() + 1;
+
+	// The multicast group receives everything
+	if ( mIsMulticast && !mFilters.empty() )
+	{
+		std::size_t numKeptRecords = numInitialRecords;
+		for ( std::size_t i=numInitialRecords; i<records.size(); ++i )
+		{
+			if ( StreamProtocol::matches( mFilters, records[i] ) )
+				records[numKeptRecords++] = records[i];
+		}
+		records.resize( numKeptRecords );
+	}
+	return true;
+}
+
+}
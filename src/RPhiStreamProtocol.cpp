@@ -0,0 +1,373 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiStreamProtocol.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+namespace RPhi
+{
+
+const double StreamProtocol::kValueResolution = 1e-6;
+
+// Kind, serial number, channel and time, followed by the largest payload
+const std::size_t StreamFrameEncoder::kMaxRecordSize = 1 + 3*10 + ( StreamProtocol::kMaxNumValues*10 > Record::kTextSize ? StreamProtocol::kMaxNumValues*10 : Record::kTextSize );
+
+namespace
+{
+	int64_t quantize( double value )
+	{
+		return static_cast<int64_t>( floor( value / StreamProtocol::kValueResolution + 0.5 ) );
+	}
+
+	double unquantize( int64_t value )
+	{
+		return static_cast<double>(value) * StreamProtocol::kValueResolution;
+	}
+
+	// The channels a measure record is about. The channel of a Spatial measure is the 
+	// mask of the sensors read, which are the channels of a Spatial, 0 meaning all of 
+	// them (see Spatial::getRecordChannels())
+	uint32_t getChannelMask( const Record& record )
+	{
+		if ( record.mKind==Record::kSpatialMeasure )
+			return record.mChannel ? record.mChannel : 0xffffffff;
+		return record.mChannel<32 ? ( 1u << record.mChannel ) : 0xffffffff;
+	}
+}
+
+int StreamProtocol::getValues( const Record& record, int64_t* values )
+{
+	switch ( record.mKind )
+	{
+		case Record::kSpatialMeasure:
+		{
+			const Record::SpatialMeasure& measure = record.mSpatialMeasure;
+			for ( int i=0; i<3; ++i )
+			{
+				values[i] = quantize( measure.mAccelerationInGs[i] );
+				values[3+i] = quantize( measure.mAngularRateInDegPerSec[i] );
+				values[6+i] = quantize( measure.mMagneticFieldInGauss[i] );
+			}
+			return 9;
+		}
+		case Record::kThermocoupleMeasure:
+			values[0] = quantize( record.mThermocoupleMeasure.mTemperatureInC );
+			values[1] = quantize( record.mThermocoupleMeasure.mPotentialInMV );
+			return 2;
+		case Record::kAmbientTemperature:
+			values[0] = quantize( record.mAmbientTemperatureInC );
+			return 1;
+	}
+	return 0;
+}
+
+void StreamProtocol::setValues( Record& record, const int64_t* values )
+{
+	switch ( record.mKind )
+	{
+		case Record::kSpatialMeasure:
+		{
+			Record::SpatialMeasure& measure = record.mSpatialMeasure;
+			for ( int i=0; i<3; ++i )
+			{
+				measure.mAccelerationInGs[i] = unquantize( values[i] );
+				measure.mAngularRateInDegPerSec[i] = unquantize( values[3+i] );
+				measure.mMagneticFieldInGauss[i] = unquantize( values[6+i] );
+			}
+		}
+		break;
+		case Record::kThermocoupleMeasure:
+			record.mThermocoupleMeasure.mTemperatureInC = unquantize( values[0] );
+			record.mThermocoupleMeasure.mPotentialInMV = unquantize( values[1] );
+			break;
+		case Record::kAmbientTemperature:
+			record.mAmbientTemperatureInC = unquantize( values[0] );
+			break;
+	}
+}
+
+bool StreamProtocol::isMeasure( uint16_t kind )
+{
+	return kind==Record::kSpatialMeasure || kind==Record::kThermocoupleMeasure || kind==Record::kAmbientTemperature;
+}
+
+bool StreamProtocol::matches( const Filters& filters, const Record& record )
+{
+	// The description of a device is sent whatever the channels subscribed to
+	for ( Filters::const_iterator itr=filters.begin(); itr!=filters.end(); ++itr )
+	{
+		const Filter& filter = *itr;
+		if ( filter.mSerialNumber!=0 && filter.mSerialNumber!=record.mSerialNumber )
+			continue;
+		if ( !isMeasure(record.mKind) || (filter.mChannelMask & getChannelMask(record)) )
+			return true;
+	}
+	return false;
+}
+
+void StreamProtocol::writeSubscribeFrame( std::vector<uint8_t>& buffer, const Filters& filters )
+{
+	std::vector<uint8_t> frame;
+	frame.push_back( kSubscribeFrame );
+	writeVarint( frame, filters.size() );
+	for ( Filters::const_iterator itr=filters.begin(); itr!=filters.end(); ++itr )
+	{
+		writeVarint( frame, static_cast<uint32_t>(itr->mSerialNumber) );
+		writeVarint( frame, itr->mChannelMask );
+	}
+	writeVarint( buffer, frame.size() );
+	buffer.insert( buffer.end(), frame.begin(), frame.end() );
+}
+
+bool StreamProtocol::readSubscribeFrame( const uint8_t* data, std::size_t size, Filters& filters )
+{
+	std::size_t position = 0;
+	if ( size<1 || data[position++]!=kSubscribeFrame )
+		return false;
+	uint64_t numFilters = 0;
+	if ( !readVarint( data, size, position, numFilters ) || numFilters>size )
+		return false;
+	filters.resize( static_cast<std::size_t>(numFilters) );
+	for ( std::size_t i=0; i<filters.size(); ++i )
+	{
+		uint64_t serialNumber = 0;
+		uint64_t channelMask = 0;
+		if ( !readVarint( data, size, position, serialNumber ) || !readVarint( data, size, position, channelMask ) )
+			return false;
+		filters[i].mSerialNumber = static_cast<int32_t>(serialNumber);
+		filters[i].mChannelMask = static_cast<uint32_t>(channelMask);
+	}
+	return position==size;
+}
+
+StreamProtocol::Stream& StreamProtocol::getStream( Streams& streams, const Record& record )
+{
+	// A frame only refers to a handful of streams
+	for ( std::size_t i=0; i<streams.size(); ++i )
+	{
+		Stream& stream = streams[i];
+		if ( stream.mSerialNumber==record.mSerialNumber && stream.mKind==record.mKind && stream.mChannel==record.mChannel )
+			return stream;
+	}
+	Stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	stream.mSerialNumber = record.mSerialNumber;
+	stream.mKind = record.mKind;
+	stream.mChannel = record.mChannel;
+	streams.push_back( stream );
+	return streams.back();
+}
+
+void StreamProtocol::writeVarint( std::vector<uint8_t>& buffer, uint64_t value )
+{
+	while ( value>=0x80 )
+	{
+		buffer.push_back( static_cast<uint8_t>( value | 0x80 ) );
+		value >>= 7;
+	}
+	buffer.push_back( static_cast<uint8_t>(value) );
+}
+
+void StreamProtocol::writeSignedVarint( std::vector<uint8_t>& buffer, int64_t value )
+{
+	uint64_t zigzag = ( static_cast<uint64_t>(value) << 1 ) ^ static_cast<uint64_t>( value >> 63 );
+	writeVarint( buffer, zigzag );
+}
+
+bool StreamProtocol::readVarint( const uint8_t* data, std::size_t size, std::size_t& position, uint64_t& value )
+{
+	value = 0;
+	for ( int shift=0; shift<64; shift+=7 )
+	{
+		if ( position>=size )
+			return false;
+		uint8_t byte = data[position++];
+		value |= static_cast<uint64_t>( byte & 0x7f ) << shift;
+		if ( !(byte & 0x80) )
+			return true;
+	}
+	return false;
+}
+
+bool StreamProtocol::readSignedVarint( const uint8_t* data, std::size_t size, std::size_t& position, int64_t& value )
+{
+	uint64_t zigzag = 0;
+	if ( !readVarint( data, size, position, zigzag ) )
+		return false;
+	value = static_cast<int64_t>( zigzag >> 1 ) ^ -static_cast<int64_t>( zigzag & 1 );
+	return true;
+}
+
+StreamFrameEncoder::StreamFrameEncoder()
+	: mHeader(),
+	  mRecords(),
+	  mNumRecords(0),
+	  mPreviousSerialNumber(0),
+	  mPreviousTimeInUs(0),
+	  mStreams()
+{
+}
+
+void StreamFrameEncoder::begin( uint64_t sequenceNumber, uint64_t numDroppedRecords, int64_t baseTimeInUs )
+{
+	mHeader.clear();
+	mHeader.push_back( StreamProtocol::kRecordsFrame );
+	StreamProtocol::writeVarint( mHeader, sequenceNumber );
+	StreamProtocol::writeVarint( mHeader, numDroppedRecords );
+	StreamProtocol::writeVarint( mHeader, static_cast<uint64_t>(baseTimeInUs) );
+	mRecords.clear();
+	mNumRecords = 0;
+	mPreviousSerialNumber = 0;
+	mPreviousTimeInUs = baseTimeInUs;
+	mStreams.clear();
+}
+
+void StreamFrameEncoder::addRecord( const Record& record )
+{
+	mRecords.push_back( static_cast<uint8_t>(record.mKind) );
+	StreamProtocol::writeSignedVarint( mRecords, static_cast<int64_t>(record.mSerialNumber) - mPreviousSerialNumber );
+	StreamProtocol::writeVarint( mRecords, record.mChannel );
+	StreamProtocol::writeSignedVarint( mRecords, record.mTimeInUs - mPreviousTimeInUs );
+	mPreviousSerialNumber = record.mSerialNumber;
+	mPreviousTimeInUs = record.mTimeInUs;
+
+	if ( StreamProtocol::isMeasure(record.mKind) )
+	{
+		int64_t values[StreamProtocol::kMaxNumValues];
+		int numValues = StreamProtocol::getValues( record, values );
+		StreamProtocol::Stream& stream = StreamProtocol::getStream( mStreams, record );
+		for ( int i=0; i<numValues; ++i )
+		{
+			StreamProtocol::writeSignedVarint( mRecords, values[i] - stream.mValues[i] );
+			stream.mValues[i] = values[i];
+		}
+	}
+	else
+	{
+		const uint8_t* payload = reinterpret_cast<const uint8_t*>( record.mText );
+		mRecords.insert( mRecords.end(), payload, payload + Record::kTextSize );
+	}
+	++mNumRecords;
+}
+
+void StreamFrameEncoder::end( std::vector<uint8_t>& buffer, bool sizePrefixed )
+{
+	StreamProtocol::writeVarint( mHeader, mNumRecords );
+	if ( sizePrefixed )
+		StreamProtocol::writeVarint( buffer, mHeader.size() + mRecords.size() );
+	buffer.insert( buffer.end(), mHeader.begin(), mHeader.end() );
+	buffer.insert( buffer.end(), mRecords.begin(), mRecords.end() );
+	mHeader.clear();
+	mRecords.clear();
+}
+
+StreamFrameDecoder::StreamFrameDecoder()
+	: mSequenceNumber(0),
+	  mNumDroppedRecords(0),
+	  mStreams()
+{
+}
+
+bool StreamFrameDecoder::decode( const uint8_t* data, std::size_t size, std::vector<Record>& records )
+{
+	std::size_t position = 0;
+	if ( size<1 || data[position++]!=StreamProtocol::kRecordsFrame )
+		return false;
+
+	uint64_t sequenceNumber = 0;
+	uint64_t numDroppedRecords = 0;
+	uint64_t baseTimeInUs = 0;
+	uint64_t numRecords = 0;
+	if ( !StreamProtocol::readVarint( data, size, position, sequenceNumber ) ||
+		 !StreamProtocol::readVarint( data, size, position, numDroppedRecords ) ||
+		 !StreamProtocol::readVarint( data, size, position, baseTimeInUs ) ||
+		 !StreamProtocol::readVarint( data, size, position, numRecords ) )
+		return false;
+
+	std::size_t numInitialRecords = records.size();
+	mStreams.clear();
+	int64_t serialNumber = 0;
+	int64_t timeInUs = static_cast<int64_t>(baseTimeInUs);
+	for ( uint64_t i=0; i<numRecords; ++i )
+	{
+		int64_t serialNumberDelta = 0;
+		uint64_t channel = 0;
+		int64_t timeDelta = 0;
+		if ( position>=size )
+			break;
+		uint8_t kind = data[position++];
+		if ( !StreamProtocol::readSignedVarint( data, size, position, serialNumberDelta ) ||
+			 !StreamProtocol::readVarint( data, size, position, channel ) ||
+			 !StreamProtocol::readSignedVarint( data, size, position, timeDelta ) )
+			break;
+		serialNumber += serialNumberDelta;
+		timeInUs += timeDelta;
+
+		records.resize( records.size()+1 );
+		Record& record = records.back();
+		memset( &record, 0, sizeof(Record) );
+		record.mKind = kind;
+		record.mChannel = static_cast<uint16_t>(channel);
+		record.mSerialNumber = static_cast<int32_t>(serialNumber);
+		record.mTimeInUs = timeInUs;
+
+		if ( StreamProtocol::isMeasure(kind) )
+		{
+			int64_t values[StreamProtocol::kMaxNumValues];
+			int numValues = StreamProtocol::getValues( record, values );
+			StreamProtocol::Stream& stream = StreamProtocol::getStream( mStreams, record );
+			bool valid = true;
+			for ( int j=0; j<numValues && valid; ++j )
+			{
+				int64_t delta = 0;
+				valid = StreamProtocol::readSignedVarint( data, size, position, delta );
+				stream.mValues[j] += delta;
+				values[j] = stream.mValues[j];
+			}
+			if ( !valid )
+				break;
+			StreamProtocol::setValues( record, values );
+		}
+		else
+		{
+			if ( size-position<Record::kTextSize )
+				break;
+			memcpy( record.mText, data+position, Record::kTextSize );
+			position += Record::kTextSize;
+		}
+	}
+
+	if ( records.size()-numInitialRecords!=numRecords || position!=size )
+	{
+		records.resize( numInitialRecords );
+		return false;
+	}
+	mSequenceNumber = sequenceNumber;
+	mNumDroppedRecords = numDroppedRecords;
+	return true;
+}
+
+}
@@ -0,0 +1,410 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiStreamServer.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "RPhiClock.h"
+#include "RPhiRecordBuilder.h"
+
+/*
+	Notes:
+	- The network thread only sends the records of a TCP subscriber once everything 
+	  that was previously encoded for it has been sent. So a slow subscriber has 
+	  at most one batch of frames in flight, and its queue fills up
+	- The queues are reserved to their maximum size when the subscriber is 
+	  created, so queuing records never allocates memory
+*/
+namespace RPhi
+{
+
+namespace
+{
+	const std::size_t kMaxFrameSize = 32*1024;
+	const std::size_t kMaxInputSize = 64*1024;
+	const int64_t kMulticastDescriptionIntervalInUs = 1000000;
+}
+
+StreamServer::StreamServer( DeviceManager* deviceManager, int port, int maxNumQueuedRecords )
+	: mDeviceManager(deviceManager),
+	  mPort(0),
+	  mListenerHandle(Socket::kInvalidHandle),
+	  mMaxNumQueuedRecords(static_cast<std::size_t>(maxNumQueuedRecords)),
+	  mFlushIntervalInMs(10),
+	  mRecords(),
+	  mDescriptions(),
+	  mSubscribers(),
+	  mMulticastSubscriber(NULL),
+	  mMutex(),
+	  mEncoder(),
+	  mPollEntries(),
+	  mNumFramesSent(0),
+	  mNumRecordsDropped(0),
+	  mStopRequested(false),
+	  mNetworkThread()
+{
+	assert( mDeviceManager );
+	assert( maxNumQueuedRecords>0 );
+
+	mListenerHandle = Socket::createTcpListener( port, mPort );
+	if ( mListenerHandle==Socket::kInvalidHandle )
+		return;
+	
+	mNetworkThread = std::thread( &StreamServer::networkThreadMain, this );
+
+	// Describe the devices already there and start listening
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		onDeviceConnected( mDeviceManager, *itr );
+	mDeviceManager->addListener( this );
+}
+
+StreamServer::~StreamServer()
+{
+	if ( mListenerHandle==Socket::kInvalidHandle )
+		return;
+
+	mDeviceManager->removeListener( this );
+	const DeviceManager::Devices& devices = mDeviceManager->getDevices();
+	for ( DeviceManager::Devices::const_iterator itr=devices.begin(); itr!=devices.end(); ++itr )
+		(*itr)->removeListener( this );
+
+	mStopRequested = true;
+	mNetworkThread.join();
+
+	while ( !mSubscribers.empty() )
+		removeSubscriber( mSubscribers.back() );
+	Socket::close( mListenerHandle );
+	mListenerHandle = Socket::kInvalidHandle;
+}
+
+bool StreamServer::enableMulticast( const std::string& groupAddress, int port, int timeToLive )
+{
+	if ( !isOpen() || mMulticastSubscriber )
+		return false;
+	
+	Socket::Handle handle = Socket::createMulticastSender( groupAddress, port, timeToLive );
+	if ( handle==Socket::kInvalidHandle )
+		return false;
+
+	Subscriber* subscriber = createSubscriber( handle, true );
+	std::lock_guard<std::mutex> lock( mMutex );
+	mMulticastSubscriber = subscriber;
+	mSubscribers.push_back( subscriber );
+	queueDescriptions( subscriber );
+	return true;
+}
+
+void StreamServer::setFlushIntervalInMs( int flushIntervalInMs )
+{
+	assert( flushIntervalInMs>0 );
+	mFlushIntervalInMs = flushIntervalInMs;
+}
+
+int StreamServer::getNumSubscribers() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return static_cast<int>( mSubscribers.size() ) - ( mMulticastSubscriber ? 1 : 0 );
+}
+
+void StreamServer::onDeviceConnected( DeviceManager* /*deviceManager*/, Device* device )
+{
+	mRecords.clear();
+	RecordBuilder::appendDeviceDescription( device, Clock::getTimeInUs(), mRecords );
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mDescriptions[device->getSerialNumber()] = mRecords;
+		queueRecords( &mRecords[0], mRecords.size() );
+	}
+	device->addListener( this );
+}
+
+void StreamServer::onDeviceDisconnecting( DeviceManager* /*deviceManager*/, Device* device )
+{
+	device->removeListener( this );
+	mRecords.clear();
+	RecordBuilder::appendRecord( mRecords, Record::kDeviceDetached, device->getSerialNumber(), Clock::getTimeInUs() );
+	std::lock_guard<std::mutex> lock( mMutex );
+	mDescriptions.erase( device->getSerialNumber() );
+	queueRecords( &mRecords[0], mRecords.size() );
+}
+
+void StreamServer::onDeviceChanged( Device* device )
+{
+	mRecords.clear();
+	RecordBuilder::appendMeasures( device, Clock::getTimeInUs(), mRecords );
+	if ( mRecords.empty() )
+		return;
+	std::lock_guard<std::mutex> lock( mMutex );
+	queueRecords( &mRecords[0], mRecords.size() );
+}
+
+void StreamServer::queueRecords( const Record* records, std::size_t numRecords )
+{
+	for ( Subscribers::iterator itr=mSubscribers.begin(); itr!=mSubscribers.end(); ++itr )
+		queueRecords( *itr, records, numRecords );
+}
+
+bool StreamServer::isMeasure( const Record& record )
+{
+	return record.mKind==Record::kSpatialMeasure || 
+		   record.mKind==Record::kThermocoupleMeasure || 
+		   record.mKind==Record::kAmbientTemperature;
+}
+
+void StreamServer::queueRecords( Subscriber* subscriber, const Record* records, std::size_t numRecords )
+{
+	for ( std::size_t i=0; i<numRecords; ++i )
+	{
+		if ( !StreamProtocol::matches( subscriber->mFilters, records[i] ) )
+			continue;
+		// Only the measures are dropped for a TCP subscriber, which would otherwise be left 
+		// with a device never described or never detached. The queue can go over its bound 
+		// then. The multicast group gets the descriptions again every second
+		if ( subscriber->mQueuedRecords.size()<mMaxNumQueuedRecords || ( !subscriber->mIsMulticast && !isMeasure( records[i] ) ) )
+		{
+			subscriber->mQueuedRecords.push_back( records[i] );
+		}
+		else
+		{
+			++subscriber->mNumDroppedRecords;
+			++mNumRecordsDropped;
+		}
+	}
+}
+
+void StreamServer::queueDescriptions( Subscriber* subscriber )
+{
+	for ( Descriptions::const_iterator itr=mDescriptions.begin(); itr!=mDescriptions.end(); ++itr )
+		queueRecords( subscriber, &itr->second[0], itr->second.size() );
+}
+
+StreamServer::Subscriber* StreamServer::createSubscriber( Socket::Handle handle, bool isMulticast )
+{
+	Subscriber* subscriber = new Subscriber();
+	subscriber->mHandle = handle;
+	subscriber->mIsMulticast = isMulticast;
+	StreamProtocol::Filter filter;
+	filter.mSerialNumber = 0;
+	filter.mChannelMask = Device::kAllChannels;
+	subscriber->mFilters.push_back( filter );
+	subscriber->mQueuedRecords.reserve( mMaxNumQueuedRecords );
+	subscriber->mNumDroppedRecords = 0;
+	subscriber->mSendingRecords.reserve( mMaxNumQueuedRecords );
+	subscriber->mNumFrames = 0;
+	subscriber->mOutputPosition = 0;
+	return subscriber;
+}
+
+void StreamServer::removeSubscriber( Subscriber* subscriber )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		Subscribers::iterator itr = std::find( mSubscribers.begin(), mSubscribers.end(), subscriber );
+		assert( itr!=mSubscribers.end() );
+		mSubscribers.erase( itr );
+		if ( subscriber==mMulticastSubscriber )
+			mMulticastSubscriber = NULL;
+	}
+	Socket::close( subscriber->mHandle );
+	delete subscriber;
+}
+
+void StreamServer::networkThreadMain()
+{
+	int64_t lastMulticastDescriptionTimeInUs = Clock::getTimeInUs();
+	while ( !mStopRequested )
+	{
+		// Wait for new subscribers, subscription requests and room to send. 
+		// Only the network thread modifies mSubscribers, so it can read it without locking
+		mPollEntries.resize( mSubscribers.size()+1 );
+		mPollEntries[0].mHandle = mListenerHandle;
+		mPollEntries[0].mWantRead = true;
+		mPollEntries[0].mWantWrite = false;
+		for ( std::size_t i=0; i<mSubscribers.size(); ++i )
+		{
+			const Subscriber* subscriber = mSubscribers[i];
+			Socket::PollEntry& entry = mPollEntries[i+1];
+			entry.mHandle = subscriber->mHandle;
+			entry.mWantRead = !subscriber->mIsMulticast;
+			entry.mWantWrite = subscriber->mOutputPosition<subscriber->mOutput.size();
+		}
+		if ( !Socket::poll( mPollEntries, mFlushIntervalInMs ) )
+			std::this_thread::sleep_for( std::chrono::milliseconds(mFlushIntervalInMs) );
+
+		if ( mPollEntries[0].mReadable )
+			acceptSubscribers();
+		
+		if ( mMulticastSubscriber && Clock::getTimeInUs()-lastMulticastDescriptionTimeInUs>=kMulticastDescriptionIntervalInUs )
+		{
+			lastMulticastDescriptionTimeInUs = Clock::getTimeInUs();
+			std::lock_guard<std::mutex> lock( mMutex );
+			queueDescriptions( mMulticastSubscriber );
+		}
+
+		// The subscribers accepted above come after the polled ones. Going backwards 
+		// keeps the poll entries in sync when subscribers are removed
+		for ( std::size_t i=mSubscribers.size(); i>0; --i )
+		{
+			Subscriber* subscriber = mSubscribers[i-1];
+			bool polled = i<mPollEntries.size();
+			bool connected = true;
+			if ( polled && mPollEntries[i].mReadable && !subscriber->mIsMulticast )
+				connected = receiveFromSubscriber( subscriber );
+			if ( connected )
+				connected = sendToSubscriber( subscriber );
+			if ( !connected )
+				removeSubscriber( subscriber );
+		}
+	}
+}
+
+void StreamServer::acceptSubscribers()
+{
+	for ( ;; )
+	{
+		Socket::Handle handle = Socket::accept( mListenerHandle );
+		if ( handle==Socket::kInvalidHandle )
+			break;
+		Subscriber* subscriber = createSubscriber( handle, false );
+		std::lock_guard<std::mutex> lock( mMutex );
+		mSubscribers.push_back( subscriber );
+		queueDescriptions( subscriber );
+	}
+}
+
+bool StreamServer::receiveFromSubscriber( Subscriber* subscriber )
+{
+	uint8_t buffer[4096];
+	for ( ;; )
+	{
+		int numReceived = Socket::receive( subscriber->mHandle, buffer, sizeof(buffer) );
+		if ( numReceived<0 )
+			return false;
+		if ( numReceived==0 )
+			break;
+		subscriber->mInput.insert( subscriber->mInput.end(), buffer, buffer+numReceived );
+		if ( subscriber->mInput.size()>kMaxInputSize )
+			return false;
+	}
+
+	// Handle the complete frames
+	const uint8_t* data = subscriber->mInput.empty() ? NULL : &subscriber->mInput[0];
+	std::size_t size = subscriber->mInput.size();
+	std::size_t position = 0;
+	for ( ;; )
+	{
+		std::size_t framePosition = position;
+		uint64_t frameSize = 0;
+		if ( !StreamProtocol::readVarint( data, size, framePosition, frameSize ) || size-framePosition<frameSize )
+			break;
+		std::size_t frameEnd = framePosition + static_cast<std::size_t>(frameSize);
+		position = frameEnd;
+
+		// Ignore the frames this server doesn't know about
+		if ( frameSize==0 || data[framePosition]!=StreamProtocol::kSubscribeFrame )
+			continue;
+		StreamProtocol::Filters filters;
+		if ( !StreamProtocol::readSubscribeFrame( data+framePosition, static_cast<std::size_t>(frameSize), filters ) )
+			return false;
+
+		// Describe the devices again, as the subscriber may not have received some of them yet
+		std::lock_guard<std::mutex> lock( mMutex );
+		subscriber->mFilters.swap( filters );
+		queueDescriptions( subscriber );
+	}
+	subscriber->mInput.erase( subscriber->mInput.begin(), subscriber->mInput.begin()+position );
+	return true;
+}
+
+bool StreamServer::sendToSubscriber( Subscriber* subscriber )
+{
+	// Encode the queued records once the previous frames have been sent
+	if ( subscriber->mOutputPosition>=subscriber->mOutput.size() )
+	{
+		subscriber->mOutput.clear();
+		subscriber->mOutputPosition = 0;
+		
+		uint64_t numDroppedRecords = 0;
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			subscriber->mSendingRecords.swap( subscriber->mQueuedRecords );
+			numDroppedRecords = subscriber->mNumDroppedRecords;
+			subscriber->mNumDroppedRecords = 0;
+		}
+		if ( subscriber->mSendingRecords.empty() && numDroppedRecords==0 )
+			return true;
+		encodeFrames( subscriber, numDroppedRecords );
+		subscriber->mSendingRecords.clear();
+	}
+
+	// A multicast frame is sent as one datagram, whatever happens to it
+	if ( subscriber->mIsMulticast )
+		return true;
+
+	while ( subscriber->mOutputPosition<subscriber->mOutput.size() )
+	{
+		int numSent = Socket::send( subscriber->mHandle, &subscriber->mOutput[subscriber->mOutputPosition], subscriber->mOutput.size()-subscriber->mOutputPosition );
+		if ( numSent<0 )
+			return false;
+		if ( numSent==0 )
+			break;
+		subscriber->mOutputPosition += static_cast<std::size_t>(numSent);
+	}
+	return true;
+}
+
+void StreamServer::encodeFrames( Subscriber* subscriber, uint64_t numDroppedRecords )
+{
+	const std::vector<Record>& records = subscriber->mSendingRecords;
+	std::size_t maxFrameSize = subscriber->mIsMulticast ? static_cast<std::size_t>(kMaxDatagramSize) : kMaxFrameSize;
+	std::size_t index = 0;
+	do
+	{
+		int64_t baseTimeInUs = index<records.size() ? records[index].mTimeInUs : Clock::getTimeInUs();
+		mEncoder.begin( subscriber->mNumFrames++, numDroppedRecords, baseTimeInUs );
+		numDroppedRecords = 0;
+		while ( index<records.size() && mEncoder.getSize()+StreamFrameEncoder::kMaxRecordSize<=maxFrameSize )
+			mEncoder.addRecord( records[index++] );
+		
+		if ( subscriber->mIsMulticast )
+		{
+			subscriber->mOutput.clear();
+			mEncoder.end( subscriber->mOutput, false );
+			Socket::send( subscriber->mHandle, &subscriber->mOutput[0], subscriber->mOutput.size() );
+			subscriber->mOutput.clear();
+		}
+		else
+		{
+			mEncoder.end( subscriber->mOutput, true );
+		}
+		++mNumFramesSent;
+	}
+	while ( index<records.size() );
+}
+
+}
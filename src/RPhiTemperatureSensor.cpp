@@ -27,6 +27,9 @@
 #include <sstream>
 #include <phidget21.h>
 
+#include "RPhiRecordBuilder.h"
+#include "RPhiTrace.h"
+
 /*
 	Notes:
 	- The CPhidgetTemperatureSensor_setTemperatureChangeTrigger function is not exposed here. This is because we're 
@@ -44,7 +47,12 @@ TemperatureSensor::TemperatureSensor( CPhidgetHandle phidgetSpecificHandle )
 	  mThermocouples(),
 	  mAmbientTemperatureInC(0.0),
 	  mMinAmbientTemperatureInC(0.0),
-	  mMaxAmbientTemperatureInC(0.0)
+	  mMaxAmbientTemperatureInC(0.0),
+	  mAmbientTemperatureStale(true),
+	  mEnabledChannels(kAllChannels),
+	  mAcquiredThermocoupleMeasures(),
+	  mAcquiredAmbientTemperatureInC(0.0),
+	  mAcquiredChannels(0)
 {
 	// Get common Phidget information
 	getInformation();
@@ -53,6 +61,20 @@ TemperatureSensor::TemperatureSensor( CPhidgetHandle phidgetSpecificHandle )
 	getTemperatureSensorInformation();
 }
 
+TemperatureSensor::TemperatureSensor( const std::string& name, int serialNumber, int version, const std::string& typeName )
+	: Device( kTemperatureSensor, name, serialNumber, version, typeName ),
+	  mThermocouples(),
+	  mAmbientTemperatureInC(0.0),
+	  mMinAmbientTemperatureInC(0.0),
+	  mMaxAmbientTemperatureInC(0.0),
+	  mAmbientTemperatureStale(true),
+	  mEnabledChannels(kAllChannels),
+	  mAcquiredThermocoupleMeasures(),
+	  mAcquiredAmbientTemperatureInC(0.0),
+	  mAcquiredChannels(0)
+{
+}
+
 TemperatureSensor::~TemperatureSensor()
 {
 	// Delete the Thermocouples
@@ -60,6 +82,9 @@ TemperatureSensor::~TemperatureSensor()
 		delete (*itr);
 	mThermocouples.clear();
 
+	if ( !getPhidgetHandle() )
+		return;
+
 	// Close the device
 	int ret = EPHIDGET_OK;
 	ret = CPhidget_close( getPhidgetHandle() );
@@ -70,6 +95,21 @@ TemperatureSensor::~TemperatureSensor()
 	assert( ret==EPHIDGET_OK );
 }
 
+bool TemperatureSensor::isPhidgetDeviceID( int deviceID )
+{
+	return deviceID==PHIDID_TEMPERATURESENSOR;
+}
+
+CPhidgetHandle TemperatureSensor::createPhidgetHandle()
+{
+	CPhidgetHandle handle = NULL;
+	int ret = CPhidgetTemperatureSensor_create( reinterpret_cast<CPhidgetTemperatureSensorHandle*>(&handle) );
+	assert( ret==EPHIDGET_OK );
+	if ( ret!=EPHIDGET_OK )
+		return NULL;
+	return handle;
+}
+
 void TemperatureSensor::getTemperatureSensorInformation()
 {
 	// Create the Thermocouples 
@@ -90,33 +130,239 @@ void TemperatureSensor::getTemperatureSensorInformation()
 	assert( ret==EPHIDGET_OK );
 }
 
+void TemperatureSensor::addThermocouple( int index, Thermocouple::Type type, const Thermocouple::Measure& minMeasure, const Thermocouple::Measure& maxMeasure )
+{
+	assert( index==static_cast<int>(mThermocouples.size()) );
+	mThermocouples.push_back( new Thermocouple( index, type, minMeasure, maxMeasure ) );
+}
+
+void TemperatureSensor::setAmbientTemperatureRangeInC( double minTemperatureInC, double maxTemperatureInC )
+{
+	mMinAmbientTemperatureInC = minTemperatureInC;
+	mMaxAmbientTemperatureInC = maxTemperatureInC;
+}
+
+bool TemperatureSensor::setThermocoupleMeasure( int index, const Thermocouple::Measure& measure )
+{
+	assert( index>=0 && index<static_cast<int>(mThermocouples.size()) );
+	Thermocouple* thermocouple = mThermocouples[index];
+	thermocouple->mMeasureStale = false;
+	if ( measure==thermocouple->mMeasure )
+		return false;
+	addDeltaField( index, 0, thermocouple->mMeasure.getTemperatureInC(), measure.getTemperatureInC() );
+	addDeltaField( index, 1, thermocouple->mMeasure.getPotentialInMV(), measure.getPotentialInMV() );
+	thermocouple->mMeasure = measure;
+	return true;
+}
+
+bool TemperatureSensor::setAmbientTemperatureInC( double temperatureInC )
+{
+	mAmbientTemperatureStale = false;
+	if ( temperatureInC==mAmbientTemperatureInC )
+		return false;
+	addDeltaField( kAmbientChannel, 0, mAmbientTemperatureInC, temperatureInC );
+	mAmbientTemperatureInC = temperatureInC;
+	return true;
+}
+
+bool TemperatureSensor::updateAmbientTemperature( double& temperatureInC )
+{
+	RPHI_TRACE_SCOPE( "CPhidgetTemperatureSensor_getAmbientTemperature" );
+	double temperature = 0.0;
+	int ret = CPhidgetTemperatureSensor_getAmbientTemperature( getTemperatureSensorHandle(), &temperature );
+	if ( ret!=EPHIDGET_OK )
+		return false;
+	temperatureInC = temperature;
+	return true;
+}
+
+void TemperatureSensor::setChannelEnabled( int channel, bool enabled )
+{
+	assert( channel>=0 && channel<=kAmbientChannel );
+	if ( enabled )
+		mEnabledChannels |= getChannelMask(channel);
+	else
+		mEnabledChannels &= ~getChannelMask(channel);
+}
+
+TemperatureSensor::ChannelMask TemperatureSensor::getPolledChannels() const
+{
+	ChannelMask polledChannels = mEnabledChannels;
+	if ( !getListeners().empty() )
+		polledChannels &= getSubscribedChannels();
+	return polledChannels;
+}
+
 void TemperatureSensor::update()
 {
+	RPHI_TRACE_SCOPE_ARG( "TemperatureSensor::update", "serial", getSerialNumber() );
+
+	// Only poll the enabled channels somebody is interested in
+	ChannelMask polledChannels = getPolledChannels();
+
 	// Thermocouples
-	bool thermocouplesMeasureChanged = false;
+	ChannelMask changedChannels = 0;
 	for ( Thermocouples::iterator itr=mThermocouples.begin(); itr!=mThermocouples.end(); ++itr  )
 	{
-		if ( (*itr)->update() )
-			thermocouplesMeasureChanged = true;
+		Thermocouple* thermocouple = *itr;
+		ChannelMask channelMask = getChannelMask( thermocouple->getIndex() );
+		Thermocouple::Measure measure;
+		if ( !(polledChannels & channelMask) )
+		{
+			thermocouple->mMeasureStale = true;
+		}
+		else if ( !thermocouple->updateMeasure( measure ) )
+		{
+			countFailedCall();
+			thermocouple->mMeasureStale = true;
+		}
+		else if ( setThermocoupleMeasure( thermocouple->getIndex(), measure ) )
+		{
+			changedChannels |= channelMask;
+		}
 	}
 	
 	// Ambient temperature
-	bool ambientTemperatureChanged = false;
 	double ambientTemperature = 0.0;
-	int ret = CPhidgetTemperatureSensor_getAmbientTemperature( getTemperatureSensorHandle(), &ambientTemperature );	
-	assert( ret==EPHIDGET_OK );
-	if ( ambientTemperature!=mAmbientTemperatureInC )
+	if ( !(polledChannels & getChannelMask(kAmbientChannel)) )
+	{
+		mAmbientTemperatureStale = true;
+	}
+	else if ( !updateAmbientTemperature( ambientTemperature ) )
+	{
+		countFailedCall();
+		mAmbientTemperatureStale = true;
+	}
+	else if ( setAmbientTemperatureInC( ambientTemperature ) )
+	{
+		changedChannels |= getChannelMask(kAmbientChannel);
+	}
+
+	// Notify
+	if ( changedChannels )
+		notifyDeviceChanged( changedChannels );
+}
+
+void TemperatureSensor::setStaleChannels( ChannelMask channels )
+{
+	for ( Thermocouples::iterator itr=mThermocouples.begin(); itr!=mThermocouples.end(); ++itr  )
+	{
+		if ( channels & getChannelMask( (*itr)->getIndex() ) )
+			(*itr)->mMeasureStale = true;
+	}
+	if ( channels & getChannelMask(kAmbientChannel) )
+		mAmbientTemperatureStale = true;
+}
+
+void TemperatureSensor::acquire( ChannelMask polledChannels, bool resync, int64_t timeInUs, std::vector<Record>& records )
+{
+	RPHI_TRACE_SCOPE_ARG( "TemperatureSensor::acquire", "serial", getSerialNumber() );
+
+	// A channel which wasn't polled until now is sent even if its measure didn't change, 
+	// so that the dispatching side can clear its stale flag
+	ChannelMask sentChannels = resync ? polledChannels : ( polledChannels & ~mAcquiredChannels );
+	mAcquiredChannels = polledChannels;
+
+	// Thermocouples
+	mAcquiredThermocoupleMeasures.resize( mThermocouples.size() );
+	for ( std::size_t i=0; i<mThermocouples.size(); ++i )
+	{
+		Thermocouple* thermocouple = mThermocouples[i];
+		ChannelMask channelMask = getChannelMask( thermocouple->getIndex() );
+		if ( !(polledChannels & channelMask) )
+			continue;
+
+		Thermocouple::Measure measure;
+		if ( !thermocouple->updateMeasure( measure ) )
+		{
+			countFailedCall();
+			continue;
+		}
+		if ( measure==mAcquiredThermocoupleMeasures[i] && !(sentChannels & channelMask) )
+			continue;
+		mAcquiredThermocoupleMeasures[i] = measure;
+		RecordBuilder::appendThermocoupleMeasure( thermocouple->getIndex(), measure, getSerialNumber(), timeInUs, records );
+	}
+
+	// Ambient temperature
+	ChannelMask ambientChannelMask = getChannelMask(kAmbientChannel);
+	if ( polledChannels & ambientChannelMask )
+	{
+		double ambientTemperature = 0.0;
+		if ( !updateAmbientTemperature( ambientTemperature ) )
+			countFailedCall();
+		else if ( ambientTemperature!=mAcquiredAmbientTemperatureInC || (sentChannels & ambientChannelMask) )
+		{
+			mAcquiredAmbientTemperatureInC = ambientTemperature;
+			RecordBuilder::appendAmbientTemperature( ambientTemperature, getSerialNumber(), timeInUs, records );
+		}
+	}
+}
+
+TemperatureSensor::ChannelMask TemperatureSensor::applyRecord( const Record& record )
+{
+	switch ( record.mKind )
+	{
+		case Record::kThermocoupleMeasure:
+			if ( record.mChannel<mThermocouples.size() && setThermocoupleMeasure( record.mChannel, RecordBuilder::toThermocoupleMeasure( record.mThermocoupleMeasure ) ) )
+				return getChannelMask( record.mChannel );
+			break;
+
+		case Record::kAmbientTemperature:
+			if ( setAmbientTemperatureInC( record.mAmbientTemperatureInC ) )
+				return getChannelMask( kAmbientChannel );
+			break;
+	}
+	return 0;
+}
+
+void TemperatureSensor::appendDescription( std::size_t attachedRecordIndex, int64_t timeInUs, std::vector<Record>& records ) const
+{
+	Record::DeviceInfo& info = records[attachedRecordIndex].mDeviceInfo;
+	info.mNumThermocouples = static_cast<int32_t>( mThermocouples.size() );
+	info.mMinAmbientTemperatureInC = mMinAmbientTemperatureInC;
+	info.mMaxAmbientTemperatureInC = mMaxAmbientTemperatureInC;
+	for ( Thermocouples::const_iterator itr=mThermocouples.begin(); itr!=mThermocouples.end(); ++itr )
+	{
+		const Thermocouple* thermocouple = *itr;
+		Record& record = RecordBuilder::appendRecord( records, Record::kThermocoupleInfo, getSerialNumber(), timeInUs );
+		record.mChannel = static_cast<uint16_t>( thermocouple->getIndex() );
+		Record::ThermocoupleInfo& thermocoupleInfo = record.mThermocoupleInfo;
+		thermocoupleInfo.mType = thermocouple->getType();
+		thermocoupleInfo.mMinTemperatureInC = thermocouple->getMinMeasure().getTemperatureInC();
+		thermocoupleInfo.mMinPotentialInMV = thermocouple->getMinMeasure().getPotentialInMV();
+		thermocoupleInfo.mMaxTemperatureInC = thermocouple->getMaxMeasure().getTemperatureInC();
+		thermocoupleInfo.mMaxPotentialInMV = thermocouple->getMaxMeasure().getPotentialInMV();
+	}
+}
+
+void TemperatureSensor::appendMeasures( ChannelMask channels, int64_t timeInUs, std::vector<Record>& records ) const
+{
+	for ( Thermocouples::const_iterator itr=mThermocouples.begin(); itr!=mThermocouples.end(); ++itr )
 	{
-		mAmbientTemperatureInC = ambientTemperature;
-		ambientTemperatureChanged = true;
+		const Thermocouple* thermocouple = *itr;
+		if ( thermocouple->isMeasureStale() || !( channels & getChannelMask( thermocouple->getIndex() ) ) )
+			continue;
+		RecordBuilder::appendThermocoupleMeasure( thermocouple->getIndex(), thermocouple->getMeasure(), getSerialNumber(), timeInUs, records );
 	}
 
-	if ( thermocouplesMeasureChanged || ambientTemperatureChanged )
+	if ( !mAmbientTemperatureStale && ( channels & getChannelMask(kAmbientChannel) ) )
+		RecordBuilder::appendAmbientTemperature( mAmbientTemperatureInC, getSerialNumber(), timeInUs, records );
+}
+
+void TemperatureSensor::setDescription( const Record* records, std::size_t numRecords )
+{
+	const Record::DeviceInfo& info = records[0].mDeviceInfo;
+	setAmbientTemperatureRangeInC( info.mMinAmbientTemperatureInC, info.mMaxAmbientTemperatureInC );
+	for ( std::size_t i=1; i<numRecords; ++i )
 	{
-		// Notify
-		const Listeners& listeners = getListeners();
-		for ( Listeners::const_iterator itr=listeners.begin(); itr!=listeners.end(); ++itr )
-			(*itr)->onDeviceChanged( this );
+		if ( records[i].mKind!=Record::kThermocoupleInfo )
+			continue;
+		const Record::ThermocoupleInfo& thermocoupleInfo = records[i].mThermocoupleInfo;
+		addThermocouple( static_cast<int>( mThermocouples.size() ), 
+						 static_cast<Thermocouple::Type>(thermocoupleInfo.mType),
+						 Thermocouple::Measure( thermocoupleInfo.mMinTemperatureInC, thermocoupleInfo.mMinPotentialInMV ),
+						 Thermocouple::Measure( thermocoupleInfo.mMaxTemperatureInC, thermocoupleInfo.mMaxPotentialInMV ) );
 	}
 }
 
@@ -142,11 +388,23 @@ TemperatureSensor::Thermocouple::Thermocouple( CPhidgetTemperatureSensorHandle p
 	  mType(K_Type),
 	  mMeasure(),
 	  mMinMeasure(),
-	  mMaxMeasure()
+	  mMaxMeasure(),
+	  mMeasureStale(true)
 {
 	getThermocoupleInformation();	
 }
 
+TemperatureSensor::Thermocouple::Thermocouple( int index, Type type, const Measure& minMeasure, const Measure& maxMeasure )
+	: mParentTemperatureSensorHandle(NULL),
+	  mIndex(index),
+	  mType(type),
+	  mMeasure(),
+	  mMinMeasure(minMeasure),
+	  mMaxMeasure(maxMeasure),
+	  mMeasureStale(true)
+{
+}
+
 void TemperatureSensor::Thermocouple::getThermocoupleInformation()
 {
 	int ret = EPHIDGET_OK;
@@ -175,6 +433,9 @@ void TemperatureSensor::Thermocouple::getThermocoupleInformation()
 
 void TemperatureSensor::Thermocouple::setType( Type type )
 {
+	if ( !mParentTemperatureSensorHandle )
+		return;
+
 	CPhidgetTemperatureSensor_ThermocoupleType theType = static_cast<CPhidgetTemperatureSensor_ThermocoupleType>(type) ;
 	int ret = CPhidgetTemperatureSensor_setThermocoupleType( mParentTemperatureSensorHandle, mIndex, theType );
 	assert( ret==EPHIDGET_OK );
@@ -190,7 +451,12 @@ bool TemperatureSensor::Thermocouple::update()
 
 	// Get a new measure
 	Measure measure;
-	updateMeasure( measure );
+	if ( !updateMeasure( measure ) )
+	{
+		mMeasureStale = true;
+		return false;
+	}
+	mMeasureStale = false;
 
 	// Update the current measure with the new one
 	if ( measure!=mMeasure )
@@ -202,16 +468,25 @@ bool TemperatureSensor::Thermocouple::update()
 	return changed;
 }
 
-void TemperatureSensor::Thermocouple::updateMeasure( Measure& measure )
+bool TemperatureSensor::Thermocouple::updateMeasure( Measure& measure )
 {
 	double temperature;
 	double potential;
 	int ret = EPHIDGET_OK;
-	ret = CPhidgetTemperatureSensor_getTemperature( mParentTemperatureSensorHandle, mIndex, &temperature );
-	assert( ret==EPHIDGET_OK );
-	ret = CPhidgetTemperatureSensor_getPotential( mParentTemperatureSensorHandle, mIndex, &potential );
-	assert( ret==EPHIDGET_OK );
+	{
+		RPHI_TRACE_SCOPE( "CPhidgetTemperatureSensor_getTemperature" );
+		ret = CPhidgetTemperatureSensor_getTemperature( mParentTemperatureSensorHandle, mIndex, &temperature );
+	}
+	if ( ret!=EPHIDGET_OK )
+		return false;
+	{
+		RPHI_TRACE_SCOPE( "CPhidgetTemperatureSensor_getPotential" );
+		ret = CPhidgetTemperatureSensor_getPotential( mParentTemperatureSensorHandle, mIndex, &potential );
+	}
+	if ( ret!=EPHIDGET_OK )
+		return false;
 	measure = Measure( temperature, potential );
+	return true;
 }
 
 std::string TemperatureSensor::Thermocouple::toString() const
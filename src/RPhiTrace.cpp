@@ -0,0 +1,246 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RPhiTrace.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "RPhiClock.h"
+#include "RPhiSpscQueue.h"
+
+/*
+	Notes
+	- Each thread is the single producer of its buffer and flush() is the single
+	  consumer of all of them, serialized by the mutex. The mutex is only taken by 
+	  a recording thread once, to register its buffer
+	- The buffers are kept until the end of the program, as a thread may still be 
+	  recording into its buffer while tracing is stopped. The events left in the 
+	  buffers when stopping are discarded when starting again
+	- The trailing "]" of the JSON array is optional in the Chrome trace format, 
+	  so a trace cut short by a crash can still be opened
+*/
+namespace RPhi
+{
+
+namespace
+{
+	struct ThreadBuffer
+	{
+		ThreadBuffer( std::size_t capacity, int threadID )
+			: mEvents( capacity ),
+			  mThreadID( threadID ),
+			  mThreadName( NULL ),
+			  mThreadNameWritten( false )
+		{
+		}
+
+		SpscQueue<Trace::Event>	mEvents;
+		int						mThreadID;
+		const char*				mThreadName;
+		bool					mThreadNameWritten;
+	};
+
+	struct TraceState
+	{
+		TraceState()
+			: mStarted( false ),
+			  mNumDroppedEvents( 0 ),
+			  mMutex(),
+			  mBuffers(),
+			  mNumEventsPerThread( 65536 ),
+			  mFile( NULL ),
+			  mStartTimeInNs( 0 ),
+			  mNumEventsWritten( 0 )
+		{
+		}
+
+		~TraceState()
+		{
+			for ( std::size_t i=0; i<mBuffers.size(); ++i )
+				delete mBuffers[i];
+		}
+
+		std::atomic<bool>			mStarted;
+		std::atomic<uint64_t>		mNumDroppedEvents;
+		std::mutex					mMutex;				// Guards what follows
+		std::vector<ThreadBuffer*>	mBuffers;
+		std::size_t					mNumEventsPerThread;
+		FILE*						mFile;
+		long long					mStartTimeInNs;
+		uint64_t					mNumEventsWritten;
+	};
+
+	TraceState gTraceState;
+	thread_local ThreadBuffer* gThreadBuffer = NULL;
+
+	ThreadBuffer* getThreadBuffer()
+	{
+		if ( !gThreadBuffer )
+		{
+			std::lock_guard<std::mutex> lock( gTraceState.mMutex );
+			gThreadBuffer = new ThreadBuffer( gTraceState.mNumEventsPerThread, static_cast<int>(gTraceState.mBuffers.size()) + 1 );
+			gTraceState.mBuffers.push_back( gThreadBuffer );
+		}
+		return gThreadBuffer;
+	}
+
+	void writeSeparator()
+	{
+		if ( gTraceState.mNumEventsWritten++>0 )
+			fputs( ",\n", gTraceState.mFile );
+	}
+}
+
+/*
+	Trace
+*/
+bool Trace::start( const std::string& filename, std::size_t numEventsPerThread )
+{
+	std::lock_guard<std::mutex> lock( gTraceState.mMutex );
+	assert( !gTraceState.mFile );
+	if ( gTraceState.mFile )
+		return false;
+
+	FILE* file = fopen( filename.c_str(), "w" );
+	if ( !file )
+		return false;
+	fputs( "[\n", file );
+
+	// Discard what's left of a previous trace
+	Event event;
+	for ( std::size_t i=0; i<gTraceState.mBuffers.size(); ++i )
+	{
+		ThreadBuffer* buffer = gTraceState.mBuffers[i];
+		while ( buffer->mEvents.pop( event ) ) {}
+		buffer->mThreadNameWritten = false;
+	}
+
+	gTraceState.mFile = file;
+	gTraceState.mNumEventsPerThread = numEventsPerThread;
+	gTraceState.mStartTimeInNs = Clock::getMonotonicTimeInNs();
+	gTraceState.mNumEventsWritten = 0;
+	gTraceState.mNumDroppedEvents = 0;
+	gTraceState.mStarted = true;
+	return true;
+}
+
+void Trace::flush()
+{
+	std::lock_guard<std::mutex> lock( gTraceState.mMutex );
+	FILE* file = gTraceState.mFile;
+	if ( !file )
+		return;
+
+	Event event;
+	for ( std::size_t i=0; i<gTraceState.mBuffers.size(); ++i )
+	{
+		ThreadBuffer* buffer = gTraceState.mBuffers[i];
+		if ( buffer->mThreadName && !buffer->mThreadNameWritten )
+		{
+			writeSeparator();
+			fprintf( file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", 
+				buffer->mThreadID, buffer->mThreadName );
+			buffer->mThreadNameWritten = true;
+		}
+
+		while ( buffer->mEvents.pop( event ) )
+		{
+			writeSeparator();
+			double timeInUs = static_cast<double>( event.mStartTimeInNs - gTraceState.mStartTimeInNs ) / 1000.0;
+			double durationInUs = static_cast<double>( event.mDurationInNs ) / 1000.0;
+			fprintf( file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", 
+				event.mName, buffer->mThreadID, timeInUs, durationInUs );
+			if ( event.mArgName )
+				fprintf( file, ",\"args\":{\"%s\":%lld}", event.mArgName, static_cast<long long>(event.mArgValue) );
+			fputs( "}", file );
+		}
+	}
+}
+
+void Trace::stop()
+{
+	if ( !gTraceState.mStarted )
+		return;
+	gTraceState.mStarted = false;
+	flush();
+
+	std::lock_guard<std::mutex> lock( gTraceState.mMutex );
+	fputs( "\n]\n", gTraceState.mFile );
+	fclose( gTraceState.mFile );
+	gTraceState.mFile = NULL;
+}
+
+bool Trace::isStarted()
+{
+	return gTraceState.mStarted.load( std::memory_order_relaxed );
+}
+
+void Trace::setThreadName( const char* name )
+{
+	ThreadBuffer* buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock( gTraceState.mMutex );
+	buffer->mThreadName = name;
+	buffer->mThreadNameWritten = false;
+}
+
+uint64_t Trace::getNumDroppedEvents()
+{
+	return gTraceState.mNumDroppedEvents;
+}
+
+void Trace::addEvent( const Event& event )
+{
+	if ( !getThreadBuffer()->mEvents.push( event ) )
+		gTraceState.mNumDroppedEvents.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/*
+	TraceScope
+*/
+TraceScope::TraceScope( const char* name, const char* argName, int64_t argValue )
+	: mName( name ),
+	  mArgName( argName ),
+	  mArgValue( argValue ),
+	  mStartTimeInNs( Trace::isStarted() ? Clock::getMonotonicTimeInNs() : -1 )
+{
+}
+
+TraceScope::~TraceScope()
+{
+	if ( mStartTimeInNs<0 || !Trace::isStarted() )
+		return;
+
+	Trace::Event event;
+	event.mName = mName;
+	event.mArgName = mArgName;
+	event.mArgValue = mArgValue;
+	event.mStartTimeInNs = mStartTimeInNs;
+	event.mDurationInNs = Clock::getMonotonicTimeInNs() - mStartTimeInNs;
+	Trace::addEvent( event );
+}
+
+}